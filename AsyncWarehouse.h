@@ -0,0 +1,418 @@
+#ifndef _ASYNC_WAREHOUSE_H
+#define _ASYNC_WAREHOUSE_H
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Warehouse.h"
+
+//! Queue of nodes with many producers and one consumer, which never blocks the producers
+//!
+//! The queue is the intrusive queue of Dmitry Vyukov: a producer exchanges the tail with its
+//! node and links the previous tail to it, so a push is a single atomic exchange and a store.
+//! The consumer follows the links from the head. A push that exchanged the tail, but did not
+//! link the node yet, is not visible to the consumer, which sees the queue as not empty and
+//! retries. The queue does not own its nodes.
+class MpscQueue
+{
+public:
+  struct Node
+  {
+    std::atomic<Node*> pNext{nullptr};
+  };
+
+  MpscQueue(): mpTail(&mStub), mpHead(&mStub) {}
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue& operator=(const MpscQueue &) = delete;
+
+  //! Push the node \p pNode, may be called by any thread
+  //!
+  //! Algorithm's time complexity: O(1), wait-free
+  void Push(Node *pNode)
+  {
+    pNode->pNext.store(nullptr, std::memory_order_relaxed);
+    // the exchange is sequentially consistent, so either the consumer sees the node after
+    // it announced it is going to wait, or the producer sees the announcement, see AsyncWarehouse
+    Node *pPrev = mpTail.exchange(pNode, std::memory_order_seq_cst);
+    pPrev->pNext.store(pNode, std::memory_order_release);
+  }
+
+  //! Pop the node pushed first, may be called only by the consumer
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \return the popped node, or nullptr if the queue is empty or its first node is not linked yet
+  Node* Pop()
+  {
+    Node *pHead = mpHead;
+    Node *pNext = pHead->pNext.load(std::memory_order_acquire);
+    if(pHead == &mStub)
+    {
+      if(!pNext)
+      {
+        return nullptr;
+      }
+      mpHead = pNext;
+      pHead = pNext;
+      pNext = pNext->pNext.load(std::memory_order_acquire);
+    }
+    if(pNext)
+    {
+      mpHead = pNext;
+      return pHead;
+    }
+
+    // the head is the last node, it is popped after the stub is pushed behind it
+    if(pHead != mpTail.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+    Push(&mStub);
+    pNext = pHead->pNext.load(std::memory_order_acquire);
+    if(pNext)
+    {
+      mpHead = pNext;
+      return pHead;
+    }
+    return nullptr;
+  }
+
+  //! Whether a node was pushed, but not popped yet, may be called only by the consumer
+  bool HasNodes() const
+  {
+    return mpHead != &mStub || mpTail.load(std::memory_order_seq_cst) != &mStub;
+  }
+
+private:
+  alignas(64) std::atomic<Node*> mpTail;  //!< the node pushed last, updated by the producers
+  alignas(64) Node *mpHead;               //!< the node to pop next, updated by the consumer only
+  Node mStub;                             //!< node that keeps the queue linked when it is empty
+};
+
+//! Warehouse whose modifications are queued and applied by a dedicated writer thread
+//!
+//! The *Async() methods push a request to a lock-free queue and return at once, so the calling
+//! threads never wait for the lock of the warehouse. The writer thread pops the requests in the
+//! order of the pushes and applies them in batches: the consecutive additions and removals are
+//! applied by WarehouseT::AddProducts() and WarehouseT::RemoveProductsById(), which take the
+//! lock once per run. The result of a request is reported by the returned future or by the given
+//! completion callback, which is invoked on the writer thread, so it must not call Flush().
+//!
+//! The requests of one thread are applied in its order, so a reader sees its own writes after
+//! their futures become ready, or after Flush(). The lookups and the synchronous modifications
+//! are the ones of \p WarehouseT; the latter are not ordered with the queued requests.
+//!
+//! \tparam WarehouseT warehouse to apply the modifications to, e.g. Warehouse
+template <typename WarehouseT>
+class AsyncWarehouse: public WarehouseT
+{
+public:
+  using ProductPtr = typename WarehouseT::ProductPtr;
+
+  //! Callback that is invoked with the result of a request on the writer thread
+  using Callback = std::function<void(bool)>;
+
+  //! Maximal number of requests applied in one batch
+  static constexpr size_t kMaxBatchSize = 256;
+
+  //! Create a warehouse from the arguments \p args of WarehouseT and start its writer thread
+  template <typename... Args>
+  explicit AsyncWarehouse(Args&&... args): WarehouseT(std::forward<Args>(args)...)
+  {
+    mWriter = std::thread([this]() { RunWriter(); });
+  }
+
+  //! Apply all queued requests and stop the writer thread
+  //!
+  //! \pre no request is pushed concurrently
+  ~AsyncWarehouse()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex);
+      mIsStopping = true;
+    }
+    mWakeup.notify_one();
+    mWriter.join();
+  }
+
+  AsyncWarehouse(const AsyncWarehouse &) = delete;
+  AsyncWarehouse& operator=(const AsyncWarehouse &) = delete;
+
+  //! Queue WarehouseT::AddProduct() of the product \p pProduct
+  //!
+  //! Algorithm's time complexity: O(1) for the caller, see WarehouseT::AddProducts() for the writer
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return the future of true if the product was added, false otherwise
+  std::future<bool> AddProductAsync(ProductPtr pProduct)
+  {
+    auto pRequest = MakeRequest(RequestType::Add);
+    pRequest->pProduct = std::move(pProduct);
+    return PushWithFuture(std::move(pRequest));
+  }
+
+  //! The same as AddProductAsync(ProductPtr), but the result is passed to the callback \p callback
+  void AddProductAsync(ProductPtr pProduct, Callback callback)
+  {
+    auto pRequest = MakeRequest(RequestType::Add);
+    pRequest->pProduct = std::move(pProduct);
+    pRequest->callback = std::move(callback);
+    Push(std::move(pRequest));
+  }
+
+  //! Queue WarehouseT::UpsertProduct() of the product \p pProduct
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return the future of true if the product was added, false if it replaced the product with the same id
+  std::future<bool> UpsertProductAsync(ProductPtr pProduct)
+  {
+    auto pRequest = MakeRequest(RequestType::Upsert);
+    pRequest->pProduct = std::move(pProduct);
+    return PushWithFuture(std::move(pRequest));
+  }
+
+  //! The same as UpsertProductAsync(ProductPtr), but the result is passed to the callback \p callback
+  void UpsertProductAsync(ProductPtr pProduct, Callback callback)
+  {
+    auto pRequest = MakeRequest(RequestType::Upsert);
+    pRequest->pProduct = std::move(pProduct);
+    pRequest->callback = std::move(callback);
+    Push(std::move(pRequest));
+  }
+
+  //! Queue WarehouseT::UpdatePrice() of the product with the id \p id
+  //!
+  //! \return the future of true if the warehouse had the product with the given id, false otherwise
+  std::future<bool> UpdatePriceAsync(std::string_view id, Product::Price price)
+  {
+    auto pRequest = MakeRequest(RequestType::UpdatePrice);
+    pRequest->id = id;
+    pRequest->price = price;
+    return PushWithFuture(std::move(pRequest));
+  }
+
+  //! The same as UpdatePriceAsync(std::string_view, Product::Price), but the result is passed to
+  //! the callback \p callback
+  void UpdatePriceAsync(std::string_view id, Product::Price price, Callback callback)
+  {
+    auto pRequest = MakeRequest(RequestType::UpdatePrice);
+    pRequest->id = id;
+    pRequest->price = price;
+    pRequest->callback = std::move(callback);
+    Push(std::move(pRequest));
+  }
+
+  //! Queue WarehouseT::RemoveProductById() of the product with the id \p id
+  //!
+  //! \return the future of true if the product was removed, false otherwise
+  std::future<bool> RemoveProductByIdAsync(std::string_view id)
+  {
+    auto pRequest = MakeRequest(RequestType::Remove);
+    pRequest->id = id;
+    return PushWithFuture(std::move(pRequest));
+  }
+
+  //! The same as RemoveProductByIdAsync(std::string_view), but the result is passed to the
+  //! callback \p callback
+  void RemoveProductByIdAsync(std::string_view id, Callback callback)
+  {
+    auto pRequest = MakeRequest(RequestType::Remove);
+    pRequest->id = id;
+    pRequest->callback = std::move(callback);
+    Push(std::move(pRequest));
+  }
+
+  //! Wait until all requests queued before the call are applied
+  //!
+  //! The requests of the other threads that are queued concurrently may be applied as well.
+  //!
+  //! \pre the calling thread is not the writer thread, i.e. it is not called by a callback
+  void Flush()
+  {
+    PushWithFuture(MakeRequest(RequestType::Flush)).wait();
+  }
+
+private:
+  enum class RequestType { Add, Upsert, UpdatePrice, Remove, Flush };
+
+  struct Request: MpscQueue::Node
+  {
+    RequestType type = RequestType::Flush;
+    ProductPtr pProduct;            //!< product of Add and Upsert
+    std::string id;                 //!< id of UpdatePrice and Remove
+    Product::Price price = 0;       //!< price of UpdatePrice
+    std::optional<std::promise<bool>> promise;
+    Callback callback;
+
+    void Complete(bool result)
+    {
+      if(promise)
+      {
+        promise->set_value(result);
+      }
+      if(callback)
+      {
+        callback(result);
+      }
+    }
+  };
+
+  static std::unique_ptr<Request> MakeRequest(RequestType type)
+  {
+    auto pRequest = std::make_unique<Request>();
+    pRequest->type = type;
+    return pRequest;
+  }
+
+  std::future<bool> PushWithFuture(std::unique_ptr<Request> pRequest)
+  {
+    std::future<bool> future = pRequest->promise.emplace().get_future();
+    Push(std::move(pRequest));
+    return future;
+  }
+
+  //! Push the request \p pRequest, which is owned by the writer thread afterwards
+  void Push(std::unique_ptr<Request> pRequest)
+  {
+    mQueue.Push(pRequest.release());
+    if(mIsWriterWaiting.load(std::memory_order_seq_cst))
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex);
+      mWakeup.notify_one();
+    }
+  }
+
+  //! Loop of the writer thread, which exits once it is stopping and all requests are applied
+  void RunWriter()
+  {
+    std::vector<std::unique_ptr<Request>> batch;
+    batch.reserve(kMaxBatchSize);
+    for(;;)
+    {
+      while(batch.size() < kMaxBatchSize)
+      {
+        MpscQueue::Node *pNode = mQueue.Pop();
+        if(!pNode)
+        {
+          break;
+        }
+        batch.emplace_back(static_cast<Request*>(pNode));
+      }
+
+      if(!batch.empty())
+      {
+        ApplyBatch(batch);
+        batch.clear();
+      }
+      else if(mQueue.HasNodes())
+      {
+        // a producer exchanged the tail, but did not link its request yet
+        std::this_thread::yield();
+      }
+      else if(!WaitForRequests())
+      {
+        return;
+      }
+    }
+  }
+
+  //! Wait until a request is pushed or the warehouse is stopping
+  //!
+  //! The writer announces the wait before checking the queue, and a producer checks the
+  //! announcement after pushing, both sequentially consistent, so no push is missed.
+  //!
+  //! \return false if the warehouse is stopping and all requests are applied
+  bool WaitForRequests()
+  {
+    mIsWriterWaiting.store(true, std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> lock(mWakeMutex);
+    mWakeup.wait(lock, [this]() { return mIsStopping || mQueue.HasNodes(); });
+    mIsWriterWaiting.store(false, std::memory_order_relaxed);
+    return !mIsStopping || mQueue.HasNodes();
+  }
+
+  //! Apply the requests of the batch \p batch in order and complete them
+  void ApplyBatch(std::vector<std::unique_ptr<Request>> &batch)
+  {
+    std::vector<ProductPtr> products;
+    std::vector<std::string_view> ids;
+    std::vector<bool> results;
+    for(size_t first = 0; first < batch.size(); )
+    {
+      // the run of the requests of the same type that are applied at once
+      const RequestType type = batch[first]->type;
+      size_t last = first + 1;
+      if(type == RequestType::Add || type == RequestType::Remove)
+      {
+        while(last < batch.size() && batch[last]->type == type)
+        {
+          ++last;
+        }
+      }
+
+      results.clear();
+      switch(type)
+      {
+      case RequestType::Add:
+        products.clear();
+        for(size_t i = first; i < last; ++i)
+        {
+          products.push_back(std::move(batch[i]->pProduct));
+        }
+        WarehouseT::AddProducts(products.begin(), products.end(), std::back_inserter(results));
+        break;
+      case RequestType::Remove:
+        ids.clear();
+        for(size_t i = first; i < last; ++i)
+        {
+          ids.push_back(batch[i]->id);
+        }
+        WarehouseT::RemoveProductsById(ids.begin(), ids.end(), std::back_inserter(results));
+        break;
+      case RequestType::Upsert:
+        results.push_back(WarehouseT::UpsertProduct(batch[first]->pProduct));
+        break;
+      case RequestType::UpdatePrice:
+        results.push_back(WarehouseT::UpdatePrice(batch[first]->id, batch[first]->price));
+        break;
+      case RequestType::Flush:
+        results.push_back(true);
+        break;
+      }
+
+      assert(results.size() == last - first);
+      for(size_t i = first; i < last; ++i)
+      {
+        batch[i]->Complete(results[i - first]);
+      }
+      first = last;
+    }
+  }
+
+  MpscQueue mQueue;
+
+  std::atomic<bool> mIsWriterWaiting{false};
+  bool mIsStopping = false;   //!< guarded by mWakeMutex
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeup;
+
+  std::thread mWriter;
+};
+
+#endif
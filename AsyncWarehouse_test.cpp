@@ -0,0 +1,199 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "AsyncWarehouse.h"
+#include "ShardedWarehouse.h"
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<class... Args>
+std::shared_ptr<Product> MakeProduct(Args&&... args)
+{
+  return std::make_shared<Product>(Product{std::forward<Args>(args)...});
+}
+
+TEST_CASE("queue with many producers and one consumer") {
+
+  struct Item: MpscQueue::Node
+  {
+    int producer = 0;
+    int value = 0;
+  };
+
+  MpscQueue queue;
+  CHECK(!queue.HasNodes());
+  CHECK(queue.Pop() == nullptr);
+
+  SUBCASE("the nodes are popped in the order of the pushes") {
+    std::vector<Item> items(3);
+    for(auto &item : items)
+    {
+      queue.Push(&item);
+    }
+    CHECK(queue.HasNodes());
+    CHECK(queue.Pop() == &items[0]);
+    CHECK(queue.Pop() == &items[1]);
+    CHECK(queue.Pop() == &items[2]);
+    CHECK(queue.Pop() == nullptr);
+    CHECK(!queue.HasNodes());
+
+    // the queue is reused after it was emptied
+    queue.Push(&items[1]);
+    CHECK(queue.Pop() == &items[1]);
+    CHECK(!queue.HasNodes());
+  }
+
+  SUBCASE("the nodes of every producer are popped in its order") {
+    const int cntProducers = 4;
+    const int cntItems = 10000;
+    std::vector<std::vector<Item>> items;
+    for(int p = 0; p < cntProducers; ++p)
+    {
+      items.emplace_back(cntItems);
+    }
+    std::vector<std::thread> producers;
+    for(int p = 0; p < cntProducers; ++p)
+    {
+      producers.emplace_back([&queue, &items, p]() {
+        for(int i = 0; i < cntItems; ++i)
+        {
+          items[p][i].producer = p;
+          items[p][i].value = i;
+          queue.Push(&items[p][i]);
+        }
+      });
+    }
+
+    std::vector<int> nextValues(cntProducers, 0);
+    for(int cntPopped = 0; cntPopped < cntProducers * cntItems; )
+    {
+      if(auto *pItem = static_cast<Item*>(queue.Pop()))
+      {
+        REQUIRE(pItem->value == nextValues[pItem->producer]);
+        nextValues[pItem->producer]++;
+        cntPopped++;
+      }
+    }
+    for(auto &producer : producers)
+    {
+      producer.join();
+    }
+    CHECK(!queue.HasNodes());
+  }
+}
+
+TEST_CASE("modifying the warehouse asynchronously") {
+
+  AsyncWarehouse<Warehouse> wh;
+
+  SUBCASE("the futures report the results of the modifications") {
+    auto added = wh.AddProductAsync(MakeProduct("id1", "producer", "name", 1u));
+    auto notAdded = wh.AddProductAsync(MakeProduct("id1", "producer", "name", 2u));
+    auto upserted = wh.UpsertProductAsync(MakeProduct("id2", "producer", "name", 3u));
+    auto priceUpdated = wh.UpdatePriceAsync("id2", 4u);
+    auto priceNotUpdated = wh.UpdatePriceAsync("id3", 4u);
+    auto removed = wh.RemoveProductByIdAsync("id1");
+    auto notRemoved = wh.RemoveProductByIdAsync("id1");
+
+    CHECK(added.get() == true);
+    CHECK(notAdded.get() == false);
+    CHECK(upserted.get() == true);
+    CHECK(priceUpdated.get() == true);
+    CHECK(priceNotUpdated.get() == false);
+    CHECK(removed.get() == true);
+    CHECK(notRemoved.get() == false);
+
+    CHECK(wh.FindProductById("id1") == nullptr);
+    CHECK(wh.FindProductById("id2")->price == 4);
+  }
+
+  SUBCASE("the callbacks report the results of the modifications") {
+    std::vector<bool> results;
+    wh.AddProductAsync(MakeProduct("id1", "producer", "name", 1u), [&results](bool result) { results.push_back(result); });
+    wh.AddProductAsync(MakeProduct("id1", "producer", "name", 1u), [&results](bool result) { results.push_back(result); });
+    wh.UpsertProductAsync(MakeProduct("id1", "producer", "name", 2u), [&results](bool result) { results.push_back(result); });
+    wh.UpdatePriceAsync("id1", 3u, [&results](bool result) { results.push_back(result); });
+    wh.RemoveProductByIdAsync("id2", [&results](bool result) { results.push_back(result); });
+
+    // the callbacks are invoked before the flush completes
+    wh.Flush();
+    CHECK(results == std::vector<bool>{true, false, false, true, false});
+    CHECK(wh.FindProductById("id1")->price == 3);
+  }
+
+  SUBCASE("a flush waits for all queued modifications") {
+    for(int i = 0; i < 1000; ++i)
+    {
+      wh.AddProductAsync(MakeProduct("id" + std::to_string(i), "producer", "name", 1u), nullptr);
+      if(i % 3 == 0)
+      {
+        wh.RemoveProductByIdAsync("id" + std::to_string(i / 2), nullptr);
+      }
+    }
+    wh.Flush();
+
+    // the removals are applied in order with the additions, so the 334 removed ids were added already
+    CHECK(wh.CountProductsByProducer("producer") == 666);
+    CHECK(wh.FindProductById("id0") == nullptr);
+    CHECK(wh.FindProductById("id1") == nullptr);
+    CHECK(wh.FindProductById("id2") != nullptr);
+    CHECK(wh.FindProductById("id999") != nullptr);
+  }
+
+  SUBCASE("flushing the empty queue returns at once") {
+    wh.Flush();
+    wh.Flush();
+    CHECK(wh.CountProductsByProducer("producer") == 0);
+  }
+}
+
+TEST_CASE("modifying the warehouse asynchronously from several threads") {
+
+  AsyncWarehouse<ShardedWarehouse<4, SharedLocking>> wh;
+  std::vector<std::thread> threads;
+  std::atomic<size_t> cntAdded{0};
+  for(int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&wh, &cntAdded, t]() {
+      for(int i = 0; i < 1000; ++i)
+      {
+        const std::string id = std::to_string(t) + "_" + std::to_string(i);
+        wh.AddProductAsync(MakeProduct(id, "producer", "name", 1u), [&cntAdded](bool result) { cntAdded += result; });
+        if(i % 2 == 0)
+        {
+          wh.RemoveProductByIdAsync(id, nullptr);
+        }
+      }
+
+      // the thread reads its own writes after the flush
+      wh.Flush();
+      CHECK(wh.FindProductById(std::to_string(t) + "_0") == nullptr);
+      CHECK(wh.FindProductById(std::to_string(t) + "_1") != nullptr);
+    });
+  }
+  for(auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  wh.Flush();
+  CHECK(cntAdded == 4000);
+  CHECK(wh.CountProductsByProducer("producer") == 2000);
+}
+
+TEST_CASE("the queued modifications are applied before the warehouse is destroyed") {
+
+  std::atomic<int> cntCompleted{0};
+  {
+    AsyncWarehouse<Warehouse> wh;
+    for(int i = 0; i < 100; ++i)
+    {
+      wh.AddProductAsync(MakeProduct("id" + std::to_string(i), "producer", "name", 1u),
+        [&cntCompleted](bool) { cntCompleted++; });
+    }
+  }
+  CHECK(cntCompleted == 100);
+}
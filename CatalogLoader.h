@@ -0,0 +1,810 @@
+#ifndef _CATALOG_LOADER_H
+#define _CATALOG_LOADER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Warehouse.h"
+
+//! Format of a catalog of products read by CatalogLoader
+enum class CatalogFormat
+{
+  //! Comma separated values: a product per line with the fields id, producer, name and price;
+  //! the fields may be quoted by '"' and a quoted field may contain delimiters, line breaks
+  //! and '"' written twice
+  Csv,
+
+  //! Newline delimited JSON: a product per line as an object with the members "id", "producer",
+  //! "name" (strings) and "price" (non-negative integer), other members are ignored
+  Ndjson
+};
+
+//! Options of CatalogLoader
+struct CatalogLoadOptions
+{
+  CatalogFormat format = CatalogFormat::Csv;
+
+  //! The first line of a CSV catalog names the columns, so the columns may come in any order
+  //! and the unknown ones are ignored; otherwise the columns are id, producer, name and price
+  bool hasCsvHeader = true;
+
+  char csvDelimiter = ',';
+
+  //! Number of bytes read at once and parsed by one thread
+  size_t chunkSize = size_t(4) << 20;
+
+  //! Number of threads parsing the chunks, 0 stands for std::thread::hardware_concurrency()
+  size_t cntThreads = 0;
+
+  //! Number of parsed products staged before they are added to the warehouse at once.
+  //! AddProducts() loads an empty warehouse by sorting instead of inserting one by one,
+  //! so staging the whole catalog is the fastest, while a smaller number bounds the staging
+  //! buffer (about 24 bytes per product).
+  size_t cntStagedProducts = SIZE_MAX;
+};
+
+//! Result of loading a catalog, see CatalogLoader::Load()
+struct CatalogLoadResult
+{
+  enum class Status
+  {
+    Ok,             //!< the whole catalog was read
+    InvalidHeader,  //!< the CSV header misses some of the columns, nothing was loaded
+    ReadError       //!< the stream failed before its end, the products read so far were loaded
+  };
+
+  Status status = Status::Ok;
+  size_t cntProducts = 0;         //!< number of parsed products
+  size_t cntAdded = 0;            //!< number of products added to the warehouse
+  size_t cntDuplicates = 0;       //!< number of products rejected, since their ids were not unique
+  size_t cntMalformed = 0;        //!< number of non-empty lines that are not products
+  size_t firstMalformedLine = 0;  //!< number (from 1) of the first malformed line, 0 if there is none
+};
+
+//! Streaming loader of a catalog of products into a warehouse
+//!
+//! The catalog is read in chunks cut at the line boundaries. The chunks are parsed into products
+//! by several threads, while the caller keeps reading the next chunks and stages the parsed ones,
+//! which are added to the warehouse by a single AddProducts() per cntStagedProducts products.
+//! The products are added in the order of the catalog, so the result is the same as of calling
+//! AddProduct() for every product of the catalog in order: of several products with the same id
+//! only the first one is added.
+//!
+//! At most cntThreads chunks are parsed at once, so the memory used besides the warehouse is
+//! bound by the chunk size, the number of threads and the staging buffer.
+//!
+//! The products are made by MakeProduct() of the warehouse, if it has one, on the parsing
+//! threads, so the memory resource of the warehouse has to be thread-safe.
+class CatalogLoader
+{
+public:
+  explicit CatalogLoader(const CatalogLoadOptions &options = CatalogLoadOptions()): mOptions(options)
+  {
+    if(mOptions.cntThreads == 0)
+    {
+      mOptions.cntThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mOptions.chunkSize = std::max<size_t>(mOptions.chunkSize, 1);
+  }
+
+  //! Load the catalog read from \p in into the warehouse \p wh
+  //!
+  //! \param[in] wh warehouse to add the products to, e.g. Warehouse, ShardedWarehouse or RcuWarehouse
+  //! \param[in] in stream to read the catalog from
+  //! \param[in] onDuplicate callable that is invoked as onDuplicate(size_t line, const ProductPtr&)
+  //!   with every product that was not added, since the warehouse already had its id, and the
+  //!   number of its line; it is invoked by the calling thread in the order of the catalog
+  //!
+  //! Algorithm's time complexity: O(L) for parsing, where L is size of the catalog, plus the time
+  //!   complexity of the warehouse's AddProducts() for all products
+  //!
+  //! \return counts of the loaded, rejected and malformed products
+  template <typename WarehouseT, typename DuplicateVisitor>
+  CatalogLoadResult Load(WarehouseT &wh, std::istream &in, DuplicateVisitor &&onDuplicate) const
+  {
+    using ProductPtr = typename WarehouseT::ProductPtr;
+
+    CatalogLoadResult result;
+    size_t firstLine = 1;
+
+    Columns columns = {0, 1, 2, 3};
+    if(mOptions.format == CatalogFormat::Csv && mOptions.hasCsvHeader)
+    {
+      std::string header;
+      if(!std::getline(in, header))
+      {
+        result.status = in.bad()? CatalogLoadResult::Status::ReadError : CatalogLoadResult::Status::InvalidHeader;
+        return result;
+      }
+      if(!ParseCsvHeader(header, columns))
+      {
+        result.status = CatalogLoadResult::Status::InvalidHeader;
+        return result;
+      }
+      firstLine = 2;
+    }
+
+    // The staged chunks are added to the warehouse by a single call, in the order of the catalog.
+    std::vector<ParsedChunk<ProductPtr>> stagedChunks;
+    std::vector<ProductPtr> stagedProducts;
+    auto addStagedProducts = [&]() {
+      std::vector<bool> added;
+      added.reserve(stagedProducts.size());
+      result.cntAdded += wh.AddProducts(stagedProducts.begin(), stagedProducts.end(), std::back_inserter(added));
+
+      size_t i = 0;
+      for(const ParsedChunk<ProductPtr> &chunk : stagedChunks)
+      {
+        for(const size_t line : chunk.lines)
+        {
+          if(!added[i])
+          {
+            result.cntDuplicates++;
+            onDuplicate(chunk.firstLine + line, static_cast<const ProductPtr&>(stagedProducts[i]));
+          }
+          ++i;
+        }
+      }
+      stagedChunks.clear();
+      stagedProducts.clear();
+    };
+
+    // the chunks being parsed, oldest first, which are staged in this order
+    std::deque<std::future<ParsedChunk<ProductPtr>>> parsedChunks;
+    auto stageOldestChunk = [&]() {
+      ParsedChunk<ProductPtr> chunk = parsedChunks.front().get();
+      parsedChunks.pop_front();
+
+      result.cntProducts += chunk.products.size();
+      if(chunk.cntMalformed != 0 && result.cntMalformed == 0)
+      {
+        result.firstMalformedLine = chunk.firstLine + chunk.firstMalformedLine;
+      }
+      result.cntMalformed += chunk.cntMalformed;
+
+      stagedProducts.insert(stagedProducts.end(), std::make_move_iterator(chunk.products.begin()),
+        std::make_move_iterator(chunk.products.end()));
+      chunk.products = std::vector<ProductPtr>();
+      stagedChunks.push_back(std::move(chunk));
+      if(stagedProducts.size() >= mOptions.cntStagedProducts)
+      {
+        addStagedProducts();
+      }
+    };
+
+    // Every chunk ends with a complete line, the rest of the read bytes starts the next chunk;
+    // the rest was already searched for the ends of the lines, so only the new bytes are.
+    std::string rest;
+    CsvScan scan;
+    for(bool isEnd = false; !isEnd; )
+    {
+      std::string text = std::move(rest);
+      rest.clear();
+      const size_t cntCarried = text.size();
+      text.resize(cntCarried + mOptions.chunkSize);
+      in.read(text.data() + cntCarried, static_cast<std::streamsize>(mOptions.chunkSize));
+      text.resize(cntCarried + static_cast<size_t>(in.gcount()));
+      isEnd = !in;
+
+      if(!isEnd)
+      {
+        const size_t end = EndOfLastLine(text, cntCarried, scan);
+        rest.assign(text, end, std::string::npos);
+        text.resize(end);
+      }
+      if(text.empty())
+      {
+        continue;
+      }
+
+      const size_t cntLines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+      if(parsedChunks.size() == mOptions.cntThreads)
+      {
+        stageOldestChunk();
+      }
+      parsedChunks.push_back(std::async(std::launch::async,
+        [this, &wh, &columns, firstLine](std::string text) { return Parse(wh, text, columns, firstLine); },
+        std::move(text)));
+      firstLine += cntLines;
+    }
+    while(!parsedChunks.empty())
+    {
+      stageOldestChunk();
+    }
+    addStagedProducts();
+
+    if(in.bad())
+    {
+      result.status = CatalogLoadResult::Status::ReadError;
+    }
+    return result;
+  }
+
+  //! Load the catalog read from \p in into the warehouse \p wh
+  //!
+  //! The same as Load(WarehouseT&, std::istream&, DuplicateVisitor&&), but without reporting
+  //! every rejected product.
+  template <typename WarehouseT>
+  CatalogLoadResult Load(WarehouseT &wh, std::istream &in) const
+  {
+    return Load(wh, in, [](size_t, const typename WarehouseT::ProductPtr &) {});
+  }
+
+private:
+  //! Indexes of the columns with the id, the producer, the name and the price of a product
+  using Columns = size_t[4];
+
+  enum Field { kId, kProducer, kName, kPrice, kFieldCount };
+
+  //! Products parsed from a chunk of the catalog
+  template <typename ProductPtr>
+  struct ParsedChunk
+  {
+    size_t firstLine = 0;             //!< number of the first line of the chunk
+    std::vector<ProductPtr> products;
+    std::vector<size_t> lines;        //!< line of every product, relative to the first line
+    size_t cntMalformed = 0;
+    size_t firstMalformedLine = 0;    //!< line of the first malformed product, relative to the first line
+  };
+
+  //! Fields of a product being parsed
+  struct ParsedFields
+  {
+    std::string strings[kName + 1];
+    Product::Price price = 0;
+    bool hasField[kFieldCount] = {};
+  };
+
+  template <typename WarehouseT, typename = void>
+  struct HasMakeProduct: std::false_type {};
+
+  template <typename WarehouseT>
+  struct HasMakeProduct<WarehouseT, std::void_t<decltype(std::declval<const WarehouseT&>().MakeProduct())>>:
+    std::true_type {};
+
+  //! State of the search for the ends of the CSV lines, carried from one read to the next
+  struct CsvScan
+  {
+    bool isQuoted = false;      //!< whether the scanned bytes end inside a quoted field
+    bool canOpenQuote = true;   //!< whether a quote opens a quoted field, i.e. the scanned bytes end
+                                //!< at the start of a field or right after a closing quote
+  };
+
+  //! Offset after the last line break of \p text that ends a line of the catalog,
+  //! 0 if \p text has no such line break
+  //!
+  //! Only the bytes from the offset \p from are scanned, the bytes before it hold no end of
+  //! a line. \p scan is the state of the search at \p from and is moved to the end of \p text.
+  //!
+  //! Algorithm's time complexity: O(size of \p text - \p from)
+  size_t EndOfLastLine(std::string_view text, size_t from, CsvScan &scan) const
+  {
+    const std::string_view scanned = text.substr(from);
+    const size_t lastLineBreak = scanned.rfind('\n');
+    if(mOptions.format == CatalogFormat::Ndjson)
+    {
+      return (lastLineBreak == std::string_view::npos)? 0 : from + lastLineBreak + 1;
+    }
+    if(!scan.isQuoted && scanned.find('"') == std::string_view::npos)
+    {
+      if(!scanned.empty())
+      {
+        scan.canOpenQuote = (scanned.back() == mOptions.csvDelimiter || scanned.back() == '\n');
+      }
+      return (lastLineBreak == std::string_view::npos)? 0 : from + lastLineBreak + 1;
+    }
+
+    // A line break inside a quoted CSV field does not end the line. Only a quote at the start of
+    // a field opens a quoted field, ParseCsvField() rejects the fields with stray quotes.
+    size_t end = 0;
+    for(size_t i = from; i < text.size(); ++i)
+    {
+      const char c = text[i];
+      if(scan.isQuoted)
+      {
+        // a doubled quote is closed and opened again right away
+        scan.isQuoted = (c != '"');
+        scan.canOpenQuote = !scan.isQuoted;
+      }
+      else if(c == '"' && scan.canOpenQuote)
+      {
+        scan.isQuoted = true;
+      }
+      else
+      {
+        scan.canOpenQuote = (c == mOptions.csvDelimiter || c == '\n');
+        if(c == '\n')
+        {
+          end = i + 1;
+        }
+      }
+    }
+    return end;
+  }
+
+  //! Parse the chunk \p text starting at the line \p firstLine into products of the warehouse \p wh
+  template <typename WarehouseT>
+  ParsedChunk<typename WarehouseT::ProductPtr> Parse(const WarehouseT &wh, std::string_view text,
+    const Columns &columns, size_t firstLine) const
+  {
+    ParsedChunk<typename WarehouseT::ProductPtr> chunk;
+    chunk.firstLine = firstLine;
+
+    ParsedFields fields;
+    size_t line = 0;
+    for(size_t pos = 0; pos < text.size(); )
+    {
+      const size_t lineOfProduct = line;
+      const size_t begin = pos;
+      const bool isParsed = (mOptions.format == CatalogFormat::Csv)?
+        ParseCsvLine(text, pos, columns, fields) : ParseNdjsonLine(text, pos, fields);
+      line += static_cast<size_t>(std::count(text.begin() + begin, text.begin() + pos, '\n'));
+
+      if(isParsed)
+      {
+        chunk.products.push_back(MakeProduct(wh, fields));
+        chunk.lines.push_back(lineOfProduct);
+      }
+      else if(!IsBlank(text.substr(begin, pos - begin)))
+      {
+        if(chunk.cntMalformed++ == 0)
+        {
+          chunk.firstMalformedLine = lineOfProduct;
+        }
+      }
+    }
+    return chunk;
+  }
+
+  template <typename WarehouseT>
+  static typename WarehouseT::ProductPtr MakeProduct(const WarehouseT &wh, ParsedFields &fields)
+  {
+    if constexpr(HasMakeProduct<WarehouseT>::value)
+    {
+      return wh.MakeProduct(std::move(fields.strings[kId]), std::move(fields.strings[kProducer]),
+        std::move(fields.strings[kName]), fields.price);
+    }
+    else
+    {
+      return std::make_shared<Product>(Product{std::move(fields.strings[kId]), std::move(fields.strings[kProducer]),
+        std::move(fields.strings[kName]), fields.price});
+    }
+  }
+
+  static bool IsBlank(std::string_view text)
+  {
+    return text.find_first_not_of(" \t\r\n") == std::string_view::npos;
+  }
+
+  static bool ParsePrice(std::string_view text, Product::Price &price)
+  {
+    const char *pEnd = text.data() + text.size();
+    const auto [ptr, error] = std::from_chars(text.data(), pEnd, price);
+    return error == std::errc() && ptr == pEnd && !text.empty();
+  }
+
+  //! Map the column names of the CSV header \p header to the columns of the fields
+  bool ParseCsvHeader(std::string_view header, Columns &columns) const
+  {
+    static constexpr std::string_view kNames[kFieldCount] = {"id", "producer", "name", "price"};
+
+    std::vector<std::string> names;
+    std::string name;
+    size_t pos = 0;
+    bool isLast = false;
+    while(!isLast)
+    {
+      if(!ParseCsvField(header, pos, name, isLast))
+      {
+        return false;
+      }
+      names.push_back(name);
+    }
+
+    for(size_t field = 0; field < kFieldCount; ++field)
+    {
+      const auto it = std::find(names.begin(), names.end(), kNames[field]);
+      if(it == names.end())
+      {
+        return false;
+      }
+      columns[field] = static_cast<size_t>(it - names.begin());
+    }
+    return true;
+  }
+
+  //! Parse the CSV field at the offset \p pos of \p text into \p field and move \p pos past
+  //! the delimiter or the line break after the field
+  //!
+  //! \return false if the field is malformed, \p pos is moved past the line then
+  bool ParseCsvField(std::string_view text, size_t &pos, std::string &field, bool &isLast) const
+  {
+    field.clear();
+    isLast = false;
+
+    auto finish = [&](size_t end) {
+      // the delimiter or the line break (with the carriage return before it) after the field
+      if(end < text.size() && text[end] == mOptions.csvDelimiter)
+      {
+        pos = end + 1;
+        return true;
+      }
+      if(end < text.size() && text[end] == '\r')
+      {
+        end++;
+      }
+      if(end == text.size() || text[end] == '\n')
+      {
+        pos = std::min(end + 1, text.size());
+        isLast = true;
+        return true;
+      }
+      return false;
+    };
+
+    if(pos < text.size() && text[pos] == '"')
+    {
+      for(size_t i = pos + 1; i < text.size(); ++i)
+      {
+        if(text[i] != '"')
+        {
+          field.push_back(text[i]);
+        }
+        else if(i + 1 < text.size() && text[i + 1] == '"')
+        {
+          field.push_back('"');
+          ++i;
+        }
+        else if(finish(i + 1))
+        {
+          return true;
+        }
+        else
+        {
+          break;
+        }
+      }
+    }
+    else
+    {
+      size_t end = pos;
+      while(end < text.size() && text[end] != mOptions.csvDelimiter && text[end] != '\n')
+      {
+        end++;
+      }
+      const size_t endOfField = (end > pos && text[end - 1] == '\r' && (end == text.size() || text[end] == '\n'))?
+        end - 1 : end;
+      field.assign(text.substr(pos, endOfField - pos));
+      if(text.substr(pos, end - pos).find('"') == std::string_view::npos)
+      {
+        pos = std::min(end + 1, text.size());
+        isLast = (end == text.size() || text[end] == '\n');
+        return true;
+      }
+    }
+
+    // the rest of the malformed line is skipped
+    const size_t lineBreak = text.find('\n', pos);
+    pos = (lineBreak == std::string_view::npos)? text.size() : lineBreak + 1;
+    isLast = true;
+    return false;
+  }
+
+  //! Parse the CSV line at the offset \p pos of \p text into \p fields and move \p pos past the line
+  bool ParseCsvLine(std::string_view text, size_t &pos, const Columns &columns, ParsedFields &fields) const
+  {
+    std::fill(std::begin(fields.hasField), std::end(fields.hasField), false);
+
+    std::string value;
+    bool isValid = true;
+    bool isLast = false;
+    for(size_t column = 0; !isLast; ++column)
+    {
+      if(!ParseCsvField(text, pos, value, isLast))
+      {
+        return false;
+      }
+      for(size_t field = 0; field < kFieldCount; ++field)
+      {
+        if(columns[field] != column)
+        {
+          continue;
+        }
+        fields.hasField[field] = true;
+        if(field == kPrice)
+        {
+          isValid &= ParsePrice(value, fields.price);
+        }
+        else
+        {
+          fields.strings[field] = value;
+        }
+      }
+    }
+    return isValid && std::all_of(std::begin(fields.hasField), std::end(fields.hasField), [](bool has) { return has; });
+  }
+
+  //! Reader of a JSON object on a single line
+  struct JsonReader
+  {
+    std::string_view text;
+    size_t pos = 0;
+
+    void SkipSpaces()
+    {
+      while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r'))
+      {
+        pos++;
+      }
+    }
+
+    bool Consume(char c)
+    {
+      SkipSpaces();
+      if(pos < text.size() && text[pos] == c)
+      {
+        pos++;
+        return true;
+      }
+      return false;
+    }
+
+    static void AppendUtf8(std::string &str, uint32_t codePoint)
+    {
+      if(codePoint < 0x80)
+      {
+        str.push_back(static_cast<char>(codePoint));
+      }
+      else if(codePoint < 0x800)
+      {
+        str.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      }
+      else if(codePoint < 0x10000)
+      {
+        str.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      }
+      else
+      {
+        str.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        str.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      }
+    }
+
+    bool ReadHex4(uint32_t &value)
+    {
+      if(text.size() - pos < 4)
+      {
+        return false;
+      }
+      const auto [ptr, error] = std::from_chars(text.data() + pos, text.data() + pos + 4, value, 16);
+      pos += 4;
+      return error == std::errc() && ptr == text.data() + pos;
+    }
+
+    bool ReadString(std::string &str)
+    {
+      str.clear();
+      if(!Consume('"'))
+      {
+        return false;
+      }
+      while(pos < text.size())
+      {
+        // the characters up to the next quote or escape are copied at once
+        const size_t end = text.find_first_of("\"\\", pos);
+        if(end == std::string_view::npos)
+        {
+          return false;
+        }
+        str.append(text.substr(pos, end - pos));
+        pos = end + 1;
+        if(text[end] == '"')
+        {
+          return true;
+        }
+        if(pos == text.size())
+        {
+          return false;
+        }
+        const char escaped = text[pos++];
+        switch(escaped)
+        {
+          case '"': case '\\': case '/': str.push_back(escaped); break;
+          case 'b': str.push_back('\b'); break;
+          case 'f': str.push_back('\f'); break;
+          case 'n': str.push_back('\n'); break;
+          case 'r': str.push_back('\r'); break;
+          case 't': str.push_back('\t'); break;
+          case 'u':
+          {
+            uint32_t codePoint = 0;
+            if(!ReadHex4(codePoint))
+            {
+              return false;
+            }
+            uint32_t low = 0;
+            if(codePoint >= 0xD800 && codePoint < 0xDC00 && text.substr(pos, 2) == "\\u")
+            {
+              pos += 2;
+              if(!ReadHex4(low) || low < 0xDC00 || low >= 0xE000)
+              {
+                return false;
+              }
+              codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            }
+            AppendUtf8(str, codePoint);
+            break;
+          }
+          default:
+            return false;
+        }
+      }
+      return false;
+    }
+
+    bool ReadPrice(Product::Price &price)
+    {
+      SkipSpaces();
+      const size_t begin = pos;
+      while(pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+      {
+        pos++;
+      }
+      return ParsePrice(text.substr(begin, pos - begin), price);
+    }
+
+    //! Skip a value of any type, including the nested objects and arrays
+    //!
+    //! The closing brackets of the open objects and arrays are kept on an explicit stack, so
+    //! a deeply nested value costs memory proportional to its depth instead of the call stack.
+    bool SkipValue()
+    {
+      std::string ignored;
+      std::string closes;
+      for(;;)
+      {
+        SkipSpaces();
+        if(pos == text.size())
+        {
+          return false;
+        }
+        if(text[pos] == '"')
+        {
+          if(!ReadString(ignored))
+          {
+            return false;
+          }
+        }
+        else if(text[pos] == '{' || text[pos] == '[')
+        {
+          const char close = (text[pos] == '{')? '}' : ']';
+          pos++;
+          if(!Consume(close))
+          {
+            closes.push_back(close);
+            if(close == '}' && (!ReadString(ignored) || !Consume(':')))
+            {
+              return false;
+            }
+            continue;
+          }
+        }
+        else
+        {
+          // a number, true, false or null
+          const size_t begin = pos;
+          while(pos < text.size() && std::strchr(",}] \t\r", text[pos]) == nullptr)
+          {
+            pos++;
+          }
+          if(pos == begin)
+          {
+            return false;
+          }
+        }
+
+        // the value is skipped, close the objects and arrays it ends until another value follows
+        for(;;)
+        {
+          if(closes.empty())
+          {
+            return true;
+          }
+          if(Consume(','))
+          {
+            if(closes.back() == '}' && (!ReadString(ignored) || !Consume(':')))
+            {
+              return false;
+            }
+            break;
+          }
+          if(!Consume(closes.back()))
+          {
+            return false;
+          }
+          closes.pop_back();
+        }
+      }
+    }
+  };
+
+  //! Parse the NDJSON line at the offset \p pos of \p text into \p fields and move \p pos past the line
+  bool ParseNdjsonLine(std::string_view text, size_t &pos, ParsedFields &fields) const
+  {
+    static constexpr std::string_view kNames[kFieldCount] = {"id", "producer", "name", "price"};
+
+    const size_t lineBreak = text.find('\n', pos);
+    const size_t end = (lineBreak == std::string_view::npos)? text.size() : lineBreak;
+    JsonReader reader{text.substr(pos, end - pos)};
+    pos = std::min(end + 1, text.size());
+
+    std::fill(std::begin(fields.hasField), std::end(fields.hasField), false);
+    if(!reader.Consume('{'))
+    {
+      return false;
+    }
+    if(!reader.Consume('}'))
+    {
+      std::string name;
+      do
+      {
+        if(!reader.ReadString(name) || !reader.Consume(':'))
+        {
+          return false;
+        }
+        const size_t field = static_cast<size_t>(std::find(std::begin(kNames), std::end(kNames), name) - std::begin(kNames));
+        bool isRead = false;
+        if(field == kPrice)
+        {
+          isRead = reader.ReadPrice(fields.price);
+        }
+        else if(field < kFieldCount)
+        {
+          isRead = reader.ReadString(fields.strings[field]);
+        }
+        else
+        {
+          isRead = reader.SkipValue();
+        }
+        if(!isRead)
+        {
+          return false;
+        }
+        if(field < kFieldCount)
+        {
+          fields.hasField[field] = true;
+        }
+      } while(reader.Consume(','));
+      if(!reader.Consume('}'))
+      {
+        return false;
+      }
+    }
+    reader.SkipSpaces();
+    return reader.pos == reader.text.size() &&
+      std::all_of(std::begin(fields.hasField), std::end(fields.hasField), [](bool has) { return has; });
+  }
+
+  CatalogLoadOptions mOptions;
+};
+
+#endif
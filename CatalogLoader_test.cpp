@@ -0,0 +1,189 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "CatalogLoader.h"
+#include "ShardedWarehouse.h"
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Load the given catalog \p catalog into the warehouse \p wh, collecting the lines of the duplicates
+template <typename WarehouseT>
+CatalogLoadResult Load(WarehouseT &wh, const std::string &catalog, const CatalogLoadOptions &options,
+  std::vector<std::pair<size_t, std::string>> *pDuplicates = nullptr)
+{
+  std::istringstream in(catalog);
+  return CatalogLoader(options).Load(wh, in, [pDuplicates](size_t line, const typename WarehouseT::ProductPtr &pProduct) {
+    if(pDuplicates)
+    {
+      pDuplicates->emplace_back(line, pProduct->name);
+    }
+  });
+}
+
+TEST_CASE("loading a CSV catalog") {
+
+  Warehouse wh;
+  CatalogLoadOptions options;
+
+  SUBCASE("the columns are found by the header") {
+    const auto result = Load(wh, "price,name,extra,id,producer\n10,name1,x,id1,producerA\n20,name2,y,id2,producerB\n", options);
+    CHECK(result.status == CatalogLoadResult::Status::Ok);
+    CHECK(result.cntProducts == 2);
+    CHECK(result.cntAdded == 2);
+
+    auto pProduct = wh.FindProductById("id2");
+    REQUIRE(pProduct);
+    CHECK(pProduct->producer == "producerB");
+    CHECK(pProduct->name == "name2");
+    CHECK(pProduct->price == 20);
+  }
+
+  SUBCASE("quoted fields may contain delimiters, quotes and line breaks") {
+    const auto result = Load(wh, "id,producer,name,price\r\n"
+      "id1,\"producer, Inc.\",\"say \"\"hi\"\"\",1\r\n"
+      "id2,producer,\"two\nlines\",2\r\n"
+      "id3,producer,name3,3", options);
+    CHECK(result.cntAdded == 3);
+    CHECK(result.cntMalformed == 0);
+    CHECK(wh.FindProductById("id1")->producer == "producer, Inc.");
+    CHECK(wh.FindProductById("id1")->name == "say \"hi\"");
+    CHECK(wh.FindProductById("id2")->name == "two\nlines");
+    CHECK(wh.FindProductById("id3")->price == 3);
+  }
+
+  SUBCASE("the columns are in the default order without the header") {
+    options.hasCsvHeader = false;
+    options.csvDelimiter = ';';
+    const auto result = Load(wh, "id1;producer;name;1\n", options);
+    CHECK(result.cntAdded == 1);
+    CHECK(wh.CountProductsByProducer("producer") == 1);
+  }
+
+  SUBCASE("the header without some of the columns => nothing is loaded") {
+    const auto result = Load(wh, "id,producer,name\nid1,producer,name\n", options);
+    CHECK(result.status == CatalogLoadResult::Status::InvalidHeader);
+    CHECK(wh.FindProductById("id1") == nullptr);
+  }
+
+  SUBCASE("malformed lines are counted, blank lines are skipped") {
+    const auto result = Load(wh, "id,producer,name,price\n"
+      "id1,producer,name,1\n"
+      "\n"
+      "id2,producer,name,price\n"
+      "id3,producer,name\n"
+      "id4,producer,\"unterminated,4\n"
+      "id5,producer,name,-5\n"
+      "id6,producer,name,6\n", options);
+    CHECK(result.cntAdded == 2);
+    CHECK(result.cntMalformed == 4);
+    CHECK(result.firstMalformedLine == 4);
+  }
+}
+
+TEST_CASE("loading an NDJSON catalog") {
+
+  Warehouse wh;
+  CatalogLoadOptions options;
+  options.format = CatalogFormat::Ndjson;
+
+  SUBCASE("members are found by names, unknown ones are ignored") {
+    const auto result = Load(wh,
+      "{\"price\": 10, \"id\": \"id1\", \"tags\": [\"a\", {\"b\": [1, 2.5, null]}], \"producer\": \"A\", \"name\": \"n\"}\n"
+      "{ \"id\" : \"id2\" , \"producer\" : \"B\" , \"name\" : \"tab\\tquote\\\" \\u00e9 \\ud83d\\ude00\" , \"price\" : 0 , \"ok\": true }\r\n",
+      options);
+    CHECK(result.cntAdded == 2);
+    CHECK(result.cntMalformed == 0);
+    CHECK(wh.FindProductById("id1")->price == 10);
+    CHECK(wh.FindProductById("id2")->name == "tab\tquote\" \xC3\xA9 \xF0\x9F\x98\x80");
+  }
+
+  SUBCASE("lines with missing members or invalid JSON are malformed") {
+    const auto result = Load(wh,
+      "{\"id\": \"id1\", \"producer\": \"A\", \"name\": \"n\", \"price\": 1}\n"
+      "{\"id\": \"id2\", \"producer\": \"A\", \"name\": \"n\"}\n"
+      "{\"id\": \"id3\", \"producer\": \"A\", \"name\": \"n\", \"price\": 1.5}\n"
+      "{\"id\": \"id4\", \"producer\": \"A\", \"name\": \"n\", \"price\": 1} trailing\n"
+      "[1, 2]\n",
+      options);
+    CHECK(result.cntAdded == 1);
+    CHECK(result.cntMalformed == 4);
+    CHECK(result.firstMalformedLine == 2);
+  }
+  SUBCASE("deeply nested ignored members do not exhaust the stack") {
+    const std::string nested = std::string(500000, '[') + std::string(500000, ']');
+    const auto result = Load(wh,
+      "{\"x\": " + nested + ", \"id\": \"id1\", \"producer\": \"A\", \"name\": \"n\", \"price\": 1}\n"
+      "{\"x\": [{\"y\": " + nested + "}, 1], \"id\": \"id2\", \"producer\": \"A\", \"name\": \"n\", \"price\": 1}\n"
+      "{\"x\": " + nested.substr(1) + ", \"id\": \"id3\", \"producer\": \"A\", \"name\": \"n\", \"price\": 1}\n",
+      options);
+    CHECK(result.cntAdded == 2);
+    CHECK(result.cntMalformed == 1);
+    CHECK(result.firstMalformedLine == 3);
+  }
+}
+
+TEST_CASE("loading a catalog in small chunks on several threads") {
+
+  std::string csv = "id,producer,name,price\n";
+  for(int i = 0; i < 2000; ++i)
+  {
+    // every tenth product is a duplicate of the previous one
+    const int id = (i % 10 == 9)? i - 1 : i;
+    csv += "id" + std::to_string(id) + ",\"producer" + std::to_string(i % 13) + "\",\"name\n" + std::to_string(i) + "\"," +
+      std::to_string(i % 100) + "\n";
+  }
+
+  CatalogLoadOptions options;
+  options.chunkSize = 100;
+  options.cntThreads = 4;
+
+  SUBCASE("the result is the same as of adding the products one by one") {
+    SUBCASE("the whole catalog is staged") {}
+    SUBCASE("few products are staged at once") { options.cntStagedProducts = 50; }
+
+    Warehouse wh;
+    std::vector<std::pair<size_t, std::string>> duplicates;
+    const auto result = Load(wh, csv, options, &duplicates);
+    CHECK(result.status == CatalogLoadResult::Status::Ok);
+    CHECK(result.cntProducts == 2000);
+    CHECK(result.cntAdded == 1800);
+    CHECK(result.cntDuplicates == 200);
+    CHECK(result.cntMalformed == 0);
+
+    // a product takes two lines after the header, the first duplicate is the product 9
+    REQUIRE(duplicates.size() == 200);
+    CHECK(duplicates.front() == std::make_pair(size_t(2 + 9 * 2), std::string("name\n9")));
+    CHECK(duplicates.back() == std::make_pair(size_t(2 + 1999 * 2), std::string("name\n1999")));
+    CHECK(wh.FindProductById("id8")->name == "name\n8");
+  }
+
+  SUBCASE("a stray quote inside an unquoted field does not quote the rest of the catalog") {
+    csv.insert(csv.find('\n') + 1, "idX,pro\"ducer,name,1\n");
+    options.chunkSize = 16;
+
+    Warehouse wh;
+    const auto result = Load(wh, csv, options);
+    CHECK(result.cntAdded == 1800);
+    CHECK(result.cntMalformed == 1);
+    CHECK(result.firstMalformedLine == 2);
+    CHECK(wh.FindProductById("id1998")->name == "name\n1998");
+  }
+
+  SUBCASE("the sharded warehouse is loaded as well") {
+    ShardedWarehouse<4> wh;
+    const auto result = Load(wh, csv, options);
+    CHECK(result.cntAdded == 1800);
+    CHECK(wh.FindProductById("id1998")->price == 98);
+  }
+
+  SUBCASE("the products are added to the warehouse with the products") {
+    Warehouse wh;
+    REQUIRE(wh.AddProduct(std::make_shared<Product>(Product{"id0", "producer", "name", 1u})));
+    const auto result = Load(wh, csv, options);
+    CHECK(result.cntAdded == 1799);
+    CHECK(result.cntDuplicates == 201);
+    CHECK(wh.FindProductById("id0")->producer == "producer");
+  }
+}
@@ -0,0 +1,749 @@
+#ifndef _CHANGE_LOG_H
+#define _CHANGE_LOG_H
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "Warehouse.h"
+
+// the change log is flushed to the disk by fsync where it is available, otherwise by fflush only
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#define WAREHOUSE_CHANGE_LOG_FSYNC 1
+#endif
+
+//! Change of a warehouse recorded by ChangeLog
+//!
+//! The strings refer to the buffer of the reader, they are valid only during the visit.
+struct Change
+{
+  enum class Type : uint32_t
+  {
+    Add = 1,    //!< the product was added by AddProduct()
+    Remove = 2, //!< the product with the id was removed by RemoveProductById()
+    Upsert = 3  //!< the product was added or replaced by UpsertProduct() or UpdatePrice()
+  };
+
+  uint64_t sequence = 0;  //!< number of the change in the log, starting from 1
+  Type type = Type::Add;
+  std::string_view id;
+  std::string_view producer;  //!< producer of the added or replaced product, empty for a removal
+  std::string_view name;      //!< name of the added or replaced product, empty for a removal
+  Product::Price price = 0;   //!< price of the added or replaced product, 0 for a removal
+};
+
+//! Binary format of the change log
+//!
+//! The file starts with kMagic and kVersion (4 bytes) followed by the records. A record consists
+//! of its size and checksum (4 bytes each), a Record and the id, the producer and the name of the
+//! product. The integers are stored in the byte order of the writer.
+struct ChangeLogFormat
+{
+  static constexpr char kMagic[8] = {'W', 'H', 'L', 'O', 'G', '\0', '\0', '\0'};
+  static constexpr uint32_t kVersion = 1;
+  static constexpr size_t kFileHeaderSize = sizeof(kMagic) + sizeof(kVersion);
+  static constexpr size_t kRecordHeaderSize = 2 * sizeof(uint32_t);
+
+  struct Record
+  {
+    uint64_t sequence;
+    uint32_t type;
+    uint32_t price;
+    uint32_t idLength;
+    uint32_t producerLength;
+    uint32_t nameLength;
+    uint32_t reserved;
+  };
+
+  //! FNV-1a hash of the record, which detects torn and corrupted records
+  static uint32_t Checksum(const char *pData, size_t size)
+  {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < size; ++i)
+    {
+      hash = (hash ^ static_cast<unsigned char>(pData[i])) * 16777619u;
+    }
+    return hash;
+  }
+
+  //! Append the record of the given change \p change to \p buffer
+  static void Append(std::string &buffer, const Change &change)
+  {
+    const Record record{change.sequence, static_cast<uint32_t>(change.type), change.price,
+      static_cast<uint32_t>(change.id.size()), static_cast<uint32_t>(change.producer.size()),
+      static_cast<uint32_t>(change.name.size()), 0};
+    const uint32_t size = static_cast<uint32_t>(sizeof(record) + change.id.size() + change.producer.size() +
+      change.name.size());
+
+    const size_t begin = buffer.size();
+    buffer.resize(begin + kRecordHeaderSize);
+    buffer.append(reinterpret_cast<const char*>(&record), sizeof(record));
+    buffer.append(change.id);
+    buffer.append(change.producer);
+    buffer.append(change.name);
+
+    const uint32_t checksum = Checksum(buffer.data() + begin + kRecordHeaderSize, size);
+    std::memcpy(&buffer[begin], &size, sizeof(size));
+    std::memcpy(&buffer[begin + sizeof(size)], &checksum, sizeof(checksum));
+  }
+
+  enum class ParseStatus { Ok, Incomplete, Corrupted };
+
+  //! Parse the record at the beginning of [\p pData, \p pData + \p size) into \p change
+  //! and set \p recordSize to its size; the size of a corrupted record is the declared one
+  static ParseStatus Parse(const char *pData, size_t size, Change &change, size_t &recordSize)
+  {
+    if(size < kRecordHeaderSize)
+    {
+      return ParseStatus::Incomplete;
+    }
+    uint32_t payloadSize = 0, checksum = 0;
+    std::memcpy(&payloadSize, pData, sizeof(payloadSize));
+    std::memcpy(&checksum, pData + sizeof(payloadSize), sizeof(checksum));
+    recordSize = kRecordHeaderSize + size_t(payloadSize);
+    if(payloadSize < sizeof(Record))
+    {
+      return ParseStatus::Corrupted;
+    }
+    if(size - kRecordHeaderSize < payloadSize)
+    {
+      return ParseStatus::Incomplete;
+    }
+
+    const char *pPayload = pData + kRecordHeaderSize;
+    Record record;
+    std::memcpy(&record, pPayload, sizeof(record));
+    const uint64_t stringsSize = uint64_t(record.idLength) + record.producerLength + record.nameLength;
+    if(Checksum(pPayload, payloadSize) != checksum || stringsSize != payloadSize - sizeof(record) ||
+       record.type < uint32_t(Change::Type::Add) || record.type > uint32_t(Change::Type::Upsert))
+    {
+      return ParseStatus::Corrupted;
+    }
+
+    const char *pStrings = pPayload + sizeof(record);
+    change.sequence = record.sequence;
+    change.type = static_cast<Change::Type>(record.type);
+    change.price = record.price;
+    change.id = std::string_view(pStrings, record.idLength);
+    change.producer = std::string_view(pStrings + record.idLength, record.producerLength);
+    change.name = std::string_view(pStrings + record.idLength + record.producerLength, record.nameLength);
+    return ParseStatus::Ok;
+  }
+};
+
+//! Failure of writing or flushing a change log, see LoggedWarehouse
+class ChangeLogError: public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+//! Append-only log of the changes of a warehouse, see LoggedWarehouse
+//!
+//! The appended changes are buffered and written to the file by Sync(), which flushes the file
+//! to the disk. Concurrent calls of Sync() are committed as a group: one thread writes and flushes
+//! all changes appended so far, while the other ones wait for it, so a single flush makes the
+//! changes of many writers durable.
+//!
+//! All public methods are thread-safe.
+class ChangeLog
+{
+public:
+  ChangeLog() = default;
+
+  ~ChangeLog()
+  {
+    Sync(LastSequence());
+    if(mpFile)
+    {
+      std::fclose(mpFile);
+    }
+  }
+
+  ChangeLog(const ChangeLog &) = delete;
+  ChangeLog& operator=(const ChangeLog &) = delete;
+
+  //! Open the log with the given path \p path, which is created if it does not exist
+  //!
+  //! The records of an existing log are checked and a torn record at its end, left by a crash
+  //! during writing, is truncated; the next appended change follows the last complete one.
+  //! A corrupted record that is followed by other data is not truncated, since the records
+  //! after it would be lost; such a log is not opened and left as it is.
+  //!
+  //! Algorithm's time complexity: O(S), where S is size of the existing log
+  //!
+  //! \return false if the file could not be opened, it is not a change log or it has
+  //!   a corrupted record before its end
+  bool Open(const std::string &path)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mpFile)
+    {
+      return false;
+    }
+
+    std::string content;
+    {
+      std::ifstream file(path, std::ios::binary);
+      content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    uint64_t lastSequence = 0;
+    size_t end = 0;
+    if(!content.empty())
+    {
+      if(content.size() < ChangeLogFormat::kFileHeaderSize || !IsFileHeader(content.data()))
+      {
+        return false;
+      }
+      end = ChangeLogFormat::kFileHeaderSize;
+      Change change;
+      size_t recordSize = 0;
+      ChangeLogFormat::ParseStatus status;
+      while((status = ChangeLogFormat::Parse(content.data() + end, content.size() - end, change, recordSize)) ==
+        ChangeLogFormat::ParseStatus::Ok)
+      {
+        lastSequence = change.sequence;
+        end += recordSize;
+      }
+      if(end != content.size())
+      {
+        // the record is torn only if it was cut by the end of the file
+        if(status == ChangeLogFormat::ParseStatus::Corrupted && recordSize < content.size() - end)
+        {
+          return false;
+        }
+        std::error_code error;
+        std::filesystem::resize_file(path, end, error);
+        if(error)
+        {
+          return false;
+        }
+      }
+    }
+
+    mpFile = std::fopen(path.c_str(), "ab");
+    if(!mpFile)
+    {
+      return false;
+    }
+    if(end == 0)
+    {
+      // readers may open the new log before the first change is written
+      const bool success = std::fwrite(ChangeLogFormat::kMagic, sizeof(ChangeLogFormat::kMagic), 1, mpFile) == 1 &&
+        std::fwrite(&ChangeLogFormat::kVersion, sizeof(ChangeLogFormat::kVersion), 1, mpFile) == 1 &&
+        std::fflush(mpFile) == 0;
+      if(!success)
+      {
+        std::fclose(mpFile);
+        mpFile = nullptr;
+        return false;
+      }
+    }
+    mLastSequence = mDurableSequence = lastSequence;
+    return true;
+  }
+
+  //! Append the addition of the given product \p product to the log
+  //!
+  //! Algorithm's time complexity: O(1) amortized
+  //!
+  //! \pre the log is opened
+  //!
+  //! \return sequence number of the change
+  uint64_t AppendAdd(const Product &product)
+  {
+    return AppendProduct(Change::Type::Add, product);
+  }
+
+  //! Append the addition or the replacement of the given product \p product to the log
+  //!
+  //! Algorithm's time complexity: O(1) amortized
+  //!
+  //! \pre the log is opened
+  //!
+  //! \return sequence number of the change
+  uint64_t AppendUpsert(const Product &product)
+  {
+    return AppendProduct(Change::Type::Upsert, product);
+  }
+
+  //! Append the removal of the product with the given id \p id to the log
+  //!
+  //! Algorithm's time complexity: O(1) amortized
+  //!
+  //! \pre the log is opened
+  //!
+  //! \return sequence number of the change
+  uint64_t AppendRemove(std::string_view id)
+  {
+    Change change;
+    change.type = Change::Type::Remove;
+    change.id = id;
+    return Append(change);
+  }
+
+  //! Wait until the change with the given sequence number \p sequence and all changes before it
+  //! are written to the file and flushed to the disk
+  //!
+  //! \return false if writing or flushing the log failed, then all following calls fail as well
+  bool Sync(uint64_t sequence)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while(!mHasFailed && mDurableSequence < sequence)
+    {
+      if(mIsSyncing)
+      {
+        mSynced.wait(lock);
+        continue;
+      }
+
+      // this thread commits all changes appended so far, the following ones are buffered meanwhile
+      std::string batch;
+      batch.swap(mBuffer);
+      const uint64_t lastSequenceOfBatch = mLastSequence;
+      mIsSyncing = true;
+      lock.unlock();
+
+      bool success = std::fwrite(batch.data(), 1, batch.size(), mpFile) == batch.size() && std::fflush(mpFile) == 0;
+#ifdef WAREHOUSE_CHANGE_LOG_FSYNC
+      success = success && ::fsync(::fileno(mpFile)) == 0;
+#endif
+
+      lock.lock();
+      mIsSyncing = false;
+      mHasFailed |= !success;
+      if(success)
+      {
+        mDurableSequence = lastSequenceOfBatch;
+      }
+      mSynced.notify_all();
+    }
+    return !mHasFailed;
+  }
+
+  //! Whether writing or flushing the log failed, no changes are written after it
+  bool HasFailed() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHasFailed;
+  }
+
+  //! Sequence number of the last appended change, 0 if there is none
+  uint64_t LastSequence() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastSequence;
+  }
+
+  //! Sequence number of the last change flushed to the disk, 0 if there is none
+  uint64_t DurableSequence() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mDurableSequence;
+  }
+
+  static bool IsFileHeader(const char *pData)
+  {
+    uint32_t version = 0;
+    std::memcpy(&version, pData + sizeof(ChangeLogFormat::kMagic), sizeof(version));
+    return std::memcmp(pData, ChangeLogFormat::kMagic, sizeof(ChangeLogFormat::kMagic)) == 0 &&
+      version == ChangeLogFormat::kVersion;
+  }
+
+private:
+  uint64_t AppendProduct(Change::Type type, const Product &product)
+  {
+    Change change;
+    change.type = type;
+    change.id = product.id;
+    change.producer = product.producer;
+    change.name = product.name;
+    change.price = product.price;
+    return Append(change);
+  }
+
+  uint64_t Append(Change &change)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // pre-conditions
+    assert(mpFile);
+
+    change.sequence = ++mLastSequence;
+    ChangeLogFormat::Append(mBuffer, change);
+    return change.sequence;
+  }
+
+  mutable std::mutex mMutex;
+  std::condition_variable mSynced;
+  std::FILE *mpFile = nullptr;
+  std::string mBuffer;             //!< appended changes that are not written yet
+  uint64_t mLastSequence = 0;
+  uint64_t mDurableSequence = 0;
+  bool mIsSyncing = false;         //!< whether a thread is writing and flushing a batch
+  bool mHasFailed = false;
+};
+
+//! Reader of a change log, which follows the log as it grows
+//!
+//! A replica opens the reader from the sequence number after the last change it has applied
+//! (e.g. after the one of its snapshot, see LoggedWarehouse::SaveSnapshot()) and reads the
+//! changes repeatedly, applying them by ApplyChange().
+class ChangeLogReader
+{
+public:
+  //! Open the log with the given path \p path to read the changes starting from the sequence
+  //! number \p fromSequence
+  //!
+  //! \return false if the file could not be opened or it is not a change log
+  bool Open(const std::string &path, uint64_t fromSequence = 1)
+  {
+    mFile.open(path, std::ios::binary);
+    mFromSequence = fromSequence;
+    mOffset = 0;
+    mBuffer.clear();
+    mHasFailed = false;
+
+    char header[ChangeLogFormat::kFileHeaderSize];
+    if(!mFile.read(header, sizeof(header)) || !ChangeLog::IsFileHeader(header))
+    {
+      return false;
+    }
+    mOffset = sizeof(header);
+    return true;
+  }
+
+  //! Read the changes appended to the log since the previous call
+  //!
+  //! A change that is not completely written yet is read by one of the next calls.
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Change&) with every read change
+  //!   in the order of the log
+  //! \param[in] maxSequence the last sequence number to read, e.g. ChangeLog::DurableSequence()
+  //!   to read only the changes flushed to the disk
+  //!
+  //! Algorithm's time complexity: O(S), where S is size of the read changes
+  //!
+  //! \return number of visited changes
+  template <typename Visitor>
+  size_t Read(Visitor &&visitor, uint64_t maxSequence = UINT64_MAX)
+  {
+    if(mHasFailed)
+    {
+      return 0;
+    }
+
+    // the bytes appended since the previous call follow the unread rest of the buffer
+    mFile.clear();
+    mFile.seekg(static_cast<std::streamoff>(mOffset + mBuffer.size()));
+    char chunk[1 << 16];
+    while(mFile.read(chunk, sizeof(chunk)) || mFile.gcount() > 0)
+    {
+      mBuffer.append(chunk, static_cast<size_t>(mFile.gcount()));
+    }
+
+    size_t cntVisited = 0;
+    size_t pos = 0;
+    Change change;
+    size_t recordSize = 0;
+    while(true)
+    {
+      const auto status = ChangeLogFormat::Parse(mBuffer.data() + pos, mBuffer.size() - pos, change, recordSize);
+      if(status != ChangeLogFormat::ParseStatus::Ok)
+      {
+        mHasFailed = (status == ChangeLogFormat::ParseStatus::Corrupted);
+        break;
+      }
+      if(change.sequence > maxSequence)
+      {
+        break;
+      }
+      if(change.sequence >= mFromSequence)
+      {
+        visitor(static_cast<const Change&>(change));
+        cntVisited++;
+      }
+      pos += recordSize;
+    }
+    mBuffer.erase(0, pos);
+    mOffset += pos;
+    return cntVisited;
+  }
+
+  //! Whether the reader met a corrupted record, no changes are read after it
+  bool HasFailed() const
+  {
+    return mHasFailed;
+  }
+
+private:
+  std::ifstream mFile;
+  uint64_t mFromSequence = 1;
+  uint64_t mOffset = 0;   //!< offset of the first unparsed byte of the log
+  std::string mBuffer;    //!< read bytes of the log that are not parsed yet
+  bool mHasFailed = false;
+};
+
+//! Apply the given change \p change to the warehouse \p wh, e.g. to a replica
+//!
+//! \return true if the warehouse was changed, false otherwise
+template <typename WarehouseT>
+bool ApplyChange(WarehouseT &wh, const Change &change)
+{
+  if(change.type == Change::Type::Remove)
+  {
+    return wh.RemoveProductById(change.id) != 0;
+  }
+
+  auto pProduct = std::make_shared<Product>(Product{Product::Id(change.id), Product::Producer(change.producer),
+    Product::Name(change.name), change.price});
+  if(change.type == Change::Type::Upsert)
+  {
+    wh.UpsertProduct(pProduct);
+    return true;
+  }
+  return wh.AddProduct(pProduct);
+}
+
+//! Warehouse that records every successful AddProduct(), UpsertProduct(), UpdatePrice()
+//! and RemoveProductById() in a change log
+//!
+//! The modifications are applied and appended to the log under a common lock, so the order of
+//! the log is the order of the modifications, and then waited to be flushed by ChangeLog::Sync()
+//! outside of the lock, so concurrent writers share the flushes of the log. A modifying method
+//! returns once its changes are durable. Lookups are the ones of \p WarehouseT.
+//!
+//! If the log fails to write or flush the changes, the modifying method throws ChangeLogError:
+//! its changes are applied to the warehouse, but may be missing from the log. The log does not
+//! recover, so every following modification throws ChangeLogError without being applied.
+//!
+//! The modifications that cannot be recorded in the log are not available: the expiries and the
+//! evictions, which remove the products without a call of the warehouse, and the products loaded
+//! on the misses, see Warehouse::ReapExpiredProducts(), Warehouse::SetCapacity() and
+//! Warehouse::FindOrLoadProductById().
+//!
+//! \tparam WarehouseT warehouse to record the modifications of, e.g. Warehouse
+template <typename WarehouseT>
+class LoggedWarehouse: public WarehouseT
+{
+public:
+  using ProductPtr = typename WarehouseT::ProductPtr;
+
+  //! Create a warehouse that records its modifications in the given opened log \p log
+  //!
+  //! \pre \p log outlives the warehouse
+  template <typename... Args>
+  explicit LoggedWarehouse(ChangeLog &log, Args&&... args): WarehouseT(std::forward<Args>(args)...), mLog(log) {}
+
+  LoggedWarehouse(const LoggedWarehouse &) = delete;
+  LoggedWarehouse& operator=(const LoggedWarehouse &) = delete;
+
+  //! See Warehouse::AddProduct(), the added product is recorded in the log
+  bool AddProduct(const ProductPtr &pProduct)
+  {
+    uint64_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      CheckLog();
+      if(!WarehouseT::AddProduct(pProduct))
+      {
+        return false;
+      }
+      sequence = mLog.AppendAdd(*pProduct);
+    }
+    Sync(sequence);
+    return true;
+  }
+
+  //! See Warehouse::UpsertProduct(), the product is recorded in the log
+  bool UpsertProduct(const ProductPtr &pProduct)
+  {
+    bool success = false;
+    uint64_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      CheckLog();
+      success = WarehouseT::UpsertProduct(pProduct);
+      sequence = mLog.AppendUpsert(*pProduct);
+    }
+    Sync(sequence);
+    return success;
+  }
+
+  //! See Warehouse::UpdatePrice(), the product with the new price is recorded in the log
+  bool UpdatePrice(std::string_view id, Product::Price price)
+  {
+    uint64_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      CheckLog();
+      if(!WarehouseT::UpdatePrice(id, price))
+      {
+        return false;
+      }
+      sequence = mLog.AppendUpsert(*WarehouseT::FindProductById(id));
+    }
+    Sync(sequence);
+    return true;
+  }
+
+  //! See Warehouse::AddProducts(), the added products are recorded in the log and flushed at once
+  template <typename InputIt, typename OutputIt>
+  size_t AddProducts(InputIt first, InputIt last, OutputIt added)
+  {
+    const std::vector<ProductPtr> products(first, last);
+    std::vector<bool> addedProducts;
+    addedProducts.reserve(products.size());
+
+    size_t cntAdded = 0;
+    uint64_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      CheckLog();
+      cntAdded = WarehouseT::AddProducts(products.begin(), products.end(), std::back_inserter(addedProducts));
+      for(size_t i = 0; i < products.size(); ++i)
+      {
+        if(addedProducts[i])
+        {
+          sequence = mLog.AppendAdd(*products[i]);
+        }
+      }
+    }
+    std::copy(addedProducts.begin(), addedProducts.end(), added);
+    Sync(sequence);
+    return cntAdded;
+  }
+
+  template <typename InputIt>
+  size_t AddProducts(InputIt first, InputIt last)
+  {
+    return AddProducts(first, last, DiscardIterator{});
+  }
+
+  //! See Warehouse::RemoveProductById(), the removal is recorded in the log
+  size_t RemoveProductById(std::string_view id)
+  {
+    uint64_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      CheckLog();
+      if(WarehouseT::RemoveProductById(id) == 0)
+      {
+        return 0;
+      }
+      sequence = mLog.AppendRemove(id);
+    }
+    Sync(sequence);
+    return 1;
+  }
+
+  //! See Warehouse::RemoveProductsById(), the removals are recorded in the log and flushed at once
+  template <typename InputIt, typename OutputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last, OutputIt removed)
+  {
+    size_t cntRemoved = 0;
+    uint64_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      CheckLog();
+      for(; first != last; ++first)
+      {
+        const std::string_view id = *first;
+        const bool success = (WarehouseT::RemoveProductById(id) != 0);
+        if(success)
+        {
+          sequence = mLog.AppendRemove(id);
+        }
+        *removed++ = success;
+        cntRemoved += success;
+      }
+    }
+    Sync(sequence);
+    return cntRemoved;
+  }
+
+  template <typename InputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last)
+  {
+    return RemoveProductsById(first, last, DiscardIterator{});
+  }
+
+  //! Save the snapshot of the warehouse, see Warehouse::SaveSnapshot(), which contains all changes
+  //! of the log up to the sequence number \p sequence
+  //!
+  //! A replica loads the snapshot and then applies the changes of the log from \p sequence + 1,
+  //! see ChangeLogReader. The modifications wait for the saving.
+  //!
+  //! \return true if the snapshot was saved, false otherwise
+  bool SaveSnapshot(const std::string &path, uint64_t &sequence)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    sequence = mLog.LastSequence();
+    return WarehouseT::SaveSnapshot(path);
+  }
+
+  //! Loading a snapshot is not recorded in the log, so it is available to replicas only
+  bool LoadSnapshot(const std::string &path) = delete;
+
+  //! The expired products would be removed without being recorded in the log
+  size_t ReapExpiredProducts(size_t maxCount = 0) = delete;
+
+  //! The evicted products would be removed without being recorded in the log
+  size_t SetCapacity(size_t maxProducts, size_t maxBytes = 0) = delete;
+
+  //! The loaded products would be added without being recorded in the log
+  template <typename IdType>
+  ProductPtr FindOrLoadProductById(IdType id) = delete;
+
+private:
+  //! Throw ChangeLogError if the log has failed, so the warehouse does not get ahead of the log
+  void CheckLog() const
+  {
+    if(mLog.HasFailed())
+    {
+      throw ChangeLogError("the change log has failed");
+    }
+  }
+
+  //! Wait until the change with the given sequence number \p sequence is durable, 0 if no change
+  //! was appended, and throw ChangeLogError if the log failed to write or flush it
+  void Sync(uint64_t sequence)
+  {
+    if(sequence != 0 && !mLog.Sync(sequence))
+    {
+      throw ChangeLogError("the change was applied, but the change log failed to write it");
+    }
+  }
+
+  //! Output iterator that ignores everything written to it
+  struct DiscardIterator
+  {
+    DiscardIterator& operator*() { return *this; }
+    DiscardIterator& operator++() { return *this; }
+    DiscardIterator& operator++(int) { return *this; }
+
+    template <typename T>
+    DiscardIterator& operator=(T &&) { return *this; }
+  };
+
+  std::mutex mWriterMutex;
+  ChangeLog &mLog;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "ChangeLog.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __has_include(<sys/resource.h>)
+#include <sys/resource.h>
+#endif
+
+template<class... Args>
+std::shared_ptr<Product> MakeProduct(Args&&... args)
+{
+  return std::make_shared<Product>(Product{std::forward<Args>(args)...});
+}
+
+//! Changes of the log with the given path \p path from the sequence number \p fromSequence
+std::vector<std::string> ReadChanges(const std::string &path, uint64_t fromSequence = 1)
+{
+  std::vector<std::string> changes;
+  ChangeLogReader reader;
+  REQUIRE(reader.Open(path, fromSequence));
+  reader.Read([&changes](const Change &change) {
+    changes.push_back(std::to_string(change.sequence) + ((change.type == Change::Type::Add)? " add " : " remove ") +
+      std::string(change.id));
+  });
+  CHECK(!reader.HasFailed());
+  return changes;
+}
+
+TEST_CASE("recording changes of the warehouse in the change log") {
+
+  const std::string path = "ChangeLog_test.log";
+  std::remove(path.c_str());
+
+  {
+    ChangeLog log;
+    REQUIRE(log.Open(path));
+    LoggedWarehouse<Warehouse> wh(log);
+
+    CHECK(wh.AddProduct(MakeProduct("id1", "producerA", "name1", 1u)));
+    CHECK(wh.AddProduct(MakeProduct("id1", "producerA", "name1", 1u)) == false);
+    const std::vector<std::shared_ptr<const Product>> products = {
+      MakeProduct("id2", "producerA", "name2", 2u), MakeProduct("id1", "producerB", "name", 3u),
+      MakeProduct("id3", "producerB", "name3", 3u)};
+    CHECK(wh.AddProducts(products.begin(), products.end()) == 2);
+    CHECK(wh.RemoveProductById("id2") == 1);
+    CHECK(wh.RemoveProductById("id2") == 0);
+    const std::vector<std::string> ids = {"id3", "id4"};
+    CHECK(wh.RemoveProductsById(ids.begin(), ids.end()) == 1);
+
+    // the log is flushed once the modifying method returns
+    CHECK(log.LastSequence() == 5);
+    CHECK(log.DurableSequence() == 5);
+    CHECK(wh.FindProductById("id1") != nullptr);
+  }
+
+  SUBCASE("only the successful modifications are recorded") {
+    CHECK(ReadChanges(path) == std::vector<std::string>{"1 add id1", "2 add id2", "3 add id3", "4 remove id2", "5 remove id3"});
+    CHECK(ReadChanges(path, 4) == std::vector<std::string>{"4 remove id2", "5 remove id3"});
+  }
+
+  SUBCASE("the replica applying the log has the same products") {
+    Warehouse replica;
+    ChangeLogReader reader;
+    REQUIRE(reader.Open(path));
+    CHECK(reader.Read([&replica](const Change &change) { ApplyChange(replica, change); }) == 5);
+
+    auto pProduct = replica.FindProductById("id1");
+    REQUIRE(pProduct);
+    CHECK(pProduct->producer == "producerA");
+    CHECK(pProduct->name == "name1");
+    CHECK(pProduct->price == 1);
+    CHECK(replica.FindProductById("id2") == nullptr);
+    CHECK(replica.FindProductById("id3") == nullptr);
+  }
+
+  SUBCASE("reopened log continues the sequence numbers") {
+    ChangeLog log;
+    REQUIRE(log.Open(path));
+    CHECK(log.LastSequence() == 5);
+    CHECK(log.Sync(log.AppendRemove("id1")));
+    CHECK(ReadChanges(path, 6) == std::vector<std::string>{"6 remove id1"});
+  }
+
+  SUBCASE("torn record at the end of the log is truncated on opening") {
+    {
+      std::ofstream file(path, std::ios::binary | std::ios::app);
+      file << "torn";
+    }
+    CHECK(ReadChanges(path).size() == 5);
+
+    ChangeLog log;
+    REQUIRE(log.Open(path));
+    CHECK(log.LastSequence() == 5);
+    CHECK(log.Sync(log.AppendRemove("id1")));
+    CHECK(ReadChanges(path).size() == 6);
+  }
+
+  SUBCASE("corrupted record at the end of the log is truncated on opening") {
+    {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+      file.seekp(-1, std::ios::end);
+      file.put('X');
+    }
+    ChangeLog log;
+    REQUIRE(log.Open(path));
+    CHECK(log.LastSequence() == 4);
+  }
+
+  SUBCASE("corrupted record in the middle of the log is left as it is") {
+    {
+      // the first byte of the id of the first record
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(ChangeLogFormat::kFileHeaderSize + ChangeLogFormat::kRecordHeaderSize + sizeof(ChangeLogFormat::Record));
+      file.put('X');
+    }
+    const auto size = std::filesystem::file_size(path);
+    ChangeLog log;
+    CHECK(log.Open(path) == false);
+    CHECK(std::filesystem::file_size(path) == size);
+  }
+
+  SUBCASE("the file that is not a change log is not opened") {
+    {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      file << "not a change log";
+    }
+    ChangeLog log;
+    CHECK(log.Open(path) == false);
+    ChangeLogReader reader;
+    CHECK(reader.Open(path) == false);
+  }
+
+  std::remove(path.c_str());
+}
+
+#if __has_include(<sys/resource.h>)
+TEST_CASE("failures of the change log are thrown by the modifications") {
+
+  const std::string path = "ChangeLog_test_failing.log";
+  std::remove(path.c_str());
+
+  ChangeLog log;
+  REQUIRE(log.Open(path));
+  LoggedWarehouse<Warehouse> wh(log);
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "name1", 1u)));
+
+  {
+    // the log cannot grow past its size, as on a full disk
+    rlimit oldLimit;
+    REQUIRE(::getrlimit(RLIMIT_FSIZE, &oldLimit) == 0);
+    const auto oldHandler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit limit = oldLimit;
+    limit.rlim_cur = static_cast<rlim_t>(std::filesystem::file_size(path));
+    REQUIRE(::setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+    CHECK_THROWS_AS(wh.AddProduct(MakeProduct("id2", "producer", "name2", 2u)), ChangeLogError);
+
+    REQUIRE(::setrlimit(RLIMIT_FSIZE, &oldLimit) == 0);
+    std::signal(SIGXFSZ, oldHandler);
+  }
+  CHECK(log.HasFailed());
+  CHECK(log.DurableSequence() == 1);
+
+  // the failed change is applied, but the following ones are not
+  CHECK(wh.FindProductById("id2") != nullptr);
+  CHECK_THROWS_AS(wh.RemoveProductById("id1"), ChangeLogError);
+  CHECK_THROWS_AS(wh.UpsertProduct(MakeProduct("id3", "producer", "name3", 3u)), ChangeLogError);
+  CHECK(wh.FindProductById("id1") != nullptr);
+  CHECK(wh.FindProductById("id3") == nullptr);
+  CHECK(ReadChanges(path) == std::vector<std::string>{"1 add id1"});
+
+  std::remove(path.c_str());
+}
+#endif
+
+TEST_CASE("recording upserts and price updates in the change log") {
+
+  const std::string path = "ChangeLog_test_upsert.log";
+  std::remove(path.c_str());
+
+  ChangeLog log;
+  REQUIRE(log.Open(path));
+  LoggedWarehouse<Warehouse> wh(log);
+
+  CHECK(wh.UpsertProduct(MakeProduct("id1", "producerA", "name1", 1u)) == true);
+  CHECK(wh.UpsertProduct(MakeProduct("id1", "producerB", "name1", 2u)) == false);
+  CHECK(wh.UpdatePrice("id1", 3u) == true);
+  CHECK(wh.UpdatePrice("id2", 3u) == false);
+  CHECK(log.LastSequence() == 3);
+
+  Warehouse replica;
+  ChangeLogReader reader;
+  REQUIRE(reader.Open(path));
+  CHECK(reader.Read([&replica](const Change &change) {
+    CHECK(change.type == Change::Type::Upsert);
+    ApplyChange(replica, change);
+  }) == 3);
+
+  auto pProduct = replica.FindProductById("id1");
+  REQUIRE(pProduct);
+  CHECK(pProduct->producer == "producerB");
+  CHECK(pProduct->price == 3);
+  CHECK(replica.CountProductsByProducer("producerA") == 0);
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("following the growing change log") {
+
+  const std::string path = "ChangeLog_test_follow.log";
+  std::remove(path.c_str());
+
+  ChangeLog log;
+  REQUIRE(log.Open(path));
+  LoggedWarehouse<Warehouse> wh(log);
+
+  Warehouse replica;
+  ChangeLogReader reader;
+  REQUIRE(reader.Open(path));
+  auto apply = [&replica](const Change &change) { ApplyChange(replica, change); };
+  CHECK(reader.Read(apply) == 0);
+
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producer", "name", 1u)));
+  CHECK(reader.Read(apply) == 2);
+  REQUIRE(wh.RemoveProductById("id1") == 1);
+  CHECK(reader.Read(apply) == 1);
+  CHECK(reader.Read(apply) == 0);
+
+  CHECK(replica.FindProductById("id1") == nullptr);
+  CHECK(replica.FindProductById("id2") != nullptr);
+
+  SUBCASE("snapshot and the tail of the log replace replaying the whole log") {
+    const std::string snapshotPath = "ChangeLog_test.snapshot";
+    uint64_t sequence = 0;
+    REQUIRE(wh.SaveSnapshot(snapshotPath, sequence));
+    CHECK(sequence == 3);
+    REQUIRE(wh.AddProduct(MakeProduct("id3", "producer", "name", 1u)));
+
+    Warehouse newReplica;
+    REQUIRE(newReplica.LoadSnapshot(snapshotPath));
+    ChangeLogReader tailReader;
+    REQUIRE(tailReader.Open(path, sequence + 1));
+    CHECK(tailReader.Read([&newReplica](const Change &change) { ApplyChange(newReplica, change); }) == 1);
+    CHECK(newReplica.FindProductById("id2") != nullptr);
+    CHECK(newReplica.FindProductById("id3") != nullptr);
+    std::remove(snapshotPath.c_str());
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("concurrent writers share the flushes of the change log") {
+
+  const std::string path = "ChangeLog_test_concurrent.log";
+  std::remove(path.c_str());
+
+  {
+    ChangeLog log;
+    REQUIRE(log.Open(path));
+    LoggedWarehouse<BasicWarehouse<SharedLocking>> wh(log);
+
+    std::vector<std::thread> writers;
+    for(int t = 0; t < 4; ++t)
+    {
+      writers.emplace_back([&wh, t]() {
+        for(int i = 0; i < 200; ++i)
+        {
+          const std::string id = "id" + std::to_string(t) + "_" + std::to_string(i);
+          wh.AddProduct(MakeProduct(id, "producer", "name", 1u));
+          if(i % 2)
+          {
+            wh.RemoveProductById(id);
+          }
+        }
+      });
+    }
+    for(auto &writer : writers)
+    {
+      writer.join();
+    }
+    CHECK(log.DurableSequence() == 1200);
+  }
+
+  Warehouse replica;
+  ChangeLogReader reader;
+  REQUIRE(reader.Open(path));
+  uint64_t lastSequence = 0;
+  CHECK(reader.Read([&](const Change &change) {
+    CHECK(change.sequence == lastSequence + 1);
+    lastSequence = change.sequence;
+    CHECK(ApplyChange(replica, change));
+  }) == 1200);
+  CHECK(replica.CountProductsByProducer("producer") == 400);
+
+  std::remove(path.c_str());
+}
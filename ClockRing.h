@@ -0,0 +1,176 @@
+#ifndef _CLOCK_RING_H
+#define _CLOCK_RING_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! Ring of pointers with the reference bits of the CLOCK replacement policy
+//!
+//! Every pointer takes a slot with a reference bit, which Touch() sets when the pointer is used.
+//! Victim() sweeps the hand over the slots, clears the set bits and stops at the first slot whose
+//! bit is clear, so the pointers that were not used since the last sweep are evicted first, as
+//! by an approximation of LRU. A pointer is inserted with its bit set, as it is used by its
+//! insertion, so the pointer that was just inserted is not evicted by the next sweep.
+//! Touch() stores the bit only if it is clear, with a relaxed atomic store, so it may be
+//! called by concurrent readers, and a hit on a recently used pointer does not write to
+//! memory at all.
+//!
+//! The slots are dense: an erased slot is taken by the last entry, so the owner of the ring
+//! updates the slot it keeps for the moved pointer, see PriceColumns.
+//!
+//! \tparam Ptr type of the (smart) pointers
+//! \tparam Allocator allocator, which is rebound to the ring
+template <typename Ptr, typename Allocator = std::allocator<Ptr>>
+class ClockRing
+{
+  using AllocTraits = std::allocator_traits<Allocator>;
+
+  //! Reference bit of a slot, which is copied and moved by its value, so it is kept in a vector
+  struct ReferenceBit
+  {
+    ReferenceBit(bool isSet = false): bit(isSet) {}
+    ReferenceBit(const ReferenceBit &other): bit(other.bit.load(std::memory_order_relaxed)) {}
+
+    ReferenceBit& operator=(const ReferenceBit &other)
+    {
+      bit.store(other.bit.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+
+    mutable std::atomic<bool> bit;
+  };
+
+public:
+  using Slot = uint32_t;
+  using allocator_type = Allocator;
+
+  explicit ClockRing(const Allocator &allocator = Allocator()):
+    mPtrs(allocator), mBits(allocator)
+  {
+  }
+
+  //! Exchange the entries of the ring and of \p other
+  //!
+  //! \pre the allocators of the rings are equal, unless they propagate on swap
+  void swap(ClockRing &other) noexcept
+  {
+    mPtrs.swap(other.mPtrs);
+    mBits.swap(other.mBits);
+    std::swap(mHand, other.mHand);
+  }
+
+  size_t size() const { return mPtrs.size(); }
+  bool empty() const { return mPtrs.empty(); }
+
+  void reserve(size_t count)
+  {
+    mPtrs.reserve(count);
+    mBits.reserve(count);
+  }
+
+  //! Pointer of the given slot \p slot
+  const Ptr& PtrOf(Slot slot) const
+  {
+    // pre-conditions
+    assert(slot < mPtrs.size());
+
+    return mPtrs[slot];
+  }
+
+  //! Add the pointer \p ptr with its reference bit set, so it survives one sweep of the hand
+  //!
+  //! \return the slot of the pointer
+  Slot insert(Ptr ptr)
+  {
+    // pre-conditions
+    assert(mPtrs.size() < size_t(Slot(-1)));
+
+    mPtrs.push_back(std::move(ptr));
+    mBits.emplace_back(true);
+    return static_cast<Slot>(mPtrs.size() - 1);
+  }
+
+  //! Replace the pointer of the given slot \p slot by \p ptr, keeping its reference bit
+  void replace(Slot slot, Ptr ptr)
+  {
+    // pre-conditions
+    assert(slot < mPtrs.size());
+
+    mPtrs[slot] = std::move(ptr);
+  }
+
+  //! Erase the entry of the given slot \p slot, the last entry takes the slot
+  //!
+  //! \return true if an entry was moved to the slot, whose owner has to be told of it
+  bool erase(Slot slot)
+  {
+    // pre-conditions
+    assert(slot < mPtrs.size());
+
+    const bool isMoved = (slot + 1 != mPtrs.size());
+    if(isMoved)
+    {
+      mPtrs[slot] = std::move(mPtrs.back());
+      mBits[slot] = mBits.back();
+    }
+    mPtrs.pop_back();
+    mBits.pop_back();
+    if(mHand >= mPtrs.size())
+    {
+      mHand = 0;
+    }
+    return isMoved;
+  }
+
+  //! Mark the pointer of the given slot \p slot as used
+  //!
+  //! Unlike the other methods, it may be called concurrently with itself and with the const
+  //! methods.
+  void Touch(Slot slot) const
+  {
+    // pre-conditions
+    assert(slot < mBits.size());
+
+    std::atomic<bool> &bit = mBits[slot].bit;
+    if(!bit.load(std::memory_order_relaxed))
+    {
+      bit.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  //! Slot of the pointer to evict: the first slot from the hand on whose reference bit is clear,
+  //! the bits of the passed slots are cleared; the hand stays at the returned slot, which is
+  //! erased by the caller then
+  //!
+  //! Algorithm's time complexity: O(1) amortized, at most one sweep over the slots
+  //!
+  //! \pre the ring is not empty
+  Slot Victim()
+  {
+    // pre-conditions
+    assert(!mPtrs.empty());
+
+    for(;;)
+    {
+      std::atomic<bool> &bit = mBits[mHand].bit;
+      if(!bit.load(std::memory_order_relaxed))
+      {
+        return static_cast<Slot>(mHand);
+      }
+      bit.store(false, std::memory_order_relaxed);
+      mHand = (mHand + 1 < mPtrs.size())? mHand + 1 : 0;
+    }
+  }
+
+private:
+  std::vector<Ptr, Allocator> mPtrs;
+  std::vector<ReferenceBit, typename AllocTraits::template rebind_alloc<ReferenceBit>> mBits;
+  size_t mHand = 0;   //!< slot where the next sweep starts
+};
+
+#endif
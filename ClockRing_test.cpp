@@ -0,0 +1,92 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "ClockRing.h"
+
+#include <vector>
+
+using Ring = ClockRing<int>;
+
+TEST_CASE("the pointers that were not used are evicted first") {
+
+  Ring ring;
+  CHECK(ring.empty());
+  for(int i = 0; i < 4; ++i)
+  {
+    CHECK(ring.insert(i) == Ring::Slot(i));
+  }
+  CHECK(ring.size() == 4);
+
+  // all bits are set by the insertion, so the first sweep clears them and stops where it started
+  CHECK(ring.Victim() == 0);
+  CHECK(ring.erase(0) == true);
+  CHECK(ring.PtrOf(0) == 3);
+
+  // the hand stays at the slot 0, which is taken by 3 now; 3 and 2 are used, so 1 is evicted
+  ring.Touch(0);
+  ring.Touch(2);
+  CHECK(ring.PtrOf(ring.Victim()) == 1);
+
+  // the inserted pointer survives the next sweep
+  CHECK(ring.erase(1) == true);
+  ring.insert(4);
+  CHECK(ring.PtrOf(ring.Victim()) == 3);
+}
+
+TEST_CASE("erasing the entries of the ring") {
+
+  Ring ring;
+  ring.insert(10);
+  ring.insert(11);
+  ring.insert(12);
+  CHECK(ring.erase(2) == false);
+  CHECK(ring.erase(0) == true);
+  CHECK(ring.PtrOf(0) == 11);
+  ring.replace(0, 21);
+  CHECK(ring.PtrOf(0) == 21);
+  CHECK(ring.erase(0) == false);
+  CHECK(ring.empty());
+
+  Ring other;
+  other.insert(1);
+  ring.swap(other);
+  CHECK(ring.size() == 1);
+  CHECK(other.empty());
+}
+
+TEST_CASE("the used pointers survive the evictions") {
+
+  Ring ring;
+  std::vector<Ring::Slot> slots;
+  for(int i = 0; i < 1000; ++i)
+  {
+    slots.push_back(ring.insert(i));
+  }
+
+  // the first sweep clears the bits of the insertions
+  const Ring::Slot first = ring.Victim();
+  CHECK(first == 0);
+  ring.erase(first);
+  slots[ring.PtrOf(first)] = first;
+  slots[0] = Ring::Slot(-1);
+
+  // the pointers in [1, 100) are used between all evictions, so none of them is evicted
+  for(int i = 0; i < 800; ++i)
+  {
+    for(int hot = 1; hot < 100; ++hot)
+    {
+      ring.Touch(slots[hot]);
+    }
+    const Ring::Slot victim = ring.Victim();
+    const int evicted = ring.PtrOf(victim);
+    REQUIRE(evicted >= 100);
+    if(ring.erase(victim))
+    {
+      slots[ring.PtrOf(victim)] = victim;
+    }
+  }
+  CHECK(ring.size() == 199);
+  for(int hot = 1; hot < 100; ++hot)
+  {
+    CHECK(ring.PtrOf(slots[hot]) == hot);
+  }
+}
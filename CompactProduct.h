@@ -0,0 +1,227 @@
+#ifndef _COMPACT_PRODUCT_H
+#define _COMPACT_PRODUCT_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include "Warehouse.h"
+
+class CompactProductPtr;
+
+//! Immutable product stored in a single allocation together with its reference counter
+//!
+//! The allocation consists of a small header with the price, the lengths of the strings and
+//! the counter, which is followed by the bytes of the id, the producer and the name. A product
+//! is made by MakeCompactProduct() and is held by CompactProductPtr, so a lookup by id reads
+//! the id right after the header, instead of the separate strings and control block of Product.
+class CompactProduct
+{
+public:
+  using Price = Product::Price;
+
+  CompactProduct(const CompactProduct &) = delete;
+  CompactProduct& operator=(const CompactProduct &) = delete;
+
+  std::string_view id() const { return std::string_view(Bytes(), mIdLength); }
+  std::string_view producer() const { return std::string_view(Bytes() + mIdLength, mProducerLength); }
+  std::string_view name() const { return std::string_view(Bytes() + mIdLength + mProducerLength, mNameLength); }
+  Price price() const { return mPrice; }
+
+  //! Number of bytes allocated for the product
+  size_t AllocationSize() const
+  {
+    return AllocationSizeFor(mIdLength, mProducerLength, mNameLength);
+  }
+
+private:
+  friend class CompactProductPtr;
+  friend CompactProductPtr MakeCompactProduct(std::pmr::memory_resource *pMemoryResource, std::string_view id,
+    std::string_view producer, std::string_view name, Price price);
+
+  CompactProduct(std::pmr::memory_resource *pMemoryResource, std::string_view id, std::string_view producer,
+    std::string_view name, Price price):
+    mpMemoryResource(pMemoryResource), mPrice(price), mIdLength(static_cast<uint32_t>(id.size())),
+    mProducerLength(static_cast<uint32_t>(producer.size())), mNameLength(static_cast<uint32_t>(name.size()))
+  {
+    char *pBytes = reinterpret_cast<char*>(this + 1);
+    std::memcpy(pBytes, id.data(), id.size());
+    std::memcpy(pBytes + id.size(), producer.data(), producer.size());
+    std::memcpy(pBytes + id.size() + producer.size(), name.data(), name.size());
+  }
+
+  ~CompactProduct() = default;
+
+  static size_t AllocationSizeFor(size_t idLength, size_t producerLength, size_t nameLength)
+  {
+    return sizeof(CompactProduct) + idLength + producerLength + nameLength;
+  }
+
+  const char* Bytes() const { return reinterpret_cast<const char*>(this + 1); }
+
+  void AddRef() const
+  {
+    mCntRefs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //! Release a reference, destroying the product with the last one
+  void Release() const
+  {
+    // the destroying thread has to see all accesses of the other holders
+    if(mCntRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::pmr::memory_resource *pMemoryResource = mpMemoryResource;
+      const size_t size = AllocationSize();
+      CompactProduct *pThis = const_cast<CompactProduct*>(this);
+      pThis->~CompactProduct();
+      pMemoryResource->deallocate(pThis, size, alignof(CompactProduct));
+    }
+  }
+
+  std::pmr::memory_resource *mpMemoryResource;  //!< resource the product is allocated from
+  mutable std::atomic<uint32_t> mCntRefs{1};
+  Price mPrice;
+  uint32_t mIdLength;
+  uint32_t mProducerLength;
+  uint32_t mNameLength;
+};
+
+//! Smart pointer that shares the ownership of a CompactProduct, as std::shared_ptr does,
+//! but with the counter inside the product
+class CompactProductPtr
+{
+public:
+  CompactProductPtr() = default;
+  CompactProductPtr(std::nullptr_t) {}
+
+  CompactProductPtr(const CompactProductPtr &other): mpProduct(other.mpProduct)
+  {
+    if(mpProduct)
+    {
+      mpProduct->AddRef();
+    }
+  }
+
+  CompactProductPtr(CompactProductPtr &&other) noexcept: mpProduct(std::exchange(other.mpProduct, nullptr)) {}
+
+  ~CompactProductPtr()
+  {
+    if(mpProduct)
+    {
+      mpProduct->Release();
+    }
+  }
+
+  CompactProductPtr& operator=(CompactProductPtr other) noexcept
+  {
+    swap(other);
+    return *this;
+  }
+
+  void swap(CompactProductPtr &other) noexcept
+  {
+    std::swap(mpProduct, other.mpProduct);
+  }
+
+  void reset()
+  {
+    CompactProductPtr().swap(*this);
+  }
+
+  const CompactProduct* get() const { return mpProduct; }
+  const CompactProduct& operator*() const { return *mpProduct; }
+  const CompactProduct* operator->() const { return mpProduct; }
+  explicit operator bool() const { return mpProduct != nullptr; }
+
+  //! Number of the pointers sharing the product, 0 for the empty pointer
+  size_t use_count() const
+  {
+    return mpProduct? mpProduct->mCntRefs.load(std::memory_order_relaxed) : 0;
+  }
+
+  friend bool operator==(const CompactProductPtr &lhs, const CompactProductPtr &rhs) { return lhs.mpProduct == rhs.mpProduct; }
+  friend bool operator!=(const CompactProductPtr &lhs, const CompactProductPtr &rhs) { return lhs.mpProduct != rhs.mpProduct; }
+  friend bool operator==(const CompactProductPtr &lhs, std::nullptr_t) { return lhs.mpProduct == nullptr; }
+  friend bool operator!=(const CompactProductPtr &lhs, std::nullptr_t) { return lhs.mpProduct != nullptr; }
+
+private:
+  friend CompactProductPtr MakeCompactProduct(std::pmr::memory_resource *pMemoryResource, std::string_view id,
+    std::string_view producer, std::string_view name, CompactProduct::Price price);
+
+  //! Take over the reference of a newly made product \p pProduct
+  explicit CompactProductPtr(const CompactProduct *pProduct): mpProduct(pProduct) {}
+
+  const CompactProduct *mpProduct = nullptr;
+};
+
+//! Make a product with the given fields, which is allocated from the given memory resource
+//! \p pMemoryResource
+//!
+//! The memory resource is used by the thread that releases the last reference to the product,
+//! so a resource shared by several threads has to be thread-safe.
+//!
+//! Algorithm's time complexity: O(L), where L is the total length of the strings
+//!
+//! \pre \p pMemoryResource is not null and outlives the product, no string is longer than UINT32_MAX
+//!
+//! \return the smart pointer to the made product
+inline CompactProductPtr MakeCompactProduct(std::pmr::memory_resource *pMemoryResource, std::string_view id,
+  std::string_view producer, std::string_view name, CompactProduct::Price price)
+{
+  // pre-conditions
+  assert(pMemoryResource);
+  assert(id.size() <= UINT32_MAX && producer.size() <= UINT32_MAX && name.size() <= UINT32_MAX);
+
+  const size_t size = CompactProduct::AllocationSizeFor(id.size(), producer.size(), name.size());
+  void *pMemory = pMemoryResource->allocate(size, alignof(CompactProduct));
+  return CompactProductPtr(new(pMemory) CompactProduct(pMemoryResource, id, producer, name, price));
+}
+
+//! Make a product with the given fields, which is allocated from the default memory resource
+inline CompactProductPtr MakeCompactProduct(std::string_view id, std::string_view producer, std::string_view name,
+  CompactProduct::Price price)
+{
+  return MakeCompactProduct(std::pmr::get_default_resource(), id, producer, name, price);
+}
+
+//! Product traits: the products are CompactProduct held by CompactProductPtr, see BasicWarehouse
+struct CompactProductTraits
+{
+  using ProductType = CompactProduct;
+  using ProductPtr = CompactProductPtr;
+  using IdType = std::string_view;
+  using IdHash = StringHash;
+
+  static std::string_view IdOf(const CompactProduct &product) { return product.id(); }
+  static std::string_view ProducerOf(const CompactProduct &product) { return product.producer(); }
+  static std::string_view NameOf(const CompactProduct &product) { return product.name(); }
+  static Product::Price PriceOf(const CompactProduct &product) { return product.price(); }
+
+  //! Make a product from the given arguments \p args, which are id, producer, name and price
+  template <typename... Args>
+  static ProductPtr Make(std::pmr::memory_resource *pMemoryResource, Args&&... args)
+  {
+    return MakeCompactProduct(pMemoryResource, std::forward<Args>(args)...);
+  }
+
+  static ProductPtr MakeFromStrings(std::pmr::memory_resource *pMemoryResource, std::string_view id,
+    std::string_view producer, std::string_view name, Product::Price price)
+  {
+    return MakeCompactProduct(pMemoryResource, id, producer, name, price);
+  }
+};
+
+//! Warehouse of compact products with the given locking policy \p LockingPolicy
+template <typename LockingPolicy = ExclusiveLocking>
+using BasicCompactWarehouse = BasicWarehouse<LockingPolicy, CompactProductTraits>;
+
+//! Warehouse of compact products with the default (exclusive) locking policy
+using CompactWarehouse = BasicCompactWarehouse<>;
+
+#endif
@@ -0,0 +1,212 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "CompactProduct.h"
+#include "CatalogLoader.h"
+#include "ShardedWarehouse.h"
+
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Memory resource that counts the bytes allocated from it
+class CountingResource: public std::pmr::memory_resource
+{
+public:
+  size_t cntAllocatedBytes = 0;
+  size_t cntAllocations = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override
+  {
+    cntAllocatedBytes += bytes;
+    ++cntAllocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override
+  {
+    cntAllocatedBytes -= bytes;
+    --cntAllocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+TEST_CASE("making and sharing compact products") {
+
+  CountingResource resource;
+  {
+    CompactProductPtr pProduct = MakeCompactProduct(&resource, "SKU-00000001", "producer", "name of the product", 42u);
+    REQUIRE(pProduct);
+    CHECK(pProduct->id() == "SKU-00000001");
+    CHECK(pProduct->producer() == "producer");
+    CHECK(pProduct->name() == "name of the product");
+    CHECK(pProduct->price() == 42);
+
+    // the product is a single allocation
+    CHECK(resource.cntAllocations == 1);
+    CHECK(resource.cntAllocatedBytes == pProduct->AllocationSize());
+    CHECK(pProduct->AllocationSize() == sizeof(CompactProduct) + 12 + 8 + 19);
+
+    CompactProductPtr pCopy = pProduct;
+    CHECK(pProduct.use_count() == 2);
+    CHECK(pCopy == pProduct);
+
+    CompactProductPtr pMoved = std::move(pCopy);
+    CHECK(pCopy == nullptr);
+    CHECK(pMoved.use_count() == 2);
+
+    pProduct.reset();
+    CHECK(pProduct == nullptr);
+    CHECK(pMoved.use_count() == 1);
+    CHECK(resource.cntAllocations == 1);
+  }
+  CHECK(resource.cntAllocations == 0);
+  CHECK(resource.cntAllocatedBytes == 0);
+
+  SUBCASE("empty strings") {
+    CompactProductPtr pProduct = MakeCompactProduct("", "", "", 0u);
+    CHECK(pProduct->id().empty());
+    CHECK(pProduct->name().empty());
+  }
+
+  SUBCASE("the references are released by several threads") {
+    CompactProductPtr pProduct = MakeCompactProduct(&resource, "id", "producer", "name", 1u);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+    {
+      threads.emplace_back([pProduct]() {
+        for(int i = 0; i < 1000; ++i)
+        {
+          CompactProductPtr pCopy = pProduct;
+          CHECK(pCopy->price() == 1);
+        }
+      });
+    }
+    pProduct.reset();
+    for(auto &thread : threads)
+    {
+      thread.join();
+    }
+    CHECK(resource.cntAllocations == 0);
+  }
+}
+
+TEST_CASE("warehouse of compact products") {
+
+  CountingResource resource;
+  {
+    CompactWarehouse wh(&resource);
+    CHECK(wh.AddProduct(wh.MakeProduct("id1", "producerA", "name1", 3u)));
+    CHECK(wh.AddProduct(wh.MakeProduct("id2", "producerA", "name2", 1u)));
+    CHECK(wh.AddProduct(wh.MakeProduct("id3", "producerB", "name3", 2u)));
+    CHECK(wh.AddProduct(wh.MakeProduct("id1", "producerB", "name", 1u)) == false);
+
+    auto pProduct = wh.FindProductById("id1");
+    REQUIRE(pProduct);
+    CHECK(pProduct->producer() == "producerA");
+    CHECK(wh.FindProductById(std::string("id4")) == nullptr);
+
+    std::vector<std::string> names;
+    CHECK(wh.ForEachProductOfProducer("producerA", [&names](const CompactProduct &product) {
+      names.emplace_back(product.name());
+    }) == 2);
+    CHECK(names == std::vector<std::string>{"name2", "name1"});
+
+    std::vector<CompactWarehouse::ProductPtr> found;
+    CHECK(wh.FindProductsByPriceRange(2, 3, std::back_inserter(found)) == 2);
+    CHECK(found[0]->id() == "id3");
+
+    CHECK(wh.UpsertProduct(wh.MakeProduct("id2", "producerB", "name2", 5u)) == false);
+    CHECK(wh.UpdatePrice("id3", 7u));
+    CHECK(wh.CountProductsByProducer("producerA") == 1);
+    CHECK(wh.CountProductsByProducer("producerB") == 2);
+    CHECK(wh.FindProductById("id3")->price() == 7);
+
+    wh.EnableNameIndex();
+    found.clear();
+    CHECK(wh.FindProductsByNamePrefix("name", 10, std::back_inserter(found)) == 3);
+    CHECK(found[0]->id() == "id1");
+    CHECK(wh.FindProductsByNameSubstring("ame3", 10, std::back_inserter(found)) == 1);
+
+    const auto sums = wh.AggregateByProducer(ScanPolicy{2, 1}, 0u,
+      [](unsigned sum, const CompactProduct &product) { return sum + product.price(); });
+    CHECK(sums == std::vector<std::pair<Product::Producer, unsigned>>{{"producerA", 3}, {"producerB", 12}});
+    std::atomic<size_t> cntNamed{0};
+    CHECK(wh.ForEachProduct(kParallelScan, [&cntNamed](const CompactProduct &product) {
+      cntNamed += (product.name().substr(0, 4) == "name");
+    }) == 3);
+    CHECK(cntNamed == 3);
+
+    CHECK(wh.RemoveProductById("id1") == 1);
+    CHECK(wh.FindProductById("id1") == nullptr);
+    // the found product is still held
+    CHECK(pProduct->name() == "name1");
+
+    SUBCASE("saving and loading the snapshot") {
+      const std::string path = "CompactProduct_test.snapshot";
+      REQUIRE(wh.SaveSnapshot(path));
+
+      CompactWarehouse loaded(&resource);
+      REQUIRE(loaded.LoadSnapshot(path));
+      CHECK(loaded.FindProductById("id2")->producer() == "producerB");
+      CHECK(loaded.FindProductById("id3")->price() == 7);
+      CHECK(loaded.CountProductsByProducer("producerB") == 2);
+
+      // the snapshots of both representations are interchangeable
+      Warehouse sharedLoaded;
+      REQUIRE(sharedLoaded.LoadSnapshot(path));
+      CHECK(sharedLoaded.FindProductById("id2")->name == "name2");
+      std::remove(path.c_str());
+    }
+  }
+  CHECK(resource.cntAllocations == 0);
+}
+
+TEST_CASE("compact products take less memory than the shared ones") {
+
+  CountingResource compactResource;
+  CountingResource sharedResource;
+  {
+    CompactWarehouse compact(&compactResource);
+    Warehouse shared(&sharedResource);
+    for(int i = 0; i < 1000; ++i)
+    {
+      const std::string id = "SKU-" + std::to_string(10000000 + i);
+      const std::string name = "product name of " + std::to_string(i) + " that spills to the heap";
+      compact.AddProduct(compact.MakeProduct(id, "producer " + std::to_string(i % 10), name, 1u));
+      shared.AddProduct(shared.MakeProduct(id, "producer " + std::to_string(i % 10), name, 1u));
+    }
+    // the names of the shared products are allocated by the default resource, not by the counted one
+    CHECK(compactResource.cntAllocatedBytes < sharedResource.cntAllocatedBytes);
+  }
+}
+
+TEST_CASE("loading a catalog into the warehouses of compact products") {
+
+  const std::string csv = "id,producer,name,price\nid1,producerA,name1,1\nid2,producerB,name2,2\n";
+
+  SUBCASE("single warehouse") {
+    CompactWarehouse wh;
+    std::istringstream in(csv);
+    CHECK(CatalogLoader().Load(wh, in).cntAdded == 2);
+    CHECK(wh.FindProductById("id2")->name() == "name2");
+  }
+
+  SUBCASE("sharded warehouse") {
+    ShardedWarehouse<4, ExclusiveLocking, CompactProductTraits> wh;
+    std::istringstream in(csv);
+    CHECK(CatalogLoader().Load(wh, in).cntAdded == 2);
+    CHECK(wh.FindProductById("id1")->producer() == "producerA");
+    CHECK(wh.CountProductsByProducer("producerB") == 1);
+  }
+}
@@ -0,0 +1,714 @@
+#ifndef _FLAT_HASH_TABLE_H
+#define _FLAT_HASH_TABLE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// define FLAT_HASH_TABLE_NO_SIMD to use the portable probing even if SSE2 is available
+#if !defined(FLAT_HASH_TABLE_NO_SIMD) && \
+  (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FLAT_HASH_TABLE_SSE2 1
+#endif
+
+//! Hash table with open addressing that stores its elements in one flat array
+//!
+//! The table follows the layout of the Swiss tables: the slots are split into groups of
+//! 16, and every slot has a control byte that is either empty, deleted or holds the 7 low
+//! bits of the hash of the element in the slot. A lookup compares the control bytes of
+//! a whole group at once (with SSE2 if available), so usually only the slot of the looked
+//! up element is touched. The full hash of every element is stored as well, so a rehash
+//! never calls the hash function and key comparison is skipped for different hashes.
+//!
+//! The key is not stored separately, it is extracted from the element by \p KeyOfValue,
+//! hence the key part of an element must not be modified while it is in the table.
+//!
+//! Unlike std::unordered_map, insertion and rehashing move the elements, so pointers,
+//! references and iterators to the elements are invalidated by them.
+//!
+//! \tparam Value type of the elements
+//! \tparam KeyOfValue callable that returns the key of the given element
+//! \tparam Hash hash function of the keys
+//! \tparam KeyEqual equality of the keys
+//! \tparam Allocator allocator of the elements
+template <typename Value, typename KeyOfValue, typename Hash, typename KeyEqual,
+  typename Allocator = std::allocator<Value>>
+class FlatHashTable
+{
+  using Ctrl = int8_t;
+
+  static constexpr Ctrl kEmpty = -128;    //!< 0b10000000
+  static constexpr Ctrl kDeleted = -2;    //!< 0b11111110
+  static constexpr size_t kGroupWidth = 16;
+
+  //! Control bytes of one group of slots
+  class Group
+  {
+  public:
+    explicit Group(const Ctrl *pCtrl)
+    {
+#ifdef FLAT_HASH_TABLE_SSE2
+      mCtrl = _mm_load_si128(reinterpret_cast<const __m128i*>(pCtrl));
+#else
+      std::memcpy(mCtrl, pCtrl, kGroupWidth);
+#endif
+    }
+
+    //! Bit mask of the slots with the given 7 bits of hash \p h2
+    uint32_t Match(Ctrl h2) const
+    {
+#ifdef FLAT_HASH_TABLE_SSE2
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), mCtrl)));
+#else
+      return MatchIf([h2](Ctrl ctrl) { return ctrl == h2; });
+#endif
+    }
+
+    //! Bit mask of the empty slots
+    uint32_t MatchEmpty() const
+    {
+      return Match(kEmpty);
+    }
+
+    //! Bit mask of the empty or deleted slots, which are the ones with the sign bit set
+    uint32_t MatchEmptyOrDeleted() const
+    {
+#ifdef FLAT_HASH_TABLE_SSE2
+      return static_cast<uint32_t>(_mm_movemask_epi8(mCtrl));
+#else
+      return MatchIf([](Ctrl ctrl) { return ctrl < 0; });
+#endif
+    }
+
+  private:
+#ifdef FLAT_HASH_TABLE_SSE2
+    __m128i mCtrl;
+#else
+    template <typename Predicate>
+    uint32_t MatchIf(Predicate predicate) const
+    {
+      uint32_t mask = 0;
+      for(size_t i = 0; i < kGroupWidth; ++i)
+      {
+        mask |= static_cast<uint32_t>(predicate(mCtrl[i])) << i;
+      }
+      return mask;
+    }
+
+    Ctrl mCtrl[kGroupWidth];
+#endif
+  };
+
+  static size_t LowestBit(uint32_t mask)
+  {
+    // pre-conditions
+    assert(mask != 0);
+
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctz(mask));
+#else
+    size_t index = 0;
+    for(; !(mask & 1u); mask >>= 1)
+    {
+      ++index;
+    }
+    return index;
+#endif
+  }
+
+  static Ctrl H2(size_t hash) { return static_cast<Ctrl>(hash & 0x7F); }
+  static size_t H1(size_t hash) { return hash >> 7; }
+
+  //! Maximal number of elements in a table with the given capacity (load factor 7/8)
+  static size_t MaxSizeFor(size_t capacity) { return capacity - capacity / 8; }
+
+  template <typename T, typename = void>
+  struct IsTransparent: std::false_type {};
+  template <typename T>
+  struct IsTransparent<T, std::void_t<typename T::is_transparent>>: std::true_type {};
+
+  using AllocTraits = std::allocator_traits<Allocator>;
+  using CtrlAllocator = typename AllocTraits::template rebind_alloc<Ctrl>;
+  using HashAllocator = typename AllocTraits::template rebind_alloc<size_t>;
+
+public:
+  using key_type = std::decay_t<decltype(std::declval<KeyOfValue>()(std::declval<const Value&>()))>;
+  using value_type = Value;
+  using size_type = size_t;
+  using allocator_type = Allocator;
+
+  //! Whether elements can be looked up by keys of other types than key_type, which is the
+  //! case if both \p Hash and \p KeyEqual declare is_transparent
+  static constexpr bool kIsTransparent = IsTransparent<Hash>::value && IsTransparent<KeyEqual>::value;
+
+  //! Type of the keys other than key_type that elements can be looked up by
+  template <typename K>
+  using LookupKey = std::enable_if_t<kIsTransparent && !std::is_same_v<K, key_type>
+    && std::is_invocable_v<const Hash&, const K&>, K>;
+
+  template <bool IsConst>
+  class Iterator
+  {
+    friend class FlatHashTable;
+    using Table = std::conditional_t<IsConst, const FlatHashTable, FlatHashTable>;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<IsConst, const Value*, Value*>;
+    using reference = std::conditional_t<IsConst, const Value&, Value&>;
+
+    Iterator() = default;
+
+    //! Conversion of a mutable iterator to a const one
+    template <bool IsOtherConst, typename = std::enable_if_t<IsConst && !IsOtherConst>>
+    Iterator(const Iterator<IsOtherConst> &other): mpTable(other.mpTable), mIndex(other.mIndex) {}
+
+    reference operator*() const { return mpTable->mpSlots[mIndex]; }
+    pointer operator->() const { return &mpTable->mpSlots[mIndex]; }
+
+    Iterator& operator++()
+    {
+      mIndex = mpTable->NextFullSlot(mIndex + 1);
+      return *this;
+    }
+
+    Iterator operator++(int)
+    {
+      Iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    friend bool operator==(const Iterator &lhs, const Iterator &rhs) { return lhs.mIndex == rhs.mIndex; }
+    friend bool operator!=(const Iterator &lhs, const Iterator &rhs) { return lhs.mIndex != rhs.mIndex; }
+
+  private:
+    Iterator(Table *pTable, size_t index): mpTable(pTable), mIndex(index) {}
+
+    Table *mpTable = nullptr;
+    size_t mIndex = 0;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  explicit FlatHashTable(const Allocator &allocator = Allocator()): mAllocator(allocator) {}
+
+  FlatHashTable(const FlatHashTable &other):
+    FlatHashTable(other, AllocTraits::select_on_container_copy_construction(other.mAllocator))
+  {
+  }
+
+  //! Create a copy of the table \p other, which allocates with the given allocator \p allocator
+  FlatHashTable(const FlatHashTable &other, const Allocator &allocator):
+    mAllocator(allocator),
+    mHash(other.mHash), mKeyEqual(other.mKeyEqual), mKeyOfValue(other.mKeyOfValue)
+  {
+    if(other.mCapacity == 0)
+    {
+      return;
+    }
+
+    // the layout is copied as is, so no element has to be looked up again
+    Allocate(other.mCapacity);
+    std::memcpy(mpCtrl, other.mpCtrl, mCapacity);
+    std::memcpy(mpHashes, other.mpHashes, mCapacity * sizeof(size_t));
+    for(size_t i = 0; i < mCapacity; ++i)
+    {
+      if(mpCtrl[i] >= 0)
+      {
+        AllocTraits::construct(mAllocator, mpSlots + i, other.mpSlots[i]);
+      }
+    }
+    mSize = other.mSize;
+    mGrowthLeft = other.mGrowthLeft;
+  }
+
+  FlatHashTable(FlatHashTable &&other) noexcept:
+    mAllocator(std::move(other.mAllocator)),
+    mHash(std::move(other.mHash)), mKeyEqual(std::move(other.mKeyEqual)), mKeyOfValue(std::move(other.mKeyOfValue))
+  {
+    StealFrom(other);
+  }
+
+  //! Replace the elements of the table with copies of the elements of \p other
+  //!
+  //! The table keeps its allocator, as the standard containers do for the allocators that
+  //! do not propagate on copy assignment, e.g. std::pmr::polymorphic_allocator.
+  FlatHashTable& operator=(const FlatHashTable &other)
+  {
+    if(this != &other)
+    {
+      FlatHashTable copy(other, mAllocator);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  //! Replace the elements of the table with the elements of \p other
+  //!
+  //! The memory of \p other is taken over if both tables use equal allocators,
+  //! otherwise the elements are copied with the allocator of the table.
+  FlatHashTable& operator=(FlatHashTable &&other) noexcept(AllocTraits::is_always_equal::value)
+  {
+    if(AllocTraits::is_always_equal::value || mAllocator == other.mAllocator)
+    {
+      swap(other);
+    }
+    else
+    {
+      *this = static_cast<const FlatHashTable&>(other);
+    }
+    return *this;
+  }
+
+  ~FlatHashTable()
+  {
+    Destroy();
+  }
+
+  //! Exchange the elements of the table and of \p other
+  //!
+  //! \pre the allocators of the tables are equal, unless they propagate on swap
+  void swap(FlatHashTable &other) noexcept
+  {
+    using std::swap;
+    if constexpr(AllocTraits::propagate_on_container_swap::value)
+    {
+      swap(mAllocator, other.mAllocator);
+    }
+    else
+    {
+      assert(AllocTraits::is_always_equal::value || mAllocator == other.mAllocator);
+    }
+    swap(mHash, other.mHash);
+    swap(mKeyEqual, other.mKeyEqual);
+    swap(mKeyOfValue, other.mKeyOfValue);
+    swap(mpCtrlAllocation, other.mpCtrlAllocation);
+    swap(mpCtrl, other.mpCtrl);
+    swap(mpHashes, other.mpHashes);
+    swap(mpSlots, other.mpSlots);
+    swap(mCapacity, other.mCapacity);
+    swap(mSize, other.mSize);
+    swap(mGrowthLeft, other.mGrowthLeft);
+    swap(mCntRehashes, other.mCntRehashes);
+  }
+
+  allocator_type get_allocator() const { return mAllocator; }
+
+  iterator begin() { return iterator(this, NextFullSlot(0)); }
+  iterator end() { return iterator(this, mCapacity); }
+  const_iterator begin() const { return const_iterator(this, NextFullSlot(0)); }
+  const_iterator end() const { return const_iterator(this, mCapacity); }
+
+  size_t size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+
+  //! Number of slots
+  size_t capacity() const { return mCapacity; }
+
+  //! Ratio of the elements to the slots
+  float load_factor() const { return mCapacity? static_cast<float>(mSize) / mCapacity : 0.0f; }
+
+  //! Number of times the elements were moved into new slots, either to grow the table or to
+  //! drop the deleted slots; a copy of the table starts from 0
+  size_t rehash_count() const { return mCntRehashes; }
+
+  //! Make room for \p count elements, so inserting up to count - size() elements
+  //! does not rehash the table
+  void reserve(size_t count)
+  {
+    if(count > mSize + mGrowthLeft)
+    {
+      Rehash(CapacityFor(count));
+    }
+  }
+
+  void clear()
+  {
+    Destroy();
+    mpCtrlAllocation = mpCtrl = nullptr;
+    mpHashes = nullptr;
+    mpSlots = nullptr;
+    mCapacity = mSize = mGrowthLeft = 0;
+  }
+
+  iterator find(const key_type &key)
+  {
+    return iterator(this, FindIndex(key, mHash(key)));
+  }
+
+  const_iterator find(const key_type &key) const
+  {
+    return const_iterator(this, FindIndex(key, mHash(key)));
+  }
+
+  //! Find the element with the key equal to \p key of another type than key_type,
+  //! without converting it to key_type
+  template <typename K, typename = LookupKey<K>>
+  iterator find(const K &key)
+  {
+    return iterator(this, FindIndex(key, mHash(key)));
+  }
+
+  template <typename K, typename = LookupKey<K>>
+  const_iterator find(const K &key) const
+  {
+    return const_iterator(this, FindIndex(key, mHash(key)));
+  }
+
+  //! The same as find(), but with the hash \p hash of the key \p key computed already,
+  //! e.g. to hash a batch of keys before looking them up, see prefetch()
+  //!
+  //! \pre \p hash is equal to the hash of \p key by the hash function of the table
+  template <typename K>
+  iterator find_with_hash(size_t hash, const K &key)
+  {
+    return iterator(this, FindIndex(key, hash));
+  }
+
+  template <typename K>
+  const_iterator find_with_hash(size_t hash, const K &key) const
+  {
+    return const_iterator(this, FindIndex(key, hash));
+  }
+
+  //! Hint the processor to load the control bytes and the hashes probed first by a lookup of
+  //! a key with the given hash \p hash, so the lookups of a batch of keys overlap their cache misses
+  void prefetch(size_t hash) const
+  {
+    if(mCapacity == 0)
+    {
+      return;
+    }
+
+    const size_t index = (H1(hash) & (mCapacity / kGroupWidth - 1)) * kGroupWidth;
+#if defined(__GNUC__) || defined(__clang__)
+    // the hashes of a group take two cache lines
+    __builtin_prefetch(mpCtrl + index);
+    __builtin_prefetch(mpHashes + index);
+    __builtin_prefetch(mpHashes + index + kGroupWidth / 2);
+#elif defined(FLAT_HASH_TABLE_SSE2)
+    _mm_prefetch(reinterpret_cast<const char*>(mpCtrl + index), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(mpHashes + index), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(mpHashes + index + kGroupWidth / 2), _MM_HINT_T0);
+#endif
+  }
+
+  //! Insert the element constructed from \p args if the table has no element with the key \p key
+  //!
+  //! \pre the key of the element constructed from \p args is equal to \p key
+  //!
+  //! \return iterator to the element with the key \p key and whether the element was inserted
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type &key, Args&&... args)
+  {
+    return TryEmplace(mHash(key), key, std::forward<Args>(args)...);
+  }
+
+  //! The same as try_emplace(const key_type&, Args&&...), but for a key \p key of another type
+  //! than key_type, which is not converted to key_type
+  template <typename K, typename... Args, typename = LookupKey<K>>
+  std::pair<iterator, bool> try_emplace(const K &key, Args&&... args)
+  {
+    return TryEmplace(mHash(key), key, std::forward<Args>(args)...);
+  }
+
+  //! The same as try_emplace(const key_type&, Args&&...), but with the hash \p hash of the key
+  //! \p key computed already, e.g. by hash_of() of another table with the same hash function
+  //!
+  //! \pre \p hash is equal to the hash of \p key by the hash function of the table
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace_with_hash(size_t hash, const K &key, Args&&... args)
+  {
+    return TryEmplace(hash, key, std::forward<Args>(args)...);
+  }
+
+  //! Hash of the key of the element pointed by \p it, which is stored by the table
+  size_t hash_of(const_iterator it) const
+  {
+    // pre-conditions
+    assert(it.mIndex < mCapacity && mpCtrl[it.mIndex] >= 0);
+
+    return mpHashes[it.mIndex];
+  }
+
+  //! Remove the element pointed by \p it
+  void erase(const_iterator it)
+  {
+    // pre-conditions
+    assert(it.mIndex < mCapacity && mpCtrl[it.mIndex] >= 0);
+
+    const size_t index = it.mIndex;
+    AllocTraits::destroy(mAllocator, mpSlots + index);
+    --mSize;
+
+    // A group that has an empty slot never had all slots occupied, so no probe sequence
+    // has ever continued past it and the slot can become empty again. Otherwise a tombstone
+    // keeps the probe sequences going through the group intact.
+    if(Group(mpCtrl + index / kGroupWidth * kGroupWidth).MatchEmpty())
+    {
+      mpCtrl[index] = kEmpty;
+      ++mGrowthLeft;
+    }
+    else
+    {
+      mpCtrl[index] = kDeleted;
+    }
+  }
+
+  //! Remove the element with the key \p key
+  //!
+  //! \return the number of removed elements, which is either 1 or 0
+  size_t erase(const key_type &key)
+  {
+    return Erase(key);
+  }
+
+  //! The same as erase(const key_type&), but for a key \p key of another type than key_type,
+  //! which is not converted to key_type
+  template <typename K, typename = LookupKey<K>>
+  size_t erase(const K &key)
+  {
+    return Erase(key);
+  }
+
+private:
+  template <typename K>
+  size_t Erase(const K &key)
+  {
+    const size_t index = FindIndex(key, mHash(key));
+    if(index == mCapacity)
+    {
+      return 0;
+    }
+    erase(const_iterator(this, index));
+    return 1;
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> TryEmplace(size_t hash, const K &key, Args&&... args)
+  {
+    const size_t foundIndex = FindIndex(key, hash);
+    if(foundIndex != mCapacity)
+    {
+      return {iterator(this, foundIndex), false};
+    }
+
+    const size_t index = PrepareInsert(hash);
+    AllocTraits::construct(mAllocator, mpSlots + index, std::forward<Args>(args)...);
+
+    // post-conditions
+    assert(mKeyEqual(mKeyOfValue(mpSlots[index]), key));
+
+    return {iterator(this, index), true};
+  }
+
+  static size_t CapacityFor(size_t count)
+  {
+    size_t capacity = kGroupWidth;
+    while(MaxSizeFor(capacity) < count)
+    {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  //! Index of the slot with the given key \p key or the capacity if there is no such slot
+  template <typename K>
+  size_t FindIndex(const K &key, size_t hash) const
+  {
+    if(mCapacity == 0)
+    {
+      return mCapacity;
+    }
+
+    const size_t groupMask = mCapacity / kGroupWidth - 1;
+    const Ctrl h2 = H2(hash);
+
+    // triangular probing visits every group once when the number of groups is a power of 2
+    size_t groupIndex = H1(hash) & groupMask;
+    for(size_t step = 1; ; groupIndex = (groupIndex + step++) & groupMask)
+    {
+      const Group group(mpCtrl + groupIndex * kGroupWidth);
+      for(uint32_t mask = group.Match(h2); mask; mask &= mask - 1)
+      {
+        const size_t index = groupIndex * kGroupWidth + LowestBit(mask);
+        if(mpHashes[index] == hash && mKeyEqual(mKeyOfValue(mpSlots[index]), key))
+        {
+          return index;
+        }
+      }
+
+      // there is always an empty slot, since the load factor is kept below 1
+      if(group.MatchEmpty())
+      {
+        return mCapacity;
+      }
+    }
+  }
+
+  //! Index of the first empty or deleted slot of the probe sequence of the hash \p hash
+  size_t FindInsertIndex(size_t hash) const
+  {
+    const size_t groupMask = mCapacity / kGroupWidth - 1;
+
+    size_t groupIndex = H1(hash) & groupMask;
+    for(size_t step = 1; ; groupIndex = (groupIndex + step++) & groupMask)
+    {
+      if(uint32_t mask = Group(mpCtrl + groupIndex * kGroupWidth).MatchEmptyOrDeleted())
+      {
+        return groupIndex * kGroupWidth + LowestBit(mask);
+      }
+    }
+  }
+
+  //! Mark the slot for a new element with the given hash \p hash as occupied
+  //!
+  //! \return index of the slot, where the element has to be constructed
+  size_t PrepareInsert(size_t hash)
+  {
+    if(mCapacity == 0)
+    {
+      Rehash(kGroupWidth);
+    }
+
+    size_t index = FindInsertIndex(hash);
+    if(mGrowthLeft == 0 && mpCtrl[index] == kEmpty)
+    {
+      // if most of the non-empty slots are tombstones they are dropped by rehashing 
+      // into the same capacity, otherwise the table grows
+      Rehash((mSize < MaxSizeFor(mCapacity) / 2)? mCapacity : mCapacity * 2);
+      index = FindInsertIndex(hash);
+    }
+
+    mGrowthLeft -= (mpCtrl[index] == kEmpty);
+    mpCtrl[index] = H2(hash);
+    mpHashes[index] = hash;
+    ++mSize;
+    return index;
+  }
+
+  //! Move all elements into the new slots of the given capacity \p capacity,
+  //! using the stored hashes of the elements
+  void Rehash(size_t capacity)
+  {
+    // pre-conditions
+    assert(MaxSizeFor(capacity) >= mSize);
+
+    Ctrl *pOldCtrlAllocation = mpCtrlAllocation;
+    Ctrl *pOldCtrl = mpCtrl;
+    size_t *pOldHashes = mpHashes;
+    Value *pOldSlots = mpSlots;
+    const size_t oldCapacity = mCapacity;
+    mCntRehashes += (oldCapacity != 0);
+
+    Allocate(capacity);
+    for(size_t i = 0; i < oldCapacity; ++i)
+    {
+      if(pOldCtrl[i] >= 0)
+      {
+        const size_t index = FindInsertIndex(pOldHashes[i]);
+        mpCtrl[index] = pOldCtrl[i];
+        mpHashes[index] = pOldHashes[i];
+        AllocTraits::construct(mAllocator, mpSlots + index, std::move(pOldSlots[i]));
+        AllocTraits::destroy(mAllocator, pOldSlots + i);
+      }
+    }
+    mGrowthLeft = MaxSizeFor(capacity) - mSize;
+
+    Deallocate(pOldCtrlAllocation, pOldHashes, pOldSlots, oldCapacity);
+  }
+
+  //! Allocate empty slots of the given capacity \p capacity
+  void Allocate(size_t capacity)
+  {
+    CtrlAllocator ctrlAllocator(mAllocator);
+    HashAllocator hashAllocator(mAllocator);
+
+    // control bytes of a group are loaded with one aligned load
+    mpCtrlAllocation = std::allocator_traits<CtrlAllocator>::allocate(ctrlAllocator, capacity + kGroupWidth);
+    const size_t misalignment = reinterpret_cast<uintptr_t>(mpCtrlAllocation) % kGroupWidth;
+    mpCtrl = mpCtrlAllocation + (misalignment? kGroupWidth - misalignment : 0);
+    std::memset(mpCtrl, static_cast<unsigned char>(kEmpty), capacity);
+
+    mpHashes = std::allocator_traits<HashAllocator>::allocate(hashAllocator, capacity);
+    mpSlots = AllocTraits::allocate(mAllocator, capacity);
+    mCapacity = capacity;
+    mGrowthLeft = MaxSizeFor(capacity);
+  }
+
+  void Deallocate(Ctrl *pCtrlAllocation, size_t *pHashes, Value *pSlots, size_t capacity)
+  {
+    if(capacity == 0)
+    {
+      return;
+    }
+
+    CtrlAllocator ctrlAllocator(mAllocator);
+    HashAllocator hashAllocator(mAllocator);
+    std::allocator_traits<CtrlAllocator>::deallocate(ctrlAllocator, pCtrlAllocation, capacity + kGroupWidth);
+    std::allocator_traits<HashAllocator>::deallocate(hashAllocator, pHashes, capacity);
+    AllocTraits::deallocate(mAllocator, pSlots, capacity);
+  }
+
+  //! Destroy all elements and free the slots
+  void Destroy()
+  {
+    for(size_t i = 0; i < mCapacity; ++i)
+    {
+      if(mpCtrl[i] >= 0)
+      {
+        AllocTraits::destroy(mAllocator, mpSlots + i);
+      }
+    }
+    Deallocate(mpCtrlAllocation, mpHashes, mpSlots, mCapacity);
+  }
+
+  void StealFrom(FlatHashTable &other)
+  {
+    mpCtrl = std::exchange(other.mpCtrl, nullptr);
+    mpHashes = std::exchange(other.mpHashes, nullptr);
+    mpSlots = std::exchange(other.mpSlots, nullptr);
+    mCapacity = std::exchange(other.mCapacity, 0);
+    mSize = std::exchange(other.mSize, 0);
+    mGrowthLeft = std::exchange(other.mGrowthLeft, 0);
+    mCntRehashes = std::exchange(other.mCntRehashes, 0);
+    mpCtrlAllocation = std::exchange(other.mpCtrlAllocation, nullptr);
+  }
+
+  //! Index of the first occupied slot starting from the given index \p index
+  size_t NextFullSlot(size_t index) const
+  {
+    while(index < mCapacity && mpCtrl[index] < 0)
+    {
+      ++index;
+    }
+    return index;
+  }
+
+  Allocator mAllocator;
+  Hash mHash;
+  KeyEqual mKeyEqual;
+  KeyOfValue mKeyOfValue;
+
+  Ctrl *mpCtrlAllocation = nullptr;  //!< allocation of the control bytes
+  Ctrl *mpCtrl = nullptr;            //!< control bytes aligned to the group width
+  size_t *mpHashes = nullptr;
+  Value *mpSlots = nullptr;
+  size_t mCapacity = 0;     //!< number of slots, either 0 or a power of 2 not less than kGroupWidth
+  size_t mSize = 0;         //!< number of elements
+  size_t mGrowthLeft = 0;   //!< number of elements that can be inserted into the empty slots before rehashing
+  size_t mCntRehashes = 0;  //!< see rehash_count()
+};
+
+#endif
@@ -0,0 +1,175 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "FlatHashTable.h"
+
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+using Element = std::pair<std::string, int>;
+
+struct KeyOfElement
+{
+  const std::string& operator()(const Element &element) const { return element.first; }
+};
+
+using Table = FlatHashTable<Element, KeyOfElement, std::hash<std::string>, std::equal_to<std::string>>;
+
+//! Check that the table contains exactly the elements of the model
+void CheckEqual(const Table &table, const std::unordered_map<std::string, int> &model)
+{
+  REQUIRE(table.size() == model.size());
+  size_t cntVisited = 0;
+  for(const auto &[key, value] : table)
+  {
+    auto it = model.find(key);
+    REQUIRE(it != model.end());
+    CHECK(it->second == value);
+    cntVisited++;
+  }
+  CHECK(cntVisited == model.size());
+}
+
+TEST_CASE("inserting, finding and erasing elements of the flat hash table") {
+
+  Table table;
+
+  SUBCASE("empty table => nothing found") {
+    CHECK(table.empty());
+    CHECK(table.find("key") == table.end());
+    CHECK(table.erase("key") == 0);
+    CHECK(table.begin() == table.end());
+  }
+
+  SUBCASE("elements with new keys are inserted, with existing keys are not") {
+    auto [it1, inserted1] = table.try_emplace("key1", "key1", 1);
+    CHECK(inserted1);
+    CHECK(it1->second == 1);
+
+    auto [it2, inserted2] = table.try_emplace("key1", "key1", 2);
+    CHECK(!inserted2);
+    CHECK(it2->second == 1);
+
+    CHECK(table.size() == 1);
+    CHECK(table.find("key1")->second == 1);
+    CHECK(table.find("key2") == table.end());
+  }
+
+  SUBCASE("erased elements are not found any more") {
+    table.try_emplace("key1", "key1", 1);
+    table.try_emplace("key2", "key2", 2);
+
+    CHECK(table.erase("key1") == 1);
+    CHECK(table.erase("key1") == 0);
+    CHECK(table.find("key1") == table.end());
+    CHECK(table.find("key2")->second == 2);
+
+    table.erase(table.find("key2"));
+    CHECK(table.empty());
+  }
+}
+
+TEST_CASE("finding elements of the flat hash table by the precomputed hashes") {
+
+  Table table;
+  std::hash<std::string> hash;
+
+  // prefetching an empty table is a no-op
+  table.prefetch(hash("key0"));
+  CHECK(table.find_with_hash(hash("key0"), std::string("key0")) == table.end());
+
+  for(int i = 0; i < 100; ++i)
+  {
+    const std::string key = "key" + std::to_string(i);
+    table.try_emplace(key, key, i);
+  }
+  for(int i = 0; i < 200; ++i)
+  {
+    const std::string key = "key" + std::to_string(i);
+    table.prefetch(hash(key));
+    const Table &constTable = table;
+    CHECK(table.find_with_hash(hash(key), key) == table.find(key));
+    CHECK(constTable.find_with_hash(hash(key), key) == constTable.find(key));
+  }
+}
+
+TEST_CASE("random operations on the flat hash table match std::unordered_map") {
+
+  Table table;
+  std::unordered_map<std::string, int> model;
+
+  std::mt19937 random(42);
+  for(int i = 0; i < 20000; ++i)
+  {
+    // small key space, so the same slots are inserted and erased many times and tombstones pile up
+    const std::string key = "key" + std::to_string(random() % 2000);
+    if(random() % 3)
+    {
+      const bool inserted = table.try_emplace(key, key, i).second;
+      CHECK(inserted == model.emplace(key, i).second);
+    }
+    else
+    {
+      CHECK(table.erase(key) == model.erase(key));
+    }
+
+    auto it = table.find(key);
+    auto itModel = model.find(key);
+    REQUIRE((it == table.end()) == (itModel == model.end()));
+    if(itModel != model.end())
+    {
+      CHECK(it->second == itModel->second);
+    }
+  }
+  CheckEqual(table, model);
+  CHECK(table.load_factor() <= 0.875f);
+}
+
+TEST_CASE("reserving, copying and moving the flat hash table") {
+
+  Table table;
+  std::unordered_map<std::string, int> model;
+  for(int i = 0; i < 1000; ++i)
+  {
+    const std::string key = "key" + std::to_string(i);
+    table.try_emplace(key, key, i);
+    model.emplace(key, i);
+  }
+
+  SUBCASE("reserving keeps the elements and prevents rehashing") {
+    const size_t cntRehashes = table.rehash_count();
+    CHECK(cntRehashes > 0);
+    table.reserve(5000);
+    const size_t capacity = table.capacity();
+    for(int i = 1000; i < 5000; ++i)
+    {
+      const std::string key = "key" + std::to_string(i);
+      table.try_emplace(key, key, i);
+      model.emplace(key, i);
+    }
+    CHECK(table.capacity() == capacity);
+    CHECK(table.rehash_count() == cntRehashes + 1);
+    CheckEqual(table, model);
+  }
+
+  SUBCASE("copy is independent of the original") {
+    Table copy(table);
+    table.erase("key1");
+    CheckEqual(copy, model);
+    CHECK(copy.find("key1") != copy.end());
+  }
+
+  SUBCASE("moving transfers the elements") {
+    Table moved(std::move(table));
+    CheckEqual(moved, model);
+
+    table = std::move(moved);
+    CheckEqual(table, model);
+
+    table.clear();
+    CHECK(table.empty());
+    CHECK(table.find("key1") == table.end());
+  }
+}
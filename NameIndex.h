@@ -0,0 +1,413 @@
+#ifndef _NAME_INDEX_H
+#define _NAME_INDEX_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "FlatHashTable.h"
+#include "PriceIndex.h"
+
+//! Index of pointers by the names of their pointees, which finds the names by a prefix or
+//! by a substring
+//!
+//! Every pointer takes a slot of the index, which is returned on insertion and identifies the
+//! pointer afterwards, so the owner of the index keeps the slots instead of looking them up.
+//! The names are ordered by a PriceIndex whose "prices" are the names, so the names with the
+//! same prefix are adjacent. Every name is split into its trigrams, the substrings of 3 bytes,
+//! and every trigram has a sorted posting list of the slots of the names containing it.
+//! A substring is found by intersecting the posting lists of its trigrams, starting from the
+//! shortest one and galloping through the others, and the candidates are verified by comparing
+//! the names, since a name may contain all trigrams of a substring, but not the substring itself.
+//!
+//! The names are compared byte by byte, the index does not fold the case.
+//!
+//! \tparam Ptr type of the (smart) pointers, get() returns the address of the pointee
+//! \tparam NameOf callable that returns the name of the given pointee as std::string_view,
+//!   which must not change while its pointer is in the index
+//! \tparam Allocator allocator, which is rebound to the slots, to the posting lists and to the
+//!   name order
+template <typename Ptr, typename NameOf, typename Allocator = std::allocator<Ptr>>
+class NameIndex
+{
+public:
+  using Slot = uint32_t;
+  using allocator_type = Allocator;
+
+  explicit NameIndex(const Allocator &allocator = Allocator()):
+    mSlots(allocator), mFreeSlots(allocator), mByName(allocator),
+    mPostingsByTrigram(allocator), mPostings(allocator)
+  {
+  }
+
+  //! Exchange the entries of the index and of \p other
+  //!
+  //! \pre the allocators of the indexes are equal, unless they propagate on swap
+  void swap(NameIndex &other) noexcept
+  {
+    mSlots.swap(other.mSlots);
+    mFreeSlots.swap(other.mFreeSlots);
+    mByName.swap(other.mByName);
+    mPostingsByTrigram.swap(other.mPostingsByTrigram);
+    mPostings.swap(other.mPostings);
+  }
+
+  size_t size() const { return mByName.size(); }
+  bool empty() const { return mByName.empty(); }
+
+  void clear()
+  {
+    mSlots.clear();
+    mFreeSlots.clear();
+    mByName.clear();
+    mPostingsByTrigram.clear();
+    mPostings.clear();
+  }
+
+  //! Insert the pointer \p ptr
+  //!
+  //! Algorithm's time complexity: O(L*logL + logN + kMaxBlockSize + L*S) amortized, where
+  //! L is length of the name and S is length of the longest posting list of its trigrams,
+  //! which is O(L*logL + logN) if no slot was freed before
+  //!
+  //! \pre \p ptr is not null and is not in the index
+  //!
+  //! \return the slot of the pointer
+  Slot insert(Ptr ptr)
+  {
+    // pre-conditions
+    assert(ptr);
+    assert(mSlots.size() - mFreeSlots.size() < std::numeric_limits<Slot>::max());
+
+    Slot slot;
+    if(mFreeSlots.empty())
+    {
+      slot = static_cast<Slot>(mSlots.size());
+      mSlots.emplace_back();
+    }
+    else
+    {
+      slot = mFreeSlots.back();
+      mFreeSlots.pop_back();
+    }
+
+    const std::string_view name = NameOf()(*ptr);
+    AddPostings(slot, name);
+    mByName.insert(name, ptr);
+    mSlots[slot] = std::move(ptr);
+    return slot;
+  }
+
+  //! Erase the pointer with the slot \p slot
+  //!
+  //! Algorithm's time complexity: O(L*logL + logN + kMaxBlockSize + L*S) amortized
+  //!
+  //! \pre \p slot is the slot of a pointer of the index
+  void erase(Slot slot)
+  {
+    // pre-conditions
+    assert(slot < mSlots.size() && mSlots[slot]);
+
+    Ptr ptr = std::move(mSlots[slot]);
+    mSlots[slot] = Ptr();
+    mFreeSlots.push_back(slot);
+
+    const std::string_view name = NameOf()(*ptr);
+    RemovePostings(slot, name);
+    mByName.erase(name, ptr);
+  }
+
+  //! Replace the pointer with the slot \p slot by the pointer \p ptr, which takes the same slot
+  //!
+  //! The posting lists are not changed if the names of the pointers are equal.
+  //!
+  //! Algorithm's time complexity:
+  //! - O(logN + kMaxBlockSize) amortized if the names are equal
+  //! - as of erase() and insert() otherwise
+  //!
+  //! \pre \p slot is the slot of a pointer of the index, \p ptr is not null and is not in the index
+  void replace(Slot slot, Ptr ptr)
+  {
+    // pre-conditions
+    assert(slot < mSlots.size() && mSlots[slot]);
+    assert(ptr);
+
+    Ptr oldPtr = std::move(mSlots[slot]);
+    const std::string_view oldName = NameOf()(*oldPtr);
+    const std::string_view name = NameOf()(*ptr);
+    if(oldName != name)
+    {
+      RemovePostings(slot, oldName);
+      AddPostings(slot, name);
+    }
+    mByName.replace(oldName, oldPtr, name, ptr);
+    mSlots[slot] = std::move(ptr);
+  }
+
+  //! Replace the pointers of the index with the pointers of the range [\p first, \p last),
+  //! the i-th pointer of the range takes the slot i
+  //!
+  //! Algorithm's time complexity: O(K*L*logL + K*logK), where K is number of pointers of the range
+  //!
+  //! \pre the pointers of the range are unique and not null
+  template <typename InputIt>
+  void assign(InputIt first, InputIt last)
+  {
+    clear();
+
+    // the slots are added in increasing order, so every posting list is appended to
+    std::vector<typename ByName::Entry> entries;
+    for(; first != last; ++first)
+    {
+      const Ptr &ptr = *first;
+      assert(ptr);
+
+      const Slot slot = static_cast<Slot>(mSlots.size());
+      const std::string_view name = NameOf()(*ptr);
+      AddPostings(slot, name);
+      entries.push_back({name, ptr});
+      mSlots.push_back(ptr);
+    }
+    mByName.assign(entries.begin(), entries.end());
+  }
+
+  //! Visit in the order of the names at most \p limit pointers whose names start with the given
+  //! prefix \p prefix
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Ptr&) for every pointer
+  //!
+  //! Algorithm's time complexity: O(logN + kMaxBlockSize + M), where M is number of visited pointers
+  //!
+  //! \return number of visited pointers
+  template <typename Visitor>
+  size_t ForEachWithPrefix(std::string_view prefix, size_t limit, Visitor &&visitor) const
+  {
+    if(limit == 0)
+    {
+      return 0;
+    }
+
+    return mByName.ForEachFromPrice(prefix, [prefix, limit, &visitor, cntVisited = size_t(0)](
+      const typename ByName::Entry &entry) mutable {
+      if(cntVisited == limit || entry.price.substr(0, prefix.size()) != prefix)
+      {
+        return false;
+      }
+      visitor(entry.ptr);
+      ++cntVisited;
+      return true;
+    });
+  }
+
+  //! Visit in the order of the slots at most \p limit pointers whose names contain the given
+  //! substring \p substring
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Ptr&) for every pointer
+  //!
+  //! Algorithm's time complexity:
+  //! - O(L*logL + T*S*L), where L is length of the substring, T is number of its trigrams and
+  //!   S is length of the shortest posting list of them, if the substring is not shorter than
+  //!   a trigram; the other lists are galloped through, so usually only S slots are tested
+  //! - O(N*L) otherwise, since every name is tested
+  //!
+  //! \return number of visited pointers
+  template <typename Visitor>
+  size_t ForEachWithSubstring(std::string_view substring, size_t limit, Visitor &&visitor) const
+  {
+    if(limit == 0)
+    {
+      return 0;
+    }
+
+    size_t cntVisited = 0;
+    if(substring.size() < kTrigramSize)
+    {
+      for(const Ptr &ptr : mSlots)
+      {
+        if(ptr && NameOf()(*ptr).find(substring) != std::string_view::npos)
+        {
+          visitor(ptr);
+          if(++cntVisited == limit)
+          {
+            break;
+          }
+        }
+      }
+      return cntVisited;
+    }
+
+    // Time complexity of collecting the posting lists: O(L*logL)
+    std::vector<const SlotList*> postings;
+    for(Trigram trigram : TrigramsOf(substring))
+    {
+      auto it = mPostingsByTrigram.find(trigram);
+      if(it == mPostingsByTrigram.end() || mPostings[it->postings].empty())
+      {
+        return 0;
+      }
+      postings.push_back(&mPostings[it->postings]);
+    }
+    std::sort(postings.begin(), postings.end(), [](const SlotList *pLhs, const SlotList *pRhs) {
+      return pLhs->size() < pRhs->size();
+    });
+
+    // Time complexity of the intersection: O(T*S*logS') for the galloping, where S' is length
+    // of the longest list, and O(S*L) for testing the candidates
+    std::vector<size_t> positions(postings.size());
+    for(Slot slot : *postings.front())
+    {
+      bool isInAll = true;
+      for(size_t i = 1; i < postings.size(); ++i)
+      {
+        const SlotList &list = *postings[i];
+        positions[i] = LowerBoundFrom(list, positions[i], slot);
+        if(positions[i] == list.size())
+        {
+          // the next slots of the shortest list are greater still
+          return cntVisited;
+        }
+        if(list[positions[i]] != slot)
+        {
+          isInAll = false;
+          break;
+        }
+      }
+
+      const Ptr &ptr = mSlots[slot];
+      if(isInAll && NameOf()(*ptr).find(substring) != std::string_view::npos)
+      {
+        visitor(ptr);
+        if(++cntVisited == limit)
+        {
+          break;
+        }
+      }
+    }
+    return cntVisited;
+  }
+
+private:
+  using Trigram = uint32_t;
+  static constexpr size_t kTrigramSize = 3;
+
+  using AllocTraits = std::allocator_traits<Allocator>;
+  using SlotList = std::vector<Slot, typename AllocTraits::template rebind_alloc<Slot>>;
+  using ByName = PriceIndex<std::string_view, Ptr, typename AllocTraits::template rebind_alloc<Ptr>>;
+
+  //! Unique trigrams of the given string \p str in increasing order
+  static std::vector<Trigram> TrigramsOf(std::string_view str)
+  {
+    std::vector<Trigram> trigrams;
+    for(size_t i = 0; i + kTrigramSize <= str.size(); ++i)
+    {
+      trigrams.push_back(Trigram(static_cast<unsigned char>(str[i])) << 16 |
+        Trigram(static_cast<unsigned char>(str[i + 1])) << 8 | Trigram(static_cast<unsigned char>(str[i + 2])));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+  }
+
+  //! Index of the first slot of the sorted list \p list from the position \p first that is not
+  //! less than \p slot, found by doubling the step first, so the close slots are found fast
+  static size_t LowerBoundFrom(const SlotList &list, size_t first, Slot slot)
+  {
+    size_t last = first;
+    for(size_t step = 1; last < list.size() && list[last] < slot; step *= 2)
+    {
+      first = last + 1;
+      last += step;
+    }
+    last = std::min(last + 1, list.size());
+    return std::lower_bound(list.begin() + first, list.begin() + last, slot) - list.begin();
+  }
+
+  //! Add the slot \p slot to the posting lists of the trigrams of the name \p name
+  void AddPostings(Slot slot, std::string_view name)
+  {
+    for(Trigram trigram : TrigramsOf(name))
+    {
+      auto [it, success] = mPostingsByTrigram.try_emplace(trigram, TrigramPostings{trigram, mPostings.size()});
+      if(success)
+      {
+        mPostings.emplace_back();
+      }
+
+      SlotList &list = mPostings[it->postings];
+      if(list.empty() || list.back() < slot)
+      {
+        list.push_back(slot);
+      }
+      else
+      {
+        list.insert(std::lower_bound(list.begin(), list.end(), slot), slot);
+      }
+    }
+  }
+
+  //! Remove the slot \p slot from the posting lists of the trigrams of the name \p name
+  //!
+  //! The empty lists are kept, as the number of distinct trigrams is bounded.
+  void RemovePostings(Slot slot, std::string_view name)
+  {
+    for(Trigram trigram : TrigramsOf(name))
+    {
+      auto it = mPostingsByTrigram.find(trigram);
+      assert(it != mPostingsByTrigram.end());
+
+      SlotList &list = mPostings[it->postings];
+      auto itSlot = std::lower_bound(list.begin(), list.end(), slot);
+      assert(itSlot != list.end() && *itSlot == slot);
+      list.erase(itSlot);
+    }
+  }
+
+  //! Posting list of a trigram, see mPostings
+  struct TrigramPostings
+  {
+    Trigram trigram;
+    size_t postings;
+  };
+
+  struct TrigramOfPostings
+  {
+    Trigram operator()(const TrigramPostings &trigramPostings) const { return trigramPostings.trigram; }
+  };
+
+  //! Hash of the trigrams, which mixes their bytes into all bits of the hash
+  struct TrigramHash
+  {
+    size_t operator()(Trigram trigram) const
+    {
+      const uint64_t hash = uint64_t(trigram) * 0x9E3779B97F4A7C15ull;
+      return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+  };
+
+  //! Pointers by their slots, the free slots have empty pointers
+  std::vector<Ptr, typename AllocTraits::template rebind_alloc<Ptr>> mSlots;
+
+  //! Free slots, which are taken before new ones
+  std::vector<Slot, typename AllocTraits::template rebind_alloc<Slot>> mFreeSlots;
+
+  //! Pointers ordered by their names
+  ByName mByName;
+
+  //! Indexes of the posting lists of the trigrams; the lists themselves are kept in a vector,
+  //! so they allocate from the same allocator as the vector of them
+  FlatHashTable<TrigramPostings, TrigramOfPostings, TrigramHash, std::equal_to<Trigram>,
+    typename AllocTraits::template rebind_alloc<TrigramPostings>> mPostingsByTrigram;
+
+  //! Sorted slots of the names containing the trigrams
+  std::vector<SlotList, typename AllocTraits::template rebind_alloc<SlotList>> mPostings;
+};
+
+#endif
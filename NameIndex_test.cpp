@@ -0,0 +1,192 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "NameIndex.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using NamePtr = std::shared_ptr<const std::string>;
+
+struct NameOfString
+{
+  std::string_view operator()(const std::string &str) const { return str; }
+};
+
+using Index = NameIndex<NamePtr, NameOfString>;
+
+NamePtr MakeName(std::string name)
+{
+  return std::make_shared<const std::string>(std::move(name));
+}
+
+//! Names of the pointers visited by the given search \p search
+template <typename Search>
+std::vector<std::string> NamesFoundBy(Search &&search)
+{
+  std::vector<std::string> names;
+  search([&names](const NamePtr &ptr) { names.push_back(*ptr); });
+  return names;
+}
+
+TEST_CASE("finding names by their prefixes and substrings") {
+
+  Index index;
+  const auto banana = index.insert(MakeName("banana"));
+  index.insert(MakeName("apple pie"));
+  index.insert(MakeName("apple"));
+  index.insert(MakeName("pineapple"));
+  index.insert(MakeName("ban"));
+  REQUIRE(index.size() == 5);
+
+  auto withPrefix = [&index](std::string_view prefix, size_t limit) {
+    return NamesFoundBy([&](auto &&visitor) { index.ForEachWithPrefix(prefix, limit, visitor); });
+  };
+  auto withSubstring = [&index](std::string_view substring, size_t limit) {
+    auto names = NamesFoundBy([&](auto &&visitor) { index.ForEachWithSubstring(substring, limit, visitor); });
+    std::sort(names.begin(), names.end());
+    return names;
+  };
+
+  SUBCASE("the names with a prefix are visited in order") {
+    CHECK(withPrefix("app", 10) == std::vector<std::string>{"apple", "apple pie"});
+    CHECK(withPrefix("ban", 10) == std::vector<std::string>{"ban", "banana"});
+    CHECK(withPrefix("", 10) == std::vector<std::string>{"apple", "apple pie", "ban", "banana", "pineapple"});
+    CHECK(withPrefix("apples", 10).empty());
+    CHECK(withPrefix("z", 10).empty());
+  }
+
+  SUBCASE("the names with a substring are visited") {
+    CHECK(withSubstring("apple", 10) == std::vector<std::string>{"apple", "apple pie", "pineapple"});
+    CHECK(withSubstring("nan", 10) == std::vector<std::string>{"banana"});
+    CHECK(withSubstring("pie", 10) == std::vector<std::string>{"apple pie"});
+    CHECK(withSubstring("an", 10) == std::vector<std::string>{"ban", "banana"});
+    CHECK(withSubstring("", 10).size() == 5);
+    CHECK(withSubstring("xyz", 10).empty());
+    // all trigrams are there, but not the substring
+    CHECK(withSubstring("anana pie", 10).empty());
+  }
+
+  SUBCASE("at most limit names are visited") {
+    CHECK(withPrefix("", 2) == std::vector<std::string>{"apple", "apple pie"});
+    CHECK(withPrefix("", 0).empty());
+    CHECK(withSubstring("apple", 2).size() == 2);
+    CHECK(withSubstring("a", 1).size() == 1);
+    CHECK(withSubstring("apple", 0).empty());
+  }
+
+  SUBCASE("erased and replaced names are not found any more") {
+    index.erase(banana);
+    CHECK(withPrefix("ban", 10) == std::vector<std::string>{"ban"});
+    CHECK(withSubstring("nan", 10).empty());
+
+    // the freed slot is taken again
+    CHECK(index.insert(MakeName("bandana")) == banana);
+    CHECK(withSubstring("ana", 10) == std::vector<std::string>{"bandana"});
+
+    index.replace(banana, MakeName("cabana"));
+    CHECK(withSubstring("ana", 10) == std::vector<std::string>{"cabana"});
+    CHECK(withPrefix("band", 10).empty());
+    CHECK(index.size() == 5);
+  }
+
+  SUBCASE("assigning replaces all names") {
+    const std::vector<NamePtr> ptrs{MakeName("cherry"), MakeName("cheese")};
+    index.assign(ptrs.begin(), ptrs.end());
+    CHECK(index.size() == 2);
+    CHECK(withPrefix("che", 10) == std::vector<std::string>{"cheese", "cherry"});
+    CHECK(withSubstring("err", 10) == std::vector<std::string>{"cherry"});
+    CHECK(withSubstring("apple", 10).empty());
+    index.erase(1);
+    CHECK(withPrefix("", 10) == std::vector<std::string>{"cherry"});
+  }
+
+  SUBCASE("copies and swapped indexes are independent") {
+    Index copy(index);
+    Index other;
+    other.swap(index);
+    CHECK(index.empty());
+    CHECK(withSubstring("apple", 10).empty());
+    CHECK(copy.size() == 5);
+    CHECK(other.size() == 5);
+  }
+}
+
+TEST_CASE("random operations on the name index match a brute force search") {
+
+  std::mt19937 random(42);
+  std::pmr::unsynchronized_pool_resource resource;
+  NameIndex<NamePtr, NameOfString, std::pmr::polymorphic_allocator<NamePtr>> index(&resource);
+  std::map<Index::Slot, NamePtr> model;
+
+  // the names over a small alphabet share many trigrams
+  auto randomString = [&random](size_t maxLength) {
+    std::string str(random() % (maxLength + 1), ' ');
+    for(char &c : str)
+    {
+      c = "abc"[random() % 3];
+    }
+    return str;
+  };
+
+  for(int i = 0; i < 3000; ++i)
+  {
+    const unsigned operation = random() % 10;
+    if(operation < 5 || model.empty())
+    {
+      NamePtr ptr = MakeName(randomString(12));
+      model[index.insert(ptr)] = ptr;
+    }
+    else
+    {
+      auto it = std::next(model.begin(), random() % model.size());
+      if(operation < 8)
+      {
+        index.erase(it->first);
+        model.erase(it);
+      }
+      else
+      {
+        NamePtr ptr = MakeName(operation == 8? randomString(12) : *it->second);
+        index.replace(it->first, ptr);
+        it->second = ptr;
+      }
+    }
+
+    if(i % 50 != 0)
+    {
+      continue;
+    }
+    REQUIRE(index.size() == model.size());
+    const std::string pattern = randomString(5);
+
+    std::vector<std::string> expectedWithPrefix, expectedWithSubstring;
+    for(const auto &[slot, ptr] : model)
+    {
+      if(ptr->compare(0, pattern.size(), pattern) == 0)
+      {
+        expectedWithPrefix.push_back(*ptr);
+      }
+      if(ptr->find(pattern) != std::string::npos)
+      {
+        expectedWithSubstring.push_back(*ptr);
+      }
+    }
+    std::sort(expectedWithPrefix.begin(), expectedWithPrefix.end());
+    std::sort(expectedWithSubstring.begin(), expectedWithSubstring.end());
+
+    auto withPrefix = NamesFoundBy([&](auto &&visitor) { index.ForEachWithPrefix(pattern, SIZE_MAX, visitor); });
+    CHECK(withPrefix == expectedWithPrefix);
+
+    auto withSubstring = NamesFoundBy([&](auto &&visitor) {
+      index.ForEachWithSubstring(pattern, SIZE_MAX, visitor);
+    });
+    std::sort(withSubstring.begin(), withSubstring.end());
+    CHECK(withSubstring == expectedWithSubstring);
+  }
+}
@@ -0,0 +1,118 @@
+#ifndef _PARALLEL_SCAN_H
+#define _PARALLEL_SCAN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! How a scan of all products is executed, see BasicWarehouse::ForEachProduct() and
+//! BasicWarehouse::AggregateByProducer()
+struct ScanPolicy
+{
+  //! Number of threads scanning the chunks, including the calling one, 0 stands for
+  //! std::thread::hardware_concurrency()
+  size_t cntThreads = 1;
+
+  //! Number of products scanned by a thread at once; a thread takes the next chunk as soon as
+  //! it is done with the previous one, so the faster threads scan more chunks
+  size_t chunkSize = 4096;
+};
+
+//! Scan by the calling thread only
+inline constexpr ScanPolicy kSequentialScan{1};
+
+//! Scan by all hardware threads
+inline constexpr ScanPolicy kParallelScan{0};
+
+//! Number of threads scanning with the given policy \p policy
+inline size_t ScanThreadsOf(const ScanPolicy &policy)
+{
+  return (policy.cntThreads != 0)? policy.cntThreads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+//! Invoke task(i) once for every i of [0, \p cntTasks) by the threads of the policy \p policy
+//!
+//! The tasks are taken one after another from a shared counter, so the calling thread and
+//! the std::async ones balance themselves. Once all tasks are run, the first exception thrown
+//! by a task of another thread is rethrown.
+template <typename Task>
+void RunScanTasks(const ScanPolicy &policy, size_t cntTasks, Task &&task)
+{
+  std::atomic<size_t> nextTask{0};
+  auto runTasks = [&nextTask, cntTasks, &task]() {
+    for(size_t i = nextTask++; i < cntTasks; i = nextTask++)
+    {
+      task(i);
+    }
+  };
+
+  const size_t cntThreads = std::min(ScanThreadsOf(policy), cntTasks);
+  std::vector<std::future<void>> threads;
+  for(size_t thread = 1; thread < cntThreads; ++thread)
+  {
+    threads.push_back(std::async(std::launch::async, runTasks));
+  }
+  runTasks();
+  for(auto &thread : threads)
+  {
+    thread.get();
+  }
+}
+
+//! Invoke visitor(const Ptr&) with every pointer of \p ptrs by the threads of the policy \p policy,
+//! which scan \p ptrs in chunks of ScanPolicy::chunkSize pointers
+template <typename Ptr, typename Visitor>
+void ScanInChunks(const ScanPolicy &policy, const std::vector<Ptr> &ptrs, Visitor &&visitor)
+{
+  const size_t chunkSize = std::max<size_t>(policy.chunkSize, 1);
+  RunScanTasks(policy, (ptrs.size() + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+    const size_t last = std::min(ptrs.size(), (chunk + 1) * chunkSize);
+    for(size_t i = chunk * chunkSize; i < last; ++i)
+    {
+      visitor(ptrs[i]);
+    }
+  });
+}
+
+//! Fold the pointers of every group of \p groups by the threads of the policy \p policy
+//!
+//! Every group is folded by a single thread as acc = fold(std::move(acc), ptr), starting from
+//! a copy of \p init, so the fold needs no combining of partial results and sees the pointers of
+//! its group in order. The largest groups are folded first, so a large group does not delay
+//! the end of the scan.
+//!
+//! \return the keys of the groups with their folded values, in the order of the groups
+template <typename Key, typename Ptr, typename T, typename Fold>
+std::vector<std::pair<Key, T>> FoldGroups(const ScanPolicy &policy, std::vector<std::pair<Key, std::vector<Ptr>>> groups,
+  const T &init, Fold &&fold)
+{
+  std::vector<size_t> order(groups.size());
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::stable_sort(order.begin(), order.end(),
+    [&groups](size_t lhs, size_t rhs) { return groups[lhs].second.size() > groups[rhs].second.size(); });
+
+  // every task writes its own result only
+  std::vector<std::pair<Key, T>> results;
+  results.reserve(groups.size());
+  for(auto &group : groups)
+  {
+    results.emplace_back(std::move(group.first), init);
+  }
+  RunScanTasks(policy, groups.size(), [&](size_t task) {
+    const size_t i = order[task];
+    T acc = init;
+    for(const Ptr &ptr : groups[i].second)
+    {
+      acc = fold(std::move(acc), ptr);
+    }
+    results[i].second = std::move(acc);
+  });
+  return results;
+}
+
+#endif
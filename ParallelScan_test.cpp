@@ -0,0 +1,84 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "ParallelScan.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("running the tasks of a scan") {
+
+  SUBCASE("every task is run once by any number of threads") {
+    for(size_t cntThreads : {0, 1, 3, 16})
+    {
+      CAPTURE(cntThreads);
+      std::vector<std::atomic<int>> cntRuns(100);
+      RunScanTasks(ScanPolicy{cntThreads}, cntRuns.size(), [&cntRuns](size_t task) { cntRuns[task]++; });
+      for(const auto &cnt : cntRuns)
+      {
+        CHECK(cnt == 1);
+      }
+    }
+  }
+
+  SUBCASE("no tasks => nothing run") {
+    RunScanTasks(kParallelScan, 0, [](size_t) { FAIL("no task should be run"); });
+  }
+
+  SUBCASE("an exception of a task is rethrown after all threads are done") {
+    std::atomic<int> cntRuns{0};
+    CHECK_THROWS_AS(RunScanTasks(ScanPolicy{4}, 100, [&cntRuns](size_t task) {
+      cntRuns++;
+      if(task == 50)
+      {
+        throw std::runtime_error("task failed");
+      }
+    }), std::runtime_error);
+    CHECK(cntRuns > 50);
+  }
+}
+
+TEST_CASE("scanning pointers in chunks") {
+
+  std::vector<int> values(1001);
+  std::vector<const int*> ptrs;
+  for(int &value : values)
+  {
+    ptrs.push_back(&value);
+  }
+
+  for(size_t chunkSize : {0, 1, 7, 1000, 5000})
+  {
+    CAPTURE(chunkSize);
+    std::atomic<size_t> cntVisited{0};
+    ScanInChunks(ScanPolicy{4, chunkSize}, ptrs, [&](const int *pValue) {
+      values[pValue - values.data()]++;
+      cntVisited++;
+    });
+    CHECK(cntVisited == values.size());
+  }
+  for(int value : values)
+  {
+    CHECK(value == 5);
+  }
+}
+
+TEST_CASE("folding groups of pointers") {
+
+  const std::vector<int> values{1, 2, 3, 4, 5, 6};
+  std::vector<std::pair<std::string, std::vector<const int*>>> groups{
+    {"small", {&values[0]}},
+    {"empty", {}},
+    {"large", {&values[1], &values[2], &values[3], &values[4]}},
+    {"medium", {&values[5]}}};
+
+  // every group is folded in its order from a copy of the initial value
+  const auto folds = FoldGroups(ScanPolicy{3}, groups, std::string("init:"),
+    [](std::string &&acc, const int *pValue) { return acc + std::to_string(*pValue); });
+  CHECK(folds == std::vector<std::pair<std::string, std::string>>{{"small", "init:1"}, {"empty", "init:"},
+    {"large", "init:2345"}, {"medium", "init:6"}});
+
+  CHECK(FoldGroups(kSequentialScan, decltype(groups)(), 0, [](int acc, const int*) { return acc; }).empty());
+}
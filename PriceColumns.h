@@ -0,0 +1,307 @@
+#ifndef _PRICE_COLUMNS_H
+#define _PRICE_COLUMNS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// define PRICE_COLUMNS_NO_SIMD to use the portable kernels even if AVX2 is available
+#if !defined(PRICE_COLUMNS_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define PRICE_COLUMNS_AVX2 1
+#endif
+
+//! Count, range and sum of a set of prices
+struct PriceStats
+{
+  size_t count = 0;                                       //!< number of prices
+  uint32_t min = std::numeric_limits<uint32_t>::max();    //!< the lowest price, if count is not 0
+  uint32_t max = 0;                                       //!< the highest price, if count is not 0
+  uint64_t sum = 0;                                       //!< sum of the prices
+
+  void Add(uint32_t price)
+  {
+    ++count;
+    min = std::min(min, price);
+    max = std::max(max, price);
+    sum += price;
+  }
+
+  //! Add the prices summarized by \p other
+  void Merge(const PriceStats &other)
+  {
+    count += other.count;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+  }
+
+  bool operator==(const PriceStats &other) const
+  {
+    return count == other.count && min == other.min && max == other.max && sum == other.sum;
+  }
+
+  bool operator!=(const PriceStats &other) const { return !(*this == other); }
+};
+
+//! Column store of the prices of pointers
+//!
+//! Every pointer takes a slot, and the slots are dense: the price and the pointer of the slot i
+//! are the i-th elements of two arrays. A scan of the prices streams 4 bytes per pointer instead
+//! of following the pointer, so the scans run at the memory bandwidth, and with AVX2 they
+//! process 8 prices per instruction. An erased slot is taken by the last entry, so the owner
+//! of the columns updates the slot it keeps for the moved pointer.
+//!
+//! \tparam Ptr type of the (smart) pointers
+//! \tparam Allocator allocator, which is rebound to the columns
+template <typename Ptr, typename Allocator = std::allocator<Ptr>>
+class PriceColumns
+{
+  using AllocTraits = std::allocator_traits<Allocator>;
+
+public:
+  using Price = uint32_t;
+  using Slot = uint32_t;
+  using allocator_type = Allocator;
+
+  explicit PriceColumns(const Allocator &allocator = Allocator()):
+    mPrices(allocator), mPtrs(allocator)
+  {
+  }
+
+  //! Exchange the entries of the columns and of \p other
+  //!
+  //! \pre the allocators of the columns are equal, unless they propagate on swap
+  void swap(PriceColumns &other) noexcept
+  {
+    mPrices.swap(other.mPrices);
+    mPtrs.swap(other.mPtrs);
+  }
+
+  size_t size() const { return mPtrs.size(); }
+  bool empty() const { return mPtrs.empty(); }
+
+  void clear()
+  {
+    mPrices.clear();
+    mPtrs.clear();
+  }
+
+  void reserve(size_t capacity)
+  {
+    mPrices.reserve(capacity);
+    mPtrs.reserve(capacity);
+  }
+
+  //! The pointer of the slot \p slot
+  //!
+  //! \pre \p slot is less than size()
+  const Ptr& PtrOf(Slot slot) const
+  {
+    // pre-conditions
+    assert(slot < mPtrs.size());
+
+    return mPtrs[slot];
+  }
+
+  //! Insert the pointer \p ptr with the price \p price
+  //!
+  //! Algorithm's time complexity: O(1) amortized
+  //!
+  //! \return the slot of the pointer, which is the last one
+  Slot insert(Price price, Ptr ptr)
+  {
+    // pre-conditions
+    assert(mPtrs.size() < std::numeric_limits<Slot>::max());
+
+    mPrices.push_back(price);
+    mPtrs.push_back(std::move(ptr));
+    return static_cast<Slot>(mPtrs.size() - 1);
+  }
+
+  //! Erase the pointer with the slot \p slot, the last pointer is moved to the slot
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \pre \p slot is less than size()
+  //!
+  //! \return true if the last pointer was moved to the slot, false if the slot was the last one
+  bool erase(Slot slot)
+  {
+    // pre-conditions
+    assert(slot < mPtrs.size());
+
+    const bool isMoved = (slot + 1 != mPtrs.size());
+    if(isMoved)
+    {
+      mPrices[slot] = mPrices.back();
+      mPtrs[slot] = std::move(mPtrs.back());
+    }
+    mPrices.pop_back();
+    mPtrs.pop_back();
+    return isMoved;
+  }
+
+  //! Replace the entry of the slot \p slot by the pointer \p ptr with the price \p price
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \pre \p slot is less than size()
+  void replace(Slot slot, Price price, Ptr ptr)
+  {
+    // pre-conditions
+    assert(slot < mPtrs.size());
+
+    mPrices[slot] = price;
+    mPtrs[slot] = std::move(ptr);
+  }
+
+  //! Stats of all prices
+  //!
+  //! Algorithm's time complexity: O(N)
+  PriceStats Stats() const
+  {
+    PriceStats stats;
+    const Price *pPrices = mPrices.data();
+    const size_t cntPrices = mPrices.size();
+    size_t i = 0;
+#ifdef PRICE_COLUMNS_AVX2
+    __m256i min = _mm256_set1_epi32(-1);
+    __m256i max = _mm256_setzero_si256();
+    __m256i sum = _mm256_setzero_si256();
+    for(; i + kLanes <= cntPrices; i += kLanes)
+    {
+      const __m256i prices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPrices + i));
+      min = _mm256_min_epu32(min, prices);
+      max = _mm256_max_epu32(max, prices);
+      sum = _mm256_add_epi64(sum, WidenedSum(prices));
+    }
+    MergeLanes(stats, i, min, max, sum);
+#endif
+    for(; i < cntPrices; ++i)
+    {
+      stats.Add(pPrices[i]);
+    }
+    return stats;
+  }
+
+  //! Add the number of prices of every bucket of the histogram with the bounds \p bounds to
+  //! \p counts: the bucket 0 has the prices below bounds[0], the bucket i has the prices
+  //! of [bounds[i - 1], bounds[i]) and the last bucket the prices from bounds.back()
+  //!
+  //! The prices from every bound are counted without branches, by AVX2 if it is available,
+  //! for a block of the prices fitting into the L1 cache at a time, so the prices are still
+  //! read from the memory once.
+  //!
+  //! Algorithm's time complexity: O(N*B), where B is number of the bounds
+  //!
+  //! \pre \p bounds are sorted, \p counts has bounds.size() + 1 elements
+  void AddHistogram(const std::vector<Price> &bounds, std::vector<size_t> &counts) const
+  {
+    // pre-conditions
+    assert(std::is_sorted(bounds.begin(), bounds.end()));
+    assert(counts.size() == bounds.size() + 1);
+
+    // the number of prices of a bucket is the difference of the numbers of prices from its bounds
+    std::vector<size_t> cntFromBounds(bounds.size(), 0);
+    for(size_t first = 0; first < mPrices.size(); first += kBlockSize)
+    {
+      const size_t last = std::min(mPrices.size(), first + kBlockSize);
+      for(size_t b = 0; b < bounds.size(); ++b)
+      {
+        cntFromBounds[b] += CountFrom(mPrices.data() + first, mPrices.data() + last, bounds[b]);
+      }
+    }
+
+    size_t cntBelow = mPrices.size();
+    for(size_t b = 0; b < bounds.size(); ++b)
+    {
+      counts[b] += cntBelow - cntFromBounds[b];
+      cntBelow = cntFromBounds[b];
+    }
+    counts.back() += cntBelow;
+  }
+
+private:
+  //! Number of prices compared with all bounds of a histogram at once, 16 KiB of them
+  static constexpr size_t kBlockSize = 4096;
+
+  //! Number of the prices of the range [\p pFirst, \p pLast) that are not below \p bound
+  static size_t CountFrom(const Price *pFirst, const Price *pLast, Price bound)
+  {
+    size_t count = 0;
+#ifdef PRICE_COLUMNS_AVX2
+    const __m256i bounds = _mm256_set1_epi32(static_cast<int>(bound));
+    __m256i counts = _mm256_setzero_si256();
+    for(; pLast - pFirst >= std::ptrdiff_t(kLanes); pFirst += kLanes)
+    {
+      const __m256i prices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pFirst));
+      counts = _mm256_sub_epi32(counts, _mm256_cmpeq_epi32(_mm256_max_epu32(prices, bounds), prices));
+    }
+    count = SumOfLanes(counts);
+#endif
+    for(; pFirst != pLast; ++pFirst)
+    {
+      count += (*pFirst >= bound);
+    }
+    return count;
+  }
+
+#ifdef PRICE_COLUMNS_AVX2
+  static constexpr size_t kLanes = 8;
+
+  //! Sums of the pairs of the given 32-bit lanes \p values as 4 64-bit lanes
+  static __m256i WidenedSum(__m256i values)
+  {
+    return _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(values)),
+      _mm256_cvtepu32_epi64(_mm256_extracti128_si256(values, 1)));
+  }
+
+  static size_t SumOfLanes(__m256i counts)
+  {
+    alignas(32) uint32_t lanes[kLanes];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), counts);
+    size_t sum = 0;
+    for(uint32_t lane : lanes)
+    {
+      sum += lane;
+    }
+    return sum;
+  }
+
+  //! Merge the lanes of the minimums \p min, of the maximums \p max and of the 64-bit sums
+  //! \p sum of \p count prices into \p stats
+  static void MergeLanes(PriceStats &stats, size_t count, __m256i min, __m256i max, __m256i sum)
+  {
+    alignas(32) uint32_t minLanes[kLanes], maxLanes[kLanes];
+    alignas(32) uint64_t sumLanes[kLanes / 2];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(minLanes), min);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(maxLanes), max);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sumLanes), sum);
+
+    PriceStats lanes;
+    lanes.count = count;
+    lanes.min = *std::min_element(std::begin(minLanes), std::end(minLanes));
+    lanes.max = *std::max_element(std::begin(maxLanes), std::end(maxLanes));
+    for(uint64_t lane : sumLanes)
+    {
+      lanes.sum += lane;
+    }
+    if(count != 0)
+    {
+      stats.Merge(lanes);
+    }
+  }
+#endif
+
+  std::vector<Price, typename AllocTraits::template rebind_alloc<Price>> mPrices;
+  std::vector<Ptr, typename AllocTraits::template rebind_alloc<Ptr>> mPtrs;
+};
+
+#endif
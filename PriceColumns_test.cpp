@@ -0,0 +1,120 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "PriceColumns.h"
+
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+using Columns = PriceColumns<std::shared_ptr<const int>>;
+
+std::shared_ptr<const int> MakePtr(int value)
+{
+  return std::make_shared<const int>(value);
+}
+
+TEST_CASE("stats and histograms of the price columns") {
+
+  Columns columns;
+  CHECK(columns.Stats() == PriceStats());
+  CHECK(columns.Stats().count == 0);
+
+  // more prices than the lanes of a vector, with a tail
+  const std::vector<uint32_t> prices{5, 1, 9, 3, 7, 3, 0, 4294967295u, 8, 2, 6};
+  for(size_t i = 0; i < prices.size(); ++i)
+  {
+    CHECK(columns.insert(prices[i], MakePtr(int(i))) == i);
+  }
+  REQUIRE(columns.size() == prices.size());
+
+  SUBCASE("the stats of all prices") {
+    const PriceStats stats = columns.Stats();
+    CHECK(stats.count == 11);
+    CHECK(stats.min == 0);
+    CHECK(stats.max == 4294967295u);
+    CHECK(stats.sum == 44 + uint64_t(4294967295u));
+  }
+
+  SUBCASE("the histogram counts the prices of every bucket") {
+    std::vector<size_t> counts(4, 0);
+    columns.AddHistogram({3, 7, 9}, counts);
+    CHECK(counts == std::vector<size_t>{3, 4, 2, 2});
+
+    // the counts are added to
+    columns.AddHistogram({3, 7, 9}, counts);
+    CHECK(counts == std::vector<size_t>{6, 8, 4, 4});
+
+    std::vector<size_t> single(1, 0);
+    columns.AddHistogram({}, single);
+    CHECK(single == std::vector<size_t>{11});
+  }
+
+  SUBCASE("an erased slot is taken by the last entry") {
+    CHECK(columns.erase(1) == true);
+    CHECK(*columns.PtrOf(1) == 10);
+    CHECK(columns.erase(uint32_t(columns.size() - 1)) == false);
+    CHECK(columns.size() == 9);
+    CHECK(columns.Stats().sum == 44 - 1 - 2 + uint64_t(4294967295u));
+
+    columns.replace(0, 100, MakePtr(100));
+    CHECK(columns.Stats().max == 4294967295u);
+    columns.replace(7, 50, MakePtr(7));
+    CHECK(columns.Stats().max == 100);
+  }
+
+  SUBCASE("swapped and cleared columns") {
+    Columns other;
+    other.swap(columns);
+    CHECK(columns.empty());
+    CHECK(other.Stats().count == 11);
+    other.clear();
+    CHECK(other.Stats() == PriceStats());
+  }
+}
+
+TEST_CASE("random operations on the price columns match a brute force computation") {
+
+  std::mt19937 random(42);
+  std::pmr::unsynchronized_pool_resource resource;
+  PriceColumns<std::shared_ptr<const int>, std::pmr::polymorphic_allocator<std::shared_ptr<const int>>> columns(&resource);
+  std::vector<uint32_t> model;  // price of every slot
+  const std::vector<uint32_t> bounds{10, 100, 100, 1000, 50000};
+
+  for(int i = 0; i < 20000; ++i)
+  {
+    if(random() % 3 != 0 || model.empty())
+    {
+      const uint32_t price = (random() % 2)? random() % 200 : random();
+      columns.insert(price, MakePtr(i));
+      model.push_back(price);
+    }
+    else
+    {
+      const auto slot = uint32_t(random() % model.size());
+      columns.erase(slot);
+      model[slot] = model.back();
+      model.pop_back();
+    }
+
+    if(i % 500 != 0)
+    {
+      continue;
+    }
+    REQUIRE(columns.size() == model.size());
+
+    PriceStats expectedStats;
+    std::vector<size_t> expectedCounts(bounds.size() + 1, 0);
+    for(uint32_t price : model)
+    {
+      expectedStats.Add(price);
+      expectedCounts[std::upper_bound(bounds.begin(), bounds.end(), price) - bounds.begin()]++;
+    }
+    CHECK(columns.Stats() == expectedStats);
+
+    std::vector<size_t> counts(bounds.size() + 1, 0);
+    columns.AddHistogram(bounds, counts);
+    CHECK(counts == expectedCounts);
+  }
+}
@@ -0,0 +1,558 @@
+#ifndef _PRICE_INDEX_H
+#define _PRICE_INDEX_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! Index of pointers ordered by prices
+//!
+//! The entries are ordered by the price and then by the address of the pointee, so every
+//! entry is found by a binary search, however many entries share the same price.
+//!
+//! The entries are stored in sorted blocks of at most kMaxBlockSize entries, which are split
+//! when they overflow and merged when they become sparse, so a range of entries is read
+//! sequentially. The blocks are kept in a balanced tree by their first keys, so a block is
+//! found, split off or merged in O(logN) whatever the number of blocks, and the node of
+//! a block is rekeyed in place when its first entry changes. The keys must be the ones of
+//! the entries, since the prices may refer to their pointees.
+//!
+//! \tparam Price type of the prices
+//! \tparam Ptr type of the (smart) pointers, get() returns the address of the pointee
+//! \tparam Allocator allocator, which is rebound to the tree, to the blocks and to the entries
+template <typename Price, typename Ptr, typename Allocator = std::allocator<Ptr>>
+class PriceIndex
+{
+  using Key = std::pair<Price, const void*>;
+
+public:
+  struct Entry
+  {
+    Price price;
+    Ptr ptr;
+  };
+
+  //! Position between the entries to resume visiting them from, see ForEachFrom()
+  //!
+  //! The cursor refers to the key of the last visited entry, not to its place in the blocks,
+  //! so it stays valid when the index is modified or copied.
+  class Cursor
+  {
+  public:
+    //! Cursor before the first entry
+    Cursor() = default;
+
+    //! Cursor after the last entry
+    static Cursor End()
+    {
+      Cursor cursor;
+      cursor.mState = State::kEnd;
+      return cursor;
+    }
+
+    //! Whether there are no entries to visit after the cursor
+    bool AtEnd() const { return mState == State::kEnd; }
+
+  private:
+    friend class PriceIndex;
+
+    enum class State { kBegin, kAfterKey, kEnd };
+
+    State mState = State::kBegin;
+    Key mKey{};   //!< key of the last visited entry, if the state is kAfterKey
+  };
+
+  using allocator_type = Allocator;
+
+  //! Maximal number of entries in a block
+  static constexpr size_t kMaxBlockSize = 128;
+
+  explicit PriceIndex(const Allocator &allocator = Allocator()):
+    mBlocks(allocator)
+  {
+  }
+
+  PriceIndex(const PriceIndex &other) = default;
+
+  PriceIndex(const PriceIndex &other, const Allocator &allocator):
+    mBlocks(other.mBlocks, allocator), mSize(other.mSize)
+  {
+  }
+
+  PriceIndex(PriceIndex &&other) noexcept:
+    mBlocks(std::move(other.mBlocks)), mSize(other.mSize)
+  {
+    other.mSize = 0;
+  }
+
+  PriceIndex(PriceIndex &&other, const Allocator &allocator):
+    mBlocks(std::move(other.mBlocks), allocator), mSize(other.mSize)
+  {
+    other.mBlocks.clear();
+    other.mSize = 0;
+  }
+
+  PriceIndex& operator=(const PriceIndex &other) = default;
+
+  PriceIndex& operator=(PriceIndex &&other)
+  {
+    mBlocks = std::move(other.mBlocks);
+    mSize = other.mSize;
+    other.mBlocks.clear();
+    other.mSize = 0;
+    return *this;
+  }
+
+  //! Exchange the entries of the index and of \p other
+  //!
+  //! \pre the allocators of the indexes are equal, unless they propagate on swap
+  void swap(PriceIndex &other) noexcept
+  {
+    mBlocks.swap(other.mBlocks);
+    std::swap(mSize, other.mSize);
+  }
+
+  size_t size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+
+  void clear()
+  {
+    mBlocks.clear();
+    mSize = 0;
+  }
+
+  //! Insert the entry of the pointer \p ptr with the price \p price
+  //!
+  //! Algorithm's time complexity: O(logN + kMaxBlockSize) amortized
+  //!
+  //! \pre \p ptr is not null
+  //!
+  //! \return true if the entry was inserted, false if the index already has the same entry
+  bool insert(Price price, Ptr ptr)
+  {
+    // pre-conditions
+    assert(ptr);
+
+    const Key key{price, ptr.get()};
+    if(mBlocks.empty())
+    {
+      auto itBlock = mBlocks.emplace_hint(mBlocks.end(), key, Block(mBlocks.get_allocator()));
+      itBlock->second.push_back(Entry{price, std::move(ptr)});
+      mSize = 1;
+      return true;
+    }
+
+    auto itBlock = FindBlock(key);
+    Block &block = itBlock->second;
+    auto it = std::lower_bound(block.begin(), block.end(), key, EntryLess());
+    if(it != block.end() && !KeyLess()(key, KeyOf(*it)))
+    {
+      return false;
+    }
+    it = block.insert(it, Entry{price, std::move(ptr)});
+    ++mSize;
+
+    if(it == block.begin())
+    {
+      // only the key of the first block can be greater than the inserted one
+      itBlock = RekeyBlock(itBlock);
+    }
+
+    if(block.size() > kMaxBlockSize)
+    {
+      SplitBlock(itBlock);
+    }
+    return true;
+  }
+
+  //! Erase the entry of the pointer \p ptr with the price \p price
+  //!
+  //! Algorithm's time complexity: O(logN + kMaxBlockSize) amortized
+  //!
+  //! \return true if the entry was erased, false if the index has no such entry
+  bool erase(Price price, const Ptr &ptr)
+  {
+    if(mBlocks.empty())
+    {
+      return false;
+    }
+
+    const Key key{price, ptr.get()};
+    auto itBlock = FindBlock(key);
+    Block &block = itBlock->second;
+    auto it = std::lower_bound(block.begin(), block.end(), key, EntryLess());
+    if(it == block.end() || KeyLess()(key, KeyOf(*it)))
+    {
+      return false;
+    }
+    it = block.erase(it);
+    --mSize;
+
+    if(block.empty())
+    {
+      mBlocks.erase(itBlock);
+      return true;
+    }
+    MergeSparseBlock(it == block.begin()? RekeyBlock(itBlock) : itBlock);
+    return true;
+  }
+
+  //! Replace the entry of the pointer \p oldPtr with the price \p oldPrice by the entry of
+  //! the pointer \p newPtr with the price \p newPrice
+  //!
+  //! The entry is overwritten in place, if the new one fits between the neighbours of the old one,
+  //! otherwise the new entry is inserted and the old one is erased.
+  //!
+  //! Algorithm's time complexity:
+  //! - O(logN) if the entry is overwritten in place
+  //! - O(logN + kMaxBlockSize) amortized otherwise
+  //!
+  //! \pre \p newPtr is not null and the index has no entry of it with the price \p newPrice,
+  //!   unless it is the replaced one
+  //!
+  //! \return true if the entry was replaced, false if the index has no entry to replace
+  bool replace(Price oldPrice, const Ptr &oldPtr, Price newPrice, Ptr newPtr)
+  {
+    // pre-conditions
+    assert(newPtr);
+
+    if(mBlocks.empty())
+    {
+      return false;
+    }
+
+    const Key oldKey{oldPrice, oldPtr.get()};
+    const Key newKey{newPrice, newPtr.get()};
+    const auto itBlock = FindBlock(oldKey);
+    Block &block = itBlock->second;
+    auto it = std::lower_bound(block.begin(), block.end(), oldKey, EntryLess());
+    if(it == block.end() || KeyLess()(oldKey, KeyOf(*it)))
+    {
+      return false;
+    }
+
+    // the entries before the first one of a block are in the previous blocks, and the ones
+    // after the last one are in the next blocks
+    const bool isAfterPrevious = (it != block.begin())? KeyLess()(KeyOf(*(it - 1)), newKey) :
+      (itBlock == mBlocks.begin() || KeyLess()(KeyOf(std::prev(itBlock)->second.back()), newKey));
+    const bool isBeforeNext = (it + 1 != block.end())? KeyLess()(newKey, KeyOf(*(it + 1))) :
+      (std::next(itBlock) == mBlocks.end() || KeyLess()(newKey, std::next(itBlock)->first));
+    if(isAfterPrevious && isBeforeNext)
+    {
+      *it = Entry{newPrice, std::move(newPtr)};
+      if(it == block.begin())
+      {
+        RekeyBlock(itBlock);
+      }
+      return true;
+    }
+
+    const bool isInserted = insert(newPrice, std::move(newPtr));
+    assert(isInserted);
+    (void)isInserted;
+    return erase(oldPrice, oldPtr);
+  }
+
+  //! Replace the entries of the index with the entries of the range [\p first, \p last)
+  //!
+  //! Algorithm's time complexity: O(K*logK), where K is number of entries of the range
+  //!
+  //! \pre the entries of the range are unique and their pointers are not null
+  template <typename InputIt>
+  void assign(InputIt first, InputIt last)
+  {
+    std::vector<Entry> entries(first, last);
+    std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+      return KeyLess()(KeyOf(lhs), KeyOf(rhs));
+    });
+
+    clear();
+
+    // the blocks are not filled completely, so the following insertions do not split them at once
+    const size_t blockSize = kMaxBlockSize * 3 / 4;
+    for(size_t i = 0; i < entries.size(); i += blockSize)
+    {
+      auto itFirst = std::make_move_iterator(entries.begin() + i);
+      auto itLast = std::make_move_iterator(entries.begin() + std::min(i + blockSize, entries.size()));
+      auto itBlock = mBlocks.emplace_hint(mBlocks.end(), KeyOf(entries[i]), Block(mBlocks.get_allocator()));
+      itBlock->second.assign(itFirst, itLast);
+    }
+    mSize = entries.size();
+  }
+
+  //! Visit all entries in order
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Entry&) for every entry
+  //!
+  //! Algorithm's time complexity: O(N)
+  template <typename Visitor>
+  void ForEach(Visitor &&visitor) const
+  {
+    for(const auto &[firstKey, block] : mBlocks)
+    {
+      for(const Entry &entry : block)
+      {
+        visitor(entry);
+      }
+    }
+  }
+
+  //! Visit in order the entries with the prices from the range [\p priceLo, \p priceHi]
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Entry&) for every entry
+  //!
+  //! Algorithm's time complexity: O(logN + kMaxBlockSize + M), where M is number of visited entries
+  //!
+  //! \return number of visited entries
+  template <typename Visitor>
+  size_t ForEachInRange(Price priceLo, Price priceHi, Visitor &&visitor) const
+  {
+    if(mBlocks.empty() || priceHi < priceLo)
+    {
+      return 0;
+    }
+
+    // the entries with the price priceLo may start inside the block preceding the first block
+    // whose first price is not less than priceLo
+    auto itBlock = mBlocks.lower_bound(priceLo);
+    if(itBlock != mBlocks.begin())
+    {
+      --itBlock;
+    }
+    auto it = std::lower_bound(itBlock->second.begin(), itBlock->second.end(), priceLo,
+      [](const Entry &entry, const Price &price) { return entry.price < price; });
+
+    size_t cntVisited = 0;
+    for(;;)
+    {
+      for(; it != itBlock->second.end(); ++it)
+      {
+        if(priceHi < it->price)
+        {
+          return cntVisited;
+        }
+        visitor(*it);
+        ++cntVisited;
+      }
+
+      if(++itBlock == mBlocks.end())
+      {
+        return cntVisited;
+      }
+      it = itBlock->second.begin();
+    }
+  }
+
+  //! Visit in order the entries with the prices not less than \p priceLo, until the visitor
+  //! returns false
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Entry&) for every entry and
+  //!   returns whether to visit the next entry
+  //!
+  //! Algorithm's time complexity: O(logN + kMaxBlockSize + M), where M is number of visited entries
+  //!
+  //! \return number of entries for which the visitor returned true
+  template <typename Visitor>
+  size_t ForEachFromPrice(Price priceLo, Visitor &&visitor) const
+  {
+    if(mBlocks.empty())
+    {
+      return 0;
+    }
+
+    // the entries with the price priceLo may start inside the block preceding the first block
+    // whose first price is not less than priceLo
+    auto itBlock = mBlocks.lower_bound(priceLo);
+    if(itBlock != mBlocks.begin())
+    {
+      --itBlock;
+    }
+    auto it = std::lower_bound(itBlock->second.begin(), itBlock->second.end(), priceLo,
+      [](const Entry &entry, const Price &price) { return entry.price < price; });
+
+    size_t cntVisited = 0;
+    for(;;)
+    {
+      for(; it != itBlock->second.end(); ++it)
+      {
+        if(!visitor(*it))
+        {
+          return cntVisited;
+        }
+        ++cntVisited;
+      }
+
+      if(++itBlock == mBlocks.end())
+      {
+        return cntVisited;
+      }
+      it = itBlock->second.begin();
+    }
+  }
+
+  //! Visit in order at most \p limit entries that follow the cursor \p cursor
+  //!
+  //! \param[in] visitor callable that is invoked as visitor(const Entry&) for every entry
+  //!
+  //! Algorithm's time complexity: O(logN + kMaxBlockSize + limit)
+  //!
+  //! \return cursor after the last visited entry, which is at the end if no entry follows it
+  template <typename Visitor>
+  Cursor ForEachFrom(const Cursor &cursor, size_t limit, Visitor &&visitor) const
+  {
+    if(cursor.AtEnd() || mBlocks.empty())
+    {
+      return Cursor::End();
+    }
+
+    auto itBlock = mBlocks.begin();
+    auto it = itBlock->second.begin();
+    if(cursor.mState == Cursor::State::kAfterKey)
+    {
+      itBlock = FindBlock(cursor.mKey);
+      const Block &block = itBlock->second;
+      it = std::upper_bound(block.begin(), block.end(), cursor.mKey,
+        [](const Key &key, const Entry &entry) { return KeyLess()(key, KeyOf(entry)); });
+    }
+
+    Cursor nextCursor = cursor;
+    for(;;)
+    {
+      if(it == itBlock->second.end())
+      {
+        if(++itBlock == mBlocks.end())
+        {
+          return Cursor::End();
+        }
+        it = itBlock->second.begin();
+      }
+      if(limit == 0)
+      {
+        return nextCursor;
+      }
+
+      visitor(*it);
+      nextCursor.mState = Cursor::State::kAfterKey;
+      nextCursor.mKey = KeyOf(*it);
+      ++it;
+      --limit;
+    }
+  }
+
+private:
+  //! Order of the keys, which also compares them with the prices, so the tree of the blocks is
+  //! searched by a price
+  struct KeyLess
+  {
+    using is_transparent = void;
+
+    bool operator()(const Key &key, const Price &price) const { return key.first < price; }
+    bool operator()(const Price &price, const Key &key) const { return price < key.first; }
+
+    bool operator()(const Key &lhs, const Key &rhs) const
+    {
+      if(lhs.first < rhs.first)
+      {
+        return true;
+      }
+      if(rhs.first < lhs.first)
+      {
+        return false;
+      }
+      return std::less<const void*>()(lhs.second, rhs.second);
+    }
+  };
+
+  static Key KeyOf(const Entry &entry)
+  {
+    return Key{entry.price, entry.ptr.get()};
+  }
+
+  struct EntryLess
+  {
+    bool operator()(const Entry &entry, const Key &key) const { return KeyLess()(KeyOf(entry), key); }
+  };
+
+  using AllocTraits = std::allocator_traits<Allocator>;
+  using Block = std::vector<Entry, typename AllocTraits::template rebind_alloc<Entry>>;
+  using Blocks = std::map<Key, Block, KeyLess, typename AllocTraits::template rebind_alloc<std::pair<const Key, Block>>>;
+
+  //! Last block whose first key is not greater than \p key, or the first block if there is
+  //! no such block
+  //!
+  //! \pre the index is not empty
+  typename Blocks::iterator FindBlock(const Key &key)
+  {
+    auto it = mBlocks.upper_bound(key);
+    return (it == mBlocks.begin())? it : std::prev(it);
+  }
+
+  typename Blocks::const_iterator FindBlock(const Key &key) const
+  {
+    auto it = mBlocks.upper_bound(key);
+    return (it == mBlocks.begin())? it : std::prev(it);
+  }
+
+  //! Move the upper half of the overflowed block \p itBlock into a new block
+  void SplitBlock(typename Blocks::iterator itBlock)
+  {
+    Block &block = itBlock->second;
+    const size_t middle = block.size() / 2;
+
+    Block upperHalf(mBlocks.get_allocator());
+    upperHalf.assign(std::make_move_iterator(block.begin() + middle), std::make_move_iterator(block.end()));
+    block.erase(block.begin() + middle, block.end());
+
+    const Key firstKey = KeyOf(upperHalf.front());
+    mBlocks.emplace_hint(std::next(itBlock), firstKey, std::move(upperHalf));
+  }
+
+  //! Set the key of the block \p itBlock to the key of its first entry, the block is not copied
+  //!
+  //! \return iterator to the rekeyed block
+  typename Blocks::iterator RekeyBlock(typename Blocks::iterator itBlock)
+  {
+    const auto itNext = std::next(itBlock);
+    auto node = mBlocks.extract(itBlock);
+    node.key() = KeyOf(node.mapped().front());
+    return mBlocks.insert(itNext, std::move(node));
+  }
+
+  //! Merge the block \p itBlock with a neighbour, if both are sparse
+  void MergeSparseBlock(typename Blocks::iterator itBlock)
+  {
+    const size_t maxMergedSize = kMaxBlockSize / 2;
+    const auto itNext = std::next(itBlock);
+    if(itNext != mBlocks.end() && itBlock->second.size() + itNext->second.size() <= maxMergedSize)
+    {
+      MergeBlocks(itBlock);
+    }
+    else if(itBlock != mBlocks.begin() && std::prev(itBlock)->second.size() + itBlock->second.size() <= maxMergedSize)
+    {
+      MergeBlocks(std::prev(itBlock));
+    }
+  }
+
+  //! Append the block following the block \p itBlock to it
+  void MergeBlocks(typename Blocks::iterator itBlock)
+  {
+    Block &block = itBlock->second;
+    const auto itNext = std::next(itBlock);
+    block.insert(block.end(), std::make_move_iterator(itNext->second.begin()), std::make_move_iterator(itNext->second.end()));
+    mBlocks.erase(itNext);
+  }
+
+  //! Sorted blocks by their first keys, every block is not empty and its entries precede the
+  //! entries of the next block
+  Blocks mBlocks;
+
+  size_t mSize = 0;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "PriceIndex.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using Index = PriceIndex<unsigned, std::shared_ptr<int>>;
+using Model = std::set<std::pair<unsigned, int*>>;
+
+//! Entries of the index with the prices from [priceLo, priceHi], in the visiting order
+std::vector<std::pair<unsigned, int*>> EntriesInRange(const Index &index, unsigned priceLo, unsigned priceHi)
+{
+  std::vector<std::pair<unsigned, int*>> entries;
+  const size_t cntVisited = index.ForEachInRange(priceLo, priceHi, [&entries](const Index::Entry &entry) {
+    entries.emplace_back(entry.price, entry.ptr.get());
+  });
+  CHECK(cntVisited == entries.size());
+  return entries;
+}
+
+//! Entries of the model with the prices from [priceLo, priceHi], in order
+std::vector<std::pair<unsigned, int*>> EntriesInRange(const Model &model, unsigned priceLo, unsigned priceHi)
+{
+  std::vector<std::pair<unsigned, int*>> entries;
+  for(const auto &entry : model)
+  {
+    if(priceLo <= entry.first && entry.first <= priceHi)
+    {
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+//! At most cntEntries first entries of the index with the prices not less than priceLo, in the visiting order
+std::vector<std::pair<unsigned, int*>> EntriesFromPrice(const Index &index, unsigned priceLo, size_t cntEntries)
+{
+  std::vector<std::pair<unsigned, int*>> entries;
+  const size_t cntVisited = index.ForEachFromPrice(priceLo, [&entries, cntEntries](const Index::Entry &entry) {
+    if(entries.size() == cntEntries)
+    {
+      return false;
+    }
+    entries.emplace_back(entry.price, entry.ptr.get());
+    return true;
+  });
+  CHECK(cntVisited == entries.size());
+  return entries;
+}
+
+//! At most cntEntries first entries of the model with the prices not less than priceLo, in order
+std::vector<std::pair<unsigned, int*>> EntriesFromPrice(const Model &model, unsigned priceLo, size_t cntEntries)
+{
+  std::vector<std::pair<unsigned, int*>> entries;
+  for(auto it = model.lower_bound({priceLo, nullptr}); it != model.end() && entries.size() < cntEntries; ++it)
+  {
+    entries.push_back(*it);
+  }
+  return entries;
+}
+
+TEST_CASE("inserting, erasing and visiting entries of the price index") {
+
+  Index index;
+  auto ptr1 = std::make_shared<int>(1);
+  auto ptr2 = std::make_shared<int>(2);
+
+  SUBCASE("empty index => nothing visited") {
+    CHECK(index.empty());
+    CHECK(index.ForEachInRange(0, 100, [](const Index::Entry &) { FAIL("no entry should be visited"); }) == 0);
+    CHECK(index.erase(1, ptr1) == false);
+  }
+
+  SUBCASE("entries with the same price and pointer are inserted once") {
+    CHECK(index.insert(10, ptr1) == true);
+    CHECK(index.insert(10, ptr1) == false);
+    CHECK(index.insert(10, ptr2) == true);
+    CHECK(index.insert(20, ptr1) == true);
+    CHECK(index.size() == 3);
+  }
+
+  SUBCASE("entries are visited in the order of the prices, the range is inclusive") {
+    REQUIRE(index.insert(30, ptr1));
+    REQUIRE(index.insert(10, ptr2));
+    REQUIRE(index.insert(20, ptr1));
+
+    std::vector<unsigned> prices;
+    index.ForEach([&prices](const Index::Entry &entry) { prices.push_back(entry.price); });
+    CHECK(prices == std::vector<unsigned>{10, 20, 30});
+
+    CHECK(index.ForEachInRange(10, 20, [](const Index::Entry &) {}) == 2);
+    CHECK(index.ForEachInRange(11, 19, [](const Index::Entry &) {}) == 0);
+    CHECK(index.ForEachInRange(30, 10, [](const Index::Entry &) {}) == 0);
+  }
+
+  SUBCASE("erased entries are not visited any more") {
+    REQUIRE(index.insert(10, ptr1));
+    REQUIRE(index.insert(10, ptr2));
+
+    CHECK(index.erase(10, ptr1) == true);
+    CHECK(index.erase(10, ptr1) == false);
+    CHECK(index.erase(20, ptr2) == false);
+    CHECK(EntriesInRange(index, 0, 100) == std::vector<std::pair<unsigned, int*>>{{10, ptr2.get()}});
+  }
+}
+
+TEST_CASE("random operations on the price index match std::set") {
+
+  Index index;
+  Model model;
+
+  std::vector<std::shared_ptr<int>> ptrs;
+  for(int i = 0; i < 500; ++i)
+  {
+    ptrs.push_back(std::make_shared<int>(i));
+  }
+
+  std::mt19937 random(42);
+  for(int i = 0; i < 20000; ++i)
+  {
+    // few prices, so many entries share the same price and span several blocks
+    const unsigned price = random() % 50;
+    const auto &ptr = ptrs[random() % ptrs.size()];
+    if(random() % 3)
+    {
+      CHECK(index.insert(price, ptr) == model.emplace(price, ptr.get()).second);
+    }
+    else
+    {
+      CHECK(index.erase(price, ptr) == (model.erase({price, ptr.get()}) == 1));
+    }
+    REQUIRE(index.size() == model.size());
+
+    if(i % 100 == 0)
+    {
+      const unsigned priceLo = random() % 60;
+      const unsigned priceHi = priceLo + random() % 10;
+      CHECK(EntriesInRange(index, priceLo, priceHi) == EntriesInRange(model, priceLo, priceHi));
+      CHECK(EntriesFromPrice(index, priceLo, 300) == EntriesFromPrice(model, priceLo, 300));
+    }
+  }
+  CHECK(EntriesInRange(index, 0, 100) == EntriesInRange(model, 0, 100));
+
+  SUBCASE("assigned index matches the model as well") {
+    std::vector<Index::Entry> entries;
+    index.ForEach([&entries](const Index::Entry &entry) { entries.push_back(entry); });
+    std::shuffle(entries.begin(), entries.end(), random);
+
+    Index assigned;
+    assigned.assign(entries.begin(), entries.end());
+    CHECK(assigned.size() == model.size());
+    CHECK(EntriesInRange(assigned, 0, 100) == EntriesInRange(model, 0, 100));
+    CHECK(EntriesInRange(assigned, 20, 25) == EntriesInRange(model, 20, 25));
+  }
+
+  SUBCASE("erasing all entries empties the index") {
+    for(const auto &[price, p] : Model(model))
+    {
+      for(const auto &ptr : ptrs)
+      {
+        if(ptr.get() == p)
+        {
+          REQUIRE(index.erase(price, ptr));
+        }
+      }
+    }
+    CHECK(index.empty());
+    CHECK(EntriesInRange(index, 0, 100).empty());
+  }
+}
+
+TEST_CASE("visiting entries of the price index in chunks") {
+
+  Index index;
+  Model model;
+  std::vector<std::shared_ptr<int>> ptrs;
+  for(int i = 0; i < 1000; ++i)
+  {
+    ptrs.push_back(std::make_shared<int>(i));
+    const unsigned price = i % 37;
+    REQUIRE(index.insert(price, ptrs.back()));
+    model.emplace(price, ptrs.back().get());
+  }
+
+  auto visitAll = [&index](size_t limit) {
+    std::vector<std::pair<unsigned, int*>> entries;
+    Index::Cursor cursor;
+    while(!cursor.AtEnd())
+    {
+      const size_t cntBefore = entries.size();
+      cursor = index.ForEachFrom(cursor, limit, [&entries](const Index::Entry &entry) {
+        entries.emplace_back(entry.price, entry.ptr.get());
+      });
+      REQUIRE(entries.size() - cntBefore <= limit);
+    }
+    return entries;
+  };
+
+  CHECK(visitAll(1) == EntriesInRange(model, 0, 100));
+  CHECK(visitAll(7) == EntriesInRange(model, 0, 100));
+  CHECK(visitAll(1000) == EntriesInRange(model, 0, 100));
+
+  SUBCASE("the cursor reaches the end together with the last entry") {
+    CHECK(index.ForEachFrom(Index::Cursor(), 1000, [](const Index::Entry &) {}).AtEnd());
+    CHECK(!index.ForEachFrom(Index::Cursor(), 999, [](const Index::Entry &) {}).AtEnd());
+    CHECK(Index().ForEachFrom(Index::Cursor(), 10, [](const Index::Entry &) {}).AtEnd());
+  }
+
+  SUBCASE("the cursor stays valid when the visited entry is erased") {
+    std::vector<Index::Entry> entries;
+    auto cursor = index.ForEachFrom(Index::Cursor(), 500, [&entries](const Index::Entry &entry) { entries.push_back(entry); });
+    for(const auto &entry : entries)
+    {
+      REQUIRE(index.erase(entry.price, entry.ptr));
+    }
+
+    size_t cntVisited = 0;
+    cursor = index.ForEachFrom(cursor, 1000, [&cntVisited](const Index::Entry &) { cntVisited++; });
+    CHECK(cntVisited == 500);
+    CHECK(cursor.AtEnd());
+  }
+}
+
+TEST_CASE("replacing entries of the price index") {
+
+  Index index;
+  Model model;
+  std::vector<std::shared_ptr<int>> ptrs;
+  for(int i = 0; i < 1000; ++i)
+  {
+    ptrs.push_back(std::make_shared<int>(i));
+  }
+  std::vector<unsigned> prices(ptrs.size());
+  for(size_t i = 0; i < 600; ++i)
+  {
+    prices[i] = i % 50;
+    REQUIRE(index.insert(prices[i], ptrs[i]));
+    model.emplace(prices[i], ptrs[i].get());
+  }
+
+  SUBCASE("missing entry => nothing replaced") {
+    CHECK(index.replace(prices[0] + 1, ptrs[0], 1, ptrs[999]) == false);
+    CHECK(index.replace(0, ptrs[999], 1, ptrs[998]) == false);
+    CHECK(Index().replace(0, ptrs[0], 1, ptrs[1]) == false);
+    CHECK(index.size() == 600);
+  }
+
+  SUBCASE("random replacements match std::set") {
+    std::mt19937 random(7);
+    std::vector<size_t> inIndex(600);
+    std::iota(inIndex.begin(), inIndex.end(), 0);
+    for(int i = 0; i < 5000; ++i)
+    {
+      // the price changes a little or the entry moves to another pointer with the same price
+      size_t &slot = inIndex[random() % inIndex.size()];
+      size_t newSlot = slot;
+      unsigned newPrice = prices[slot];
+      if(random() % 2)
+      {
+        newPrice = prices[slot] + random() % 5 - 2;
+      }
+      else
+      {
+        do
+        {
+          newSlot = random() % ptrs.size();
+        } while(std::find(inIndex.begin(), inIndex.end(), newSlot) != inIndex.end());
+      }
+
+      REQUIRE(index.replace(prices[slot], ptrs[slot], newPrice, ptrs[newSlot]));
+      model.erase({prices[slot], ptrs[slot].get()});
+      model.emplace(newPrice, ptrs[newSlot].get());
+      prices[newSlot] = newPrice;
+      slot = newSlot;
+      REQUIRE(index.size() == model.size());
+    }
+    CHECK(EntriesInRange(index, 0, UINT_MAX) == EntriesInRange(model, 0, UINT_MAX));
+  }
+}
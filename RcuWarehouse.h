@@ -0,0 +1,817 @@
+#ifndef _RCU_WAREHOUSE_H
+#define _RCU_WAREHOUSE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Warehouse.h"
+
+//! Epoch-based reclamation domain shared by all read-optimized warehouses
+//!
+//! Every thread that reads owns a record with the epoch in which its current read-side
+//! critical section has started (0 when the thread is outside of any critical section).
+//! A writer that has unpublished an object waits in Synchronize() until every thread
+//! which could still see that object has left its critical section, after that
+//! the object can be safely destroyed.
+//!
+//! Entering and leaving a critical section only stores to the thread's own record, which
+//! lives on its own cache line, so readers do not bounce shared cache lines between cores.
+class EpochDomain
+{
+  struct alignas(64) ThreadRecord
+  {
+    std::atomic<uint64_t> epoch{0};   //!< epoch of the current critical section, 0 if none
+    std::atomic<bool> inUse{true};    //!< whether the record is owned by a thread
+    unsigned nesting = 0;             //!< depth of the nested critical sections of the owner
+    ThreadRecord *pNext = nullptr;    //!< next record of the domain
+  };
+
+public:
+  //! The domain of the process
+  //!
+  //! The domain is intentionally never destroyed, so threads that outlive static
+  //! destruction can still leave their critical sections.
+  static EpochDomain& Instance()
+  {
+    static EpochDomain *pDomain = new EpochDomain;
+    return *pDomain;
+  }
+
+  //! RAII read-side critical section of the current thread
+  //!
+  //! Objects that were loaded from a published pointer inside the critical section
+  //! stay alive until the critical section is left. Critical sections can be nested.
+  class ReadGuard
+  {
+  public:
+    explicit ReadGuard(EpochDomain &domain): mRecord(domain.ThisThreadRecord())
+    {
+      if(mRecord.nesting++ == 0)
+      {
+        mRecord.epoch.store(domain.mGlobalEpoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // the epoch has to be visible to writers before any published pointer is loaded
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+
+    ~ReadGuard()
+    {
+      if(--mRecord.nesting == 0)
+      {
+        mRecord.epoch.store(0, std::memory_order_release);
+      }
+    }
+
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard& operator=(const ReadGuard &) = delete;
+
+  private:
+    ThreadRecord &mRecord;
+  };
+
+  //! Wait until all critical sections that were entered before the call are left
+  //!
+  //! \pre the calling thread is not inside a critical section
+  void Synchronize()
+  {
+    // the unpublishing store of the caller has to be visible to readers before
+    // their records are inspected
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint64_t newEpoch = mGlobalEpoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    for(ThreadRecord *pRecord = mpRecords.load(std::memory_order_acquire); pRecord; pRecord = pRecord->pNext)
+    {
+      for(;;)
+      {
+        const uint64_t epoch = pRecord->epoch.load(std::memory_order_acquire);
+        if(epoch == 0 || epoch >= newEpoch)
+        {
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  EpochDomain() = default;
+
+  //! Owner of the record of a thread, releases the record when the thread exits
+  struct ThreadRecordHolder
+  {
+    explicit ThreadRecordHolder(EpochDomain &domain): record(domain.AcquireRecord()) {}
+    ~ThreadRecordHolder() { record.inUse.store(false, std::memory_order_release); }
+
+    ThreadRecord &record;
+  };
+
+  ThreadRecord& ThisThreadRecord()
+  {
+    thread_local ThreadRecordHolder holder(*this);
+    return holder.record;
+  }
+
+  //! Reuse a record released by an exited thread or add a new one to the domain
+  ThreadRecord& AcquireRecord()
+  {
+    for(ThreadRecord *pRecord = mpRecords.load(std::memory_order_acquire); pRecord; pRecord = pRecord->pNext)
+    {
+      bool inUse = false;
+      if(!pRecord->inUse.load(std::memory_order_relaxed) &&
+        pRecord->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+      {
+        return *pRecord;
+      }
+    }
+
+    // records are never removed from the list, so pushing to its head is the only modification
+    auto *pRecord = new ThreadRecord;
+    pRecord->pNext = mpRecords.load(std::memory_order_relaxed);
+    while(!mpRecords.compare_exchange_weak(pRecord->pNext, pRecord, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return *pRecord;
+  }
+
+  std::atomic<uint64_t> mGlobalEpoch{1};
+  std::atomic<ThreadRecord*> mpRecords{nullptr};
+};
+
+//! Read-optimized warehouse that contains products
+//!
+//! Readers look up products in an immutable snapshot of the indexes, which is published
+//! via an atomic pointer and protected by EpochDomain, so the read path takes no lock and
+//! performs no atomic read-modify-write on shared memory (except of the reference counter of
+//! the returned product in FindProductById() and FindProductsByProducer(); use
+//! VisitProductById() and ForEachProductOfProducer() to avoid even that).
+//!
+//! Writers modify a private version of the indexes, the modifications are batched and
+//! become visible to readers only after Publish(), which builds a new snapshot.
+//!
+//! A snapshot is a full copy of the indexes: every publication costs O(N) time under the
+//! lock of the writers, and the previous snapshot stays alive until readers leave it, so
+//! the memory peaks at twice the size of the indexes. Publish after batches of
+//! modifications rather than after every one of them; PublishIfDue() bounds the rate of
+//! the publications by the number of the pending modifications and their age.
+//!
+//! All public methods are thread-safe.
+class RcuWarehouse
+{
+  using Index = BasicWarehouse<NoLocking>;
+
+public:
+  using ProductPtr = Index::ProductPtr;
+  using ProducerHandle = Index::ProducerHandle;
+  using ProducerCursor = Index::ProducerCursor;
+  using ProducerProducts = Index::ProducerProducts;
+
+  RcuWarehouse(): mpSnapshot(new Index) {}
+
+  ~RcuWarehouse()
+  {
+    delete mpSnapshot.load(std::memory_order_relaxed);
+  }
+
+  RcuWarehouse(const RcuWarehouse &) = delete;
+  RcuWarehouse& operator=(const RcuWarehouse &) = delete;
+
+  //! Add the given product \p pProduct to the warehouse
+  //!
+  //! If the warehouse (including the unpublished modifications) already contains a product
+  //! with the same id as id of the \p pProduct then \p pProduct will not be added.
+  //! The added product becomes visible to readers after the next Publish().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::AddProduct()
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if product was added, false otherwise
+  bool AddProduct(const ProductPtr &pProduct)
+  {
+    // pre-conditions
+    assert(pProduct);
+
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const bool success = mPending.AddProduct(pProduct);
+    NotePendingChanges(success ? 1 : 0);
+    return success;
+  }
+
+  //! Add the given product \p pProduct to the warehouse or replace the product with the same id
+  //!
+  //! The change becomes visible to readers after the next Publish().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::UpsertProduct()
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if the product was added, false if it replaced the product with the same id
+  bool UpsertProduct(const ProductPtr &pProduct)
+  {
+    // pre-conditions
+    assert(pProduct);
+
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const bool success = mPending.UpsertProduct(pProduct);
+    NotePendingChanges(1);
+    return success;
+  }
+
+  //! Build the index of the names of the products, see Warehouse::EnableNameIndex()
+  //!
+  //! The index becomes available to readers after the next Publish().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::EnableNameIndex()
+  void EnableNameIndex()
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    if(!mPending.IsNameIndexEnabled())
+    {
+      mPending.EnableNameIndex();
+      NotePendingChanges(1);
+    }
+  }
+
+  //! Build the columns of the prices of the products, see Warehouse::EnablePriceColumns()
+  //!
+  //! The columns become available to readers after the next Publish().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::EnablePriceColumns()
+  void EnablePriceColumns()
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    if(!mPending.IsPriceColumnsEnabled())
+    {
+      mPending.EnablePriceColumns();
+      NotePendingChanges(1);
+    }
+  }
+
+  //! Change the price of the product with the given id \p id to \p price
+  //!
+  //! The change becomes visible to readers after the next Publish().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::UpdatePrice()
+  //!
+  //! \return true if the warehouse has the product with the given id, false otherwise
+  bool UpdatePrice(std::string_view id, Product::Price price)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const bool success = mPending.UpdatePrice(id, price);
+    NotePendingChanges(success ? 1 : 0);
+    return success;
+  }
+
+  //! Add the products of the range [\p first, \p last) to the warehouse
+  //!
+  //! The added products become visible to readers after the next Publish().
+  //!
+  //! \param[in] first, last range of the products to add
+  //! \param[out] added out-iterator to which per product of the range, in the same order,
+  //!   true is written if the product was added and false otherwise
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::AddProducts()
+  //!
+  //! \pre no product of the range is an empty smart-pointer
+  //!
+  //! \return number of added products
+  template <typename InputIt, typename OutputIt>
+  size_t AddProducts(InputIt first, InputIt last, OutputIt added)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const size_t cntAdded = mPending.AddProducts(first, last, added);
+    NotePendingChanges(cntAdded);
+    return cntAdded;
+  }
+
+  //! Add the products of the range [\p first, \p last) to the warehouse
+  //!
+  //! The same as AddProducts(first, last, added), but without per product results.
+  //!
+  //! \return number of added products
+  template <typename InputIt>
+  size_t AddProducts(InputIt first, InputIt last)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const size_t cntAdded = mPending.AddProducts(first, last);
+    NotePendingChanges(cntAdded);
+    return cntAdded;
+  }
+
+  //! Find a product inside the last published snapshot by the given product id \p id
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductById()
+  //!
+  //! \return if the product with the given id \p id is presented inside the snapshot then
+  //!   the smart pointer to this product will be returned,
+  //!   otherwise an empty smart pointer will be returned
+  ProductPtr FindProductById(std::string_view id) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductById(id);
+  }
+
+  //! Find inside the last published snapshot at most \p limit products whose names start
+  //! with the given prefix \p prefix, see Warehouse::FindProductsByNamePrefix()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByNamePrefix()
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByNamePrefix(std::string_view prefix, size_t limit, OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByNamePrefix(prefix, limit, out);
+  }
+
+  //! Find inside the last published snapshot at most \p limit products whose names contain
+  //! the given substring \p substring, see Warehouse::FindProductsByNameSubstring()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByNameSubstring()
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByNameSubstring(std::string_view substring, size_t limit, OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByNameSubstring(substring, limit, out);
+  }
+
+  //! Visit a product inside the last published snapshot with the given product id \p id
+  //!
+  //! \param[in] id id of the product
+  //! \param[in] visitor callable that is invoked as visitor(const Product&) with the found
+  //!   product (if any); it must not call Publish()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductById()
+  //!
+  //! \return true if the product was found and visited, false otherwise
+  template <typename Visitor>
+  bool VisitProductById(std::string_view id, Visitor &&visitor) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->VisitProductById(id, std::forward<Visitor>(visitor));
+  }
+
+  //! Find inside the last published snapshot the products with the ids of the range [\p first, \p last)
+  //!
+  //! \param[in] first, last range of the ids of the products, which are convertible to std::string_view
+  //! \param[out] out out-iterator to which per id an either found or empty smart pointer would be written
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByIds()
+  //!
+  //! \return number of found products
+  template <typename ForwardIt, typename OutputIt>
+  size_t FindProductsByIds(ForwardIt first, ForwardIt last, OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByIds(first, last, out);
+  }
+
+  //! Find inside the last published snapshot all products of the given producer \p producer.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByProducer()
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByProducer(producer, out);
+  }
+
+  //! Find inside the last published snapshot all products of the producer with the given
+  //! handle \p producer.
+  //!
+  //! \param[in] producer handle of the producer of the products, see GetProducerHandle()
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity: O(M), where M is number of products of the given producer
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(ProducerHandle producer, OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByProducer(producer, out);
+  }
+
+  //! Find inside the last published snapshot at most \p limit products of the given producer
+  //! \p producer, which follow the given cursor \p cursor.
+  //!
+  //! The cursor does not refer to a snapshot, so the next chunk is found in the snapshot that
+  //! is the last published one at the time of the next call, see Warehouse::FindProductsByProducer().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByProducer()
+  //!
+  //! \return cursor after the last found product
+  template <typename OutputIt>
+  ProducerCursor FindProductsByProducer(std::string_view producer, const ProducerCursor &cursor, size_t limit,
+    OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByProducer(producer, cursor, limit, out);
+  }
+
+  //! Find inside the last published snapshot at most \p limit products of the producer with
+  //! the given handle \p producer, which follow the given cursor \p cursor.
+  //!
+  //! Algorithm's time complexity: O(logM + limit), where M is number of products of the given producer
+  //!
+  //! \return cursor after the last found product
+  template <typename OutputIt>
+  ProducerCursor FindProductsByProducer(ProducerHandle producer, const ProducerCursor &cursor, size_t limit,
+    OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByProducer(producer, cursor, limit, out);
+  }
+
+  //! Find inside the last published snapshot all products of the given producer \p producer
+  //! with the prices from the range [\p priceLo, \p priceHi].
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] priceLo, priceHi the lowest and the highest price of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in the ascending order of the prices
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByProducer()
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, Product::Price priceLo, Product::Price priceHi,
+    OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByProducer(producer, priceLo, priceHi, out);
+  }
+
+  //! Find inside the last published snapshot all products of the producer with the given
+  //! handle \p producer with the prices from the range [\p priceLo, \p priceHi].
+  //!
+  //! Algorithm's time complexity: O(logM + K), where M is number of products of the given
+  //! producer and K is number of found products
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(ProducerHandle producer, Product::Price priceLo, Product::Price priceHi,
+    OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByProducer(producer, priceLo, priceHi, out);
+  }
+
+  //! Find inside the last published snapshot all products with the prices from the range
+  //! [\p priceLo, \p priceHi].
+  //!
+  //! \param[in] priceLo, priceHi the lowest and the highest price of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in the ascending order of the prices
+  //!
+  //! Algorithm's time complexity: O(logN + K), where K is number of found products
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByPriceRange(Product::Price priceLo, Product::Price priceHi, OutputIt out) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->FindProductsByPriceRange(priceLo, priceHi, out);
+  }
+
+  //! Visit inside the last published snapshot all products of the given producer \p producer.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] visitor callable that is invoked as visitor(const Product&) with every found
+  //!   product in the ascending order of the prices; it must not call Publish()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::ForEachProductOfProducer()
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProductOfProducer(std::string_view producer, Visitor &&visitor) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->ForEachProductOfProducer(producer, std::forward<Visitor>(visitor));
+  }
+
+  //! Visit inside the last published snapshot all products of the producer with the given
+  //! handle \p producer.
+  //!
+  //! Algorithm's time complexity: O(M), where M is number of products of the given producer
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProductOfProducer(ProducerHandle producer, Visitor &&visitor) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->ForEachProductOfProducer(producer, std::forward<Visitor>(visitor));
+  }
+
+  //! Get the stats of the prices of all products of the last published snapshot, see
+  //! Warehouse::GetPriceStats()
+  //!
+  //! Algorithm's time complexity: O(N)
+  PriceStats GetPriceStats() const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->GetPriceStats();
+  }
+
+  //! Get the stats of the prices of the products of the given producer \p producer inside
+  //! the last published snapshot, see Warehouse::GetPriceStats(std::string_view)
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::GetPriceStats(std::string_view)
+  PriceStats GetPriceStats(std::string_view producer) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->GetPriceStats(producer);
+  }
+
+  //! Get the stats of the prices of the products of every producer of the last published
+  //! snapshot, see Warehouse::GetPriceStatsByProducer()
+  //!
+  //! Algorithm's time complexity: O(N + P*logP), where P is number of producers
+  std::vector<std::pair<Product::Producer, PriceStats>> GetPriceStatsByProducer() const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->GetPriceStatsByProducer();
+  }
+
+  //! Get the histogram of the prices of all products of the last published snapshot, see
+  //! Warehouse::GetPriceHistogram()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::GetPriceHistogram()
+  std::vector<size_t> GetPriceHistogram(const std::vector<Product::Price> &bounds) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->GetPriceHistogram(bounds);
+  }
+
+  //! Copy all products of the last published snapshot, see Warehouse::SnapshotProducts()
+  //!
+  //! Algorithm's time complexity: O(N)
+  //!
+  //! \return the smart pointers to all products in an unspecified order
+  std::vector<ProductPtr> SnapshotProducts() const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->SnapshotProducts();
+  }
+
+  //! Copy all products of the last published snapshot grouped by their producers, see
+  //! Warehouse::SnapshotProductsByProducer()
+  //!
+  //! Algorithm's time complexity: O(N + P*logP), where P is number of producers
+  //!
+  //! \return the producers with products in the order of their names
+  std::vector<ProducerProducts> SnapshotProductsByProducer() const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->SnapshotProductsByProducer();
+  }
+
+  //! Visit all products of the last published snapshot by the threads of the given policy
+  //! \p policy, see Warehouse::ForEachProduct()
+  //!
+  //! The smart pointers are copied under the read guard, so a long scan does not delay the
+  //! reclamation of the snapshot by Publish().
+  //!
+  //! Algorithm's time complexity: O(N) for the copy plus O(N/T) visits, where T is number of threads
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProduct(const ScanPolicy &policy, Visitor &&visitor) const
+  {
+    const std::vector<ProductPtr> products = SnapshotProducts();
+    ScanInChunks(policy, products, [&visitor](const ProductPtr &pProduct) { visitor(*pProduct); });
+    return products.size();
+  }
+
+  //! Fold the products of every producer of the last published snapshot by the threads of the
+  //! given policy \p policy, see Warehouse::AggregateByProducer()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::AggregateByProducer()
+  //!
+  //! \return the producers with products in the order of their names, every one with its fold
+  template <typename T, typename Fold>
+  std::vector<std::pair<Product::Producer, T>> AggregateByProducer(const ScanPolicy &policy, const T &init,
+    Fold &&fold) const
+  {
+    return FoldGroups(policy, SnapshotProductsByProducer(), init, [&fold](T &&acc, const ProductPtr &pProduct) {
+      return fold(std::move(acc), *pProduct);
+    });
+  }
+
+  //! Count the products of the given producer \p producer inside the last published snapshot.
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::CountProductsByProducer()
+  //!
+  //! \return number of products of the producer
+  size_t CountProductsByProducer(std::string_view producer) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->CountProductsByProducer(producer);
+  }
+
+  //! Count the products of the producer with the given handle \p producer inside the last
+  //! published snapshot.
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \return number of products of the producer
+  size_t CountProductsByProducer(ProducerHandle producer) const
+  {
+    EpochDomain::ReadGuard guard(EpochDomain::Instance());
+    return mpSnapshot.load(std::memory_order_acquire)->CountProductsByProducer(producer);
+  }
+
+  //! Get the handle of the given producer \p producer
+  //!
+  //! The producer is interned if it is not known to the warehouse yet, see
+  //! Warehouse::GetProducerHandle(). Snapshots are copies of the unpublished indexes,
+  //! so the handle is valid for all snapshots published after getting it.
+  //!
+  //! \return handle of the producer
+  ProducerHandle GetProducerHandle(std::string_view producer)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    return mPending.GetProducerHandle(producer);
+  }
+
+  //! Remove the product with given id \p id from the warehouse
+  //!
+  //! The removal becomes visible to readers after the next Publish().
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::RemoveProductById()
+  //!
+  //! \post @returned is 0 or 1
+  //!
+  //! \return the number of removed products, which is either 1 or 0
+  size_t RemoveProductById(std::string_view id)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const size_t cntRemoved = mPending.RemoveProductById(id);
+    NotePendingChanges(cntRemoved);
+    return cntRemoved;
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from the warehouse
+  //!
+  //! The removals become visible to readers after the next Publish().
+  //!
+  //! \param[in] first, last range of the ids of the products to remove
+  //! \param[out] removed out-iterator to which per id of the range, in the same order,
+  //!   true is written if the product was removed and false otherwise
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::RemoveProductsById()
+  //!
+  //! \return number of removed products
+  template <typename InputIt, typename OutputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last, OutputIt removed)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const size_t cntRemoved = mPending.RemoveProductsById(first, last, removed);
+    NotePendingChanges(cntRemoved);
+    return cntRemoved;
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from the warehouse
+  //!
+  //! The same as RemoveProductsById(first, last, removed), but without per id results.
+  //!
+  //! \return number of removed products
+  template <typename InputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const size_t cntRemoved = mPending.RemoveProductsById(first, last);
+    NotePendingChanges(cntRemoved);
+    return cntRemoved;
+  }
+
+  //! Save all products and producers of the warehouse to the file with the given path \p path
+  //!
+  //! The unpublished modifications are saved as well. Writers wait for the saving,
+  //! readers do not, see Warehouse::SaveSnapshot().
+  //!
+  //! \return true if the snapshot was saved, false otherwise
+  bool SaveSnapshot(const std::string &path)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    return mPending.SaveSnapshot(path);
+  }
+
+  //! Replace the content of the warehouse with the snapshot saved to the file with the given
+  //! path \p path, see Warehouse::LoadSnapshot()
+  //!
+  //! The loaded content becomes visible to readers after the next Publish().
+  //!
+  //! \return true if the snapshot was loaded, false otherwise
+  bool LoadSnapshot(const std::string &path)
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    const bool success = mPending.LoadSnapshot(path);
+    NotePendingChanges(success ? 1 : 0);
+    return success;
+  }
+
+  //! Make all modifications done so far visible to readers
+  //!
+  //! A new snapshot is copied from the modified indexes and published; the previous
+  //! snapshot is destroyed once no reader uses it any longer. Writers wait only for the
+  //! copy, the destruction happens after the lock of the writers is released.
+  //!
+  //! Algorithm's time complexity: O(N) regardless of the number of the modifications,
+  //! plus the time readers need to leave their current lookups
+  //!
+  //! \pre the calling thread is not inside a visitor of the warehouse
+  void Publish()
+  {
+    const Index *pOldSnapshot = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      if(mCntPendingChanges == 0)
+      {
+        return;
+      }
+      pOldSnapshot = PublishUnlocked();
+    }
+    Reclaim(pOldSnapshot);
+  }
+
+  //! Make the modifications done so far visible to readers if enough of them are pending
+  //!
+  //! The modifications are published, see Publish(), if there are at least \p minChanges
+  //! of them or the oldest of them was done at least \p maxDelay ago. Calling it after every
+  //! modification bounds both the rate of the O(N) publications and the staleness of readers.
+  //!
+  //! Algorithm's time complexity: O(1) if nothing is published, otherwise the same as of Publish()
+  //!
+  //! \pre the calling thread is not inside a visitor of the warehouse
+  //!
+  //! \return true if the modifications were published, false otherwise
+  bool PublishIfDue(size_t minChanges, std::chrono::steady_clock::duration maxDelay)
+  {
+    const Index *pOldSnapshot = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mWriterMutex);
+      if(mCntPendingChanges == 0 ||
+        (mCntPendingChanges < minChanges && std::chrono::steady_clock::now() - mFirstPendingChangeTime < maxDelay))
+      {
+        return false;
+      }
+      pOldSnapshot = PublishUnlocked();
+    }
+    Reclaim(pOldSnapshot);
+    return true;
+  }
+
+private:
+  //! Count \p cntChanges modifications of the pending indexes
+  //!
+  //! \pre the lock of the writers is held
+  void NotePendingChanges(size_t cntChanges)
+  {
+    if(cntChanges != 0 && mCntPendingChanges == 0)
+    {
+      mFirstPendingChangeTime = std::chrono::steady_clock::now();
+    }
+    mCntPendingChanges += cntChanges;
+  }
+
+  //! Publish a copy of the pending indexes
+  //!
+  //! \pre the lock of the writers is held
+  //!
+  //! \return the previous snapshot, which readers may still use
+  const Index* PublishUnlocked()
+  {
+    const Index *pOldSnapshot = mpSnapshot.exchange(new Index(mPending), std::memory_order_acq_rel);
+    mCntPendingChanges = 0;
+    return pOldSnapshot;
+  }
+
+  //! Destroy the unpublished snapshot \p pOldSnapshot once no reader uses it
+  static void Reclaim(const Index *pOldSnapshot)
+  {
+    EpochDomain::Instance().Synchronize();
+    delete pOldSnapshot;
+  }
+
+  std::mutex mWriterMutex;
+  Index mPending;                  //!< indexes with the unpublished modifications
+  size_t mCntPendingChanges = 0;   //!< number of the unpublished modifications
+  std::chrono::steady_clock::time_point mFirstPendingChangeTime;  //!< time of the oldest unpublished modification
+
+  std::atomic<const Index*> mpSnapshot;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "RcuWarehouse.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<class... Args>
+std::shared_ptr<Product> MakeProduct(Args&&... args)
+{
+  return std::make_shared<Product>(Product{std::forward<Args>(args)...});
+}
+
+TEST_CASE("modifications of the read-optimized warehouse become visible after publishing") {
+
+  RcuWarehouse wh;
+
+  auto product1 = MakeProduct("id1", "producerA", "1", 1u);
+  auto product2 = MakeProduct("id2", "producerA", "2", 1u);
+
+  SUBCASE("added products are visible only after publishing") {
+    CHECK(wh.AddProduct(product1) == true);
+    CHECK(wh.AddProduct(product2) == true);
+    CHECK(!wh.FindProductById("id1"));
+
+    wh.Publish();
+
+    CHECK(wh.FindProductById("id1") == product1);
+    CHECK(wh.FindProductById("id2") == product2);
+
+    std::set<RcuWarehouse::ProductPtr> foundProducts;
+    auto outIt = std::inserter(foundProducts, foundProducts.end());
+    CHECK(wh.FindProductsByProducer("producerA", outIt) == 2);
+    CHECK(foundProducts == std::set<RcuWarehouse::ProductPtr>{product1, product2});
+  }
+
+  SUBCASE("products with existing ids should not be added, even if they are not published yet") {
+    REQUIRE(wh.AddProduct(product1));
+    CHECK(wh.AddProduct(MakeProduct("id1", "producerB", "1", 1u)) == false);
+
+    wh.Publish();
+    CHECK(wh.AddProduct(MakeProduct("id1", "producerB", "1", 1u)) == false);
+  }
+
+  SUBCASE("removed products stay visible until publishing") {
+    REQUIRE(wh.AddProduct(product1));
+    REQUIRE(wh.AddProduct(product2));
+    wh.Publish();
+
+    CHECK(wh.RemoveProductById("id42") == 0);
+    CHECK(wh.RemoveProductById("id1") == 1);
+    CHECK(wh.RemoveProductById("id1") == 0);
+    CHECK(wh.FindProductById("id1") == product1);
+
+    wh.Publish();
+
+    CHECK(!wh.FindProductById("id1"));
+    CHECK(wh.FindProductById("id2") == product2);
+  }
+}
+
+TEST_CASE("finding batches of products of the read-optimized warehouse by their ids") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)));
+
+  const std::vector<std::string> ids{"id1", "id2"};
+  std::vector<RcuWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(foundProducts)) == 0);
+
+  wh.Publish();
+  foundProducts.clear();
+  CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(foundProducts)) == 1);
+  REQUIRE(foundProducts.size() == 2);
+  CHECK(foundProducts[0]->id == "id1");
+  CHECK(!foundProducts[1]);
+}
+
+TEST_CASE("finding products of the read-optimized warehouse by their names") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "apple pie", 1u)));
+  wh.Publish();
+
+  std::vector<RcuWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByNameSubstring("pie", 10, std::back_inserter(foundProducts)) == 1);
+
+  // the name index is published as any modification
+  wh.EnableNameIndex();
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producer", "apple", 1u)));
+  CHECK(wh.FindProductsByNamePrefix("apple", 10, std::back_inserter(foundProducts)) == 1);
+  wh.Publish();
+  foundProducts.clear();
+  CHECK(wh.FindProductsByNamePrefix("apple", 10, std::back_inserter(foundProducts)) == 2);
+  CHECK(foundProducts[0]->id == "id2");
+  CHECK(wh.FindProductsByNameSubstring("pie", 10, std::back_inserter(foundProducts)) == 1);
+}
+
+TEST_CASE("visiting products of the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "name1", 42u)));
+  wh.Publish();
+
+  Product::Price price = 0;
+  CHECK(wh.VisitProductById("id1", [&price](const Product &product) { price = product.price; }) == true);
+  CHECK(price == 42u);
+
+  CHECK(wh.VisitProductById("id42", [](const Product &) { FAIL("no product should be visited"); }) == false);
+}
+
+TEST_CASE("scanning and aggregating the products of the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "name1", 1u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerB", "name2", 2u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id3", "producerA", "name3", 3u)));
+
+  // only the published products are scanned
+  CHECK(wh.ForEachProduct(kParallelScan, [](const Product &) { FAIL("no product should be visited"); }) == 0);
+  wh.Publish();
+
+  std::atomic<unsigned> sumOfPrices{0};
+  CHECK(wh.ForEachProduct(ScanPolicy{2, 1}, [&sumOfPrices](const Product &product) { sumOfPrices += product.price; }) == 3);
+  CHECK(sumOfPrices == 6);
+
+  const auto sums = wh.AggregateByProducer(kParallelScan, 0u,
+    [](unsigned sum, const Product &product) { return sum + product.price; });
+  CHECK(sums == std::vector<std::pair<Product::Producer, unsigned>>{{"producerA", 4}, {"producerB", 2}});
+  CHECK(wh.SnapshotProductsByProducer().size() == 2);
+  CHECK(wh.SnapshotProducts().size() == 3);
+}
+
+TEST_CASE("stats and histograms of the prices of the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "name1", 1u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerB", "name2", 5u)));
+  wh.EnablePriceColumns();
+  CHECK(wh.GetPriceStats().count == 0);
+
+  wh.Publish();
+  CHECK(wh.GetPriceStats().sum == 6);
+  CHECK(wh.GetPriceStats("producerB").max == 5);
+  CHECK(wh.GetPriceStatsByProducer().size() == 2);
+  CHECK(wh.GetPriceHistogram({2}) == std::vector<size_t>{1, 1});
+
+  // the columns follow the published modifications
+  REQUIRE(wh.RemoveProductById("id1") == 1);
+  wh.Publish();
+  CHECK(wh.GetPriceStats().min == 5);
+}
+
+TEST_CASE("concurrent lookups while publishing the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> cntInconsistent{0};
+
+  std::vector<std::thread> readers;
+  for(int t = 0; t < 3; ++t)
+  {
+    readers.emplace_back([&]() {
+      while(!stop)
+      {
+        // products are published in pairs, so a snapshot contains either both of them or none
+        std::vector<RcuWarehouse::ProductPtr> foundProducts;
+        const size_t cntFound = wh.FindProductsByProducer("producer", std::back_inserter(foundProducts));
+        if(cntFound != 0 && cntFound != 2)
+        {
+          cntInconsistent++;
+        }
+        wh.FindProductById("id0");
+        wh.VisitProductById("id1", [](const Product &) {});
+      }
+    });
+  }
+
+  for(int i = 0; i < 200; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id0", "producer", "name", 1u)));
+    REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)));
+    wh.Publish();
+    REQUIRE(wh.RemoveProductById("id0") == 1);
+    REQUIRE(wh.RemoveProductById("id1") == 1);
+    wh.Publish();
+  }
+
+  stop = true;
+  for(auto &reader : readers)
+  {
+    reader.join();
+  }
+
+  CHECK(cntInconsistent == 0);
+}
+
+TEST_CASE("adding and removing batches of products in the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+
+  std::vector<RcuWarehouse::ProductPtr> products{
+    MakeProduct("id1", "producer", "1", 1u), MakeProduct("id2", "producer", "2", 1u), MakeProduct("id1", "producer", "1", 1u)};
+  std::vector<bool> added;
+  CHECK(wh.AddProducts(products.begin(), products.end(), std::back_inserter(added)) == 2);
+  CHECK(added == std::vector<bool>{true, true, false});
+  wh.Publish();
+  CHECK(wh.FindProductById("id1") == products[0]);
+
+  std::vector<Product::Id> ids{"id1", "id42"};
+  std::vector<bool> removed;
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end(), std::back_inserter(removed)) == 1);
+  CHECK(removed == std::vector<bool>{true, false});
+  wh.Publish();
+  CHECK(!wh.FindProductById("id1"));
+}
+
+TEST_CASE("finding products of the read-optimized warehouse by the given producer handle") {
+
+  RcuWarehouse wh;
+
+  const auto producer = wh.GetProducerHandle("producer");
+  std::vector<RcuWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer(producer, std::back_inserter(foundProducts)) == 0);
+
+  auto product = MakeProduct("id1", "producer", "1", 1u);
+  REQUIRE(wh.AddProduct(product));
+  wh.Publish();
+
+  CHECK(wh.FindProductsByProducer(producer, std::back_inserter(foundProducts)) == 1);
+  CHECK(foundProducts == std::vector<RcuWarehouse::ProductPtr>{product});
+}
+
+TEST_CASE("finding products of the read-optimized warehouse by the given price range") {
+
+  RcuWarehouse wh;
+  auto product1 = MakeProduct("id1", "producerA", "1", 10u);
+  auto product2 = MakeProduct("id2", "producerB", "2", 20u);
+  REQUIRE(wh.AddProduct(product1));
+  REQUIRE(wh.AddProduct(product2));
+
+  std::vector<RcuWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByPriceRange(0, 100, std::back_inserter(foundProducts)) == 0);
+
+  wh.Publish();
+  CHECK(wh.FindProductsByPriceRange(0, 100, std::back_inserter(foundProducts)) == 2);
+  CHECK(foundProducts == std::vector<RcuWarehouse::ProductPtr>{product1, product2});
+
+  foundProducts.clear();
+  CHECK(wh.FindProductsByProducer("producerB", 0, 15, std::back_inserter(foundProducts)) == 0);
+  CHECK(wh.FindProductsByProducer(wh.GetProducerHandle("producerB"), 15, 25, std::back_inserter(foundProducts)) == 1);
+  CHECK(foundProducts == std::vector<RcuWarehouse::ProductPtr>{product2});
+}
+
+TEST_CASE("visiting and counting products of the given producer in the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "1", 2u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerA", "2", 1u)));
+  CHECK(wh.CountProductsByProducer("producerA") == 0);
+
+  wh.Publish();
+
+  std::vector<Product::Id> visitedIds;
+  CHECK(wh.ForEachProductOfProducer("producerA", [&visitedIds](const Product &product) { visitedIds.push_back(product.id); }) == 2);
+  CHECK(visitedIds == std::vector<Product::Id>{"id2", "id1"});
+  CHECK(wh.ForEachProductOfProducer(wh.GetProducerHandle("producerA"), [](const Product &) {}) == 2);
+
+  CHECK(wh.CountProductsByProducer("producerA") == 2);
+  CHECK(wh.CountProductsByProducer(wh.GetProducerHandle("producerA")) == 2);
+  CHECK(wh.CountProductsByProducer("producerB") == 0);
+}
+
+TEST_CASE("finding products of the given producer in chunks in the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+  for(unsigned i = 0; i < 10; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", i)));
+  }
+  wh.Publish();
+
+  std::vector<RcuWarehouse::ProductPtr> foundProducts;
+  auto cursor = wh.FindProductsByProducer("producer", RcuWarehouse::ProducerCursor(), 6, std::back_inserter(foundProducts));
+  CHECK(foundProducts.size() == 6);
+
+  // the cursor is valid for the next snapshot as well
+  REQUIRE(wh.RemoveProductById("id9") == 1);
+  wh.Publish();
+  cursor = wh.FindProductsByProducer(wh.GetProducerHandle("producer"), cursor, 6, std::back_inserter(foundProducts));
+  CHECK(cursor.AtEnd());
+  CHECK(foundProducts.size() == 9);
+}
+
+TEST_CASE("saving and loading snapshots of the read-optimized warehouse") {
+
+  const std::string path = "RcuWarehouse_test.snapshot";
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "1", 1u)));
+  wh.Publish();
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerA", "2", 2u)));
+
+  // the unpublished product is saved as well
+  REQUIRE(wh.SaveSnapshot(path));
+
+  RcuWarehouse loaded;
+  REQUIRE(loaded.LoadSnapshot(path));
+  CHECK(loaded.FindProductById("id1") == nullptr);
+  loaded.Publish();
+  CHECK(loaded.FindProductById("id1") != nullptr);
+  CHECK(loaded.FindProductById("id2") != nullptr);
+  CHECK(loaded.CountProductsByProducer("producerA") == 2);
+
+  CHECK(loaded.LoadSnapshot(path + ".missing") == false);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("upserting products and updating their prices in the read-optimized warehouse") {
+
+  RcuWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "1", 1u)));
+  wh.Publish();
+
+  CHECK(wh.UpdatePrice("id1", 2u) == true);
+  CHECK(wh.UpdatePrice("id2", 2u) == false);
+  CHECK(wh.UpsertProduct(MakeProduct("id2", "producerB", "2", 3u)) == true);
+
+  // the changes become visible after publishing
+  CHECK(wh.FindProductById("id1")->price == 1);
+  CHECK(wh.FindProductById("id2") == nullptr);
+  wh.Publish();
+  CHECK(wh.FindProductById("id1")->price == 2);
+  CHECK(wh.CountProductsByProducer("producerB") == 1);
+}
+
+TEST_CASE("publishing the modifications of the read-optimized warehouse in batches") {
+
+  RcuWarehouse wh;
+  const auto kNever = std::chrono::hours(1);
+  CHECK(wh.PublishIfDue(0, std::chrono::seconds(0)) == false);
+
+  // the modifications are kept pending until enough of them are done
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "1", 1u)));
+  CHECK(wh.AddProduct(MakeProduct("id1", "producerA", "1", 1u)) == false);
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerA", "2", 2u)));
+  CHECK(wh.PublishIfDue(3, kNever) == false);
+  CHECK(wh.FindProductById("id1") == nullptr);
+
+  REQUIRE(wh.RemoveProductById("id2") == 1);
+  CHECK(wh.PublishIfDue(3, kNever) == true);
+  CHECK(wh.FindProductById("id1") != nullptr);
+  CHECK(wh.FindProductById("id2") == nullptr);
+
+  // or until the oldest of them is old enough
+  REQUIRE(wh.UpdatePrice("id1", 5u));
+  CHECK(wh.PublishIfDue(3, kNever) == false);
+  CHECK(wh.PublishIfDue(3, std::chrono::seconds(0)) == true);
+  CHECK(wh.FindProductById("id1")->price == 5);
+  CHECK(wh.PublishIfDue(0, std::chrono::seconds(0)) == false);
+}
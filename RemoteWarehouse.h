@@ -0,0 +1,895 @@
+#ifndef _REMOTE_WAREHOUSE_H
+#define _REMOTE_WAREHOUSE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Warehouse.h"
+
+//! Binary wire protocol of RemoteWarehouse and WarehouseNode
+//!
+//! A client sends a request frame and a node answers it with a response frame, which has one
+//! response per request in the order of the requests, so many requests are batched into one
+//! frame, and several frames may be in flight to one node at once. A frame is:
+//! - kMagic, kVersion
+//! - the status (response frames only), see Status
+//! - the number of the messages
+//! - the messages: a request is its Op and its arguments, a response is the result of its request
+//!
+//! The integers are varints (7 bits per byte, the lowest first), so the frames do not depend on
+//! the byte order, and the strings are their lengths followed by their bytes. The ids are strings
+//! or varints, depending on their type, see WireWriter::PutId(). A product is its id, producer,
+//! name and price.
+struct WireFormat
+{
+  static constexpr uint8_t kMagic = 0xA7;
+  static constexpr uint8_t kVersion = 1;
+
+  //! Operations of the requests
+  enum class Op: uint8_t
+  {
+    AddProduct = 1,               //!< product -> added (0 or 1)
+    FindProductById = 2,          //!< id -> found (0 or 1), then the product if found
+    RemoveProductById = 3,        //!< id -> removed (0 or 1)
+    FindProductsByProducer = 4,   //!< producer -> number of the products, then the products
+  };
+
+  //! Status of a response frame
+  enum class Status: uint8_t
+  {
+    Ok = 0,
+    Malformed = 1,   //!< the request frame could not be decoded, the frame has no messages
+  };
+};
+
+//! Error of the protocol: a malformed response frame, or a request frame the node could not decode
+class WireError: public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+//! Writer of a frame of WireFormat
+class WireWriter
+{
+public:
+  void PutByte(uint8_t byte) { mBuffer.push_back(static_cast<char>(byte)); }
+
+  void PutVarint(uint64_t value)
+  {
+    for(; value >= 0x80; value >>= 7)
+    {
+      PutByte(static_cast<uint8_t>(value | 0x80));
+    }
+    PutByte(static_cast<uint8_t>(value));
+  }
+
+  void PutString(std::string_view str)
+  {
+    PutVarint(str.size());
+    mBuffer.append(str.data(), str.size());
+  }
+
+  //! Put the id \p id: the integer ids as varints, the other ones as strings
+  template <typename IdType>
+  void PutId(const IdType &id)
+  {
+    if constexpr(std::is_integral_v<IdType>)
+    {
+      PutVarint(static_cast<uint64_t>(id));
+    }
+    else
+    {
+      PutString(id);
+    }
+  }
+
+  template <typename ProductTraits>
+  void PutProduct(const typename ProductTraits::ProductType &product)
+  {
+    PutId(ProductTraits::IdOf(product));
+    PutString(ProductTraits::ProducerOf(product));
+    PutString(ProductTraits::NameOf(product));
+    PutVarint(ProductTraits::PriceOf(product));
+  }
+
+  //! Start a request frame of \p cntMessages messages
+  void BeginRequests(size_t cntMessages)
+  {
+    PutByte(WireFormat::kMagic);
+    PutByte(WireFormat::kVersion);
+    PutVarint(cntMessages);
+  }
+
+  //! Start a response frame with the status \p status of \p cntMessages messages
+  void BeginResponses(WireFormat::Status status, size_t cntMessages)
+  {
+    PutByte(WireFormat::kMagic);
+    PutByte(WireFormat::kVersion);
+    PutByte(static_cast<uint8_t>(status));
+    PutVarint(cntMessages);
+  }
+
+  size_t size() const { return mBuffer.size(); }
+
+  //! The written frame, the writer is empty afterwards
+  std::string Take() { return std::move(mBuffer); }
+
+private:
+  std::string mBuffer;
+};
+
+//! Reader of a frame of WireFormat
+//!
+//! Every method returns false if the frame ends too early or has an invalid value, so a malformed
+//! frame never makes the reader read outside of it. The strings refer to the frame.
+class WireReader
+{
+public:
+  explicit WireReader(std::string_view frame): mFrame(frame) {}
+
+  bool GetByte(uint8_t &byte)
+  {
+    if(mPos == mFrame.size())
+    {
+      return false;
+    }
+    byte = static_cast<uint8_t>(mFrame[mPos++]);
+    return true;
+  }
+
+  bool GetVarint(uint64_t &value)
+  {
+    value = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7)
+    {
+      uint8_t byte;
+      if(!GetByte(byte))
+      {
+        return false;
+      }
+      value |= uint64_t(byte & 0x7F) << shift;
+      if(!(byte & 0x80))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool GetString(std::string_view &str)
+  {
+    uint64_t size;
+    if(!GetVarint(size) || size > mFrame.size() - mPos)
+    {
+      return false;
+    }
+    str = mFrame.substr(mPos, static_cast<size_t>(size));
+    mPos += static_cast<size_t>(size);
+    return true;
+  }
+
+  template <typename IdType>
+  bool GetId(IdType &id)
+  {
+    if constexpr(std::is_integral_v<IdType>)
+    {
+      uint64_t value;
+      if(!GetVarint(value) || value > static_cast<uint64_t>(std::numeric_limits<IdType>::max()))
+      {
+        return false;
+      }
+      id = static_cast<IdType>(value);
+      return true;
+    }
+    else
+    {
+      std::string_view str;
+      if(!GetString(str))
+      {
+        return false;
+      }
+      id = IdType(str);
+      return true;
+    }
+  }
+
+  //! Get a product and make it by ProductTraits::MakeFromStrings() from \p pMemoryResource
+  template <typename ProductTraits>
+  bool GetProduct(std::pmr::memory_resource *pMemoryResource, typename ProductTraits::ProductPtr &pProduct)
+  {
+    typename ProductTraits::IdType id;
+    std::string_view producer, name;
+    uint64_t price;
+    if(!GetId(id) || !GetString(producer) || !GetString(name) || !GetVarint(price) ||
+       price > std::numeric_limits<Product::Price>::max())
+    {
+      return false;
+    }
+    pProduct = ProductTraits::MakeFromStrings(pMemoryResource, id, producer, name,
+      static_cast<Product::Price>(price));
+    return true;
+  }
+
+  //! Read the start of a request frame
+  bool BeginRequests(uint64_t &cntMessages)
+  {
+    uint8_t magic, version;
+    return GetByte(magic) && magic == WireFormat::kMagic && GetByte(version) && version == WireFormat::kVersion &&
+      GetVarint(cntMessages);
+  }
+
+  //! Read the start of a response frame
+  bool BeginResponses(WireFormat::Status &status, uint64_t &cntMessages)
+  {
+    uint8_t magic, version, statusByte;
+    if(!GetByte(magic) || magic != WireFormat::kMagic || !GetByte(version) || version != WireFormat::kVersion ||
+       !GetByte(statusByte) || statusByte > uint8_t(WireFormat::Status::Malformed))
+    {
+      return false;
+    }
+    status = static_cast<WireFormat::Status>(statusByte);
+    return GetVarint(cntMessages);
+  }
+
+  //! Whether the whole frame was read
+  bool AtEnd() const { return mPos == mFrame.size(); }
+
+private:
+  std::string_view mFrame;
+  size_t mPos = 0;
+};
+
+//! Ring of consistent hashing, which maps the hashes of the keys to the nodes
+//!
+//! Every node takes cntVirtualNodes points of the ring, and a key belongs to the node of the first
+//! point at or after its hash. A node that joins or leaves the ring takes or gives away only the
+//! keys of its points, about 1/N of all keys, and the virtual nodes spread them over all other nodes.
+class ConsistentHashRing
+{
+public:
+  static constexpr size_t kDefaultVirtualNodes = 128;
+
+  explicit ConsistentHashRing(size_t cntVirtualNodes = kDefaultVirtualNodes): mCntVirtualNodes(cntVirtualNodes)
+  {
+    // pre-conditions
+    assert(cntVirtualNodes > 0);
+  }
+
+  //! Mix the bits of the hash \p hash, so the hashes of std::hash, which may be the identity of
+  //! integers, are spread over the whole ring (the finalizer of SplitMix64)
+  static uint64_t Mix(uint64_t hash)
+  {
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+  }
+
+  //! Add the points of the node \p node
+  //!
+  //! Algorithm's time complexity: O(P), where P is the number of the points
+  void AddNode(size_t node)
+  {
+    for(size_t i = 0; i < mCntVirtualNodes; ++i)
+    {
+      mPoints.push_back(Point{Mix(Mix(node) + i), node});
+    }
+    std::sort(mPoints.begin(), mPoints.end(), [](const Point &a, const Point &b) {
+      return a.hash < b.hash || (a.hash == b.hash && a.node < b.node);
+    });
+    ++mCntNodes;
+  }
+
+  //! Remove the points of the node \p node
+  //!
+  //! Algorithm's time complexity: O(P), where P is the number of the points
+  void RemoveNode(size_t node)
+  {
+    const size_t cntPoints = mPoints.size();
+    mPoints.erase(std::remove_if(mPoints.begin(), mPoints.end(), [node](const Point &point) {
+      return point.node == node;
+    }), mPoints.end());
+    mCntNodes -= (mPoints.size() != cntPoints);
+  }
+
+  //! Node of the key with the given hash \p hash
+  //!
+  //! Algorithm's time complexity: O(log(P)), where P is the number of the points
+  //!
+  //! \pre the ring has a node
+  size_t NodeOf(uint64_t hash) const
+  {
+    // pre-conditions
+    assert(!mPoints.empty());
+
+    const uint64_t point = Mix(hash);
+    auto it = std::lower_bound(mPoints.begin(), mPoints.end(), point, [](const Point &a, uint64_t b) {
+      return a.hash < b;
+    });
+    return (it != mPoints.end())? it->node : mPoints.front().node;
+  }
+
+  //! Number of the nodes
+  size_t size() const { return mCntNodes; }
+  bool empty() const { return mCntNodes == 0; }
+
+private:
+  struct Point
+  {
+    uint64_t hash;
+    size_t node;
+  };
+
+  size_t mCntVirtualNodes;
+  size_t mCntNodes = 0;
+  std::vector<Point> mPoints;   //!< points of all nodes ordered by their hashes
+};
+
+//! Node of a cluster of warehouses, which answers the request frames of RemoteWarehouse
+//! with its warehouse
+//!
+//! The requests of a frame are applied in their order. A run of the requests with the same
+//! operation is applied by one batch call of the warehouse, e.g. WarehouseT::AddProducts(), which
+//! takes the lock of the warehouse once per run. Handle() is thread-safe if the warehouse is,
+//! so the frames of several connections may be handled at once.
+//!
+//! \tparam WarehouseT warehouse of the node, e.g. Warehouse or ShardedWarehouse
+//! \tparam ProductTraits traits of the products of the warehouse, see SharedProductTraits
+template <typename WarehouseT, typename ProductTraits = SharedProductTraits>
+class WarehouseNode
+{
+public:
+  using ProductPtr = typename ProductTraits::ProductPtr;
+  using IdType = typename ProductTraits::IdType;
+
+  //! Create a node of the warehouse \p warehouse, whose products are made from \p pMemoryResource
+  explicit WarehouseNode(WarehouseT &warehouse,
+    std::pmr::memory_resource *pMemoryResource = std::pmr::get_default_resource()):
+    mWarehouse(warehouse), mpMemoryResource(pMemoryResource)
+  {
+  }
+
+  //! Apply the requests of the frame \p frame to the warehouse
+  //!
+  //! Algorithm's time complexity: the sum of the complexities of the requests
+  //!
+  //! \return the response frame, whose status is Malformed if \p frame could not be decoded,
+  //!   in which case none of its requests is applied
+  std::string Handle(std::string_view frame)
+  {
+    std::vector<Request> requests;
+    if(!Decode(frame, requests))
+    {
+      WireWriter writer;
+      writer.BeginResponses(WireFormat::Status::Malformed, 0);
+      return writer.Take();
+    }
+
+    WireWriter writer;
+    writer.BeginResponses(WireFormat::Status::Ok, requests.size());
+    for(size_t first = 0; first < requests.size(); )
+    {
+      size_t last = first + 1;
+      while(last < requests.size() && requests[last].op == requests[first].op)
+      {
+        ++last;
+      }
+      ApplyRun(requests.data() + first, requests.data() + last, writer);
+      first = last;
+    }
+    return writer.Take();
+  }
+
+private:
+  struct Request
+  {
+    WireFormat::Op op;
+    ProductPtr pProduct;        //!< product to add
+    IdType id{};                //!< id to find or to remove, which refers to the frame
+    std::string_view producer;  //!< producer to find, which refers to the frame
+  };
+
+  bool Decode(std::string_view frame, std::vector<Request> &requests) const
+  {
+    WireReader reader(frame);
+    uint64_t cntMessages;
+    // every request takes at least 2 bytes, so a count above that is not trusted for the reservation
+    if(!reader.BeginRequests(cntMessages) || cntMessages > frame.size() / 2)
+    {
+      return false;
+    }
+    requests.resize(static_cast<size_t>(cntMessages));
+    for(Request &request : requests)
+    {
+      uint8_t op;
+      if(!reader.GetByte(op))
+      {
+        return false;
+      }
+      request.op = static_cast<WireFormat::Op>(op);
+      bool isDecoded = false;
+      switch(request.op)
+      {
+        case WireFormat::Op::AddProduct:
+          isDecoded = reader.GetProduct<ProductTraits>(mpMemoryResource, request.pProduct);
+          break;
+        case WireFormat::Op::FindProductById:
+        case WireFormat::Op::RemoveProductById:
+          isDecoded = reader.GetId(request.id);
+          break;
+        case WireFormat::Op::FindProductsByProducer:
+          isDecoded = reader.GetString(request.producer);
+          break;
+      }
+      if(!isDecoded)
+      {
+        return false;
+      }
+    }
+    return reader.AtEnd();
+  }
+
+  //! Apply the requests [\p first, \p last), which have the same operation, and write their responses
+  void ApplyRun(const Request *first, const Request *last, WireWriter &writer)
+  {
+    const size_t count = static_cast<size_t>(last - first);
+    switch(first->op)
+    {
+      case WireFormat::Op::AddProduct:
+      {
+        std::vector<ProductPtr> products;
+        products.reserve(count);
+        std::transform(first, last, std::back_inserter(products), [](const Request &request) {
+          return request.pProduct;
+        });
+        std::vector<bool> added;
+        added.reserve(count);
+        mWarehouse.AddProducts(products.begin(), products.end(), std::back_inserter(added));
+        for(const bool isAdded : added)
+        {
+          writer.PutByte(isAdded);
+        }
+        break;
+      }
+      case WireFormat::Op::FindProductById:
+      {
+        std::vector<IdType> ids;
+        ids.reserve(count);
+        std::transform(first, last, std::back_inserter(ids), [](const Request &request) { return request.id; });
+        std::vector<ProductPtr> found;
+        found.reserve(count);
+        mWarehouse.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(found));
+        for(const ProductPtr &pProduct : found)
+        {
+          writer.PutByte(bool(pProduct));
+          if(pProduct)
+          {
+            writer.PutProduct<ProductTraits>(*pProduct);
+          }
+        }
+        break;
+      }
+      case WireFormat::Op::RemoveProductById:
+      {
+        std::vector<IdType> ids;
+        ids.reserve(count);
+        std::transform(first, last, std::back_inserter(ids), [](const Request &request) { return request.id; });
+        std::vector<bool> removed;
+        removed.reserve(count);
+        mWarehouse.RemoveProductsById(ids.begin(), ids.end(), std::back_inserter(removed));
+        for(const bool isRemoved : removed)
+        {
+          writer.PutByte(isRemoved);
+        }
+        break;
+      }
+      case WireFormat::Op::FindProductsByProducer:
+        for(const Request *pRequest = first; pRequest != last; ++pRequest)
+        {
+          std::vector<ProductPtr> products;
+          mWarehouse.FindProductsByProducer(pRequest->producer, std::back_inserter(products));
+          writer.PutVarint(products.size());
+          for(const ProductPtr &pProduct : products)
+          {
+            writer.PutProduct<ProductTraits>(*pProduct);
+          }
+        }
+        break;
+    }
+  }
+
+  WarehouseT &mWarehouse;
+  std::pmr::memory_resource *mpMemoryResource;
+};
+
+//! Client of a cluster of warehouses that are partitioned by the ids of the products
+//!
+//! Every node of the cluster is reached by its transport, which sends a request frame of
+//! WireFormat to a WarehouseNode and returns the future of its response frame. The ids are mapped
+//! to the nodes by ConsistentHashRing, and FindProductsByProducer() gathers the products of the
+//! producer from all nodes, since the products of a producer are spread over the cluster.
+//!
+//! The methods send the frames to all nodes before they wait for any response, so the nodes work
+//! in parallel. The batch methods send the requests in frames of at most kMaxBatchSize requests,
+//! one frame per node at a time, so the requests to a node are applied in the order of the batch,
+//! e.g. of the products with the same id. The products are transferred by value: a found
+//! product is a copy made by ProductTraits::MakeFromStrings() from the memory resource of the client.
+//!
+//! All public methods are thread-safe if the transports are. A failure of a transport is rethrown
+//! by the method that waits for its response, and a response that cannot be decoded is reported
+//! by WireError; the requests of a failed batch may have been applied by some nodes.
+//!
+//! \tparam ProductTraits traits of the products, the same as of the warehouses of the nodes
+template <typename ProductTraits = SharedProductTraits>
+class RemoteWarehouse
+{
+public:
+  using ProductType = typename ProductTraits::ProductType;
+  using ProductPtr = typename ProductTraits::ProductPtr;
+  using IdType = typename ProductTraits::IdType;
+
+  //! Transport of the frames to a node: it takes a request frame and returns the future of the response frame
+  using Transport = std::function<std::future<std::string>(std::string)>;
+
+  //! Maximal number of requests in one frame
+  static constexpr size_t kMaxBatchSize = 1024;
+
+  //! Create a client of the nodes reached by the transports \p transports, each of them
+  //! taking \p cntVirtualNodes points of the ring, see ConsistentHashRing
+  //!
+  //! \pre \p transports is not empty
+  explicit RemoteWarehouse(std::vector<Transport> transports,
+    size_t cntVirtualNodes = ConsistentHashRing::kDefaultVirtualNodes,
+    std::pmr::memory_resource *pMemoryResource = std::pmr::get_default_resource()):
+    mTransports(std::move(transports)), mRing(cntVirtualNodes), mpMemoryResource(pMemoryResource)
+  {
+    // pre-conditions
+    assert(!mTransports.empty());
+
+    for(size_t node = 0; node < mTransports.size(); ++node)
+    {
+      mRing.AddNode(node);
+    }
+  }
+
+  //! Make a product from the given arguments \p args, see ProductTraits::Make()
+  template <typename... Args>
+  ProductPtr MakeProduct(Args&&... args) const
+  {
+    return ProductTraits::Make(mpMemoryResource, std::forward<Args>(args)...);
+  }
+
+  //! Node of the product with the given id \p id
+  //!
+  //! Algorithm's time complexity: O(log(P)), where P is the number of the points of the ring
+  size_t NodeOf(IdType id) const
+  {
+    return mRing.NodeOf(typename ProductTraits::IdHash()(id));
+  }
+
+  //! Number of the nodes of the cluster
+  size_t CountNodes() const { return mTransports.size(); }
+
+  //! Add the given product \p pProduct to its node, see Warehouse::AddProduct()
+  //!
+  //! \return true if the product was added, false if its node has a product with the same id
+  bool AddProduct(const ProductPtr &pProduct)
+  {
+    bool isAdded = false;
+    AddProducts(&pProduct, &pProduct + 1, &isAdded);
+    return isAdded;
+  }
+
+  //! Add the products of the range [\p first, \p last) to their nodes
+  //!
+  //! \param[out] added out-iterator to which per product of the range, in the same order,
+  //!   true is written if the product was added and false otherwise
+  //!
+  //! \return the number of added products
+  template <typename ForwardIt, typename OutputIt>
+  size_t AddProducts(ForwardIt first, ForwardIt last, OutputIt added)
+  {
+    std::vector<ProductPtr> products(first, last);
+    std::vector<char> isAdded(products.size(), false);
+    Exchange(products.size(),
+      [&](size_t i) { return NodeOf(ProductTraits::IdOf(*products[i])); },
+      [&](WireWriter &writer, size_t i) {
+        writer.PutByte(static_cast<uint8_t>(WireFormat::Op::AddProduct));
+        writer.PutProduct<ProductTraits>(*products[i]);
+      },
+      [&](WireReader &reader, size_t i) { return GetFlag(reader, isAdded[i]); });
+    std::copy(isAdded.begin(), isAdded.end(), added);
+    return static_cast<size_t>(std::count(isAdded.begin(), isAdded.end(), true));
+  }
+
+  template <typename ForwardIt>
+  size_t AddProducts(ForwardIt first, ForwardIt last)
+  {
+    return AddProducts(first, last, NullOutput());
+  }
+
+  //! Find a product by the given product id \p id on its node, see Warehouse::FindProductById()
+  //!
+  //! \return the copy of the product, or an empty smart pointer if the node has no such product
+  ProductPtr FindProductById(IdType id) const
+  {
+    ProductPtr pProduct;
+    FindProductsByIds(&id, &id + 1, &pProduct);
+    return pProduct;
+  }
+
+  //! Find the products with the ids of the range [\p first, \p last) on their nodes
+  //!
+  //! \param[out] out out-iterator to which per id of the range, in the same order, the copy of
+  //!   the found product or an empty smart pointer is written
+  //!
+  //! \return the number of found products
+  template <typename ForwardIt, typename OutputIt>
+  size_t FindProductsByIds(ForwardIt first, ForwardIt last, OutputIt out) const
+  {
+    std::vector<IdType> ids(first, last);
+    std::vector<ProductPtr> found(ids.size());
+    Exchange(ids.size(),
+      [&](size_t i) { return NodeOf(ids[i]); },
+      [&](WireWriter &writer, size_t i) {
+        writer.PutByte(static_cast<uint8_t>(WireFormat::Op::FindProductById));
+        writer.PutId(ids[i]);
+      },
+      [&](WireReader &reader, size_t i) {
+        char isFound;
+        return GetFlag(reader, isFound) && (!isFound || reader.GetProduct<ProductTraits>(mpMemoryResource, found[i]));
+      });
+    std::copy(found.begin(), found.end(), out);
+    return static_cast<size_t>(std::count_if(found.begin(), found.end(), [](const ProductPtr &p) { return bool(p); }));
+  }
+
+  //! Remove the product with the given id \p id from its node, see Warehouse::RemoveProductById()
+  //!
+  //! \return the number of removed products, which is either 1 or 0
+  size_t RemoveProductById(IdType id)
+  {
+    return RemoveProductsById(&id, &id + 1);
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from their nodes
+  //!
+  //! \param[out] removed out-iterator to which per id of the range, in the same order,
+  //!   true is written if the product was removed and false otherwise
+  //!
+  //! \return the number of removed products
+  template <typename ForwardIt, typename OutputIt>
+  size_t RemoveProductsById(ForwardIt first, ForwardIt last, OutputIt removed)
+  {
+    std::vector<IdType> ids(first, last);
+    std::vector<char> isRemoved(ids.size(), false);
+    Exchange(ids.size(),
+      [&](size_t i) { return NodeOf(ids[i]); },
+      [&](WireWriter &writer, size_t i) {
+        writer.PutByte(static_cast<uint8_t>(WireFormat::Op::RemoveProductById));
+        writer.PutId(ids[i]);
+      },
+      [&](WireReader &reader, size_t i) { return GetFlag(reader, isRemoved[i]); });
+    std::copy(isRemoved.begin(), isRemoved.end(), removed);
+    return static_cast<size_t>(std::count(isRemoved.begin(), isRemoved.end(), true));
+  }
+
+  template <typename ForwardIt>
+  size_t RemoveProductsById(ForwardIt first, ForwardIt last)
+  {
+    return RemoveProductsById(first, last, NullOutput());
+  }
+
+  //! Find the products of the given producer \p producer on all nodes
+  //!
+  //! The request is sent to all nodes at once, and the products are written in the order of
+  //! the nodes, so the order of the products of different nodes is unspecified.
+  //!
+  //! \param[out] out out-iterator to which the copies of the found products are written
+  //!
+  //! \return the number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, OutputIt out) const
+  {
+    std::vector<std::vector<ProductPtr>> productsOfNodes(mTransports.size());
+    Exchange(mTransports.size(),
+      [](size_t node) { return node; },
+      [&](WireWriter &writer, size_t) {
+        writer.PutByte(static_cast<uint8_t>(WireFormat::Op::FindProductsByProducer));
+        writer.PutString(producer);
+      },
+      [&](WireReader &reader, size_t node) {
+        uint64_t cntProducts;
+        if(!reader.GetVarint(cntProducts))
+        {
+          return false;
+        }
+        std::vector<ProductPtr> &products = productsOfNodes[node];
+        for(uint64_t i = 0; i < cntProducts; ++i)
+        {
+          ProductPtr pProduct;
+          if(!reader.GetProduct<ProductTraits>(mpMemoryResource, pProduct))
+          {
+            return false;
+          }
+          products.push_back(std::move(pProduct));
+        }
+        return true;
+      });
+
+    size_t cntFound = 0;
+    for(auto &products : productsOfNodes)
+    {
+      out = std::move(products.begin(), products.end(), out);
+      cntFound += products.size();
+    }
+    return cntFound;
+  }
+
+private:
+  //! Out-iterator that drops the written values
+  struct NullOutput
+  {
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    NullOutput& operator*() { return *this; }
+    NullOutput& operator++() { return *this; }
+    NullOutput& operator++(int) { return *this; }
+    template <typename T>
+    NullOutput& operator=(const T &) { return *this; }
+  };
+
+  static bool GetFlag(WireReader &reader, char &flag)
+  {
+    uint8_t byte;
+    if(!reader.GetByte(byte) || byte > 1)
+    {
+      return false;
+    }
+    flag = static_cast<char>(byte);
+    return true;
+  }
+
+  //! Send the requests 0..\p cntRequests-1 to their nodes and decode their responses
+  //!
+  //! The requests are grouped by their nodes into the frames of at most kMaxBatchSize requests,
+  //! which are sent in rounds of one frame per node: the frames of a round are sent first, then
+  //! their responses are awaited and decoded, and the next round is sent only if all of them
+  //! succeeded, so the frames of a node are never handled concurrently.
+  //!
+  //! \param[in] nodeOf callable that returns the node of the request i as nodeOf(i)
+  //! \param[in] put callable that writes the request i as put(WireWriter&, i)
+  //! \param[in] get callable that reads the response of the request i as get(WireReader&, i)
+  //!   and returns false if it is malformed
+  template <typename NodeOf, typename Put, typename Get>
+  void Exchange(size_t cntRequests, NodeOf &&nodeOf, Put &&put, Get &&get) const
+  {
+    std::vector<std::vector<size_t>> requestsOfNodes(mTransports.size());
+    for(size_t i = 0; i < cntRequests; ++i)
+    {
+      requestsOfNodes[nodeOf(i)].push_back(i);
+    }
+
+    struct Batch
+    {
+      const size_t *first;
+      const size_t *last;
+      std::future<std::string> response;
+    };
+    std::vector<Batch> batches;
+    for(size_t round = 0; ; ++round)
+    {
+      batches.clear();
+      for(size_t node = 0; node < mTransports.size(); ++node)
+      {
+        const std::vector<size_t> &requests = requestsOfNodes[node];
+        const size_t first = round * kMaxBatchSize;
+        if(first >= requests.size())
+        {
+          continue;
+        }
+        const size_t last = std::min(first + kMaxBatchSize, requests.size());
+        WireWriter writer;
+        writer.BeginRequests(last - first);
+        for(size_t j = first; j < last; ++j)
+        {
+          put(writer, requests[j]);
+        }
+        batches.push_back(Batch{requests.data() + first, requests.data() + last, mTransports[node](writer.Take())});
+      }
+      if(batches.empty())
+      {
+        return;
+      }
+
+      // the responses of all batches are awaited, even if some of them fail, so no batch outlives the call
+      std::exception_ptr pError;
+      for(Batch &batch : batches)
+      {
+        try
+        {
+          const std::string frame = batch.response.get();
+          if(!pError)
+          {
+            Decode(frame, batch.first, batch.last, get);
+          }
+        }
+        catch(...)
+        {
+          if(!pError)
+          {
+            pError = std::current_exception();
+          }
+        }
+      }
+      if(pError)
+      {
+        std::rethrow_exception(pError);
+      }
+    }
+  }
+
+  template <typename Get>
+  static void Decode(std::string_view frame, const size_t *first, const size_t *last, Get &get)
+  {
+    WireReader reader(frame);
+    WireFormat::Status status;
+    uint64_t cntMessages;
+    if(!reader.BeginResponses(status, cntMessages))
+    {
+      throw WireError("malformed response frame");
+    }
+    if(status == WireFormat::Status::Malformed)
+    {
+      throw WireError("the node could not decode the request frame");
+    }
+    if(cntMessages != static_cast<uint64_t>(last - first))
+    {
+      throw WireError("unexpected number of responses");
+    }
+    for(; first != last; ++first)
+    {
+      if(!get(reader, *first))
+      {
+        throw WireError("malformed response");
+      }
+    }
+    if(!reader.AtEnd())
+    {
+      throw WireError("unexpected data after the responses");
+    }
+  }
+
+  std::vector<Transport> mTransports;
+  ConsistentHashRing mRing;
+  std::pmr::memory_resource *mpMemoryResource;
+};
+
+//! Transport to a node in the same process, whose frames are handled by std::async threads,
+//! as they would be by the node's connections; e.g. for tests and for single-host clusters
+template <typename WarehouseT, typename ProductTraits>
+std::function<std::future<std::string>(std::string)> MakeLocalTransport(WarehouseNode<WarehouseT, ProductTraits> &node)
+{
+  return [&node](std::string frame) {
+    return std::async(std::launch::async, [&node, frame = std::move(frame)]() { return node.Handle(frame); });
+  };
+}
+
+#endif
@@ -0,0 +1,346 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "RemoteWarehouse.h"
+#include "ShardedWarehouse.h"
+#include "SkuProduct.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+template<class... Args>
+std::shared_ptr<Product> MakeProduct(Args&&... args)
+{
+  return std::make_shared<Product>(Product{std::forward<Args>(args)...});
+}
+
+//! Cluster of nodes in the same process and the client of it
+template <typename WarehouseT = Warehouse, typename ProductTraits = SharedProductTraits>
+struct TestCluster
+{
+  explicit TestCluster(size_t cntNodes): warehouses(cntNodes)
+  {
+    std::vector<typename RemoteWarehouse<ProductTraits>::Transport> transports;
+    for(auto &warehouse : warehouses)
+    {
+      nodes.push_back(std::make_unique<WarehouseNode<WarehouseT, ProductTraits>>(warehouse));
+      transports.push_back(MakeLocalTransport(*nodes.back()));
+    }
+    pClient = std::make_unique<RemoteWarehouse<ProductTraits>>(std::move(transports));
+  }
+
+  std::vector<WarehouseT> warehouses;
+  std::vector<std::unique_ptr<WarehouseNode<WarehouseT, ProductTraits>>> nodes;
+  std::unique_ptr<RemoteWarehouse<ProductTraits>> pClient;
+};
+
+TEST_CASE("consistent hashing of the keys") {
+
+  ConsistentHashRing ring;
+  for(size_t node = 0; node < 4; ++node)
+  {
+    ring.AddNode(node);
+  }
+  CHECK(ring.size() == 4);
+
+  std::vector<size_t> nodesOfKeys;
+  std::vector<size_t> cntKeysOfNodes(4);
+  for(uint64_t key = 0; key < 40000; ++key)
+  {
+    nodesOfKeys.push_back(ring.NodeOf(key));
+    ++cntKeysOfNodes[nodesOfKeys.back()];
+  }
+  for(const size_t cntKeys : cntKeysOfNodes)
+  {
+    // the virtual nodes spread the keys evenly enough
+    CHECK(cntKeys > 7000);
+    CHECK(cntKeys < 13000);
+  }
+
+  // the new node takes about 1/5 of the keys, the other keys stay on their nodes
+  ring.AddNode(4);
+  size_t cntMoved = 0;
+  for(uint64_t key = 0; key < 40000; ++key)
+  {
+    const size_t node = ring.NodeOf(key);
+    if(node != nodesOfKeys[key])
+    {
+      CHECK(node == 4);
+      ++cntMoved;
+    }
+  }
+  CHECK(cntMoved > 5000);
+  CHECK(cntMoved < 11000);
+
+  // the keys of the removed node go back to their nodes
+  ring.RemoveNode(4);
+  CHECK(ring.size() == 4);
+  for(uint64_t key = 0; key < 40000; key += 7)
+  {
+    CHECK(ring.NodeOf(key) == nodesOfKeys[key]);
+  }
+}
+
+TEST_CASE("frames of the wire protocol") {
+
+  WireWriter writer;
+  writer.BeginRequests(3);
+  writer.PutVarint(0);
+  writer.PutVarint(300);
+  writer.PutVarint(UINT64_MAX);
+  writer.PutString("string");
+  writer.PutId(uint64_t(42));
+  writer.PutProduct<SharedProductTraits>(Product{"id", "producer", "name", 7});
+  const std::string frame = writer.Take();
+
+  WireReader reader(frame);
+  uint64_t cntMessages, value;
+  std::string_view str;
+  uint64_t id;
+  Warehouse::ProductPtr pProduct;
+  REQUIRE(reader.BeginRequests(cntMessages));
+  CHECK(cntMessages == 3);
+  CHECK((reader.GetVarint(value) && value == 0));
+  CHECK((reader.GetVarint(value) && value == 300));
+  CHECK((reader.GetVarint(value) && value == UINT64_MAX));
+  CHECK((reader.GetString(str) && str == "string"));
+  CHECK((reader.GetId(id) && id == 42));
+  REQUIRE(reader.GetProduct<SharedProductTraits>(std::pmr::get_default_resource(), pProduct));
+  CHECK(pProduct->id == "id");
+  CHECK(pProduct->producer == "producer");
+  CHECK(pProduct->price == 7);
+  CHECK(reader.AtEnd());
+  CHECK(!reader.GetByte(*reinterpret_cast<uint8_t*>(&value)));
+
+  // the truncated frames are rejected at every length
+  for(size_t size = 0; size < frame.size(); ++size)
+  {
+    WireReader truncated(std::string_view(frame).substr(0, size));
+    bool isRead = truncated.BeginRequests(cntMessages) && truncated.GetVarint(value) && truncated.GetVarint(value) &&
+      truncated.GetVarint(value) && truncated.GetString(str) && truncated.GetId(id) &&
+      truncated.GetProduct<SharedProductTraits>(std::pmr::get_default_resource(), pProduct);
+    CHECK(!isRead);
+  }
+}
+
+TEST_CASE("the node rejects the malformed frames") {
+
+  Warehouse wh;
+  WarehouseNode<Warehouse> node(wh);
+  std::mt19937 random(42);
+
+  WireWriter writer;
+  writer.BeginRequests(2);
+  writer.PutByte(uint8_t(WireFormat::Op::AddProduct));
+  writer.PutProduct<SharedProductTraits>(Product{"id", "producer", "name", 7});
+  writer.PutByte(uint8_t(WireFormat::Op::FindProductById));
+  writer.PutId(std::string_view("id"));
+  const std::string frame = writer.Take();
+
+  for(size_t size = 0; size < frame.size(); ++size)
+  {
+    const std::string response = node.Handle(frame.substr(0, size));
+    WireReader reader(response);
+    WireFormat::Status status;
+    uint64_t cntMessages;
+    REQUIRE(reader.BeginResponses(status, cntMessages));
+    CHECK(status == WireFormat::Status::Malformed);
+    CHECK(cntMessages == 0);
+  }
+  CHECK(wh.GetStats().cntProducts == 0);
+
+  // the random frames neither crash the node nor add products
+  for(int i = 0; i < 1000; ++i)
+  {
+    std::string garbage(random() % 64, '\0');
+    std::generate(garbage.begin(), garbage.end(), [&random]() { return char(random()); });
+    node.Handle(garbage);
+  }
+
+  const std::string response = node.Handle(frame);
+  WireReader reader(response);
+  WireFormat::Status status;
+  uint64_t cntMessages;
+  uint8_t isAdded, isFound;
+  REQUIRE(reader.BeginResponses(status, cntMessages));
+  CHECK(status == WireFormat::Status::Ok);
+  CHECK(cntMessages == 2);
+  CHECK((reader.GetByte(isAdded) && isAdded == 1));
+  CHECK((reader.GetByte(isFound) && isFound == 1));
+}
+
+TEST_CASE("cluster of warehouses") {
+
+  TestCluster<> cluster(4);
+  auto &wh = *cluster.pClient;
+  CHECK(wh.CountNodes() == 4);
+
+  for(int i = 0; i < 1000; ++i)
+  {
+    REQUIRE(wh.AddProduct(wh.MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 10), "name", 1u)));
+  }
+  CHECK(!wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)));
+
+  // the products are on the nodes of their ids only
+  for(size_t node = 0; node < cluster.warehouses.size(); ++node)
+  {
+    const auto products = cluster.warehouses[node].SnapshotProducts();
+    CHECK(products.size() > 150);
+    for(const auto &pProduct : products)
+    {
+      CHECK(wh.NodeOf(pProduct->id) == node);
+    }
+  }
+
+  auto pProduct = wh.FindProductById("id5");
+  REQUIRE(pProduct);
+  CHECK(pProduct->producer == "producer5");
+  CHECK(!wh.FindProductById("id1000"));
+
+  std::vector<Warehouse::ProductPtr> products;
+  CHECK(wh.FindProductsByProducer("producer3", std::back_inserter(products)) == 100);
+  CHECK(products.size() == 100);
+  CHECK(std::all_of(products.begin(), products.end(), [](const auto &p) { return p->producer == "producer3"; }));
+  CHECK(wh.FindProductsByProducer("nobody", std::back_inserter(products)) == 0);
+
+  CHECK(wh.RemoveProductById("id5") == 1);
+  CHECK(wh.RemoveProductById("id5") == 0);
+  CHECK(!wh.FindProductById("id5"));
+}
+
+TEST_CASE("batches of the cluster") {
+
+  TestCluster<> cluster(3);
+  auto &wh = *cluster.pClient;
+
+  // the batches are larger than a frame, so every node gets several frames, which apply the duplicate ids in order
+  std::vector<Warehouse::ProductPtr> products;
+  for(int i = 0; i < 5000; ++i)
+  {
+    products.push_back(MakeProduct("id" + std::to_string(i % 4000), "producer", "name", unsigned(i)));
+  }
+  std::vector<bool> added;
+  CHECK(wh.AddProducts(products.begin(), products.end(), std::back_inserter(added)) == 4000);
+  REQUIRE(added.size() == 5000);
+  CHECK(added[3999]);
+  CHECK(!added[4000]);
+
+  std::vector<std::string> strings{"id1", "missing", "id3999"};
+  std::vector<std::string_view> ids(strings.begin(), strings.end());
+  std::vector<Warehouse::ProductPtr> found;
+  CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(found)) == 2);
+  REQUIRE(found.size() == 3);
+  CHECK(found[0]->price == 1);
+  CHECK(!found[1]);
+  CHECK(found[2]->price == 3999);
+
+  std::vector<bool> removed;
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end(), std::back_inserter(removed)) == 2);
+  CHECK(removed == std::vector<bool>{true, false, true});
+  CHECK(wh.FindProductsByProducer("producer", std::back_inserter(found)) == 3998);
+}
+
+TEST_CASE("cluster follows random modifications as one warehouse") {
+
+  std::mt19937 random(42);
+  TestCluster<ShardedWarehouse<4>> cluster(5);
+  auto &wh = *cluster.pClient;
+  Warehouse reference;
+  for(int i = 0; i < 3000; ++i)
+  {
+    const std::string id = "id" + std::to_string(random() % 500);
+    const std::string producer = "producer" + std::to_string(random() % 5);
+    switch(random() % 4)
+    {
+      case 0:
+      {
+        const auto pProduct = MakeProduct(id, producer, "name", unsigned(i));
+        CHECK(wh.AddProduct(pProduct) == reference.AddProduct(pProduct));
+        break;
+      }
+      case 1:
+        CHECK(wh.RemoveProductById(id) == reference.RemoveProductById(id));
+        break;
+      case 2:
+      {
+        const auto pProduct = wh.FindProductById(id);
+        const auto pReference = reference.FindProductById(id);
+        REQUIRE(bool(pProduct) == bool(pReference));
+        if(pProduct)
+        {
+          CHECK(pProduct->producer == pReference->producer);
+          CHECK(pProduct->price == pReference->price);
+        }
+        break;
+      }
+      default:
+      {
+        std::vector<Warehouse::ProductPtr> products, referenceProducts;
+        wh.FindProductsByProducer(producer, std::back_inserter(products));
+        reference.FindProductsByProducer(producer, std::back_inserter(referenceProducts));
+        std::set<std::string> ids, referenceIds;
+        for(const auto &pProduct : products)
+        {
+          ids.insert(pProduct->id);
+        }
+        for(const auto &pProduct : referenceProducts)
+        {
+          referenceIds.insert(pProduct->id);
+        }
+        CHECK(ids == referenceIds);
+        break;
+      }
+    }
+  }
+}
+
+TEST_CASE("cluster of the products with numeric ids") {
+
+  TestCluster<SkuWarehouse, SkuProductTraits> cluster(3);
+  auto &wh = *cluster.pClient;
+  for(uint64_t id = 0; id < 100; ++id)
+  {
+    REQUIRE(wh.AddProduct(wh.MakeProduct(id << 32, "producer", "name", unsigned(id))));
+  }
+  const auto pProduct = wh.FindProductById(uint64_t(7) << 32);
+  REQUIRE(pProduct);
+  CHECK(pProduct->price == 7);
+  CHECK(wh.RemoveProductById(uint64_t(7) << 32) == 1);
+
+  std::vector<SkuWarehouse::ProductPtr> products;
+  CHECK(wh.FindProductsByProducer("producer", std::back_inserter(products)) == 99);
+  for(const auto &warehouse : cluster.warehouses)
+  {
+    CHECK(warehouse.GetStats().cntProducts > 10);
+  }
+}
+
+TEST_CASE("failures of the transports") {
+
+  Warehouse wh;
+  WarehouseNode<Warehouse> node(wh);
+  using Client = RemoteWarehouse<>;
+
+  SUBCASE("a failed transport is reported by the call") {
+    Client client({MakeLocalTransport(node), [](std::string) -> std::future<std::string> {
+      throw std::runtime_error("connection refused");
+    }});
+    std::vector<Warehouse::ProductPtr> products;
+    CHECK_THROWS_AS(client.FindProductsByProducer("producer", std::back_inserter(products)), std::runtime_error);
+  }
+
+  SUBCASE("a malformed response is reported by WireError") {
+    Client client({[](std::string) {
+      std::promise<std::string> response;
+      response.set_value("garbage");
+      return response.get_future();
+    }});
+    CHECK_THROWS_AS(client.FindProductById("id"), WireError);
+  }
+}
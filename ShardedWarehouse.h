@@ -0,0 +1,1042 @@
+#ifndef _SHARDED_WAREHOUSE_H
+#define _SHARDED_WAREHOUSE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Warehouse.h"
+
+//! Warehouse that partitions its products into \p NShards independent shards
+//!
+//! Every product is owned by exactly one shard, selected by the hash of its id.
+//! Each shard is a complete Warehouse with its own lock, id index and producer index,
+//! so operations on products of different shards do not contend with each other.
+//!
+//! The public interface is the same as the one of Warehouse, hence switching between
+//! them is a matter of a typedef.
+//!
+//! \tparam LockingPolicy locking policy of every shard, see BasicWarehouse
+//! \tparam ProductTraits representation of the products, see BasicWarehouse
+//! \tparam Indexes the optional indexes of every shard, see BasicWarehouse
+//!
+//! All public methods are thread-safe, unless \p LockingPolicy is NoLocking.
+//! FindProductsByProducer visits the shards one by one, so its result is consistent
+//! per shard, but not across shards: a concurrent modification of one shard may be
+//! observed while a modification of another shard is not.
+template <size_t NShards, typename LockingPolicy = ExclusiveLocking, typename ProductTraits = SharedProductTraits,
+  typename Indexes = AllWarehouseIndexes>
+class ShardedWarehouse
+{
+  static_assert(NShards > 0, "ShardedWarehouse requires at least one shard");
+
+  //! Warehouse of every shard
+  using ShardWarehouse = BasicWarehouse<LockingPolicy, ProductTraits, Indexes>;
+
+public:
+  using ProductType = typename ShardWarehouse::ProductType;
+  using ProductPtr = typename ShardWarehouse::ProductPtr;
+  using IdType = typename ShardWarehouse::IdType;
+  using ProducerProducts = typename ShardWarehouse::ProducerProducts;
+  using ExpiryTime = typename ShardWarehouse::ExpiryTime;
+  using Loader = typename ShardWarehouse::Loader;
+
+  //! Handle of a producer interned by the warehouse, see GetProducerHandle()
+  //!
+  //! Every shard interns the producers on its own, so the handle consists of the
+  //! handles of the producer in all shards.
+  struct ProducerHandle
+  {
+    std::array<typename ShardWarehouse::ProducerHandle, NShards> handlesOfShards;
+  };
+
+  //! Position inside the products of a producer to resume a paginated search from, see
+  //! FindProductsByProducer(std::string_view, const ProducerCursor&, size_t, OutputIt);
+  //! a default constructed cursor is before the first product
+  //!
+  //! The shards are read one after another, so the cursor consists of the shard to resume
+  //! from and of the cursor inside that shard.
+  struct ProducerCursor
+  {
+    size_t shard = 0;
+    typename ShardWarehouse::ProducerCursor cursorOfShard;
+
+    //! Whether there are no products to find after the cursor
+    bool AtEnd() const { return shard == NShards; }
+  };
+
+  //! Make a product from the given arguments \p args, see Warehouse::MakeProduct()
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \return the smart pointer to the made product
+  template <typename... Args>
+  ProductPtr MakeProduct(Args&&... args) const
+  {
+    return mShards.front().warehouse.MakeProduct(std::forward<Args>(args)...);
+  }
+
+  //! Add the given product \p pProduct to the warehouse
+  //!
+  //! If the warehouse already contains a product with the same id
+  //! as id of the \p pProduct then \p pProduct will not be added.
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::AddProduct()
+  //! for a warehouse with N/NShards products
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if product was added, false otherwise
+  bool AddProduct(const ProductPtr &pProduct)
+  {
+    // pre-conditions
+    assert(pProduct);
+
+    return ShardOf(ProductTraits::IdOf(*pProduct)).AddProduct(pProduct);
+  }
+
+  //! Add the given product \p pProduct to the warehouse, which expires at the given time \p expiry,
+  //! see Warehouse::AddProduct(const ProductPtr&, ExpiryTime)
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::AddProduct()
+  //! for a warehouse with N/NShards products
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if product was added, false otherwise
+  bool AddProduct(const ProductPtr &pProduct, ExpiryTime expiry)
+  {
+    // pre-conditions
+    assert(pProduct);
+
+    return ShardOf(ProductTraits::IdOf(*pProduct)).AddProduct(pProduct, expiry);
+  }
+
+  //! Add the given product \p pProduct to the warehouse or replace the product with the same id
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::UpsertProduct()
+  //! for a warehouse with N/NShards products
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if the product was added, false if it replaced the product with the same id
+  bool UpsertProduct(const ProductPtr &pProduct)
+  {
+    // pre-conditions
+    assert(pProduct);
+
+    return ShardOf(ProductTraits::IdOf(*pProduct)).UpsertProduct(pProduct);
+  }
+
+  //! Change the price of the product with the given id \p id to \p price
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::UpdatePrice()
+  //! for a warehouse with N/NShards products
+  //!
+  //! \return true if the warehouse has the product with the given id, false otherwise
+  bool UpdatePrice(IdType id, Product::Price price)
+  {
+    return ShardOf(id).UpdatePrice(id, price);
+  }
+
+  //! Add the products of the range [\p first, \p last) to the warehouse
+  //!
+  //! The products are distributed over the shards first, then every shard adds
+  //! its products under its lock taken once.
+  //!
+  //! \param[in] first, last range of the products to add
+  //! \param[out] added out-iterator to which per product of the range, in the same order,
+  //!   true is written if the product was added and false otherwise
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::AddProducts()
+  //!
+  //! \pre no product of the range is an empty smart-pointer
+  //!
+  //! \return number of added products
+  template <typename InputIt, typename OutputIt>
+  size_t AddProducts(InputIt first, InputIt last, OutputIt added)
+  {
+    std::vector<size_t> shardIndexes;
+    std::array<std::vector<ProductPtr>, NShards> productsOfShards;
+    for(; first != last; ++first)
+    {
+      const ProductPtr &pProduct = *first;
+      assert(pProduct);
+
+      shardIndexes.push_back(ShardIndexOf(ProductTraits::IdOf(*pProduct)));
+      productsOfShards[shardIndexes.back()].push_back(pProduct);
+    }
+
+    size_t cntAdded = 0;
+    std::array<std::vector<bool>, NShards> addedOfShards;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntAdded += mShards[i].warehouse.AddProducts(
+        productsOfShards[i].begin(), productsOfShards[i].end(), std::back_inserter(addedOfShards[i]));
+    }
+
+    MergeShardResults(shardIndexes, addedOfShards, added);
+    return cntAdded;
+  }
+
+  //! Add the products of the range [\p first, \p last) to the warehouse
+  //!
+  //! The same as AddProducts(first, last, added), but without per product results.
+  //!
+  //! \return number of added products
+  template <typename InputIt>
+  size_t AddProducts(InputIt first, InputIt last)
+  {
+    std::array<std::vector<ProductPtr>, NShards> productsOfShards;
+    for(; first != last; ++first)
+    {
+      const ProductPtr &pProduct = *first;
+      assert(pProduct);
+
+      productsOfShards[ShardIndexOf(ProductTraits::IdOf(*pProduct))].push_back(pProduct);
+    }
+
+    size_t cntAdded = 0;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntAdded += mShards[i].warehouse.AddProducts(productsOfShards[i].begin(), productsOfShards[i].end());
+    }
+    return cntAdded;
+  }
+
+  //! Find a product inside the warehouse by the given product id \p id
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductById()
+  //! for a warehouse with N/NShards products
+  //!
+  //! \return if the product with the given id \p id is presented inside the warehouse then
+  //!   the smart pointer to this product will be returned,
+  //!   otherwise an empty smart pointer will be returned
+  ProductPtr FindProductById(IdType id) const
+  {
+    return ShardOf(id).FindProductById(id);
+  }
+
+  //! Find a product inside the warehouse by the given product id \p id, or load it on a miss,
+  //! see Warehouse::FindOrLoadProductById()
+  ProductPtr FindOrLoadProductById(IdType id)
+  {
+    return ShardOf(id).FindOrLoadProductById(id);
+  }
+
+  //! Set the loader \p loader of the products that the shards miss, see Warehouse::SetLoader()
+  void SetLoader(const Loader &loader)
+  {
+    for(auto &shard : mShards)
+    {
+      shard.warehouse.SetLoader(loader);
+    }
+  }
+
+  //! Bound the warehouse by the number of the products \p maxProducts and by their estimated bytes
+  //! \p maxBytes, see Warehouse::SetCapacity()
+  //!
+  //! Every shard is bounded by its share of the capacity, rounded up, so the products are evicted
+  //! from the shard that exceeds its share even if the warehouse as a whole does not.
+  //!
+  //! \return number of the evicted products
+  size_t SetCapacity(size_t maxProducts, size_t maxBytes = std::numeric_limits<size_t>::max())
+  {
+    auto shareOf = [](size_t limit) {
+      return (limit == std::numeric_limits<size_t>::max())? limit : limit / NShards + (limit % NShards != 0);
+    };
+    size_t cntEvicted = 0;
+    for(auto &shard : mShards)
+    {
+      cntEvicted += shard.warehouse.SetCapacity(shareOf(maxProducts), shareOf(maxBytes));
+    }
+    return cntEvicted;
+  }
+
+  //! Find inside the warehouse the products with the ids of the range [\p first, \p last)
+  //!
+  //! The ids are distributed over the shards first, then every shard looks up its ids at once,
+  //! see Warehouse::FindProductsByIds(). The shards are looked up by \p cntThreads threads,
+  //! including the calling one, which pays off for batches of thousands of ids only.
+  //!
+  //! \param[in] first, last range of the ids of the products, which are convertible to IdType
+  //! \param[out] out out-iterator to which per id of the range, in the same order, the smart
+  //!   pointer to the found product or an empty smart pointer would be written
+  //! \param[in] cntThreads number of threads looking up the shards, at most NShards are used
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::FindProductsByIds()
+  //!
+  //! \return number of found products
+  template <typename ForwardIt, typename OutputIt>
+  size_t FindProductsByIds(ForwardIt first, ForwardIt last, OutputIt out, size_t cntThreads = 1) const
+  {
+    std::vector<size_t> shardIndexes;
+    std::array<std::vector<IdType>, NShards> idsOfShards;
+    for(; first != last; ++first)
+    {
+      const IdType id(*first);
+      shardIndexes.push_back(ShardIndexOf(id));
+      idsOfShards[shardIndexes.back()].push_back(id);
+    }
+
+    // the task t looks up the shards t, t + cntTasks, t + 2*cntTasks, ...
+    std::array<std::vector<ProductPtr>, NShards> productsOfShards;
+    std::array<size_t, NShards> cntFoundOfShards{};
+    auto findInShards = [&](size_t task, size_t cntTasks) {
+      for(size_t i = task; i < NShards; i += cntTasks)
+      {
+        productsOfShards[i].reserve(idsOfShards[i].size());
+        cntFoundOfShards[i] = mShards[i].warehouse.FindProductsByIds(idsOfShards[i].begin(), idsOfShards[i].end(),
+          std::back_inserter(productsOfShards[i]));
+      }
+    };
+
+    const size_t cntTasks = std::max<size_t>(1, std::min(cntThreads, NShards));
+    std::vector<std::future<void>> tasks;
+    for(size_t task = 1; task < cntTasks; ++task)
+    {
+      tasks.push_back(std::async(std::launch::async, findInShards, task, cntTasks));
+    }
+    findInShards(0, cntTasks);
+    for(auto &task : tasks)
+    {
+      task.get();
+    }
+
+    MergeShardResults(shardIndexes, productsOfShards, out);
+    return std::accumulate(cntFoundOfShards.begin(), cntFoundOfShards.end(), size_t(0));
+  }
+
+  //! Find inside the warehouse all products of the given producer \p producer.
+  //!
+  //! The products of the same producer are spread over all shards, hence all of them
+  //! are visited one after another and their results are merged into \p out.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(NShards + M), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, OutputIt out) const
+  {
+    size_t cntFound = 0;
+    for(const auto &shard : mShards)
+    {
+      // Warehouse::FindProductsByProducer() takes the iterator by value,
+      // so it has to be passed by reference to not lose its progress between shards
+      cntFound += shard.warehouse.FindProductsByProducer(producer, OutputRef<OutputIt>{&out});
+    }
+    return cntFound;
+  }
+
+  //! Find inside the warehouse all products of the producer with the given handle \p producer.
+  //!
+  //! \param[in] producer handle of the producer of the products, see GetProducerHandle()
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity: O(NShards + M), where M is number of products of the given producer
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(const ProducerHandle &producer, OutputIt out) const
+  {
+    size_t cntFound = 0;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntFound += mShards[i].warehouse.FindProductsByProducer(producer.handlesOfShards[i], OutputRef<OutputIt>{&out});
+    }
+    return cntFound;
+  }
+
+  //! Find inside the warehouse at most \p limit products of the given producer \p producer,
+  //! which follow the given cursor \p cursor.
+  //!
+  //! The products are found shard after shard, in the ascending order of the prices inside
+  //! every shard, see Warehouse::FindProductsByProducer(). The lock of at most one
+  //! shard is held at a time. Unlike the one of Warehouse, the returned cursor may be not at
+  //! the end even if no products follow it, then the next call finds nothing.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(NShards*logM + limit), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //!
+  //! \return cursor after the last found product
+  template <typename OutputIt>
+  ProducerCursor FindProductsByProducer(std::string_view producer, const ProducerCursor &cursor, size_t limit,
+    OutputIt out) const
+  {
+    return FindProductsByProducerFrom(cursor, limit, out,
+      [this, producer](size_t shard, const auto &cursorOfShard, size_t limitOfShard, auto outOfShard) {
+        return mShards[shard].warehouse.FindProductsByProducer(producer, cursorOfShard, limitOfShard, outOfShard);
+      });
+  }
+
+  //! Find inside the warehouse at most \p limit products of the producer with the given
+  //! handle \p producer, which follow the given cursor \p cursor.
+  //!
+  //! Algorithm's time complexity: O(NShards*logM + limit), where M is number of products of
+  //! the given producer
+  //!
+  //! \return cursor after the last found product
+  template <typename OutputIt>
+  ProducerCursor FindProductsByProducer(const ProducerHandle &producer, const ProducerCursor &cursor, size_t limit,
+    OutputIt out) const
+  {
+    return FindProductsByProducerFrom(cursor, limit, out,
+      [this, &producer](size_t shard, const auto &cursorOfShard, size_t limitOfShard, auto outOfShard) {
+        return mShards[shard].warehouse.FindProductsByProducer(
+          producer.handlesOfShards[shard], cursorOfShard, limitOfShard, outOfShard);
+      });
+  }
+
+  //! Find inside the warehouse all products of the given producer \p producer with the prices
+  //! from the range [\p priceLo, \p priceHi].
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] priceLo, priceHi the lowest and the highest price of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied,
+  //!   shard after shard, in the ascending order of the prices inside every shard
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(NShards*logM + K), where M is number of products of the given producer
+  //!   and K is number of found products
+  //! - worst case:   O(N)
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, Product::Price priceLo, Product::Price priceHi,
+    OutputIt out) const
+  {
+    size_t cntFound = 0;
+    for(const auto &shard : mShards)
+    {
+      cntFound += shard.warehouse.FindProductsByProducer(producer, priceLo, priceHi, OutputRef<OutputIt>{&out});
+    }
+    return cntFound;
+  }
+
+  //! Find inside the warehouse all products of the producer with the given handle \p producer
+  //! with the prices from the range [\p priceLo, \p priceHi].
+  //!
+  //! Algorithm's time complexity: O(NShards*logM + K), where M is number of products of the
+  //! given producer and K is number of found products
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(const ProducerHandle &producer, Product::Price priceLo, Product::Price priceHi,
+    OutputIt out) const
+  {
+    size_t cntFound = 0;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntFound += mShards[i].warehouse.FindProductsByProducer(producer.handlesOfShards[i], priceLo, priceHi,
+        OutputRef<OutputIt>{&out});
+    }
+    return cntFound;
+  }
+
+  //! Find inside the warehouse all products with the prices from the range [\p priceLo, \p priceHi].
+  //!
+  //! \param[in] priceLo, priceHi the lowest and the highest price of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied,
+  //!   shard after shard, in the ascending order of the prices inside every shard
+  //!
+  //! Algorithm's time complexity: O(NShards*logN + K), where K is number of found products
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByPriceRange(Product::Price priceLo, Product::Price priceHi, OutputIt out) const
+  {
+    size_t cntFound = 0;
+    for(const auto &shard : mShards)
+    {
+      cntFound += shard.warehouse.FindProductsByPriceRange(priceLo, priceHi, OutputRef<OutputIt>{&out});
+    }
+    return cntFound;
+  }
+
+  //! Build the index of the names of the products of every shard, see Warehouse::EnableNameIndex()
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::EnableNameIndex()
+  void EnableNameIndex()
+  {
+    for(auto &shard : mShards)
+    {
+      shard.warehouse.EnableNameIndex();
+    }
+  }
+
+  //! Whether the index of the names is enabled, see EnableNameIndex()
+  bool IsNameIndexEnabled() const
+  {
+    return mShards.front().warehouse.IsNameIndexEnabled();
+  }
+
+  //! Find inside the warehouse at most \p limit products whose names start with the given
+  //! prefix \p prefix, see Warehouse::FindProductsByNamePrefix()
+  //!
+  //! Every shard finds at most \p limit products, which are merged by their names.
+  //!
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in the order of their names
+  //!
+  //! Algorithm's time complexity, where K is number of found products:
+  //! - with the name index: O(NShards*(logN + K))
+  //! - without it:          the same as of Warehouse::FindProductsByNamePrefix()
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByNamePrefix(std::string_view prefix, size_t limit, OutputIt out) const
+  {
+    std::vector<ProductPtr> found;
+    for(const auto &shard : mShards)
+    {
+      shard.warehouse.FindProductsByNamePrefix(prefix, limit, std::back_inserter(found));
+    }
+
+    // the products are ordered as by the shards: by the names and then by the addresses
+    const size_t cntFound = std::min(limit, found.size());
+    std::partial_sort(found.begin(), found.begin() + cntFound, found.end(),
+      [](const ProductPtr &pLhs, const ProductPtr &pRhs) {
+        const std::string_view lhsName = ProductTraits::NameOf(*pLhs);
+        const std::string_view rhsName = ProductTraits::NameOf(*pRhs);
+        return (lhsName != rhsName)? lhsName < rhsName : std::less<const void*>()(pLhs.get(), pRhs.get());
+      });
+    std::move(found.begin(), found.begin() + cntFound, out);
+    return cntFound;
+  }
+
+  //! Find inside the warehouse at most \p limit products whose names contain the given
+  //! substring \p substring, see Warehouse::FindProductsByNameSubstring()
+  //!
+  //! \param[out] out out-iterator to which the found products (if any) would be copied,
+  //!   shard after shard, in an unspecified order inside every shard
+  //!
+  //! Algorithm's time complexity: O(NShards) times the one of Warehouse::FindProductsByNameSubstring()
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByNameSubstring(std::string_view substring, size_t limit, OutputIt out) const
+  {
+    size_t cntFound = 0;
+    for(auto it = mShards.begin(); it != mShards.end() && cntFound < limit; ++it)
+    {
+      cntFound += it->warehouse.FindProductsByNameSubstring(substring, limit - cntFound, OutputRef<OutputIt>{&out});
+    }
+    return cntFound;
+  }
+
+  //! Visit inside the warehouse all products of the given producer \p producer.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] visitor callable that is invoked as visitor(const ProductType&) with every found
+  //!   product, shard after shard; it is invoked under the lock of a shard, hence it must not
+  //!   call methods of the warehouse
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(NShards + M), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProductOfProducer(std::string_view producer, Visitor &&visitor) const
+  {
+    size_t cntVisited = 0;
+    for(const auto &shard : mShards)
+    {
+      cntVisited += shard.warehouse.ForEachProductOfProducer(producer, visitor);
+    }
+    return cntVisited;
+  }
+
+  //! Visit inside the warehouse all products of the producer with the given handle \p producer.
+  //!
+  //! Algorithm's time complexity: O(NShards + M), where M is number of products of the given producer
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProductOfProducer(const ProducerHandle &producer, Visitor &&visitor) const
+  {
+    size_t cntVisited = 0;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntVisited += mShards[i].warehouse.ForEachProductOfProducer(producer.handlesOfShards[i], visitor);
+    }
+    return cntVisited;
+  }
+
+  //! Count the products of the given producer \p producer inside the warehouse.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(NShards)
+  //! - worst case:   O(NShards*P), where P is number of producers
+  //!
+  //! \return number of products of the producer
+  size_t CountProductsByProducer(std::string_view producer) const
+  {
+    size_t cntProducts = 0;
+    for(const auto &shard : mShards)
+    {
+      cntProducts += shard.warehouse.CountProductsByProducer(producer);
+    }
+    return cntProducts;
+  }
+
+  //! Count the products of the producer with the given handle \p producer inside the warehouse.
+  //!
+  //! Algorithm's time complexity: O(NShards)
+  //!
+  //! \return number of products of the producer
+  size_t CountProductsByProducer(const ProducerHandle &producer) const
+  {
+    size_t cntProducts = 0;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntProducts += mShards[i].warehouse.CountProductsByProducer(producer.handlesOfShards[i]);
+    }
+    return cntProducts;
+  }
+
+  //! Build the columns of the prices of every shard, see Warehouse::EnablePriceColumns()
+  //!
+  //! Algorithm's time complexity: O(N)
+  void EnablePriceColumns()
+  {
+    for(auto &shard : mShards)
+    {
+      shard.warehouse.EnablePriceColumns();
+    }
+  }
+
+  //! Whether the columns of the prices are enabled, see EnablePriceColumns()
+  bool IsPriceColumnsEnabled() const
+  {
+    return mShards.front().warehouse.IsPriceColumnsEnabled();
+  }
+
+  //! Get the stats of the prices of all products, merged from the shards, see Warehouse::GetPriceStats()
+  //!
+  //! Algorithm's time complexity: O(NShards + N)
+  PriceStats GetPriceStats() const
+  {
+    PriceStats stats;
+    for(const auto &shard : mShards)
+    {
+      stats.Merge(shard.warehouse.GetPriceStats());
+    }
+    return stats;
+  }
+
+  //! Get the stats of the prices of the products of the given producer \p producer, merged
+  //! from the shards, see Warehouse::GetPriceStats(std::string_view)
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(NShards + M), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  PriceStats GetPriceStats(std::string_view producer) const
+  {
+    PriceStats stats;
+    for(const auto &shard : mShards)
+    {
+      stats.Merge(shard.warehouse.GetPriceStats(producer));
+    }
+    return stats;
+  }
+
+  //! Get the stats of the prices of the products of every producer, merged from the shards,
+  //! see Warehouse::GetPriceStatsByProducer()
+  //!
+  //! Algorithm's time complexity: O(NShards*P*logP + N), where P is number of producers
+  //!
+  //! \return the producers with products in the order of their names, every one with its stats
+  std::vector<std::pair<Product::Producer, PriceStats>> GetPriceStatsByProducer() const
+  {
+    // the producers of every shard are sorted, so they are merged shard after shard
+    std::vector<std::pair<Product::Producer, PriceStats>> statsByProducer;
+    for(const auto &shard : mShards)
+    {
+      auto statsOfShard = shard.warehouse.GetPriceStatsByProducer();
+      std::vector<std::pair<Product::Producer, PriceStats>> merged;
+      merged.reserve(statsByProducer.size() + statsOfShard.size());
+      auto it = statsByProducer.begin();
+      for(auto &producer : statsOfShard)
+      {
+        for(; it != statsByProducer.end() && it->first < producer.first; ++it)
+        {
+          merged.push_back(std::move(*it));
+        }
+        if(it != statsByProducer.end() && it->first == producer.first)
+        {
+          it->second.Merge(producer.second);
+          merged.push_back(std::move(*it++));
+        }
+        else
+        {
+          merged.push_back(std::move(producer));
+        }
+      }
+      std::move(it, statsByProducer.end(), std::back_inserter(merged));
+      statsByProducer.swap(merged);
+    }
+    return statsByProducer;
+  }
+
+  //! Get the histogram of the prices of all products, summed over the shards, see
+  //! Warehouse::GetPriceHistogram()
+  //!
+  //! Algorithm's time complexity: NShards times the time complexity of Warehouse::GetPriceHistogram()
+  //!   for a shard
+  //!
+  //! \return bounds.size() + 1 counts of the products of the buckets
+  std::vector<size_t> GetPriceHistogram(const std::vector<Product::Price> &bounds) const
+  {
+    std::vector<size_t> counts(bounds.size() + 1, 0);
+    for(const auto &shard : mShards)
+    {
+      const std::vector<size_t> countsOfShard = shard.warehouse.GetPriceHistogram(bounds);
+      std::transform(counts.begin(), counts.end(), countsOfShard.begin(), counts.begin(), std::plus<>());
+    }
+    return counts;
+  }
+
+  //! Take a snapshot of all products of the warehouse, see Warehouse::SnapshotProducts()
+  //!
+  //! The shards are copied one after another, every one under its own lock, so the snapshot
+  //! of every shard is consistent, but the shards are copied at different moments.
+  //!
+  //! Algorithm's time complexity: O(NShards + N)
+  //!
+  //! \return the smart pointers to all products in an unspecified order
+  std::vector<ProductPtr> SnapshotProducts() const
+  {
+    std::vector<ProductPtr> products;
+    for(const auto &shard : mShards)
+    {
+      std::vector<ProductPtr> productsOfShard = shard.warehouse.SnapshotProducts();
+      products.insert(products.end(), std::make_move_iterator(productsOfShard.begin()),
+        std::make_move_iterator(productsOfShard.end()));
+    }
+    return products;
+  }
+
+  //! Take a snapshot of all products of the warehouse grouped by their producers, see
+  //! SnapshotProducts() and Warehouse::SnapshotProductsByProducer()
+  //!
+  //! Algorithm's time complexity: O(NShards*P*logP + N), where P is number of producers
+  //!
+  //! \return the producers with products in the order of their names, every one with the smart
+  //!   pointers to its products shard after shard
+  std::vector<ProducerProducts> SnapshotProductsByProducer() const
+  {
+    // the producers of every shard are sorted, so they are merged shard after shard
+    std::vector<ProducerProducts> producers;
+    for(const auto &shard : mShards)
+    {
+      std::vector<ProducerProducts> producersOfShard = shard.warehouse.SnapshotProductsByProducer();
+      std::vector<ProducerProducts> merged;
+      merged.reserve(producers.size() + producersOfShard.size());
+      auto it = producers.begin();
+      for(ProducerProducts &producer : producersOfShard)
+      {
+        for(; it != producers.end() && it->first < producer.first; ++it)
+        {
+          merged.push_back(std::move(*it));
+        }
+        if(it != producers.end() && it->first == producer.first)
+        {
+          it->second.insert(it->second.end(), std::make_move_iterator(producer.second.begin()),
+            std::make_move_iterator(producer.second.end()));
+          merged.push_back(std::move(*it++));
+        }
+        else
+        {
+          merged.push_back(std::move(producer));
+        }
+      }
+      std::move(it, producers.end(), std::back_inserter(merged));
+      producers.swap(merged);
+    }
+    return producers;
+  }
+
+  //! Visit all products of the warehouse by the threads of the given policy \p policy
+  //!
+  //! The visited products are a snapshot taken by SnapshotProducts(), so no lock is held while
+  //! visiting, see Warehouse::ForEachProduct().
+  //!
+  //! Algorithm's time complexity: O(NShards + N) for the snapshot plus O(N/T) visits, where T
+  //!   is number of threads
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProduct(const ScanPolicy &policy, Visitor &&visitor) const
+  {
+    const std::vector<ProductPtr> products = SnapshotProducts();
+    ScanInChunks(policy, products, [&visitor](const ProductPtr &pProduct) {
+      visitor(static_cast<const ProductType&>(*pProduct));
+    });
+    return products.size();
+  }
+
+  //! Fold the products of every producer of the warehouse by the threads of the given policy
+  //! \p policy, see Warehouse::AggregateByProducer()
+  //!
+  //! The products of a producer are gathered from all shards first, so every producer is
+  //! folded by a single thread and its fold is not combined from the shards.
+  //!
+  //! Algorithm's time complexity: the time complexity of SnapshotProductsByProducer() plus
+  //!   O(N/T) folds at best and O(M) at worst, where M is number of products of the largest producer
+  //!
+  //! \return the producers with products in the order of their names, every one with its fold
+  template <typename T, typename Fold>
+  std::vector<std::pair<Product::Producer, T>> AggregateByProducer(const ScanPolicy &policy, const T &init,
+    Fold &&fold) const
+  {
+    return FoldGroups(policy, SnapshotProductsByProducer(), init, [&fold](T &&acc, const ProductPtr &pProduct) {
+      return fold(std::move(acc), static_cast<const ProductType&>(*pProduct));
+    });
+  }
+
+  //! Get the handle of the given producer \p producer
+  //!
+  //! The producer is interned by every shard, see Warehouse::GetProducerHandle().
+  //!
+  //! Algorithm's time complexity: O(NShards) amortized
+  //!
+  //! \return handle of the producer
+  ProducerHandle GetProducerHandle(std::string_view producer)
+  {
+    ProducerHandle handle;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      handle.handlesOfShards[i] = mShards[i].warehouse.GetProducerHandle(producer);
+    }
+    return handle;
+  }
+
+  //! Remove the product with given id \p id from the warehouse
+  //!
+  //! In case the product with the given id is not presented in the warehouse the state
+  //! of the warehouse will not be changed
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::RemoveProductById()
+  //! for a warehouse with N/NShards products
+  //!
+  //! \post @returned is 0 or 1
+  //!
+  //! \return the number of removed products, which is either 1 or 0
+  size_t RemoveProductById(IdType id)
+  {
+    return ShardOf(id).RemoveProductById(id);
+  }
+
+  //! Remove at most \p maxCount products whose expiry times have passed
+  //!
+  //! The shards are reaped one by one, every shard under its own lock, see
+  //! Warehouse::ReapExpiredProducts(). Every shard is given an equal share of \p maxCount first,
+  //! so a shard with many expired products does not starve the others, then the rest of
+  //! \p maxCount is spent on the shards that have more expired products. By default the same
+  //! number of products is reaped as by Warehouse::ReapExpiredProducts().
+  //!
+  //! \return number of removed products
+  size_t ReapExpiredProducts(size_t maxCount = ShardWarehouse::kReapBatchSize)
+  {
+    const size_t share = (maxCount + NShards - 1) / NShards;
+    size_t cntRemoved = 0;
+    for(auto &shard : mShards)
+    {
+      cntRemoved += shard.warehouse.ReapExpiredProducts(std::min(share, maxCount - cntRemoved));
+    }
+    for(size_t i = 0; i < NShards && cntRemoved < maxCount; ++i)
+    {
+      cntRemoved += mShards[i].warehouse.ReapExpiredProducts(maxCount - cntRemoved);
+    }
+    return cntRemoved;
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from the warehouse
+  //!
+  //! The ids are distributed over the shards first, then every shard removes
+  //! its products under its lock taken once.
+  //!
+  //! \param[in] first, last range of the ids of the products to remove
+  //! \param[out] removed out-iterator to which per id of the range, in the same order,
+  //!   true is written if the product was removed and false otherwise
+  //!
+  //! Algorithm's time complexity: the same as of Warehouse::RemoveProductsById()
+  //!
+  //! \return number of removed products
+  template <typename InputIt, typename OutputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last, OutputIt removed)
+  {
+    std::vector<size_t> shardIndexes;
+    std::array<std::vector<IdValue>, NShards> idsOfShards;
+    for(; first != last; ++first)
+    {
+      shardIndexes.push_back(ShardIndexOf(*first));
+      idsOfShards[shardIndexes.back()].emplace_back(*first);
+    }
+
+    size_t cntRemoved = 0;
+    std::array<std::vector<bool>, NShards> removedOfShards;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntRemoved += mShards[i].warehouse.RemoveProductsById(
+        idsOfShards[i].begin(), idsOfShards[i].end(), std::back_inserter(removedOfShards[i]));
+    }
+
+    MergeShardResults(shardIndexes, removedOfShards, removed);
+    return cntRemoved;
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from the warehouse
+  //!
+  //! The same as RemoveProductsById(first, last, removed), but without per id results.
+  //!
+  //! \return number of removed products
+  template <typename InputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last)
+  {
+    std::array<std::vector<IdValue>, NShards> idsOfShards;
+    for(; first != last; ++first)
+    {
+      idsOfShards[ShardIndexOf(*first)].emplace_back(*first);
+    }
+
+    size_t cntRemoved = 0;
+    for(size_t i = 0; i < NShards; ++i)
+    {
+      cntRemoved += mShards[i].warehouse.RemoveProductsById(idsOfShards[i].begin(), idsOfShards[i].end());
+    }
+    return cntRemoved;
+  }
+
+  //! Stats of the warehouse, which are the sums of the stats of the shards, see Warehouse::GetStats()
+  //!
+  //! Every call of the warehouse is counted by every shard it is forwarded to, e.g. a call
+  //! of FindProductsByProducer() is counted NShards times.
+  //!
+  //! Algorithm's time complexity: O(NShards)
+  WarehouseStats GetStats() const
+  {
+    WarehouseStats stats;
+    for(const auto &shard : mShards)
+    {
+      stats += shard.warehouse.GetStats();
+    }
+    return stats;
+  }
+
+private:
+  //! Write the per item results of the shards to \p out in the original order of the items,
+  //! where \p shardIndexes contains the shard of every item in that order
+  template <typename Result, typename OutputIt>
+  static void MergeShardResults(const std::vector<size_t> &shardIndexes, 
+    std::array<std::vector<Result>, NShards> &resultsOfShards, OutputIt out)
+  {
+    std::array<size_t, NShards> positions{};
+    for(size_t shardIndex : shardIndexes)
+    {
+      *out++ = std::move(resultsOfShards[shardIndex][positions[shardIndex]++]);
+    }
+  }
+
+  //! Resume the paginated search from the cursor \p cursor, where
+  //! \p findInShard(shard, cursorOfShard, limit, out) is the search inside a shard
+  template <typename OutputIt, typename FindInShard>
+  static ProducerCursor FindProductsByProducerFrom(ProducerCursor cursor, size_t limit, OutputIt &out,
+    FindInShard &&findInShard)
+  {
+    while(!cursor.AtEnd())
+    {
+      size_t cntFound = 0;
+      cursor.cursorOfShard = findInShard(cursor.shard, cursor.cursorOfShard, limit, OutputRef<OutputIt>{&out, &cntFound});
+      if(!cursor.cursorOfShard.AtEnd())
+      {
+        // the limit is reached inside the shard
+        return cursor;
+      }
+
+      cursor.shard++;
+      cursor.cursorOfShard = {};
+      limit -= cntFound;
+      if(limit == 0)
+      {
+        break;
+      }
+    }
+    return cursor;
+  }
+
+  //! Output iterator that forwards all writes to the referenced output iterator
+  //! and counts them, if \p pCntWritten is not null
+  template <typename OutputIt>
+  struct OutputRef
+  {
+    OutputIt *pOut;
+    size_t *pCntWritten = nullptr;
+
+    OutputRef& operator*() { return *this; }
+    OutputRef& operator++() { return *this; }
+    OutputRef& operator++(int) { return *this; }
+
+    template <typename T>
+    OutputRef& operator=(T &&value)
+    {
+      *(*pOut)++ = std::forward<T>(value);
+      if(pCntWritten)
+      {
+        ++*pCntWritten;
+      }
+      return *this;
+    }
+  };
+
+  //! Type the ids of the input ranges are copied to, which owns the id
+  using IdValue = std::conditional_t<std::is_same_v<IdType, std::string_view>, Product::Id, IdType>;
+
+  //! Index of the shard that owns the product with the given id \p id
+  //!
+  //! The id hash is mixed before taking the modulo, so products of a shard still have
+  //! well distributed low hash bits inside the shard's own hash table.
+  static size_t ShardIndexOf(IdType id)
+  {
+    const uint64_t hash = typename ProductTraits::IdHash()(id);
+    return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> 32) % NShards;
+  }
+
+  ShardWarehouse& ShardOf(IdType id)
+  {
+    return mShards[ShardIndexOf(id)].warehouse;
+  }
+
+  const ShardWarehouse& ShardOf(IdType id) const
+  {
+    return mShards[ShardIndexOf(id)].warehouse;
+  }
+
+  //! Every shard occupies its own cache lines, so locking the mutex of one shard
+  //! does not invalidate the cache line with the mutex of the neighbour shard
+  struct alignas(64) Shard
+  {
+    ShardWarehouse warehouse;
+  };
+
+  std::array<Shard, NShards> mShards;
+};
+
+#endif
@@ -0,0 +1,430 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "ShardedWarehouse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<class... Args>
+std::shared_ptr<Product> MakeProduct(Args&&... args)
+{
+  return std::make_shared<Product>(Product{std::forward<Args>(args)...});
+}
+
+using TestWarehouse = ShardedWarehouse<8>;
+
+TEST_CASE("adding and finding products in the sharded warehouse") {
+
+  TestWarehouse wh;
+
+  SUBCASE("products with new ids should be added, products with existing ids should not") {
+    CHECK(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)) == true);
+    CHECK(wh.AddProduct(MakeProduct("id2", "producer", "name", 1u)) == true);
+    CHECK(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)) == false);
+  }
+
+  SUBCASE("products should be found by their ids") {
+    auto product1 = MakeProduct("id1", "producer", "name", 1u);
+    auto product2 = MakeProduct("id2", "producer", "name", 1u);
+    REQUIRE(wh.AddProduct(product1));
+    REQUIRE(wh.AddProduct(product2));
+
+    CHECK(wh.FindProductById("id1") == product1);
+    CHECK(wh.FindProductById("id2") == product2);
+    CHECK(!wh.FindProductById("id42"));
+  }
+}
+
+TEST_CASE("finding products of a producer spread over all shards") {
+
+  TestWarehouse wh;
+
+  std::set<TestWarehouse::ProductPtr> expectedProducts;
+  for(int i = 0; i < 100; ++i)
+  {
+    auto product = MakeProduct("id" + std::to_string(i), (i % 2)? "odd" : "even", "name", 1u);
+    REQUIRE(wh.AddProduct(product));
+    if(i % 2)
+    {
+      expectedProducts.insert(product);
+    }
+  }
+
+  std::set<TestWarehouse::ProductPtr> foundProducts;
+  auto outIt = std::inserter(foundProducts, foundProducts.end());
+  CHECK(wh.FindProductsByProducer("odd", outIt) == 50);
+  CHECK(foundProducts == expectedProducts);
+
+  std::vector<TestWarehouse::ProductPtr> notFoundProducts;
+  CHECK(wh.FindProductsByProducer("producer42", std::back_inserter(notFoundProducts)) == 0);
+  CHECK(notFoundProducts.size() == 0);
+}
+
+TEST_CASE("removing products from the sharded warehouse") {
+
+  TestWarehouse wh;
+
+  auto product1 = MakeProduct("id1", "producerA", "1", 1u);
+  auto product2 = MakeProduct("id2", "producerA", "2", 1u);
+  REQUIRE(wh.AddProduct(product1));
+  REQUIRE(wh.AddProduct(product2));
+
+  CHECK(wh.RemoveProductById("id42") == 0);
+  CHECK(wh.RemoveProductById("id1") == 1);
+  CHECK(wh.RemoveProductById("id1") == 0);
+
+  CHECK(!wh.FindProductById("id1"));
+  CHECK(wh.FindProductById("id2") == product2);
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer("producerA", std::back_inserter(foundProducts)) == 1);
+  CHECK(foundProducts == std::vector<TestWarehouse::ProductPtr>{product2});
+}
+
+TEST_CASE("concurrent access to the sharded warehouse") {
+
+  TestWarehouse wh;
+
+  const int cntThreads = 4;
+  const int cntProductsPerThread = 1000;
+
+  std::vector<std::thread> threads;
+  for(int t = 0; t < cntThreads; ++t)
+  {
+    threads.emplace_back([&wh, t]() {
+      for(int i = 0; i < cntProductsPerThread; ++i)
+      {
+        const auto id = std::to_string(t) + "_" + std::to_string(i);
+        wh.AddProduct(MakeProduct(id, "producer", "name", 1u));
+        wh.FindProductById(id);
+        if(i % 2)
+        {
+          wh.RemoveProductById(id);
+        }
+      }
+    });
+  }
+  for(auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer("producer", std::back_inserter(foundProducts)) == cntThreads * cntProductsPerThread / 2);
+}
+
+TEST_CASE("adding and removing batches of products in the sharded warehouse") {
+
+  TestWarehouse wh;
+
+  std::vector<TestWarehouse::ProductPtr> products;
+  for(int i = 0; i < 20; ++i)
+  {
+    products.push_back(MakeProduct("id" + std::to_string(i % 10), "producer", "name", 1u));
+  }
+
+  std::vector<bool> added;
+  CHECK(wh.AddProducts(products.begin(), products.end(), std::back_inserter(added)) == 10);
+  std::vector<bool> expectedAdded(20, false);
+  std::fill(expectedAdded.begin(), expectedAdded.begin() + 10, true);
+  CHECK(added == expectedAdded);
+
+  std::vector<Product::Id> ids{"id0", "id42", "id5"};
+  std::vector<bool> removed;
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end(), std::back_inserter(removed)) == 2);
+  CHECK(removed == std::vector<bool>{true, false, true});
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end()) == 0);
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer("producer", std::back_inserter(foundProducts)) == 8);
+}
+
+TEST_CASE("finding products of the sharded warehouse by the given producer handle") {
+
+  TestWarehouse wh;
+
+  const auto producer = wh.GetProducerHandle("producer");
+  for(int i = 0; i < 20; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), (i < 15)? "producer" : "other", "name", 1u)));
+  }
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer(producer, std::back_inserter(foundProducts)) == 15);
+  CHECK(foundProducts.size() == 15);
+}
+
+TEST_CASE("finding products of the sharded warehouse by the given price range") {
+
+  TestWarehouse wh;
+  for(unsigned i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), (i % 2)? "odd" : "even", "name", i)));
+  }
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByPriceRange(10, 19, std::back_inserter(foundProducts)) == 10);
+  for(const auto &pProduct : foundProducts)
+  {
+    CHECK((10 <= pProduct->price && pProduct->price <= 19));
+  }
+
+  CHECK(wh.FindProductsByProducer("odd", 10, 19, std::back_inserter(foundProducts)) == 5);
+  CHECK(wh.FindProductsByProducer(wh.GetProducerHandle("even"), 0, 9, std::back_inserter(foundProducts)) == 5);
+}
+
+TEST_CASE("visiting and counting products of the given producer in the sharded warehouse") {
+
+  TestWarehouse wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), (i % 4)? "many" : "few", "name", 1u)));
+  }
+
+  std::set<Product::Id> visitedIds;
+  CHECK(wh.ForEachProductOfProducer("few", [&visitedIds](const Product &product) { visitedIds.insert(product.id); }) == 25);
+  CHECK(visitedIds.size() == 25);
+  CHECK(wh.ForEachProductOfProducer(wh.GetProducerHandle("many"), [](const Product &) {}) == 75);
+
+  CHECK(wh.CountProductsByProducer("many") == 75);
+  CHECK(wh.CountProductsByProducer(wh.GetProducerHandle("few")) == 25);
+  CHECK(wh.CountProductsByProducer("none") == 0);
+}
+
+TEST_CASE("finding products of the given producer in chunks in the sharded warehouse") {
+
+  TestWarehouse wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), (i < 90)? "producer" : "other", "name", 1u)));
+  }
+
+  for(size_t limit : {1, 7, 90, 1000})
+  {
+    std::set<TestWarehouse::ProductPtr> foundProducts;
+    TestWarehouse::ProducerCursor cursor;
+    while(!cursor.AtEnd())
+    {
+      std::vector<TestWarehouse::ProductPtr> chunk;
+      cursor = wh.FindProductsByProducer("producer", cursor, limit, std::back_inserter(chunk));
+      REQUIRE(chunk.size() <= limit);
+      foundProducts.insert(chunk.begin(), chunk.end());
+    }
+    CHECK(foundProducts.size() == 90);
+  }
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  auto cursor = wh.FindProductsByProducer(wh.GetProducerHandle("other"), TestWarehouse::ProducerCursor(), 5,
+    std::back_inserter(foundProducts));
+  cursor = wh.FindProductsByProducer(wh.GetProducerHandle("other"), cursor, 5, std::back_inserter(foundProducts));
+  CHECK(foundProducts.size() == 10);
+}
+
+TEST_CASE("upserting products and updating their prices in the sharded warehouse") {
+
+  TestWarehouse wh;
+  for(int i = 0; i < 20; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producerA", "name", 1u)));
+  }
+
+  CHECK(wh.UpsertProduct(MakeProduct("id20", "producerA", "name", 1u)) == true);
+  CHECK(wh.UpsertProduct(MakeProduct("id0", "producerB", "name", 2u)) == false);
+  CHECK(wh.UpdatePrice("id1", 3u) == true);
+  CHECK(wh.UpdatePrice("id42", 3u) == false);
+
+  CHECK(wh.CountProductsByProducer("producerA") == 20);
+  CHECK(wh.CountProductsByProducer("producerB") == 1);
+  CHECK(wh.FindProductById("id1")->price == 3);
+
+  std::vector<TestWarehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByPriceRange(2, 3, std::back_inserter(foundProducts)) == 2);
+}
+
+TEST_CASE("finding batches of products by their ids in the sharded warehouse") {
+
+  TestWarehouse wh;
+  std::vector<std::string> ids;
+  for(int i = 0; i < 200; ++i)
+  {
+    const std::string id = "id" + std::to_string(i);
+    if(i % 4 != 0)
+    {
+      REQUIRE(wh.AddProduct(MakeProduct(id, "producer", "name", 1u)));
+    }
+    ids.push_back(id);
+  }
+  std::reverse(ids.begin(), ids.end());
+
+  for(size_t cntThreads : {1, 4, 16})
+  {
+    CAPTURE(cntThreads);
+    std::vector<TestWarehouse::ProductPtr> foundProducts;
+    CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(foundProducts), cntThreads) == 150);
+    REQUIRE(foundProducts.size() == ids.size());
+    for(size_t i = 0; i < ids.size(); ++i)
+    {
+      CHECK(foundProducts[i] == wh.FindProductById(ids[i]));
+    }
+  }
+}
+
+TEST_CASE("finding products by their names in the sharded warehouse") {
+
+  TestWarehouse wh;
+  for(int i = 0; i < 200; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name " + std::to_string(i), 1u)));
+  }
+
+  for(bool isNameIndexEnabled : {false, true})
+  {
+    CAPTURE(isNameIndexEnabled);
+    if(isNameIndexEnabled)
+    {
+      wh.EnableNameIndex();
+    }
+    CHECK(wh.IsNameIndexEnabled() == isNameIndexEnabled);
+
+    // the products of all shards are merged by their names
+    std::vector<TestWarehouse::ProductPtr> foundProducts;
+    CHECK(wh.FindProductsByNamePrefix("name 1", 5, std::back_inserter(foundProducts)) == 5);
+    std::vector<std::string> names;
+    for(const auto &pProduct : foundProducts)
+    {
+      names.push_back(pProduct->name);
+    }
+    CHECK(names == std::vector<std::string>{"name 1", "name 10", "name 100", "name 101", "name 102"});
+
+    foundProducts.clear();
+    CHECK(wh.FindProductsByNameSubstring("9", 1000, std::back_inserter(foundProducts)) == 38);
+    CHECK(wh.FindProductsByNameSubstring("9", 7, std::back_inserter(foundProducts)) == 7);
+    CHECK(foundProducts.size() == 45);
+  }
+}
+
+TEST_CASE("scanning and aggregating all products of the sharded warehouse") {
+
+  TestWarehouse wh;
+  for(int i = 0; i < 1000; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 3), "name", 1u)));
+  }
+
+  std::atomic<size_t> cntVisited{0};
+  CHECK(wh.ForEachProduct(ScanPolicy{4, 16}, [&cntVisited](const Product &) { cntVisited++; }) == 1000);
+  CHECK(cntVisited == 1000);
+  CHECK(wh.SnapshotProducts().size() == 1000);
+
+  // the products of a producer are gathered from all shards before they are folded
+  const auto producers = wh.SnapshotProductsByProducer();
+  REQUIRE(producers.size() == 3);
+  CHECK(producers[0].first == "producer0");
+  CHECK(producers[0].second.size() == 334);
+  CHECK(producers[2].first == "producer2");
+  CHECK(producers[2].second.size() == 333);
+
+  const auto counts = wh.AggregateByProducer(kParallelScan, size_t(0),
+    [](size_t count, const Product &) { return count + 1; });
+  CHECK(counts == std::vector<std::pair<Product::Producer, size_t>>{{"producer0", 334}, {"producer1", 333},
+    {"producer2", 333}});
+}
+
+TEST_CASE("stats and histograms of the prices of the sharded warehouse") {
+
+  TestWarehouse wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 2), "name", unsigned(i))));
+  }
+  wh.EnablePriceColumns();
+  CHECK(wh.IsPriceColumnsEnabled());
+
+  // the stats of the shards are merged
+  const PriceStats stats = wh.GetPriceStats();
+  CHECK(stats.count == 100);
+  CHECK(stats.min == 0);
+  CHECK(stats.max == 99);
+  CHECK(stats.sum == 4950);
+  CHECK(wh.GetPriceStats("producer1").sum == 2500);
+
+  const auto statsByProducer = wh.GetPriceStatsByProducer();
+  REQUIRE(statsByProducer.size() == 2);
+  CHECK(statsByProducer[0].first == "producer0");
+  CHECK(statsByProducer[0].second.count == 50);
+  CHECK(statsByProducer[0].second.max == 98);
+  CHECK(statsByProducer[1].second.min == 1);
+
+  CHECK(wh.GetPriceHistogram({10, 90}) == std::vector<size_t>{10, 80, 10});
+}
+
+TEST_CASE("sharded warehouse with the id index only") {
+
+  ShardedWarehouse<4, ExclusiveLocking, SharedProductTraits, IdWarehouseIndexes> wh;
+  std::vector<std::shared_ptr<const Product>> products;
+  for(int i = 0; i < 100; ++i)
+  {
+    products.push_back(MakeProduct("id" + std::to_string(i), "producer", "name" + std::to_string(i), 1u));
+  }
+  CHECK(wh.AddProducts(products.begin(), products.end()) == 100);
+  CHECK(wh.FindProductById("id7") == products[7]);
+  CHECK(wh.UpdatePrice("id7", 2));
+  CHECK(wh.FindProductById("id7")->price == 2);
+
+  const std::vector<std::string> ids{"id1", "id2", "unknown"};
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end()) == 2);
+  CHECK(!wh.FindProductById("id1"));
+
+  std::vector<std::shared_ptr<const Product>> found;
+  CHECK(wh.FindProductsByNamePrefix("name9", 100, std::back_inserter(found)) == 11);
+}
+
+TEST_CASE("sharded warehouse of expiring products") {
+
+  ShardedWarehouse<4, ExclusiveLocking, SharedProductTraits, ExpiringWarehouseIndexes> wh;
+  const auto now = std::chrono::steady_clock::now();
+  for(int i = 0; i < 100; ++i)
+  {
+    const auto expiry = (i % 2)? now + std::chrono::hours(1) : now - std::chrono::seconds(1);
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", 1u), expiry));
+  }
+  CHECK(!wh.FindProductById("id0"));
+  CHECK(wh.FindProductById("id1"));
+
+  // the shards with fewer expired products leave their shares to the others
+  CHECK(wh.ReapExpiredProducts(30) == 30);
+  CHECK(wh.ReapExpiredProducts(30) == 20);
+  CHECK(wh.ReapExpiredProducts(30) == 0);
+  CHECK(wh.CountProductsByProducer("producer") == 50);
+
+  // by default the same batch is reaped as by a single warehouse
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("expired" + std::to_string(i), "producer", "name", 1u), now));
+  }
+  CHECK(wh.ReapExpiredProducts() == 64);
+  CHECK(wh.ReapExpiredProducts() == 36);
+}
+
+TEST_CASE("bounded sharded warehouse") {
+
+  ShardedWarehouse<4, ExclusiveLocking, SharedProductTraits, BoundedWarehouseIndexes> wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", 1u)));
+  }
+
+  // every shard keeps at most 10 products
+  CHECK(wh.SetCapacity(40) >= 60);
+  CHECK(wh.CountProductsByProducer("producer") <= 40);
+  CHECK(wh.GetStats().cntEvictions == 100 - wh.CountProductsByProducer("producer"));
+
+  wh.SetLoader([](std::string_view id) { return MakeProduct(std::string(id), "loaded", "name", 1u); });
+  CHECK(wh.FindOrLoadProductById("new")->producer == "loaded");
+  CHECK(wh.FindProductById("new"));
+}
@@ -0,0 +1,77 @@
+#ifndef _SKU_PRODUCT_H
+#define _SKU_PRODUCT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+
+#include "Warehouse.h"
+
+//! Product with a numeric id (SKU), see SkuProductTraits
+struct SkuProduct
+{
+  using Id = uint64_t;
+
+  Id id;                      //!< unique id of the product among all products
+  Product::Producer producer; //!< producer of the product
+  Product::Name name;         //!< name of the product
+  Product::Price price{0};    //!< price of the product
+};
+
+//! Hash of the SKUs: one multiplication, whose high bits are folded into the low ones
+//!
+//! The identity hash of std::hash<uint64_t> would leave the 7 low bits that FlatHashTable
+//! matches by equal for SKUs that are multiples of 128, e.g. the SKUs of a numbering with steps.
+struct SkuHash
+{
+  size_t operator()(uint64_t sku) const
+  {
+    const uint64_t hash = sku * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+//! Product traits: the products are SkuProduct structures held by std::shared_ptr
+//!
+//! The id index of the warehouse keeps a copy of every SKU next to the pointer to the product,
+//! so a lookup by id hashes an integer and compares integers without reading the product.
+struct SkuProductTraits
+{
+  using ProductType = SkuProduct;
+  using ProductPtr = std::shared_ptr<const SkuProduct>;
+  using IdType = SkuProduct::Id;
+  using IdHash = SkuHash;
+
+  static SkuProduct::Id IdOf(const SkuProduct &product) { return product.id; }
+  static std::string_view ProducerOf(const SkuProduct &product) { return product.producer; }
+  static std::string_view NameOf(const SkuProduct &product) { return product.name; }
+  static Product::Price PriceOf(const SkuProduct &product) { return product.price; }
+
+  //! Make a product from the given arguments \p args, which initialize the fields of SkuProduct,
+  //! allocating it together with the control block of its pointer from \p pMemoryResource
+  template <typename... Args>
+  static ProductPtr Make(std::pmr::memory_resource *pMemoryResource, Args&&... args)
+  {
+    return std::allocate_shared<SkuProduct>(std::pmr::polymorphic_allocator<SkuProduct>(pMemoryResource),
+      SkuProduct{std::forward<Args>(args)...});
+  }
+
+  static ProductPtr MakeFromStrings(std::pmr::memory_resource *pMemoryResource, SkuProduct::Id id,
+    std::string_view producer, std::string_view name, Product::Price price)
+  {
+    return Make(pMemoryResource, id, Product::Producer(producer), Product::Name(name), price);
+  }
+};
+
+//! Warehouse of the products with numeric ids with the given locking policy \p LockingPolicy
+//! and the given optional indexes \p Indexes
+template <typename LockingPolicy = ExclusiveLocking, typename Indexes = AllWarehouseIndexes>
+using BasicSkuWarehouse = BasicWarehouse<LockingPolicy, SkuProductTraits, Indexes>;
+
+//! Warehouse of the products with numeric ids with the default (exclusive) locking policy
+using SkuWarehouse = BasicSkuWarehouse<>;
+
+#endif
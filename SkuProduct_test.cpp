@@ -0,0 +1,117 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "SkuProduct.h"
+#include "ShardedWarehouse.h"
+
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+TEST_CASE("hash of the SKUs") {
+
+  // the SKUs with steps still differ in the 7 low bits of their hashes
+  std::set<size_t> lowBits;
+  for(uint64_t sku = 0; sku < 128 * 1024; sku += 1024)
+  {
+    lowBits.insert(SkuHash()(sku) & 0x7F);
+  }
+  CHECK(lowBits.size() > 64);
+
+  std::set<size_t> hashes;
+  for(uint64_t sku = 0; sku < 10000; ++sku)
+  {
+    hashes.insert(SkuHash()(sku));
+  }
+  CHECK(hashes.size() == 10000);
+}
+
+TEST_CASE("warehouse of the products with numeric ids") {
+
+  SkuWarehouse wh;
+  for(uint64_t id = 0; id < 1000; ++id)
+  {
+    REQUIRE(wh.AddProduct(wh.MakeProduct(id * 7919, "producer" + std::to_string(id % 3), "name", unsigned(id))));
+  }
+  CHECK(!wh.AddProduct(wh.MakeProduct(uint64_t(7919), "producer", "name", 1u)));
+
+  auto pProduct = wh.FindProductById(7919 * 5);
+  REQUIRE(pProduct);
+  CHECK(pProduct->price == 5);
+  CHECK(!wh.FindProductById(1));
+
+  CHECK(wh.UpdatePrice(7919 * 5, 500));
+  CHECK(wh.FindProductById(7919 * 5)->price == 500);
+  CHECK(!wh.UpdatePrice(1, 500));
+  CHECK(wh.UpsertProduct(wh.MakeProduct(uint64_t(1), "producer0", "name", 2u)));
+
+  const std::vector<uint64_t> ids{1, 2, 7919 * 999};
+  std::vector<SkuWarehouse::ProductPtr> found;
+  CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(found)) == 2);
+  CHECK(found[0]->price == 2);
+  CHECK(!found[1]);
+
+  std::vector<SkuWarehouse::ProductPtr> products;
+  CHECK(wh.FindProductsByProducer("producer0", std::back_inserter(products)) == 335);
+  CHECK(wh.RemoveProductById(1) == 1);
+  CHECK(wh.RemoveProductById(1) == 0);
+  CHECK(wh.CountProductsByProducer("producer0") == 334);
+}
+
+TEST_CASE("SKU warehouse follows random modifications as the string one") {
+
+  std::mt19937_64 random(42);
+  BasicSkuWarehouse<NoLocking, IdWarehouseIndexes> wh;
+  Warehouse whOfStrings;
+  for(int i = 0; i < 20000; ++i)
+  {
+    // the SKUs are multiples of 4096, which the identity hash would put into the same control bytes
+    const uint64_t sku = (random() % 3000) << 12;
+    const std::string id = std::to_string(sku);
+    switch(random() % 3)
+    {
+      case 0:
+      {
+        const unsigned price = unsigned(random() % 100);
+        CHECK(wh.AddProduct(wh.MakeProduct(sku, "producer", "name", price)) ==
+          whOfStrings.AddProduct(whOfStrings.MakeProduct(id, "producer", "name", price)));
+        break;
+      }
+      case 1:
+        CHECK(wh.RemoveProductById(sku) == whOfStrings.RemoveProductById(id));
+        break;
+      default:
+      {
+        const auto pProduct = wh.FindProductById(sku);
+        const auto pProductOfStrings = whOfStrings.FindProductById(id);
+        REQUIRE(bool(pProduct) == bool(pProductOfStrings));
+        if(pProduct)
+        {
+          CHECK(pProduct->id == sku);
+          CHECK(pProduct->price == pProductOfStrings->price);
+        }
+        break;
+      }
+    }
+  }
+  CHECK(wh.GetStats().cntProducts == whOfStrings.GetStats().cntProducts);
+}
+
+TEST_CASE("sharded warehouse of the products with numeric ids") {
+
+  ShardedWarehouse<4, ExclusiveLocking, SkuProductTraits> wh;
+  std::vector<SkuWarehouse::ProductPtr> products;
+  for(uint64_t id = 0; id < 100; ++id)
+  {
+    products.push_back(SkuProductTraits::Make(std::pmr::get_default_resource(), id, "producer", "name", 1u));
+  }
+  CHECK(wh.AddProducts(products.begin(), products.end()) == 100);
+  CHECK(wh.FindProductById(7) == products[7]);
+
+  const std::vector<uint64_t> ids{1, 2, 1000};
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end()) == 2);
+  CHECK(!wh.FindProductById(1));
+  CHECK(wh.CountProductsByProducer("producer") == 98);
+}
@@ -0,0 +1,327 @@
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! Hierarchical timer wheel of values that are due at given ticks
+//!
+//! The wheel has kCntLevels levels of 64 slots each: the slot s of the level k holds the timers
+//! whose deadlines share the bits above 6*(k+1) with the current tick and have s as their bits
+//! [6*k, 6*(k+1)). When the current tick reaches the start of the slot, its timers cascade to the
+//! lower levels, so every timer moves at most kCntLevels times. A bit mask of the occupied slots
+//! per level lets Advance() jump over the ticks without timers, so an idle wheel costs nothing.
+//!
+//! Timers live in one array and are linked into the lists of their slots by indexes, so a timer
+//! is cancelled by its handle in O(1). Handles of cancelled and fired timers are reused.
+//!
+//! \tparam Value type of the values of the timers
+//! \tparam Allocator allocator, which is rebound to the timers
+template <typename Value, typename Allocator = std::allocator<Value>>
+class TimerWheel
+{
+  static constexpr size_t kSlotBits = 6;
+  static constexpr size_t kCntSlots = size_t(1) << kSlotBits;
+
+  //! Enough levels for the whole range of 64-bit ticks
+  static constexpr size_t kCntLevels = (64 + kSlotBits - 1) / kSlotBits;
+
+public:
+  using Tick = uint64_t;
+  using Handle = uint32_t;
+  using allocator_type = Allocator;
+
+  //! Handle of no timer
+  static constexpr Handle kNoHandle = std::numeric_limits<Handle>::max();
+
+  explicit TimerWheel(const Allocator &allocator = Allocator()): mTimers(allocator)
+  {
+    for(auto &heads : mHeads)
+    {
+      for(Handle &head : heads)
+      {
+        head = kNoHandle;
+      }
+    }
+  }
+
+  //! Exchange the timers and the current ticks of the wheel and of \p other
+  //!
+  //! \pre the allocators of the wheels are equal, unless they propagate on swap
+  void swap(TimerWheel &other) noexcept
+  {
+    mTimers.swap(other.mTimers);
+    std::swap(mHeads, other.mHeads);
+    std::swap(mOccupied, other.mOccupied);
+    std::swap(mFree, other.mFree);
+    std::swap(mSize, other.mSize);
+    std::swap(mNow, other.mNow);
+  }
+
+  //! Number of the timers that are scheduled and have not fired yet
+  size_t size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+
+  //! The tick that the wheel was advanced to
+  Tick now() const { return mNow; }
+
+  //! Schedule a timer with the value \p value that is due at the tick \p deadline; a deadline
+  //! before the current tick is due at the current tick
+  //!
+  //! Algorithm's time complexity: O(1) amortized
+  //!
+  //! \return handle of the timer
+  Handle Schedule(Tick deadline, Value value)
+  {
+    Handle handle = mFree;
+    if(handle != kNoHandle)
+    {
+      mFree = mTimers[handle].next;
+      mTimers[handle].value = std::move(value);
+    }
+    else
+    {
+      // pre-conditions
+      assert(mTimers.size() < kNoHandle);
+
+      handle = static_cast<Handle>(mTimers.size());
+      mTimers.push_back(Timer{std::move(value)});
+    }
+    mTimers[handle].deadline = deadline;
+    Link(handle);
+    ++mSize;
+    return handle;
+  }
+
+  //! Cancel the scheduled timer with the given handle \p handle
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \pre \p handle is a handle of a timer that is scheduled and has not fired yet
+  void Cancel(Handle handle)
+  {
+    // pre-conditions
+    assert(handle < mTimers.size());
+
+    Unlink(handle);
+    Free(handle);
+  }
+
+  //! Value of the scheduled timer with the given handle \p handle
+  Value& ValueOf(Handle handle)
+  {
+    // pre-conditions
+    assert(handle < mTimers.size());
+
+    return mTimers[handle].value;
+  }
+
+  //! Fire at most \p maxCount timers that are due at the ticks up to \p now, in the order of
+  //! their deadlines, and advance the current tick to \p now if all of them are fired
+  //!
+  //! A timer is removed from the wheel before it fires, so \p fire may schedule and cancel
+  //! other timers, e.g. schedule the timer again.
+  //!
+  //! Algorithm's time complexity: O(maxCount + L*S), where L is the number of levels and S is
+  //! the number of occupied slots that are passed, and every timer cascades at most L times
+  //!
+  //! \param[in] now tick to advance to
+  //! \param[in] maxCount maximal number of timers to fire
+  //! \param[in] fire callable that is invoked as fire(Value&&) with the value of every fired timer
+  //!
+  //! \return number of the fired timers
+  template <typename Fire>
+  size_t Advance(Tick now, size_t maxCount, Fire &&fire)
+  {
+    size_t cntFired = 0;
+    for(;;)
+    {
+      // the timers due at the current tick are in its slot of the level 0
+      const size_t slot = mNow & (kCntSlots - 1);
+      while(mHeads[0][slot] != kNoHandle)
+      {
+        if(cntFired == maxCount)
+        {
+          return cntFired;
+        }
+        const Handle handle = mHeads[0][slot];
+        Unlink(handle);
+        Value value = std::move(mTimers[handle].value);
+        Free(handle);
+        fire(std::move(value));
+        ++cntFired;
+      }
+
+      if(mNow >= now)
+      {
+        return cntFired;
+      }
+
+      // no timer is due before the next tick with an occupied slot, so the ticks in between are skipped
+      const Tick next = NextTick();
+      if(next > now)
+      {
+        mNow = now;
+        return cntFired;
+      }
+      mNow = next;
+      Cascade();
+    }
+  }
+
+private:
+  struct Timer
+  {
+    Value value;
+    Tick deadline = 0;
+    Handle prev = kNoHandle;
+    Handle next = kNoHandle;    //!< next timer of the slot, or the next free timer
+    uint8_t level = 0;
+    uint8_t slot = 0;
+  };
+
+  static size_t LowestBit(uint64_t mask)
+  {
+    // pre-conditions
+    assert(mask != 0);
+
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctzll(mask));
+#else
+    size_t index = 0;
+    for(; !(mask & 1u); mask >>= 1)
+    {
+      ++index;
+    }
+    return index;
+#endif
+  }
+
+  static size_t HighestBit(uint64_t mask)
+  {
+    // pre-conditions
+    assert(mask != 0);
+
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(63 - __builtin_clzll(mask));
+#else
+    size_t index = 0;
+    for(; mask >>= 1; )
+    {
+      ++index;
+    }
+    return index;
+#endif
+  }
+
+  //! Link the timer \p handle into the slot of its deadline relative to the current tick
+  void Link(Handle handle)
+  {
+    Timer &timer = mTimers[handle];
+    const Tick deadline = std::max(timer.deadline, mNow);
+    const uint64_t diff = deadline ^ mNow;
+    const size_t level = diff? HighestBit(diff) / kSlotBits : 0;
+    const size_t slot = (deadline >> (level * kSlotBits)) & (kCntSlots - 1);
+
+    timer.level = static_cast<uint8_t>(level);
+    timer.slot = static_cast<uint8_t>(slot);
+    timer.prev = kNoHandle;
+    timer.next = mHeads[level][slot];
+    if(timer.next != kNoHandle)
+    {
+      mTimers[timer.next].prev = handle;
+    }
+    mHeads[level][slot] = handle;
+    mOccupied[level] |= uint64_t(1) << slot;
+  }
+
+  void Unlink(Handle handle)
+  {
+    Timer &timer = mTimers[handle];
+    if(timer.prev != kNoHandle)
+    {
+      mTimers[timer.prev].next = timer.next;
+    }
+    else
+    {
+      mHeads[timer.level][timer.slot] = timer.next;
+      if(timer.next == kNoHandle)
+      {
+        mOccupied[timer.level] &= ~(uint64_t(1) << timer.slot);
+      }
+    }
+    if(timer.next != kNoHandle)
+    {
+      mTimers[timer.next].prev = timer.prev;
+    }
+  }
+
+  void Free(Handle handle)
+  {
+    // the value is reset, so the wheel does not keep the resources of a fired or cancelled timer
+    mTimers[handle].value = Value();
+    mTimers[handle].next = mFree;
+    mFree = handle;
+    --mSize;
+  }
+
+  //! The first tick after the current one that is the start of an occupied slot, or the maximal tick
+  //!
+  //! The occupied slots of every level are after the slot of the current tick, since a timer is
+  //! linked into a level where its deadline differs from the current tick in the slot bits.
+  Tick NextTick() const
+  {
+    Tick next = std::numeric_limits<Tick>::max();
+    for(size_t level = 0; level < kCntLevels; ++level)
+    {
+      const size_t shift = level * kSlotBits;
+      const size_t slot = (mNow >> shift) & (kCntSlots - 1);
+      const uint64_t mask = (slot + 1 < kCntSlots)? mOccupied[level] & (~uint64_t(0) << (slot + 1)) : 0;
+      if(mask)
+      {
+        const Tick start = (((mNow >> shift) & ~Tick(kCntSlots - 1)) | LowestBit(mask)) << shift;
+        next = std::min(next, start);
+      }
+    }
+    return next;
+  }
+
+  //! Move the timers of the slots that start at the current tick to the lower levels, from
+  //! the highest level down, so the timers cascade through several levels at once if they have to
+  void Cascade()
+  {
+    for(size_t level = kCntLevels - 1; level > 0; --level)
+    {
+      const size_t shift = level * kSlotBits;
+      if(mNow & ((Tick(1) << shift) - 1))
+      {
+        continue;
+      }
+      const size_t slot = (mNow >> shift) & (kCntSlots - 1);
+      Handle handle = mHeads[level][slot];
+      mHeads[level][slot] = kNoHandle;
+      mOccupied[level] &= ~(uint64_t(1) << slot);
+      while(handle != kNoHandle)
+      {
+        const Handle next = mTimers[handle].next;
+        Link(handle);
+        handle = next;
+      }
+    }
+  }
+
+  std::vector<Timer, typename std::allocator_traits<Allocator>::template rebind_alloc<Timer>> mTimers;
+  Handle mHeads[kCntLevels][kCntSlots];   //!< the first timers of the slots
+  uint64_t mOccupied[kCntLevels] = {};    //!< bit masks of the slots with timers
+  Handle mFree = kNoHandle;               //!< the first free timer
+  size_t mSize = 0;
+  Tick mNow = 0;
+};
+
+#endif
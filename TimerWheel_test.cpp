@@ -0,0 +1,132 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+using Wheel = TimerWheel<int>;
+
+TEST_CASE("timers fire in the order of their deadlines") {
+
+  Wheel wheel;
+  CHECK(wheel.empty());
+  wheel.Schedule(100, 1);
+  wheel.Schedule(5, 2);
+  wheel.Schedule(70, 3);
+  wheel.Schedule(1ull << 40, 4);
+  const Wheel::Handle cancelled = wheel.Schedule(64, 5);
+  CHECK(wheel.size() == 5);
+  wheel.Cancel(cancelled);
+  CHECK(wheel.size() == 4);
+
+  std::vector<int> fired;
+  auto fire = [&fired](int value) { fired.push_back(value); };
+  CHECK(wheel.Advance(4, 10, fire) == 0);
+  CHECK(wheel.now() == 4);
+  CHECK(wheel.Advance(100, 10, fire) == 3);
+  CHECK(fired == std::vector<int>{2, 3, 1});
+  CHECK(wheel.now() == 100);
+
+  SUBCASE("a far timer fires after a jump") {
+    CHECK(wheel.Advance((1ull << 40) - 1, 10, fire) == 0);
+    CHECK(wheel.Advance(std::numeric_limits<uint64_t>::max(), 10, fire) == 1);
+    CHECK(fired.back() == 4);
+    CHECK(wheel.empty());
+  }
+
+  SUBCASE("a timer before the current tick is due at once") {
+    wheel.Schedule(1, 6);
+    CHECK(wheel.Advance(100, 10, fire) == 1);
+    CHECK(fired.back() == 6);
+  }
+}
+
+TEST_CASE("the timers are fired in batches") {
+
+  Wheel wheel;
+  for(int i = 0; i < 10; ++i)
+  {
+    wheel.Schedule(1000 + i % 2, i);
+  }
+
+  std::vector<int> fired;
+  auto fire = [&fired](int value) { fired.push_back(value); };
+  CHECK(wheel.Advance(2000, 4, fire) == 4);
+  CHECK(wheel.now() < 2000);
+  CHECK(wheel.Advance(2000, 4, fire) == 4);
+  CHECK(wheel.Advance(2000, 4, fire) == 2);
+  CHECK(wheel.now() == 2000);
+  CHECK(fired.size() == 10);
+  CHECK(wheel.empty());
+}
+
+TEST_CASE("the timer wheel follows random schedules and cancellations") {
+
+  std::mt19937_64 random(42);
+  Wheel wheel;
+  std::map<int, uint64_t> deadlines;
+  std::map<int, Wheel::Handle> handles;
+  uint64_t now = 123456789;
+  wheel.Advance(now, 0, [](int) {});
+
+  for(int i = 0; i < 20000; ++i)
+  {
+    switch(random() % 4)
+    {
+      case 0:
+      case 1:
+      {
+        // the deadlines are spread over several levels, some of them are before the current tick
+        const uint64_t deadline = now - 10 + (random() % 4096) * (1ull << (random() % 4 * 6));
+        handles[i] = wheel.Schedule(deadline, i);
+        deadlines[i] = deadline;
+        break;
+      }
+      case 2:
+        if(!handles.empty())
+        {
+          auto it = handles.lower_bound(int(random() % (i + 1)));
+          if(it == handles.end())
+          {
+            it = handles.begin();
+          }
+          wheel.Cancel(it->second);
+          deadlines.erase(it->first);
+          handles.erase(it);
+        }
+        break;
+      default:
+      {
+        const uint64_t prevNow = now;
+        now += random() % 5000;
+        std::vector<int> fired;
+        wheel.Advance(now, std::numeric_limits<size_t>::max(), [&](int value) {
+          // the timers fire in the order of their deadlines and not before them, the overdue ones first
+          REQUIRE(deadlines.count(value));
+          CHECK(deadlines[value] <= now);
+          if(!fired.empty())
+          {
+            CHECK(std::max(deadlines[fired.back()], prevNow) <= std::max(deadlines[value], prevNow));
+          }
+          fired.push_back(value);
+        });
+        for(const int value : fired)
+        {
+          deadlines.erase(value);
+          handles.erase(value);
+        }
+        for(const auto &[value, deadline] : deadlines)
+        {
+          CHECK(deadline > now);
+        }
+        break;
+      }
+    }
+    REQUIRE(wheel.size() == deadlines.size());
+  }
+}
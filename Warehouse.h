@@ -1,12 +1,35 @@
 #ifndef _WAREHOUSE_H
 #define _WAREHOUSE_H
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <numeric>
+#include <shared_mutex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "ClockRing.h"
+#include "FlatHashTable.h"
+#include "NameIndex.h"
+#include "ParallelScan.h"
+#include "PriceColumns.h"
+#include "PriceIndex.h"
+#include "TimerWheel.h"
+#include "WarehouseSnapshot.h"
+#include "WarehouseStats.h"
 
 		
 //! Description of a single product item
@@ -23,13 +46,320 @@ struct Product
   Price price{0};    //!< price of the product
 };
 
+//! Locking policy: every method of the warehouse takes the same exclusive lock
+struct ExclusiveLocking
+{
+  using Mutex = std::mutex;
+  using ReadLock = std::lock_guard<Mutex>;
+  using WriteLock = std::lock_guard<Mutex>;
+};
+
+//! Locking policy: const methods of the warehouse take a shared lock, so lookups
+//! are executed in parallel, while modifying methods take an exclusive lock
+struct SharedLocking
+{
+  using Mutex = std::shared_mutex;
+  using ReadLock = std::shared_lock<Mutex>;
+  using WriteLock = std::lock_guard<Mutex>;
+};
+
+//! Locking policy: no locking at all, for a warehouse that is used by a single thread only
+struct NoLocking
+{
+  struct Mutex {};
+
+  struct Lock
+  {
+    explicit Lock(Mutex &) {}
+  };
+
+  using ReadLock = Lock;
+  using WriteLock = Lock;
+};
+
+//! Optional index of the warehouse: the products of every producer ordered by their prices,
+//! see WarehouseIndexes
+struct ByProducerIndex {};
+
+//! Optional index of the warehouse: all products ordered by their prices and the columns of
+//! the prices, see WarehouseIndexes
+struct ByPriceIndex {};
+
+//! Optional index of the warehouse: the names of the products, see WarehouseIndexes
+struct ByNameIndex {};
+
+//! Optional index of the warehouse: the expiry times of the products, see WarehouseIndexes and
+//! BasicWarehouse::AddProduct(const ProductPtr&, ExpiryTime)
+struct ByExpiryIndex {};
+
+//! Compile-time set of the optional indexes of a warehouse, e.g.
+//! WarehouseIndexes<ByProducerIndex, ByPriceIndex>; the id index is always there
+//!
+//! A warehouse neither stores nor maintains the indexes that are not in the set, and the entries
+//! of its id index have no members that refer to them. The methods that need a missing index
+//! do not compile.
+template <typename... Indexes>
+struct WarehouseIndexes
+{
+  template <typename Index>
+  static constexpr bool kHas = (std::is_same_v<Index, Indexes> || ...);
+};
+
+//! Optional index of the warehouse: the reference bits of the products for evicting them and
+//! the loader of the missing products, see WarehouseIndexes and BasicWarehouse::SetCapacity()
+struct ByEvictionIndex {};
+
+//! All indexes of the warehouse but the expiry and the eviction ones, which only the warehouses of
+//! expiring products and the bounded ones need
+using AllWarehouseIndexes = WarehouseIndexes<ByProducerIndex, ByPriceIndex, ByNameIndex>;
+
+//! All indexes of the warehouse, including the expiry one
+using ExpiringWarehouseIndexes = WarehouseIndexes<ByProducerIndex, ByPriceIndex, ByNameIndex, ByExpiryIndex>;
+
+//! All indexes of the warehouse but the expiry one, including the eviction one
+using BoundedWarehouseIndexes = WarehouseIndexes<ByProducerIndex, ByPriceIndex, ByNameIndex, ByEvictionIndex>;
+
+//! The id index only
+using IdWarehouseIndexes = WarehouseIndexes<>;
+
+//! Hash of strings that allows looking up std::string keys by std::string_view
+//! without constructing a temporary std::string
+struct StringHash
+{
+  using is_transparent = void;
+
+  size_t operator()(std::string_view str) const
+  {
+    // the same value as std::hash<std::string> for the equal string
+    return std::hash<std::string_view>{}(str);
+  }
+};
+
+//! Product traits: the products are Product structures held by std::shared_ptr
+//!
+//! The traits tell the warehouse how to read the fields of the products and how to make them,
+//! see CompactProductTraits for another representation of the products.
+struct SharedProductTraits
+{
+  using ProductType = Product;
+  using ProductPtr = std::shared_ptr<const Product>;
+
+  //! Type of the ids that the warehouse takes and IdOf() returns, and the hash of the ids
+  using IdType = std::string_view;
+  using IdHash = StringHash;
+
+  static std::string_view IdOf(const Product &product) { return product.id; }
+  static std::string_view ProducerOf(const Product &product) { return product.producer; }
+  static std::string_view NameOf(const Product &product) { return product.name; }
+  static Product::Price PriceOf(const Product &product) { return product.price; }
+
+  //! Make a product from the given arguments \p args, which initialize the fields of Product,
+  //! allocating it together with the control block of its pointer from \p pMemoryResource
+  template <typename... Args>
+  static ProductPtr Make(std::pmr::memory_resource *pMemoryResource, Args&&... args)
+  {
+    return std::allocate_shared<Product>(std::pmr::polymorphic_allocator<Product>(pMemoryResource),
+      Product{std::forward<Args>(args)...});
+  }
+
+  //! Make a product from the given fields, see Make(); the warehouse passes the id as IdType
+  static ProductPtr MakeFromStrings(std::pmr::memory_resource *pMemoryResource, std::string_view id,
+    std::string_view producer, std::string_view name, Product::Price price)
+  {
+    return Make(pMemoryResource, Product::Id(id), Product::Producer(producer), Product::Name(name), price);
+  }
+};
+
 //! Warehouse that contains products
 //! 
-//! All public methods are thread-safe
-class Warehouse
+//! All public methods are thread-safe, unless \p LockingPolicy is NoLocking
+//!
+//! The indexes of the warehouse allocate from the memory resource given on construction,
+//! which is used only under the lock of the warehouse. The products made by MakeProduct()
+//! are returned to the resource by the thread that releases the last reference to them,
+//! so a resource shared by several threads has to be thread-safe,
+//! e.g. std::pmr::synchronized_pool_resource.
+//!
+//! \tparam LockingPolicy defines the mutex of the warehouse (Mutex) and the locks
+//!   that are taken by const methods (ReadLock) and by modifying methods (WriteLock)
+//! \tparam ProductTraits defines the type of the products (ProductType), the type of their ids
+//!   (IdType) with its hash (IdHash), the type of the pointers to them (ProductPtr), the accessors
+//!   of their fields and how to make them, see SharedProductTraits
+//! \tparam Indexes the optional indexes of the warehouse, see WarehouseIndexes
+template <typename LockingPolicy = ExclusiveLocking, typename ProductTraits = SharedProductTraits,
+  typename Indexes = AllWarehouseIndexes>
+class BasicWarehouse
 {
+  static constexpr bool kHasProducerIndex = Indexes::template kHas<ByProducerIndex>;
+  static constexpr bool kHasPriceIndex = Indexes::template kHas<ByPriceIndex>;
+  static constexpr bool kHasNameIndex = Indexes::template kHas<ByNameIndex>;
+  static constexpr bool kHasExpiryIndex = Indexes::template kHas<ByExpiryIndex>;
+  static constexpr bool kHasEvictionIndex = Indexes::template kHas<ByEvictionIndex>;
+
+  //! Whether the id index keeps a copy of the id of every product, which is the case for the ids
+  //! that own their value, e.g. integers; a lookup then compares the ids without reading the product
+  static constexpr bool kIsIdInline = std::is_trivially_copyable_v<typename ProductTraits::IdType> &&
+    !std::is_same_v<typename ProductTraits::IdType, std::string_view>;
+
+  //! Products ordered by their prices, see PriceIndex
+  using ProductGroup = PriceIndex<Product::Price, typename ProductTraits::ProductPtr,
+    std::pmr::polymorphic_allocator<typename ProductTraits::ProductPtr>>;
+
+  //! Element of the id index, see mProductsWithMetasById
+  struct ProductWithMeta;
+  struct IdOfProductWithMeta;
+
+  //! The id of a product is not duplicated in the index, it is read from the product itself,
+  //! unless the id is inline, see kIsIdInline
+  using ProductsById = FlatHashTable<ProductWithMeta, IdOfProductWithMeta, typename ProductTraits::IdHash,
+    std::equal_to<>, std::pmr::polymorphic_allocator<ProductWithMeta>>;
+
+  //! Reference bits of the products, see SetCapacity()
+  using ProductsClock = ClockRing<typename ProductTraits::ProductPtr,
+    std::pmr::polymorphic_allocator<typename ProductTraits::ProductPtr>>;
+
+  //! Expiry times of the products, in milliseconds of ExpiryClock, see ReapExpiredProducts()
+  using ExpiryWheel = TimerWheel<typename ProductTraits::ProductPtr,
+    std::pmr::polymorphic_allocator<typename ProductTraits::ProductPtr>>;
+
+  struct NameOfProduct
+  {
+    std::string_view operator()(const typename ProductTraits::ProductType &product) const
+    {
+      return ProductTraits::NameOf(product);
+    }
+  };
+
+  //! Products by their names, see EnableNameIndex()
+  using ProductsByName = NameIndex<typename ProductTraits::ProductPtr, NameOfProduct,
+    std::pmr::polymorphic_allocator<typename ProductTraits::ProductPtr>>;
+
+  //! Prices and producers of the products in dense arrays, see EnablePriceColumns()
+  using ProductColumns = PriceColumns<typename ProductTraits::ProductPtr,
+    std::pmr::polymorphic_allocator<typename ProductTraits::ProductPtr>>;
+
+  //! Locks of the mutex of the warehouse, which measure the operations if WAREHOUSE_STATS is defined
+  using ReadLock = MeasuredLock<typename LockingPolicy::ReadLock>;
+  using WriteLock = MeasuredLock<typename LockingPolicy::WriteLock>;
+
 public:
-  using ProductPtr = std::shared_ptr<const Product>;
+  using ProductType = typename ProductTraits::ProductType;
+  using ProductPtr = typename ProductTraits::ProductPtr;
+  using IdType = typename ProductTraits::IdType;
+
+  //! Compact handle of a producer interned by the warehouse, see GetProducerHandle()
+  using ProducerHandle = uint32_t;
+
+  //! Position inside the products of a producer to resume a paginated search from, see
+  //! FindProductsByProducer(std::string_view, const ProducerCursor&, size_t, OutputIt);
+  //! a default constructed cursor is before the first product
+  using ProducerCursor = typename ProductGroup::Cursor;
+
+  //! A producer with its products, see SnapshotProductsByProducer()
+  using ProducerProducts = std::pair<Product::Producer, std::vector<ProductPtr>>;
+
+  //! Clock of the expiry times of the products, see AddProduct(const ProductPtr&, ExpiryTime)
+  using ExpiryClock = std::chrono::steady_clock;
+
+  //! Default number of the products that ReapExpiredProducts() removes under one lock
+  static constexpr size_t kReapBatchSize = 64;
+  using ExpiryTime = ExpiryClock::time_point;
+
+  //! Loader of the products that the warehouse misses, see SetLoader(); it returns the product
+  //! with the given id or an empty smart pointer if there is no such product
+  using Loader = std::function<ProductPtr(IdType)>;
+
+  BasicWarehouse(): BasicWarehouse(std::pmr::get_default_resource()) {}
+
+  //! Create an empty warehouse that allocates from the given memory resource \p pMemoryResource
+  //!
+  //! \pre \p pMemoryResource is not null and outlives the warehouse and the products made by it
+  explicit BasicWarehouse(std::pmr::memory_resource *pMemoryResource):
+    mpMemoryResource(pMemoryResource),
+    mProducerHandles(pMemoryResource),
+    mProductsByProducer(pMemoryResource),
+    mProductsByPrice(pMemoryResource),
+    mProductsByName(pMemoryResource),
+    mPriceColumns(pMemoryResource),
+    mExpiries(pMemoryResource),
+    mProductsClock(pMemoryResource),
+    mProductsWithMetasById(pMemoryResource)
+  {
+    // pre-conditions
+    assert(pMemoryResource);
+  }
+
+  //! Create a copy of the warehouse \p other
+  //!
+  //! The products themselves are not copied, both warehouses share them. The copy allocates
+  //! from the default memory resource, as the copies of the standard pmr containers do.
+  //!
+  //! Algorithm's time complexity: O(N)
+  BasicWarehouse(const BasicWarehouse &other): BasicWarehouse(other, std::pmr::get_default_resource()) {}
+
+  //! Create a copy of the warehouse \p other that allocates from the given memory resource
+  //! \p pMemoryResource
+  //!
+  //! Algorithm's time complexity: the same as of the copy constructor
+  //!
+  //! \pre \p pMemoryResource is not null and outlives the warehouse and the products made by it
+  BasicWarehouse(const BasicWarehouse &other, std::pmr::memory_resource *pMemoryResource):
+    BasicWarehouse(pMemoryResource)
+  {
+    typename LockingPolicy::ReadLock lock(other.mMutex);
+
+    // The metas refer to the groups by producer handles and positions, so all indexes are
+    // copied as they are, without looking up any product or producer
+    mProducerHandles = other.mProducerHandles;
+    mProductsByProducer = other.mProductsByProducer;
+    mProductsByPrice = other.mProductsByPrice;
+    mIsNameIndexEnabled = other.mIsNameIndexEnabled;
+    mProductsByName = other.mProductsByName;
+    mIsPriceColumnsEnabled = other.mIsPriceColumnsEnabled;
+    mPriceColumns = other.mPriceColumns;
+    mExpiries = other.mExpiries;
+    mIsEvictionEnabled = other.mIsEvictionEnabled;
+    mProductsClock = other.mProductsClock;
+    mCapacity = other.mCapacity;
+    mProductsWithMetasById = other.mProductsWithMetasById;
+  }
+
+  //! Replace the content of the warehouse with a copy of the warehouse \p other
+  //!
+  //! Algorithm's time complexity: the same as of the copy constructor
+  BasicWarehouse& operator=(const BasicWarehouse &other)
+  {
+    if(this != &other)
+    {
+      // the copy allocates from the same resource, so the indexes can be swapped
+      BasicWarehouse copy(other, mpMemoryResource);
+
+      typename LockingPolicy::WriteLock lock(mMutex);
+      SwapIndexesUnlocked(copy);
+    }
+    return *this;
+  }
+
+  //! Make a product from the given arguments \p args, which initialize the fields of the product
+  //!
+  //! The product and the control block of its smart pointer are allocated at once from the
+  //! memory resource of the warehouse, see ProductTraits::Make(). The product is not added
+  //! to the warehouse.
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \return the smart pointer to the made product
+  template <typename... Args>
+  ProductPtr MakeProduct(Args&&... args) const
+  {
+    return ProductTraits::Make(mpMemoryResource, std::forward<Args>(args)...);
+  }
+
+  //! Memory resource that the warehouse allocates from
+  std::pmr::memory_resource* GetMemoryResource() const
+  {
+    return mpMemoryResource;
+  }
 
   //! Add the given product \p pProduct to the warehouse
   //! 
@@ -37,35 +367,341 @@ public:
   //! as id of the \p pProduct then \p pProduct will not be added.
   //!
   //! Algorithm's time complexity:
-  //! - average case: O(logN) 
+  //! - average case: O(logN) amortized
   //! - worst case:   O(N)
   //! 
   //! \pre \p pProduct is not an empty smart-pointer
   //!
   //! \return true if product was added, false otherwise
   bool AddProduct(const ProductPtr &pProduct)
+  {
+    WriteLock lock(mMutex, mStats, WarehouseOperation::AddProduct);
+    return AddProductUnlocked(pProduct);
+  }
+
+  //! Add the given product \p pProduct to the warehouse, which expires at the given time \p expiry
+  //!
+  //! The same as AddProduct(const ProductPtr&), but once the expiry time passes, the lookups by
+  //! id treat the product as absent, and ReapExpiredProducts() removes it. The queries of several
+  //! products, e.g. by producer or by price, return the expired products until they are removed.
+  //! A product that replaces an expiring one by UpsertProduct() or UpdatePrice() keeps the
+  //! expiry time.
+  //!
+  //! Algorithm's time complexity: the same as of AddProduct(const ProductPtr&)
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if product was added, false otherwise
+  bool AddProduct(const ProductPtr &pProduct, ExpiryTime expiry)
+  {
+    static_assert(kHasExpiryIndex, "the warehouse has no ByExpiryIndex");
+
+    WriteLock lock(mMutex, mStats, WarehouseOperation::AddProduct);
+    return AddProductUnlocked(pProduct, TickOf(expiry));
+  }
+
+  //! Remove at most \p maxCount products whose expiry times have passed, the earliest first
+  //!
+  //! The lock is taken once for the whole batch, so a small \p maxCount bounds the time that the
+  //! other threads wait for the warehouse. A background thread reaps all expired products by
+  //! calling the method until it removes less than \p maxCount products. The expiry times
+  //! are kept in a hierarchical timer wheel, so the products that have not expired are not
+  //! visited at all.
+  //!
+  //! Algorithm's time complexity, where K is \p maxCount:
+  //! - average case: O(K*logN)
+  //! - worst case:   O(K*N)
+  //!
+  //! \return number of removed products
+  size_t ReapExpiredProducts(size_t maxCount = kReapBatchSize)
+  {
+    static_assert(kHasExpiryIndex, "the warehouse has no ByExpiryIndex");
+
+    WriteLock lock(mMutex, mStats, WarehouseOperation::ReapExpiredProducts);
+
+    // Time complexity of the TimerWheel::Advance(): O(K) plus the cascading of the timers
+    return mExpiries.Advance(TickOf(ExpiryClock::now()), maxCount, [this](ProductPtr &&pProduct) {
+      auto it = mProductsWithMetasById.find(ProductTraits::IdOf(*pProduct));
+      assert(it != mProductsWithMetasById.end() && it->pProduct == pProduct);
+
+      // the timer has fired already, so the removal does not cancel it
+      it->expiryTimer = ExpiryWheel::kNoHandle;
+      EraseProductUnlocked(it);
+    });
+  }
+
+  //! Bound the warehouse by the number of the products \p maxProducts and by the estimated bytes
+  //! of the products and of their entries in the indexes \p maxBytes
+  //!
+  //! The first call starts tracking the use of the products, which are evicted by the CLOCK
+  //! approximation of LRU afterwards: every lookup by id marks the found product as used, and
+  //! when the warehouse exceeds its capacity, the products that were not used since the last
+  //! sweep over them are removed. Marking a product costs no write if it is marked already.
+  //! The eviction runs inside the modifying methods that add the products, so the warehouse is
+  //! never above its capacity after a call returns.
+  //!
+  //! The bytes of a product are estimated by its size and the lengths of its strings, see
+  //! EstimatedBytesOf(), so they are an approximation of the memory that the product takes.
+  //!
+  //! Algorithm's time complexity: O(N) for the first call, O(E) afterwards, where E is the number
+  //! of the evicted products
+  //!
+  //! \return number of the evicted products
+  size_t SetCapacity(size_t maxProducts, size_t maxBytes = std::numeric_limits<size_t>::max())
+  {
+    static_assert(kHasEvictionIndex, "the warehouse has no ByEvictionIndex");
+
+    typename LockingPolicy::WriteLock lock(mMutex);
+    if(!mIsEvictionEnabled)
+    {
+      EnableEvictionUnlocked();
+    }
+    mCapacity.maxProducts = maxProducts;
+    mCapacity.maxBytes = maxBytes;
+    return EvictUnlocked();
+  }
+
+  //! Set the loader \p loader of the products that the warehouse misses, see FindOrLoadProductById()
+  void SetLoader(Loader loader)
+  {
+    static_assert(kHasEvictionIndex, "the warehouse has no ByEvictionIndex");
+
+    std::lock_guard<std::mutex> lock(mReadThrough.mutex);
+    mReadThrough.loader = std::move(loader);
+  }
+
+  //! Find a product inside the warehouse by the given product id \p id, or load it on a miss
+  //!
+  //! A missing product is loaded by the loader, see SetLoader(), without the lock of the warehouse,
+  //! and then added to the warehouse, which may evict other products, see SetCapacity(). Concurrent
+  //! misses of the same id are deduplicated: the first one calls the loader and the others wait for
+  //! its result, so the backing store is asked once per id. An exception thrown by the loader is
+  //! rethrown to all of them, and nothing is added.
+  //!
+  //! Algorithm's time complexity: the same as of FindProductById() on a hit, plus the time of the
+  //! loader and of AddProduct() on a miss
+  //!
+  //! \return the smart pointer to the found or the loaded product, or an empty smart pointer if
+  //!   neither the warehouse nor the loader has the product, or there is no loader
+  ProductPtr FindOrLoadProductById(IdType id)
+  {
+    static_assert(kHasEvictionIndex, "the warehouse has no ByEvictionIndex");
+
+    if(ProductPtr pProduct = FindProductById(id))
+    {
+      return pProduct;
+    }
+
+    std::shared_ptr<std::promise<ProductPtr>> pPromise;
+    std::shared_future<ProductPtr> loaded;
+    Loader loader;
+    {
+      std::lock_guard<std::mutex> lock(mReadThrough.mutex);
+      auto it = mReadThrough.loads.find(id);
+      if(it != mReadThrough.loads.end())
+      {
+        loaded = it->second;
+      }
+      else
+      {
+        // another load of the product may have completed after the lookup above
+        if(ProductPtr pProduct = FindProductById(id))
+        {
+          return pProduct;
+        }
+        if(!mReadThrough.loader)
+        {
+          return ProductPtr();
+        }
+        pPromise = std::make_shared<std::promise<ProductPtr>>();
+        loaded = pPromise->get_future().share();
+        mReadThrough.loads.emplace(IdValue(id), loaded);
+        loader = mReadThrough.loader;
+      }
+    }
+    if(!pPromise)
+    {
+      return loaded.get();
+    }
+
+    auto finishLoad = [this, id]() {
+      std::lock_guard<std::mutex> lock(mReadThrough.mutex);
+      mReadThrough.loads.erase(mReadThrough.loads.find(id));
+    };
+    ProductPtr pProduct;
+    try
+    {
+      pProduct = loader(id);
+      if(pProduct)
+      {
+        // pre-conditions
+        assert(ProductTraits::IdOf(*pProduct) == id);
+
+        WriteLock lock(mMutex, mStats, WarehouseOperation::AddProduct);
+        if(!AddProductUnlocked(pProduct))
+        {
+          // the product was added by another method meanwhile
+          pProduct = mProductsWithMetasById.find(id)->pProduct;
+        }
+      }
+    }
+    catch(...)
+    {
+      finishLoad();
+      pPromise->set_exception(std::current_exception());
+      throw;
+    }
+    finishLoad();
+    pPromise->set_value(pProduct);
+    return pProduct;
+  }
+
+  //! Add the given product \p pProduct to the warehouse or replace the product with the same id
+  //!
+  //! The product is replaced in place under a single lock, so it is never missing for other
+  //! threads. The index of the producers is changed only if the producer of the product changed.
+  //! The holders of the replaced product keep it unchanged.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(logN) amortized
+  //! - worst case:   O(N)
+  //!
+  //! \pre \p pProduct is not an empty smart-pointer
+  //!
+  //! \return true if the product was added, false if it replaced the product with the same id
+  bool UpsertProduct(const ProductPtr &pProduct)
   {
     // pre-conditions
     assert(pProduct);
 
-    std::lock_guard<std::mutex> lock(mMutex);
+    WriteLock lock(mMutex, mStats, WarehouseOperation::UpsertProduct);
 
-    // Time complexity of the std::unordered_map::emplace(): 
-    // - average: O(1)
+    // Time complexity of the FlatHashTable::try_emplace():
+    // - average: O(1) amortized
     // - worst:   O(N)
-    auto [it, success] = mProductsWithMetasById.emplace(pProduct->id, ProductWithMeta(pProduct));
+    auto [it, success] = mProductsWithMetasById.try_emplace(ProductTraits::IdOf(*pProduct), pProduct);
     if(success)
     {
-      // Time complexity of the std::multimap::emplace(): O(logN)
-      it->second.meta.it_productsByProducer = 
-        mProductsByProducer.emplace(pProduct->producer, pProduct);
+      IndexAddedProductUnlocked(*it);
+    }
+    else
+    {
+      ReplaceProductUnlocked(*it, pProduct);
+
+      // the expired product counts as absent, so the new product does not expire
+      if(IsExpiredUnlocked(*it))
+      {
+        SetExpiryUnlocked(*it, kNeverExpires);
+        success = true;
+      }
     }
+    EvictUnlocked();
     return success;
 
     // Time complexity of the method:
-    // - average: O(1) + O(logN) = O(logN)
+    // - average: O(1) + O(logN) = O(logN) amortized
+    // - worst:   O(N) + O(logN) = O(N)
+  }
+
+  //! Change the price of the product with the given id \p id to \p price
+  //!
+  //! The product is replaced by its copy with the new price, see UpsertProduct(), so the holders
+  //! of the product keep it unchanged.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(logN) amortized
+  //! - worst case:   O(N)
+  //!
+  //! \return true if the warehouse has the product with the given id, false otherwise
+  bool UpdatePrice(IdType id, Product::Price price)
+  {
+    WriteLock lock(mMutex, mStats, WarehouseOperation::UpdatePrice);
+
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(N)
+    auto it = mProductsWithMetasById.find(id);
+    if(it == mProductsWithMetasById.end() || IsExpiredUnlocked(*it))
+    {
+      return false;
+    }
+
+    const ProductType &product = *it->pProduct;
+    if(ProductTraits::PriceOf(product) != price)
+    {
+      ReplaceProductUnlocked(*it, ProductTraits::MakeFromStrings(mpMemoryResource, ProductTraits::IdOf(product),
+        ProductTraits::ProducerOf(product), ProductTraits::NameOf(product), price));
+    }
+    return true;
+
+    // Time complexity of the method:
+    // - average: O(1) + O(logN) = O(logN) amortized
     // - worst:   O(N) + O(logN) = O(N)
   }
+
+  //! Add the products of the range [\p first, \p last) to the warehouse
+  //!
+  //! The result is the same as of calling AddProduct() for every product of the range in
+  //! order, but the lock is taken only once. If the warehouse is empty, the producer index
+  //! is built by sorting the added products instead of inserting them one by one.
+  //!
+  //! \param[in] first, last range of the products to add
+  //! \param[out] added out-iterator to which per product of the range, in the same order,
+  //!   true is written if the product was added and false otherwise
+  //!
+  //! Algorithm's time complexity, where K is number of products in the range:
+  //! - average case: O(K*logN) amortized, or O(K*logK) if the warehouse is empty
+  //! - worst case:   O(K*(N+K))
+  //!
+  //! \pre no product of the range is an empty smart-pointer
+  //!
+  //! \return number of added products
+  template <typename InputIt, typename OutputIt>
+  size_t AddProducts(InputIt first, InputIt last, OutputIt added)
+  {
+    WriteLock lock(mMutex, mStats, WarehouseOperation::AddProducts);
+
+    if(mProductsWithMetasById.empty())
+    {
+      size_t cntAdded = 0;
+      if constexpr(IsForwardIterator<InputIt>)
+      {
+        cntAdded = BulkLoadUnlocked(first, last, added);
+      }
+      else
+      {
+        const std::vector<ProductPtr> products(first, last);
+        cntAdded = BulkLoadUnlocked(products.begin(), products.end(), added);
+      }
+      EvictUnlocked();
+      return cntAdded;
+    }
+
+    if constexpr(IsForwardIterator<InputIt>)
+    {
+      mProductsWithMetasById.reserve(mProductsWithMetasById.size() + std::distance(first, last));
+    }
+
+    size_t cntAdded = 0;
+    for(; first != last; ++first)
+    {
+      const bool success = AddProductUnlocked(*first);
+      *added++ = success;
+      cntAdded += success;
+    }
+    return cntAdded;
+  }
+
+  //! Add the products of the range [\p first, \p last) to the warehouse
+  //!
+  //! The same as AddProducts(first, last, added), but without per product results.
+  //!
+  //! \return number of added products
+  template <typename InputIt>
+  size_t AddProducts(InputIt first, InputIt last)
+  {
+    return AddProducts(first, last, DiscardIterator{});
+  }
   
   //! Find a product inside the warehouse by the given product id \p id
   //! 
@@ -76,115 +712,2027 @@ public:
   //! \return if the product with the given id \p id is presented inside the warehouse then 
   //!   the smart pointer to this product will be returned, 
   //!   otherwise an empty smart pointer will be returned 
-  ProductPtr FindProductById(const Product::Id &id) const
+  ProductPtr FindProductById(IdType id) const
   {
-    std::lock_guard<std::mutex> lock(mMutex);
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductById);
 
-    // Time complexity of the std::unordered_map::find(key):
+    // Time complexity of the FlatHashTable::find(key):
     // - average: O(1)
     // - worst:   O(N)
     auto it = mProductsWithMetasById.find(id);
-    return (it != mProductsWithMetasById.end())? it->second.pProduct : ProductPtr();
+    if(it == mProductsWithMetasById.end() || IsExpiredUnlocked(*it))
+    {
+      return ProductPtr();
+    }
+    TouchUnlocked(*it);
+    return it->pProduct;
 
     // Time complexity of the method:
     // - average: O(1)
     // - worst:   O(N) 
   }
 
-  //! Find inside the warehouse all products of the given producer \p producer.
-  //! 
-  //! \param[in] producer producer of the products
-  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //! Visit a product inside the warehouse with the given product id \p id
+  //!
+  //! Unlike FindProductById() no smart pointer is copied, so no reference counter is touched.
+  //!
+  //! \param[in] id id of the product
+  //! \param[in] visitor callable that is invoked as visitor(const ProductType&) with the found
+  //!   product (if any); it is invoked under the lock of the warehouse, hence it must not call
+  //!   methods of the warehouse
   //!
   //! Algorithm's time complexity:
-  //! - average case: O(max(logN,M)), where M is number of products of the given producer
+  //! - average case: O(1) 
   //! - worst case:   O(N)
-  //! 
-  //! \return number of found products
-  template <typename OutputIt>
-  size_t FindProductsByProducer(const Product::Producer &producer, OutputIt out) const
-  { 
-    std::lock_guard<std::mutex> lock(mMutex);
+  //!
+  //! \return true if the product was found and visited, false otherwise
+  template <typename Visitor>
+  bool VisitProductById(IdType id, Visitor &&visitor) const
+  {
+    ReadLock lock(mMutex, mStats, WarehouseOperation::VisitProductById);
 
-    // Time complexity of the std::multimap::equal_range(key): O(logN)
-    auto range = mProductsByProducer.equal_range(producer);
-    
-    // Time complexity of copying: O(M), where M - number of products of the given producer
-    // Relation between M and N: 0 <= M <= N
-    size_t cntFound = 0;
-    while(range.first != range.second)
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(N)
+    auto it = mProductsWithMetasById.find(id);
+    if(it == mProductsWithMetasById.end() || IsExpiredUnlocked(*it))
     {
-      *out++ = (range.first++)->second;
-      cntFound++; 
+      return false;
     }
-    return cntFound; 
 
-    // Time complexity of the method:
-    // - average: O(logN) + O(M) = O(max(logN, M))
-    // - worst:   O(logN) + O(N) = O(N)
+    TouchUnlocked(*it);
+    visitor(static_cast<const ProductType&>(*it->pProduct));
+    return true;
   }
 
-  //! Remove the product with given id \p id from the warehouse
-  //! 
-  //! In case the product with the given id is not presented in the warehouse the state
-  //! of the warehouse will not be changed
+  //! Find inside the warehouse the products with the ids of the range [\p first, \p last)
   //!
-  //! Algorithm's time complexity:
-  //! - average case: O(1) 
-  //! - worst case:   O(N)
+  //! The result is the same as of calling FindProductById() for every id of the range in order,
+  //! but the lock is taken only once. The ids are hashed before taking the lock, and the parts
+  //! of the id index probed by the next ids are prefetched while an id is looked up, so the
+  //! cache misses of the lookups overlap each other.
   //!
-  //! \post @returned is 0 or 1
-  //! 
-  //! \return the number of removed products, which is either 1 or 0
-  size_t RemoveProductById(const Product::Id &id)
-  {  
-    std::lock_guard<std::mutex> lock(mMutex);
+  //! \param[in] first, last range of the ids of the products, which are convertible to IdType
+  //! \param[out] out out-iterator to which per id of the range, in the same order, the smart
+  //!   pointer to the found product or an empty smart pointer would be written
+  //!
+  //! Algorithm's time complexity, where K is number of ids in the range:
+  //! - average case: O(K)
+  //! - worst case:   O(K*N)
+  //!
+  //! \return number of found products
+  template <typename ForwardIt, typename OutputIt>
+  size_t FindProductsByIds(ForwardIt first, ForwardIt last, OutputIt out) const
+  {
+    // Time complexity of hashing: O(K)
+    std::vector<size_t> hashes;
+    hashes.reserve(std::distance(first, last));
+    for(ForwardIt it = first; it != last; ++it)
+    {
+      hashes.push_back(typename ProductTraits::IdHash()(IdType(*it)));
+    }
 
-    // Time complexity of the std::unordered_map::find(key):
-    // - average: O(1)
-    // - worst:   O(N)
-    auto it = mProductsWithMetasById.find(id);
-    if (it == mProductsWithMetasById.end()) 
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByIds);
+
+    for(size_t i = 0; i < std::min(kPrefetchDistance, hashes.size()); ++i)
     {
-      return 0;
+      mProductsWithMetasById.prefetch(hashes[i]);
     }
 
-    // Time complexity of the std::multimap::erase(iterator):
+    // Time complexity of the FlatHashTable::find_with_hash() per id:
     // - average: O(1)
     // - worst:   O(N)
-    mProductsByProducer.erase(it->second.meta.it_productsByProducer);
+    size_t cntFound = 0;
+    for(size_t i = 0; first != last; ++first, ++i)
+    {
+      if(i + kPrefetchDistance < hashes.size())
+      {
+        mProductsWithMetasById.prefetch(hashes[i + kPrefetchDistance]);
+      }
 
-    // Time complexity of the std::unordered_map::erase(iterator):
-    // - average: O(1)
+      auto it = mProductsWithMetasById.find_with_hash(hashes[i], IdType(*first));
+      if(it != mProductsWithMetasById.end() && !IsExpiredUnlocked(*it))
+      {
+        TouchUnlocked(*it);
+        *out++ = it->pProduct;
+        ++cntFound;
+      }
+      else
+      {
+        *out++ = ProductPtr();
+      }
+    }
+    return cntFound;
+
+    // Time complexity of the method:
+    // - average: O(K) + O(K) = O(K)
+    // - worst:   O(K) + O(K*N) = O(K*N)
+  }
+
+  //! Find inside the warehouse all products of the given producer \p producer.
+  //! 
+  //! \param[in] producer producer of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(M), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //! 
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, OutputIt out) const
+  { 
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByProducer);
+
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(P), where P - number of producers, 0 <= P <= N
+    auto it = mProducerHandles.find(producer);
+    if(it == mProducerHandles.end())
+    {
+      return 0;
+    }
+    
+    // Time complexity of copying: O(M), where M - number of products of the given producer
+    // Relation between M and N: 0 <= M <= N
+    const ProductGroup &products = mProductsByProducer[it->handle];
+    products.ForEach([&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+    mStats.RecordProducerResultSize(products.size());
+    return products.size(); 
+
+    // Time complexity of the method:
+    // - average: O(1) + O(M) = O(M)
+    // - worst:   O(P) + O(M) = O(N)
+  }
+
+  //! Find inside the warehouse all products of the producer with the given handle \p producer.
+  //!
+  //! Unlike FindProductsByProducer(const Product::Producer&, OutputIt), the producer is not
+  //! hashed and looked up, so hot callers can resolve the handle once and reuse it.
+  //!
+  //! \param[in] producer handle of the producer of the products, see GetProducerHandle()
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity: O(M), where M is number of products of the given producer
+  //! 
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(ProducerHandle producer, OutputIt out) const
+  { 
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByProducer);
+
+    if(producer >= mProductsByProducer.size())
+    {
+      return 0;
+    }
+
+    const ProductGroup &products = mProductsByProducer[producer];
+    products.ForEach([&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+    mStats.RecordProducerResultSize(products.size());
+    return products.size(); 
+  }
+
+  //! Find inside the warehouse at most \p limit products of the given producer \p producer,
+  //! which follow the given cursor \p cursor.
+  //!
+  //! The products are found in the ascending order of the prices, so all products of a large
+  //! producer can be read in chunks, while the lock is held only for a chunk at a time.
+  //! The cursor does not refer to a product, so it stays valid whatever is modified between
+  //! the calls: every product that is neither added nor removed between the calls is found
+  //! exactly once, the added and removed ones may or may not be found.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] cursor cursor to resume from, a default constructed one starts from the first product
+  //! \param[in] limit maximal number of products to find
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(logM + limit), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //!
+  //! \return cursor after the last found product, which is at the end (see AtEnd())
+  //!   if the producer has no more products after it
+  template <typename OutputIt>
+  ProducerCursor FindProductsByProducer(std::string_view producer, const ProducerCursor &cursor, size_t limit,
+    OutputIt out) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByProducer);
+
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(P), where P - number of producers, 0 <= P <= N
+    auto it = mProducerHandles.find(producer);
+    if(it == mProducerHandles.end())
+    {
+      return ProducerCursor::End();
+    }
+
+    // Time complexity of the PriceIndex::ForEachFrom(): O(logM + limit)
+    return mProductsByProducer[it->handle].ForEachFrom(cursor, limit,
+      [&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+
+    // Time complexity of the method:
+    // - average: O(1) + O(logM + limit) = O(logM + limit)
+    // - worst:   O(P) + O(logM + limit) = O(N)
+  }
+
+  //! Find inside the warehouse at most \p limit products of the producer with the given
+  //! handle \p producer, which follow the given cursor \p cursor.
+  //!
+  //! The same as FindProductsByProducer(std::string_view, const ProducerCursor&, size_t, OutputIt),
+  //! but without looking up the producer.
+  //!
+  //! Algorithm's time complexity: O(logM + limit), where M is number of products of the given producer
+  //!
+  //! \return cursor after the last found product
+  template <typename OutputIt>
+  ProducerCursor FindProductsByProducer(ProducerHandle producer, const ProducerCursor &cursor, size_t limit,
+    OutputIt out) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByProducer);
+
+    if(producer >= mProductsByProducer.size())
+    {
+      return ProducerCursor::End();
+    }
+
+    return mProductsByProducer[producer].ForEachFrom(cursor, limit,
+      [&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+  }
+
+  //! Find inside the warehouse all products of the given producer \p producer with the prices
+  //! from the range [\p priceLo, \p priceHi].
+  //!
+  //! The products of every producer are ordered by their prices, so only the found products
+  //! are visited.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] priceLo, priceHi the lowest and the highest price of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in the ascending order of the prices
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(logM + K), where M is number of products of the given producer and
+  //!   K is number of found products
+  //! - worst case:   O(N)
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(std::string_view producer, Product::Price priceLo, Product::Price priceHi,
+    OutputIt out) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByProducer);
+
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(P), where P - number of producers, 0 <= P <= N
+    auto it = mProducerHandles.find(producer);
+    if(it == mProducerHandles.end())
+    {
+      return 0;
+    }
+
+    // Time complexity of the PriceIndex::ForEachInRange(): O(logM + K)
+    const size_t cntFound = mProductsByProducer[it->handle].ForEachInRange(priceLo, priceHi,
+      [&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+    mStats.RecordProducerResultSize(cntFound);
+    return cntFound;
+
+    // Time complexity of the method:
+    // - average: O(1) + O(logM + K) = O(logM + K)
+    // - worst:   O(P) + O(logM + K) = O(N)
+  }
+
+  //! Find inside the warehouse all products of the producer with the given handle \p producer
+  //! with the prices from the range [\p priceLo, \p priceHi].
+  //!
+  //! The same as FindProductsByProducer(std::string_view, Product::Price, Product::Price, OutputIt),
+  //! but without looking up the producer.
+  //!
+  //! Algorithm's time complexity: O(logM + K), where M is number of products of the given
+  //! producer and K is number of found products
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByProducer(ProducerHandle producer, Product::Price priceLo, Product::Price priceHi,
+    OutputIt out) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByProducer);
+
+    if(producer >= mProductsByProducer.size())
+    {
+      return 0;
+    }
+
+    const size_t cntFound = mProductsByProducer[producer].ForEachInRange(priceLo, priceHi,
+      [&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+    mStats.RecordProducerResultSize(cntFound);
+    return cntFound;
+  }
+
+  //! Find inside the warehouse all products with the prices from the range [\p priceLo, \p priceHi].
+  //!
+  //! \param[in] priceLo, priceHi the lowest and the highest price of the products
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in the ascending order of the prices
+  //!
+  //! Algorithm's time complexity: O(logN + K), where K is number of found products
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByPriceRange(Product::Price priceLo, Product::Price priceHi, OutputIt out) const
+  {
+    static_assert(kHasPriceIndex, "the warehouse has no ByPriceIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByPriceRange);
+
+    return mProductsByPrice.ForEachInRange(priceLo, priceHi,
+      [&out](const typename ProductGroup::Entry &entry) { *out++ = entry.ptr; });
+  }
+
+  //! Build the index of the names of the products, which is maintained by the modifications
+  //! of the warehouse afterwards, see FindProductsByNamePrefix() and FindProductsByNameSubstring()
+  //!
+  //! The index takes a slot, an entry ordered by the name and a posting list entry per trigram
+  //! of the name for every product, so it is built only on demand. Once enabled, the index is
+  //! kept until the warehouse is destroyed, and it is copied together with the warehouse.
+  //!
+  //! Algorithm's time complexity: O(N*L*logL + N*logN), where L is the length of the longest name
+  void EnableNameIndex()
+  {
+    static_assert(kHasNameIndex, "the warehouse has no ByNameIndex");
+
+    typename LockingPolicy::WriteLock lock(mMutex);
+    if(mIsNameIndexEnabled)
+    {
+      return;
+    }
+
+    std::vector<ProductWithMeta*> products;
+    products.reserve(mProductsWithMetasById.size());
+    for(ProductWithMeta &productWithMeta : mProductsWithMetasById)
+    {
+      products.push_back(&productWithMeta);
+    }
+    mIsNameIndexEnabled = true;
+    BuildNameIndexUnlocked(products);
+  }
+
+  //! Whether the index of the names is enabled, see EnableNameIndex()
+  bool IsNameIndexEnabled() const
+  {
+    typename LockingPolicy::ReadLock lock(mMutex);
+    return mIsNameIndexEnabled;
+  }
+
+  //! Find inside the warehouse at most \p limit products whose names start with the given
+  //! prefix \p prefix
+  //!
+  //! The names are compared byte by byte. Without the index of the names, see EnableNameIndex(),
+  //! all products are scanned.
+  //!
+  //! \param[in] prefix prefix of the names of the products
+  //! \param[in] limit the maximal number of products to find
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in the order of their names
+  //!
+  //! Algorithm's time complexity, where K is number of found products:
+  //! - with the name index: O(logN + K)
+  //! - without it:          O(N*L + M*logK), where M is number of products with the prefix
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByNamePrefix(std::string_view prefix, size_t limit, OutputIt out) const
+  {
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByNamePrefix);
+
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled)
+      {
+        return mProductsByName.ForEachWithPrefix(prefix, limit,
+          [&out](const ProductPtr &pProduct) { *out++ = pProduct; });
+      }
+    }
+
+    // the products are ordered as by the name index: by the names and then by the addresses
+    std::vector<const ProductPtr*> found;
+    for(const ProductWithMeta &productWithMeta : mProductsWithMetasById)
+    {
+      if(ProductTraits::NameOf(*productWithMeta.pProduct).substr(0, prefix.size()) == prefix)
+      {
+        found.push_back(&productWithMeta.pProduct);
+      }
+    }
+    const size_t cntFound = std::min(limit, found.size());
+    std::partial_sort(found.begin(), found.begin() + cntFound, found.end(),
+      [](const ProductPtr *pLhs, const ProductPtr *pRhs) {
+        const std::string_view lhsName = ProductTraits::NameOf(**pLhs);
+        const std::string_view rhsName = ProductTraits::NameOf(**pRhs);
+        return (lhsName != rhsName)? lhsName < rhsName : std::less<const void*>()(pLhs->get(), pRhs->get());
+      });
+    for(size_t i = 0; i < cntFound; ++i)
+    {
+      *out++ = *found[i];
+    }
+    return cntFound;
+  }
+
+  //! Find inside the warehouse at most \p limit products whose names contain the given
+  //! substring \p substring
+  //!
+  //! The names are compared byte by byte. Without the index of the names, see EnableNameIndex(),
+  //! all products are scanned, as they are for the substrings shorter than 3 bytes with the index.
+  //!
+  //! \param[in] substring substring of the names of the products
+  //! \param[in] limit the maximal number of products to find
+  //! \param[out] out out-iterator to which the found products (if any) would be copied
+  //!   in an unspecified order
+  //!
+  //! Algorithm's time complexity:
+  //! - with the name index: O(L*logL + T*S*L), where L is length of the substring, T is number
+  //!   of its trigrams and S is number of products with its rarest trigram, see NameIndex
+  //! - without it:          O(N*L)
+  //!
+  //! \return number of found products
+  template <typename OutputIt>
+  size_t FindProductsByNameSubstring(std::string_view substring, size_t limit, OutputIt out) const
+  {
+    ReadLock lock(mMutex, mStats, WarehouseOperation::FindProductsByNameSubstring);
+
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled)
+      {
+        return mProductsByName.ForEachWithSubstring(substring, limit,
+          [&out](const ProductPtr &pProduct) { *out++ = pProduct; });
+      }
+    }
+
+    size_t cntFound = 0;
+    for(auto it = mProductsWithMetasById.begin(); it != mProductsWithMetasById.end() && cntFound < limit; ++it)
+    {
+      if(ProductTraits::NameOf(*it->pProduct).find(substring) != std::string_view::npos)
+      {
+        *out++ = it->pProduct;
+        ++cntFound;
+      }
+    }
+    return cntFound;
+  }
+
+  //! Visit inside the warehouse all products of the given producer \p producer.
+  //!
+  //! Unlike FindProductsByProducer() no smart pointer is copied, so no reference counter is touched.
+  //!
+  //! \param[in] producer producer of the products
+  //! \param[in] visitor callable that is invoked as visitor(const ProductType&) with every found
+  //!   product in the ascending order of the prices; it is invoked under the lock of the
+  //!   warehouse, hence it must not call methods of the warehouse
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(M), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProductOfProducer(std::string_view producer, Visitor &&visitor) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::ForEachProductOfProducer);
+
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(P), where P - number of producers, 0 <= P <= N
+    auto it = mProducerHandles.find(producer);
+    if(it == mProducerHandles.end())
+    {
+      return 0;
+    }
+
+    // Time complexity of visiting: O(M)
+    const ProductGroup &products = mProductsByProducer[it->handle];
+    products.ForEach([&visitor](const typename ProductGroup::Entry &entry) {
+      visitor(static_cast<const ProductType&>(*entry.ptr));
+    });
+    return products.size();
+
+    // Time complexity of the method:
+    // - average: O(1) + O(M) = O(M)
+    // - worst:   O(P) + O(M) = O(N)
+  }
+
+  //! Visit inside the warehouse all products of the producer with the given handle \p producer.
+  //!
+  //! The same as ForEachProductOfProducer(std::string_view, Visitor&&), but without looking up
+  //! the producer.
+  //!
+  //! Algorithm's time complexity: O(M), where M is number of products of the given producer
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProductOfProducer(ProducerHandle producer, Visitor &&visitor) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::ForEachProductOfProducer);
+
+    if(producer >= mProductsByProducer.size())
+    {
+      return 0;
+    }
+
+    const ProductGroup &products = mProductsByProducer[producer];
+    products.ForEach([&visitor](const typename ProductGroup::Entry &entry) {
+      visitor(static_cast<const ProductType&>(*entry.ptr));
+    });
+    return products.size();
+  }
+
+  //! Build the columns of the prices of the products, which are maintained by the modifications
+  //! of the warehouse afterwards, see GetPriceStats() and GetPriceHistogram()
+  //!
+  //! The columns take 4 bytes for the price and a smart pointer per product. They are kept until
+  //! the warehouse is destroyed, and they are copied together with the warehouse.
+  //!
+  //! Algorithm's time complexity: O(N)
+  void EnablePriceColumns()
+  {
+    static_assert(kHasPriceIndex, "the warehouse has no ByPriceIndex");
+
+    typename LockingPolicy::WriteLock lock(mMutex);
+    if(mIsPriceColumnsEnabled)
+    {
+      return;
+    }
+
+    std::vector<ProductWithMeta*> products;
+    products.reserve(mProductsWithMetasById.size());
+    for(ProductWithMeta &productWithMeta : mProductsWithMetasById)
+    {
+      products.push_back(&productWithMeta);
+    }
+    mIsPriceColumnsEnabled = true;
+    BuildPriceColumnsUnlocked(products);
+  }
+
+  //! Whether the columns of the prices are enabled, see EnablePriceColumns()
+  bool IsPriceColumnsEnabled() const
+  {
+    typename LockingPolicy::ReadLock lock(mMutex);
+    return mIsPriceColumnsEnabled;
+  }
+
+  //! Get the count, the lowest, the highest and the sum of the prices of all products
+  //!
+  //! With the columns of the prices, see EnablePriceColumns(), the prices are scanned as
+  //! a dense array (by AVX2 if it is available), otherwise the price index is scanned.
+  //!
+  //! Algorithm's time complexity: O(N)
+  //!
+  //! \return the stats of the prices, whose count is 0 for the empty warehouse
+  PriceStats GetPriceStats() const
+  {
+    static_assert(kHasPriceIndex, "the warehouse has no ByPriceIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::GetPriceStats);
+
+    if(mIsPriceColumnsEnabled)
+    {
+      return mPriceColumns.Stats();
+    }
+
+    PriceStats stats;
+    mProductsByPrice.ForEach([&stats](const typename ProductGroup::Entry &entry) { stats.Add(entry.price); });
+    return stats;
+  }
+
+  //! Get the stats of the prices of the products of the given producer \p producer, see GetPriceStats()
+  //!
+  //! The group of the producer keeps the prices of its products, so it is scanned even with
+  //! the columns of the prices, which would be scanned as a whole.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(M), where M is number of products of the given producer
+  //! - worst case:   O(N)
+  //!
+  //! \return the stats of the prices, whose count is 0 for an unknown producer
+  PriceStats GetPriceStats(std::string_view producer) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::GetPriceStats);
+
+    PriceStats stats;
+    auto it = mProducerHandles.find(producer);
+    if(it != mProducerHandles.end())
+    {
+      mProductsByProducer[it->handle].ForEach([&stats](const typename ProductGroup::Entry &entry) {
+        stats.Add(entry.price);
+      });
+    }
+    return stats;
+  }
+
+  //! Get the stats of the prices of the products of every producer, see GetPriceStats()
+  //!
+  //! The groups of the producers are scanned one after another even with the columns of the
+  //! prices: the groups keep the prices of their products already, while spreading the dense
+  //! prices over the producers would be bound by the random updates of their stats.
+  //!
+  //! Algorithm's time complexity: O(N + P*logP), where P is number of producers
+  //!
+  //! \return the producers with products in the order of their names, every one with its stats
+  std::vector<std::pair<Product::Producer, PriceStats>> GetPriceStatsByProducer() const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    std::vector<std::pair<Product::Producer, PriceStats>> statsByProducer;
+    {
+      ReadLock lock(mMutex, mStats, WarehouseOperation::GetPriceStatsByProducer);
+
+      for(const ProducerEntry &producerEntry : mProducerHandles)
+      {
+        const ProductGroup &products = mProductsByProducer[producerEntry.handle];
+        if(products.empty())
+        {
+          continue;
+        }
+        PriceStats stats;
+        products.ForEach([&stats](const typename ProductGroup::Entry &entry) { stats.Add(entry.price); });
+        statsByProducer.emplace_back(producerEntry.producer, stats);
+      }
+    }
+
+    // Time complexity of sorting: O(P*logP), the lock is not held any more
+    std::sort(statsByProducer.begin(), statsByProducer.end(),
+      [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+    return statsByProducer;
+  }
+
+  //! Get the histogram of the prices of all products with the given bounds \p bounds of its buckets
+  //!
+  //! The bucket 0 counts the prices below bounds[0], the bucket i the prices of the range
+  //! [bounds[i - 1], bounds[i]) and the last bucket the prices from bounds.back().
+  //! With the columns of the prices, the prices are compared without branches (by AVX2 if it
+  //! is available), otherwise the price index is scanned in the ascending order of the prices.
+  //!
+  //! Algorithm's time complexity, where B is number of the bounds:
+  //! - with the columns: O(N*B), see PriceColumns::AddHistogram()
+  //! - without them:     O(N + B)
+  //!
+  //! \pre \p bounds are sorted in the ascending order
+  //!
+  //! \return bounds.size() + 1 counts of the products of the buckets
+  std::vector<size_t> GetPriceHistogram(const std::vector<Product::Price> &bounds) const
+  {
+    static_assert(kHasPriceIndex, "the warehouse has no ByPriceIndex");
+
+    // pre-conditions
+    assert(std::is_sorted(bounds.begin(), bounds.end()));
+
+    std::vector<size_t> counts(bounds.size() + 1, 0);
+    ReadLock lock(mMutex, mStats, WarehouseOperation::GetPriceHistogram);
+
+    if(mIsPriceColumnsEnabled)
+    {
+      mPriceColumns.AddHistogram(bounds, counts);
+      return counts;
+    }
+
+    size_t bucket = 0;
+    mProductsByPrice.ForEach([&](const typename ProductGroup::Entry &entry) {
+      while(bucket < bounds.size() && bounds[bucket] <= entry.price)
+      {
+        ++bucket;
+      }
+      counts[bucket]++;
+    });
+    return counts;
+  }
+
+  //! Take a consistent snapshot of all products of the warehouse
+  //!
+  //! The snapshot is taken under a single lock, and the products are immutable, so it is the
+  //! state of the warehouse at one moment whatever is modified afterwards.
+  //!
+  //! Algorithm's time complexity: O(N)
+  //!
+  //! \return the smart pointers to all products in an unspecified order
+  std::vector<ProductPtr> SnapshotProducts() const
+  {
+    std::vector<ProductPtr> products;
+    ReadLock lock(mMutex, mStats, WarehouseOperation::SnapshotProducts);
+
+    products.reserve(mProductsWithMetasById.size());
+    for(const ProductWithMeta &productWithMeta : mProductsWithMetasById)
+    {
+      products.push_back(productWithMeta.pProduct);
+    }
+    return products;
+  }
+
+  //! Take a consistent snapshot of all products of the warehouse grouped by their producers,
+  //! see SnapshotProducts()
+  //!
+  //! Algorithm's time complexity: O(N + P*logP), where P is number of producers
+  //!
+  //! \return the producers with products in the order of their names, every one with the smart
+  //!   pointers to its products in the ascending order of the prices
+  std::vector<ProducerProducts> SnapshotProductsByProducer() const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    std::vector<ProducerProducts> producers;
+    {
+      ReadLock lock(mMutex, mStats, WarehouseOperation::SnapshotProductsByProducer);
+
+      for(const ProducerEntry &producerEntry : mProducerHandles)
+      {
+        const ProductGroup &products = mProductsByProducer[producerEntry.handle];
+        if(products.empty())
+        {
+          continue;
+        }
+        producers.emplace_back(producerEntry.producer, std::vector<ProductPtr>());
+        producers.back().second.reserve(products.size());
+        products.ForEach([&producers](const typename ProductGroup::Entry &entry) {
+          producers.back().second.push_back(entry.ptr);
+        });
+      }
+    }
+
+    // Time complexity of sorting: O(P*logP), the lock is not held any more
+    std::sort(producers.begin(), producers.end(),
+      [](const ProducerProducts &lhs, const ProducerProducts &rhs) { return lhs.first < rhs.first; });
+    return producers;
+  }
+
+  //! Visit all products of the warehouse by the threads of the given policy \p policy
+  //!
+  //! The visited products are a snapshot taken by SnapshotProducts(), so the lock is held only
+  //! to copy the smart pointers and the visitor may call methods of the warehouse, but it does
+  //! not see their effects. The snapshot is visited in chunks, see ScanPolicy.
+  //!
+  //! \param[in] policy number of threads and size of the chunks, e.g. kSequentialScan or kParallelScan
+  //! \param[in] visitor callable that is invoked as visitor(const ProductType&) with every product
+  //!   in an unspecified order; with more than one thread it is invoked concurrently, hence it
+  //!   must be thread-safe
+  //!
+  //! Algorithm's time complexity: O(N) for the snapshot plus O(N/T) visits, where T is number
+  //!   of threads
+  //!
+  //! \return number of visited products
+  template <typename Visitor>
+  size_t ForEachProduct(const ScanPolicy &policy, Visitor &&visitor) const
+  {
+    const std::vector<ProductPtr> products = SnapshotProducts();
+    ScanInChunks(policy, products, [&visitor](const ProductPtr &pProduct) {
+      visitor(static_cast<const ProductType&>(*pProduct));
+    });
+    return products.size();
+  }
+
+  //! Fold the products of every producer of the warehouse by the threads of the given policy \p policy
+  //!
+  //! The folded products are a snapshot taken by SnapshotProductsByProducer(), see ForEachProduct().
+  //! Every producer is folded by a single thread as acc = fold(std::move(acc), product), starting
+  //! from a copy of \p init and in the ascending order of the prices, so no partial results
+  //! are combined; the threads fold distinct producers, the largest ones first.
+  //!
+  //! \param[in] policy number of threads, see ScanPolicy; the chunks are the producers
+  //! \param[in] init initial value of the fold of every producer
+  //! \param[in] fold callable that is invoked as fold(T&&, const ProductType&) and returns T;
+  //!   with more than one thread it is invoked concurrently for distinct producers
+  //!
+  //! Algorithm's time complexity: O(N + P*logP) for the snapshot plus O(N/T) folds at best and
+  //!   O(M) at worst, where M is number of products of the largest producer
+  //!
+  //! \return the producers with products in the order of their names, every one with its fold
+  template <typename T, typename Fold>
+  std::vector<std::pair<Product::Producer, T>> AggregateByProducer(const ScanPolicy &policy, const T &init,
+    Fold &&fold) const
+  {
+    return FoldGroups(policy, SnapshotProductsByProducer(), init, [&fold](T &&acc, const ProductPtr &pProduct) {
+      return fold(std::move(acc), static_cast<const ProductType&>(*pProduct));
+    });
+  }
+
+  //! Count the products of the given producer \p producer inside the warehouse.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(1)
+  //! - worst case:   O(P), where P is number of producers
+  //!
+  //! \return number of products of the producer
+  size_t CountProductsByProducer(std::string_view producer) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::CountProductsByProducer);
+
+    auto it = mProducerHandles.find(producer);
+    return (it != mProducerHandles.end())? mProductsByProducer[it->handle].size() : 0;
+  }
+
+  //! Count the products of the producer with the given handle \p producer inside the warehouse.
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \return number of products of the producer
+  size_t CountProductsByProducer(ProducerHandle producer) const
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    ReadLock lock(mMutex, mStats, WarehouseOperation::CountProductsByProducer);
+
+    return (producer < mProductsByProducer.size())? mProductsByProducer[producer].size() : 0;
+  }
+
+  //! Get the handle of the given producer \p producer
+  //!
+  //! The producer is interned if it is not known to the warehouse yet. The handle stays
+  //! valid for the whole lifetime of the warehouse (and of its copies), even if all products
+  //! of the producer are removed, and refers to the products added after getting it as well.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(1) amortized
+  //! - worst case:   O(P), where P is number of producers
+  //!
+  //! \return handle of the producer
+  ProducerHandle GetProducerHandle(std::string_view producer)
+  {
+    static_assert(kHasProducerIndex, "the warehouse has no ByProducerIndex");
+
+    {
+      ReadLock lock(mMutex, mStats, WarehouseOperation::GetProducerHandle);
+      auto it = mProducerHandles.find(producer);
+      if(it != mProducerHandles.end())
+      {
+        return it->handle;
+      }
+    }
+
+    WriteLock lock(mMutex, mStats, WarehouseOperation::InternProducer);
+    return InternProducerUnlocked(producer);
+  }
+
+  //! Remove the product with given id \p id from the warehouse
+  //! 
+  //! In case the product with the given id is not presented in the warehouse the state
+  //! of the warehouse will not be changed
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(logN)
+  //! - worst case:   O(N)
+  //!
+  //! \post @returned is 0 or 1
+  //! 
+  //! \return the number of removed products, which is either 1 or 0
+  size_t RemoveProductById(IdType id)
+  {  
+    WriteLock lock(mMutex, mStats, WarehouseOperation::RemoveProductById);
+    return RemoveProductByIdUnlocked(id);
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from the warehouse
+  //!
+  //! The result is the same as of calling RemoveProductById() for every id of the range
+  //! in order, but the lock is taken only once.
+  //!
+  //! \param[in] first, last range of the ids of the products to remove
+  //! \param[out] removed out-iterator to which per id of the range, in the same order,
+  //!   true is written if the product was removed and false otherwise
+  //!
+  //! Algorithm's time complexity, where K is number of ids in the range:
+  //! - average case: O(K*logN)
+  //! - worst case:   O(K*N)
+  //!
+  //! \return number of removed products
+  template <typename InputIt, typename OutputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last, OutputIt removed)
+  {
+    WriteLock lock(mMutex, mStats, WarehouseOperation::RemoveProductsById);
+
+    size_t cntRemoved = 0;
+    for(; first != last; ++first)
+    {
+      const size_t cnt = RemoveProductByIdUnlocked(*first);
+      *removed++ = (cnt != 0);
+      cntRemoved += cnt;
+    }
+    return cntRemoved;
+  }
+
+  //! Remove the products with the ids of the range [\p first, \p last) from the warehouse
+  //!
+  //! The same as RemoveProductsById(first, last, removed), but without per id results.
+  //!
+  //! \return number of removed products
+  template <typename InputIt>
+  size_t RemoveProductsById(InputIt first, InputIt last)
+  {
+    return RemoveProductsById(first, last, DiscardIterator{});
+  }
+
+  //! Save all products and producers of the warehouse to the file with the given path \p path
+  //!
+  //! The snapshot is written in the binary format described by SnapshotFormat, under a temporary
+  //! name first, so an existing file is replaced only by a complete snapshot. The producers are
+  //! saved together with their handles, including the ones without products, and the products
+  //! together with the hashes of their ids, so LoadSnapshot() does not hash the ids again.
+  //! Without the index of the producers, the producers of the products are numbered aside.
+  //! The lock of the warehouse is held only to copy the pointers to the products, so the
+  //! modifications do not wait for the file to be written.
+  //!
+  //! Algorithm's time complexity: O(N)
+  //!
+  //! \return true if the snapshot was saved, false otherwise
+  bool SaveSnapshot(const std::string &path) const
+  {
+    static_assert(sizeof(Product::Price) <= sizeof(uint32_t), "the price does not fit the snapshot record");
+    static_assert(std::is_same_v<IdType, std::string_view>, "the snapshot keeps the ids as strings");
+
+    // The lock is held only to copy the products with the hashes of their ids and the producers,
+    // the file is written after unlocking; the products are kept alive by the copied pointers.
+    // The producers are saved in the order of their handles. The copies allocate from the default
+    // resource, as the resource of the warehouse is not used by the readers.
+    // Time complexity of copying:
+    // - average: O(N)
+    // - worst:   O(N*P), where P - number of producers
+    std::vector<Product::Producer> producers;
+    std::vector<ProductPtr> products;
+    std::vector<size_t> idHashes;
+    std::vector<ProducerHandle> producersOfProducts;
+    {
+      ReadLock lock(mMutex, mStats, WarehouseOperation::SaveSnapshot);
+
+      products.reserve(mProductsWithMetasById.size());
+      idHashes.reserve(mProductsWithMetasById.size());
+      producersOfProducts.reserve(mProductsWithMetasById.size());
+      if constexpr(kHasProducerIndex)
+      {
+        producers.resize(mProductsByProducer.size());
+        for(const ProducerEntry &entry : mProducerHandles)
+        {
+          producers[entry.handle] = entry.producer;
+        }
+        for(auto it = mProductsWithMetasById.begin(); it != mProductsWithMetasById.end(); ++it)
+        {
+          products.push_back(it->pProduct);
+          idHashes.push_back(mProductsWithMetasById.hash_of(it));
+          producersOfProducts.push_back(it->producer);
+        }
+      }
+      else
+      {
+        ProducerHandles handles(std::pmr::get_default_resource());
+        for(auto it = mProductsWithMetasById.begin(); it != mProductsWithMetasById.end(); ++it)
+        {
+          const std::string_view producer = ProductTraits::ProducerOf(*it->pProduct);
+          auto itHandle = handles.find(producer);
+          if(itHandle == handles.end())
+          {
+            const auto handle = static_cast<ProducerHandle>(producers.size());
+            itHandle = handles.try_emplace(producer, ProducerEntry{Product::Producer(producer), handle}).first;
+            producers.emplace_back(producer);
+          }
+          products.push_back(it->pProduct);
+          idHashes.push_back(mProductsWithMetasById.hash_of(it));
+          producersOfProducts.push_back(itHandle->handle);
+        }
+      }
+    }
+
+    // Every string is referred by its offset in the string table, which is written after
+    // the records in the same order as the records refer to the strings.
+    // Time complexity of counting the strings: O(P + N)
+    SnapshotFormat::Header header{};
+    std::memcpy(header.magic, SnapshotFormat::kMagic, sizeof(header.magic));
+    header.version = SnapshotFormat::kVersion;
+    header.byteOrderMark = SnapshotFormat::kByteOrderMark;
+    header.hashProbe = typename ProductTraits::IdHash()(SnapshotFormat::kHashProbe);
+    header.cntProducers = producers.size();
+    header.cntProducts = products.size();
+    for(std::string_view producer : producers)
+    {
+      header.stringsSize += producer.size();
+    }
+    for(const ProductPtr &pProduct : products)
+    {
+      const size_t idSize = ProductTraits::IdOf(*pProduct).size();
+      const size_t nameSize = ProductTraits::NameOf(*pProduct).size();
+      if(idSize > UINT32_MAX || nameSize > UINT32_MAX || ProductTraits::ProducerOf(*pProduct).size() > UINT32_MAX)
+      {
+        return false;
+      }
+      header.stringsSize += idSize + nameSize;
+    }
+
+    // Time complexity of writing the records and the strings: O(P + N)
+    SnapshotWriter writer(path, header);
+
+    uint64_t stringOffset = 0;
+    for(std::string_view producer : producers)
+    {
+      const SnapshotFormat::ProducerRecord record{stringOffset, static_cast<uint32_t>(producer.size()), 0};
+      writer.Write(&record, sizeof(record));
+      stringOffset += producer.size();
+    }
+    writer.Pad();
+
+    for(size_t i = 0; i < products.size(); ++i)
+    {
+      const ProductType &product = *products[i];
+      const size_t idSize = ProductTraits::IdOf(product).size();
+      const size_t nameSize = ProductTraits::NameOf(product).size();
+      SnapshotFormat::ProductRecord record{};
+      record.idHash = idHashes[i];
+      record.idOffset = stringOffset;
+      record.idLength = static_cast<uint32_t>(idSize);
+      record.nameOffset = stringOffset + idSize;
+      record.nameLength = static_cast<uint32_t>(nameSize);
+      record.producer = producersOfProducts[i];
+      record.price = ProductTraits::PriceOf(product);
+      writer.Write(&record, sizeof(record));
+      stringOffset += idSize + nameSize;
+    }
+    writer.Pad();
+
+    for(std::string_view producer : producers)
+    {
+      writer.Write(producer.data(), producer.size());
+    }
+    for(const ProductPtr &pProduct : products)
+    {
+      const std::string_view id = ProductTraits::IdOf(*pProduct);
+      const std::string_view name = ProductTraits::NameOf(*pProduct);
+      writer.Write(id.data(), id.size());
+      writer.Write(name.data(), name.size());
+    }
+    writer.Pad();
+
+    return writer.Commit();
+  }
+
+  //! Replace the content of the warehouse with the snapshot saved by SaveSnapshot() to the file
+  //! with the given path \p path
+  //!
+  //! The file is memory-mapped where possible and the whole snapshot is loaded aside, without
+  //! the lock of the warehouse, which is taken only to swap the loaded indexes in. The products
+  //! are made by MakeProduct(). The id index is reserved for all products and filled by the
+  //! saved hashes of the ids, unless the hash function differs from the one of the writer; the
+  //! records are trusted only after the checksum of the file is verified. If the file is not
+  //! a valid snapshot, the warehouse is not changed.
+  //!
+  //! Algorithm's time complexity:
+  //! - average case: O(N*logN), spent on sorting the products by their prices
+  //! - worst case:   O(N^2)
+  //!
+  //! \return true if the snapshot was loaded, false otherwise
+  bool LoadSnapshot(const std::string &path)
+  {
+    static_assert(std::is_same_v<IdType, std::string_view>, "the snapshot keeps the ids as strings");
+
+    SnapshotFile file;
+    if(!file.Open(path))
+    {
+      return false;
+    }
+
+    BasicWarehouse loaded(mpMemoryResource);
+    loaded.mIsNameIndexEnabled = IsNameIndexEnabled();
+    loaded.mIsPriceColumnsEnabled = IsPriceColumnsEnabled();
+    {
+      typename LockingPolicy::ReadLock lock(mMutex);
+      loaded.mIsEvictionEnabled = mIsEvictionEnabled;
+      if constexpr(kHasEvictionIndex)
+      {
+        // the bytes are counted again while the products of the snapshot are added
+        loaded.mCapacity.maxProducts = mCapacity.maxProducts;
+        loaded.mCapacity.maxBytes = mCapacity.maxBytes;
+      }
+    }
+    if(!loaded.LoadSnapshotUnlocked(file.data(), file.size()))
+    {
+      return false;
+    }
+
+    // the replaced products are released after unlocking, together with the loaded warehouse
+    WriteLock lock(mMutex, mStats, WarehouseOperation::LoadSnapshot);
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled && !loaded.mIsNameIndexEnabled)
+      {
+        // the name index was enabled while the snapshot was loaded
+        loaded.EnableNameIndex();
+      }
+    }
+    if constexpr(kHasPriceIndex)
+    {
+      if(mIsPriceColumnsEnabled && !loaded.mIsPriceColumnsEnabled)
+      {
+        loaded.EnablePriceColumns();
+      }
+    }
+    if constexpr(kHasEvictionIndex)
+    {
+      // the capacity may have changed while the snapshot was loaded
+      if(mIsEvictionEnabled && !loaded.mIsEvictionEnabled)
+      {
+        loaded.EnableEvictionUnlocked();
+      }
+      loaded.mCapacity.maxProducts = mCapacity.maxProducts;
+      loaded.mCapacity.maxBytes = mCapacity.maxBytes;
+      loaded.mCapacity.cntEvictions = mCapacity.cntEvictions;
+      loaded.EvictUnlocked();
+    }
+    SwapIndexesUnlocked(loaded);
+    return true;
+  }
+
+  //! Stats of the warehouse
+  //!
+  //! The stats of the operations are collected only if WAREHOUSE_STATS is defined, see
+  //! WarehouseStats::enabled, otherwise only the sizes of the indexes are set. The counters
+  //! of the operations are read without the lock, so the calls in progress may be partially
+  //! included. The copies of the warehouse start with empty counters.
+  //!
+  //! Algorithm's time complexity: O(1)
+  //!
+  //! \return the stats of the operations since the construction of the warehouse and the
+  //!   current sizes of the indexes
+  WarehouseStats GetStats() const
+  {
+    WarehouseStats stats;
+    mStats.Collect(stats);
+
+    typename LockingPolicy::ReadLock lock(mMutex);
+    stats.cntProducts = mProductsWithMetasById.size();
+    if constexpr(kHasProducerIndex)
+    {
+      stats.cntProducers = mProductsByProducer.size();
+    }
+    stats.idIndexCapacity = mProductsWithMetasById.capacity();
+    stats.cntIdIndexRehashes = mProductsWithMetasById.rehash_count();
+    if constexpr(kHasEvictionIndex)
+    {
+      stats.cntEvictions = mCapacity.cntEvictions;
+    }
+    return stats;
+  }
+
+private:
+  //! Number of the ids that FindProductsByIds() prefetches the id index for ahead of the looked up id
+  static constexpr size_t kPrefetchDistance = 8;
+
+  //! Expiry tick of the products that never expire
+  static constexpr uint64_t kNeverExpires = std::numeric_limits<uint64_t>::max();
+
+  //! Tick of the expiry wheel of the given time \p time, which is the count of the milliseconds
+  //! rounded up, so a product never expires before its expiry time
+  static uint64_t TickOf(ExpiryTime time)
+  {
+    const auto sinceEpoch = time.time_since_epoch();
+    const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(sinceEpoch);
+    return std::max<int64_t>(0, milliseconds.count() + (milliseconds < sinceEpoch));
+  }
+
+  //! Type the ids are copied to, which owns the id
+  using IdValue = std::conditional_t<std::is_same_v<IdType, std::string_view>, Product::Id, IdType>;
+
+  //! Estimated bytes of the given product \p product and of its entries in the indexes, see SetCapacity()
+  static size_t EstimatedBytesOf(const ProductType &product)
+  {
+    size_t cntBytes = sizeof(ProductType) + sizeof(ProductWithMeta) + ProductTraits::ProducerOf(product).size() +
+      ProductTraits::NameOf(product).size();
+    if constexpr(std::is_same_v<IdType, std::string_view>)
+    {
+      cntBytes += ProductTraits::IdOf(product).size();
+    }
+    return cntBytes;
+  }
+
+  //! Mark the given product \p productWithMeta as used, see SetCapacity(); it is called under
+  //! a read lock as well, which the reference bits allow
+  void TouchUnlocked(const ProductWithMeta &productWithMeta) const
+  {
+    if constexpr(kHasEvictionIndex)
+    {
+      if(mIsEvictionEnabled)
+      {
+        mProductsClock.Touch(productWithMeta.clockSlot);
+      }
+    }
+  }
+
+  //! Start tracking the use of the products without locking, see SetCapacity()
+  void EnableEvictionUnlocked()
+  {
+    std::vector<ProductWithMeta*> products;
+    products.reserve(mProductsWithMetasById.size());
+    for(ProductWithMeta &productWithMeta : mProductsWithMetasById)
+    {
+      products.push_back(&productWithMeta);
+    }
+    mIsEvictionEnabled = true;
+    BuildProductsClockUnlocked(products);
+  }
+
+  //! Evict the products until the warehouse is within its capacity, see SetCapacity(), without locking
+  //!
+  //! \return number of the evicted products
+  size_t EvictUnlocked()
+  {
+    size_t cntEvicted = 0;
+    if constexpr(kHasEvictionIndex)
+    {
+      // Time complexity of the ClockRing::Victim(): O(1) amortized
+      while(mIsEvictionEnabled && !mProductsClock.empty() &&
+        (mProductsClock.size() > mCapacity.maxProducts || mCapacity.cntBytes > mCapacity.maxBytes))
+      {
+        const ProductPtr &pVictim = mProductsClock.PtrOf(mProductsClock.Victim());
+        EraseProductUnlocked(mProductsWithMetasById.find(ProductTraits::IdOf(*pVictim)));
+        ++cntEvicted;
+      }
+      mCapacity.cntEvictions += cntEvicted;
+    }
+    return cntEvicted;
+  }
+
+  //! Whether the given product \p productWithMeta has expired, but has not been reaped yet
+  bool IsExpiredUnlocked(const ProductWithMeta &productWithMeta) const
+  {
+    if constexpr(kHasExpiryIndex)
+    {
+      // the clock is read only for the products that expire
+      return productWithMeta.expiry != kNeverExpires && productWithMeta.expiry <= TickOf(ExpiryClock::now());
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  //! Make the given product \p productWithMeta expire at the given tick \p expiry, or never
+  //! if it is kNeverExpires, without locking
+  void SetExpiryUnlocked(ProductWithMeta &productWithMeta, uint64_t expiry)
+  {
+    if constexpr(kHasExpiryIndex)
+    {
+      if(productWithMeta.expiryTimer != ExpiryWheel::kNoHandle)
+      {
+        mExpiries.Cancel(productWithMeta.expiryTimer);
+        productWithMeta.expiryTimer = ExpiryWheel::kNoHandle;
+      }
+      productWithMeta.expiry = expiry;
+      if(expiry != kNeverExpires)
+      {
+        productWithMeta.expiryTimer = mExpiries.Schedule(expiry, productWithMeta.pProduct);
+      }
+    }
+    else
+    {
+      // pre-conditions
+      assert(expiry == kNeverExpires);
+    }
+  }
+
+  //! Output iterator that ignores everything written to it
+  struct DiscardIterator
+  {
+    DiscardIterator& operator*() { return *this; }
+    DiscardIterator& operator++() { return *this; }
+    DiscardIterator& operator++(int) { return *this; }
+
+    template <typename T>
+    DiscardIterator& operator=(T &&) { return *this; }
+  };
+
+  template <typename It>
+  static constexpr bool IsForwardIterator = 
+    std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>;
+
+  //! AddProduct() without locking, the product expires at the given tick \p expiry
+  bool AddProductUnlocked(const ProductPtr &pProduct, uint64_t expiry = kNeverExpires)
+  {
+    // pre-conditions
+    assert(pProduct);
+
+    // Time complexity of the FlatHashTable::try_emplace(): 
+    // - average: O(1) amortized
     // - worst:   O(N)
-    mProductsWithMetasById.erase(it);
+    auto [it, success] = mProductsWithMetasById.try_emplace(ProductTraits::IdOf(*pProduct), pProduct);
+    if(success)
+    {
+      IndexAddedProductUnlocked(*it);
+    }
+    else if(IsExpiredUnlocked(*it))
+    {
+      // the expired product counts as absent, so it is replaced instead of waiting to be reaped
+      ReplaceProductUnlocked(*it, pProduct);
+      success = true;
+    }
+    if(success)
+    {
+      SetExpiryUnlocked(*it, expiry);
+      EvictUnlocked();
+    }
+    return success;
+
+    // Time complexity of the method:
+    // - average: O(1) + O(1) + O(logN) = O(logN) amortized
+    // - worst:   O(N) + O(P) + O(logN) = O(N)
+  }
+
+  //! Add the product just inserted into the id index to the other indexes without locking
+  void IndexAddedProductUnlocked(ProductWithMeta &productWithMeta)
+  {
+    const ProductPtr &pProduct = productWithMeta.pProduct;
+
+    // Time complexity of the interning:
+    // - average: O(1) amortized
+    // - worst:   O(P), where P - number of producers, 0 <= P <= N
+    // Time complexity of the PriceIndex::insert(): O(logM) amortized for the group
+    if constexpr(kHasProducerIndex)
+    {
+      const ProducerHandle producer = InternProducerUnlocked(ProductTraits::ProducerOf(*pProduct));
+      productWithMeta.producer = producer;
+      mProductsByProducer[producer].insert(ProductTraits::PriceOf(*pProduct), pProduct);
+    }
+
+    // Time complexity of the PriceIndex::insert(): O(logN) amortized for the price index
+    if constexpr(kHasPriceIndex)
+    {
+      mProductsByPrice.insert(ProductTraits::PriceOf(*pProduct), pProduct);
+      if(mIsPriceColumnsEnabled)
+      {
+        productWithMeta.columnSlot = mPriceColumns.insert(ProductTraits::PriceOf(*pProduct), pProduct);
+      }
+    }
+
+    // Time complexity of the NameIndex::insert(): O(L*logL + logN) amortized, see NameIndex
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled)
+      {
+        productWithMeta.nameSlot = mProductsByName.insert(pProduct);
+      }
+    }
+
+    // Time complexity of the ClockRing::insert(): O(1) amortized
+    if constexpr(kHasEvictionIndex)
+    {
+      if(mIsEvictionEnabled)
+      {
+        productWithMeta.clockSlot = mProductsClock.insert(pProduct);
+        mCapacity.cntBytes += EstimatedBytesOf(*pProduct);
+      }
+    }
+
+    // Time complexity of the method:
+    // - average: O(1) + O(logN) = O(logN) amortized
+    // - worst:   O(P) + O(logN) = O(N)
+  }
+
+  //! Replace the product of the id index \p productWithMeta by the product \p pProduct with
+  //! the same id in all indexes without locking
+  void ReplaceProductUnlocked(ProductWithMeta &productWithMeta, const ProductPtr &pProduct)
+  {
+    // pre-conditions
+    assert(pProduct && ProductTraits::IdOf(*pProduct) == ProductTraits::IdOf(*productWithMeta.pProduct));
+
+    // the replaced product is kept alive until it is replaced in every index
+    const ProductPtr pOldProduct = productWithMeta.pProduct;
+    const Product::Price oldPrice = ProductTraits::PriceOf(*pOldProduct);
+    const Product::Price price = ProductTraits::PriceOf(*pProduct);
+
+    // Time complexity of the PriceIndex::replace(): O(logM) if the entry is replaced in place,
+    // O(logM) amortized otherwise
+    if constexpr(kHasProducerIndex)
+    {
+      const ProducerHandle oldProducer = productWithMeta.producer;
+      if(ProductTraits::ProducerOf(*pOldProduct) == ProductTraits::ProducerOf(*pProduct))
+      {
+        mProductsByProducer[oldProducer].replace(oldPrice, pOldProduct, price, pProduct);
+      }
+      else
+      {
+        const ProducerHandle producer = InternProducerUnlocked(ProductTraits::ProducerOf(*pProduct));
+        mProductsByProducer[oldProducer].erase(oldPrice, pOldProduct);
+        mProductsByProducer[producer].insert(price, pProduct);
+        productWithMeta.producer = producer;
+      }
+    }
+    if constexpr(kHasPriceIndex)
+    {
+      mProductsByPrice.replace(oldPrice, pOldProduct, price, pProduct);
+      if(mIsPriceColumnsEnabled)
+      {
+        mPriceColumns.replace(productWithMeta.columnSlot, price, pProduct);
+      }
+    }
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled)
+      {
+        mProductsByName.replace(productWithMeta.nameSlot, pProduct);
+      }
+    }
+    if constexpr(kHasEvictionIndex)
+    {
+      if(mIsEvictionEnabled)
+      {
+        mProductsClock.replace(productWithMeta.clockSlot, pProduct);
+        mCapacity.cntBytes += EstimatedBytesOf(*pProduct) - EstimatedBytesOf(*pOldProduct);
+      }
+    }
+
+    // the id of the product is the key of the id index, which is the same for the new product
+    productWithMeta.pProduct = pProduct;
+    if constexpr(kHasExpiryIndex)
+    {
+      if(productWithMeta.expiryTimer != ExpiryWheel::kNoHandle)
+      {
+        mExpiries.ValueOf(productWithMeta.expiryTimer) = pProduct;
+      }
+    }
+  }
+
+  //! AddProducts() of a forward range into the empty warehouse without locking
+  template <typename ForwardIt, typename OutputIt>
+  size_t BulkLoadUnlocked(ForwardIt first, ForwardIt last, OutputIt added)
+  {
+    // pre-conditions
+    assert(mProductsWithMetasById.empty());
+
+    // The id index is reserved for all products, so it is not rehashed while
+    // it is filled and the pointers to its elements stay valid.
+    // Time complexity of filling the id index: 
+    // - average: O(K)
+    // - worst:   O(K^2)
+    mProductsWithMetasById.reserve(std::distance(first, last));
+    std::vector<ProductWithMeta*> addedProducts;
+    for(; first != last; ++first)
+    {
+      const ProductPtr &pProduct = *first;
+      assert(pProduct);
+
+      auto [it, success] = mProductsWithMetasById.try_emplace(ProductTraits::IdOf(*pProduct), pProduct);
+      if(success)
+      {
+        addedProducts.push_back(&*it);
+      }
+      *added++ = success;
+    }
+
+    // Time complexity of the interning:
+    // - average: O(K)
+    // - worst:   O(K*P), where P - number of producers
+    if constexpr(kHasProducerIndex)
+    {
+      for(ProductWithMeta *pProductWithMeta : addedProducts)
+      {
+        pProductWithMeta->producer = InternProducerUnlocked(ProductTraits::ProducerOf(*pProductWithMeta->pProduct));
+      }
+    }
 
-    return 1;
+    // Time complexity of building the groups and the price index: O(P + K*logK)
+    BuildOptionalIndexesUnlocked(addedProducts);
+    return addedProducts.size();
 
     // Time complexity of the method:
-    // - average: O(1) + O(1) + O(1) = O(1)
-    // - worst:   O(N) + O(N) + O(N) = O(N)
+    // - average: O(K) + O(K) + O(P + K*logK) = O(P + K*logK)
+    // - worst:   O(K^2) + O(K*P) + O(P + K*logK) = O(K^2)
   }
 
-private:
-  mutable std::mutex mMutex;
-  
-  std::multimap<Product::Producer, ProductPtr> mProductsByProducer;
+  //! Fill the empty optional indexes that are maintained with the given products \p products,
+  //! whose producers are interned already, without locking
+  void BuildOptionalIndexesUnlocked(const std::vector<ProductWithMeta*> &products)
+  {
+    if constexpr(kHasProducerIndex || kHasPriceIndex)
+    {
+      BuildGroupsUnlocked(products);
+    }
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled)
+      {
+        BuildNameIndexUnlocked(products);
+      }
+    }
+    if constexpr(kHasPriceIndex)
+    {
+      if(mIsPriceColumnsEnabled)
+      {
+        BuildPriceColumnsUnlocked(products);
+      }
+    }
+    if constexpr(kHasEvictionIndex)
+    {
+      if(mIsEvictionEnabled)
+      {
+        BuildProductsClockUnlocked(products);
+      }
+    }
+  }
+
+  //! Fill the empty groups and the empty price index with the given products \p products,
+  //! whose producers are interned already, without locking
+  void BuildGroupsUnlocked(const std::vector<ProductWithMeta*> &products)
+  {
+    std::vector<typename ProductGroup::Entry> entries(products.size());
+    if constexpr(kHasProducerIndex)
+    {
+      // The entries of the groups are arranged as by a counting sort on the producer handles,
+      // then every group and the price index are sorted once instead of inserting into them
+      // one by one.
+      // Time complexity of arranging the entries: O(P + K)
+      std::vector<size_t> offsetsOfProducers(mProductsByProducer.size() + 1);
+      for(const ProductWithMeta *pProductWithMeta : products)
+      {
+        offsetsOfProducers[pProductWithMeta->producer + 1]++;
+      }
+      std::partial_sum(offsetsOfProducers.begin(), offsetsOfProducers.end(), offsetsOfProducers.begin());
+      for(const ProductWithMeta *pProductWithMeta : products)
+      {
+        const ProductPtr &pProduct = pProductWithMeta->pProduct;
+        entries[offsetsOfProducers[pProductWithMeta->producer]++] = {ProductTraits::PriceOf(*pProduct), pProduct};
+      }
+
+      // Time complexity of sorting the groups: O(K*logK)
+      for(size_t producer = 0, first = 0; producer < mProductsByProducer.size(); ++producer)
+      {
+        const size_t last = offsetsOfProducers[producer];
+        mProductsByProducer[producer].assign(entries.begin() + first, entries.begin() + last);
+        first = last;
+      }
+    }
+    else
+    {
+      for(size_t i = 0; i < products.size(); ++i)
+      {
+        const ProductPtr &pProduct = products[i]->pProduct;
+        entries[i] = {ProductTraits::PriceOf(*pProduct), pProduct};
+      }
+    }
+
+    // Time complexity of sorting the price index: O(K*logK)
+    if constexpr(kHasPriceIndex)
+    {
+      // pre-conditions
+      assert(mProductsByPrice.empty());
+
+      mProductsByPrice.assign(entries.begin(), entries.end());
+    }
+  }
+
+  //! Fill the empty name index with the given products \p products without locking
+  void BuildNameIndexUnlocked(const std::vector<ProductWithMeta*> &products)
+  {
+    // pre-conditions
+    assert(mProductsByName.empty());
+
+    // the i-th product takes the slot i
+    std::vector<ProductPtr> productPtrs;
+    productPtrs.reserve(products.size());
+    for(const ProductWithMeta *pProductWithMeta : products)
+    {
+      productPtrs.push_back(pProductWithMeta->pProduct);
+    }
+    mProductsByName.assign(productPtrs.begin(), productPtrs.end());
+    for(size_t slot = 0; slot < products.size(); ++slot)
+    {
+      products[slot]->nameSlot = static_cast<typename ProductsByName::Slot>(slot);
+    }
+  }
+
+  //! Fill the empty columns of the prices with the given products \p products without locking
+  void BuildPriceColumnsUnlocked(const std::vector<ProductWithMeta*> &products)
+  {
+    // pre-conditions
+    assert(mPriceColumns.empty());
+
+    mPriceColumns.reserve(products.size());
+    for(ProductWithMeta *pProductWithMeta : products)
+    {
+      const ProductPtr &pProduct = pProductWithMeta->pProduct;
+      pProductWithMeta->columnSlot = mPriceColumns.insert(ProductTraits::PriceOf(*pProduct), pProduct);
+    }
+  }
 
-  struct ProductWithMeta 
+  //! Add the given products \p products to the reference bits without locking
+  void BuildProductsClockUnlocked(const std::vector<ProductWithMeta*> &products)
   {
-    explicit ProductWithMeta(ProductPtr _pProduct): pProduct(std::move(_pProduct)){}
+    mProductsClock.reserve(mProductsClock.size() + products.size());
+    for(ProductWithMeta *pProductWithMeta : products)
+    {
+      const ProductPtr &pProduct = pProductWithMeta->pProduct;
+      pProductWithMeta->clockSlot = mProductsClock.insert(pProduct);
+      mCapacity.cntBytes += EstimatedBytesOf(*pProduct);
+    }
+  }
+
+  //! Load the snapshot with the given content [\p pData, \p pData + \p size) into the empty
+  //! warehouse without locking, see LoadSnapshot()
+  //!
+  //! \return false if the content is not a valid snapshot
+  bool LoadSnapshotUnlocked(const char *pData, size_t size)
+  {
+    // pre-conditions
+    assert(mProductsWithMetasById.empty());
+
+    // The records are copied out of the content, which does not have to be aligned.
+    // Time complexity of validating the header: O(1)
+    SnapshotFormat::Header header{};
+    SnapshotFormat::Layout layout{};
+    if(size < sizeof(header))
+    {
+      return false;
+    }
+    std::memcpy(&header, pData, sizeof(header));
+    if(std::memcmp(header.magic, SnapshotFormat::kMagic, sizeof(header.magic)) != 0 ||
+       header.version != SnapshotFormat::kVersion || header.byteOrderMark != SnapshotFormat::kByteOrderMark ||
+       !SnapshotFormat::LayoutOf(header, layout) || layout.fileSize != size ||
+       header.cntProducers > std::numeric_limits<ProducerHandle>::max())
+    {
+      return false;
+    }
 
-    struct Meta 
+    // Time complexity of verifying the checksum: O(S), where S is size of the file
+    SnapshotFormat::Checksum checksum;
+    checksum.Update(pData + layout.producersOffset, size - layout.producersOffset);
+    if(checksum.Value() != header.checksum)
     {
-      decltype(mProductsByProducer)::const_iterator it_productsByProducer;
+      return false;
+    }
+
+    const char *pStrings = pData + layout.stringsOffset;
+    auto stringAt = [pStrings, &header](uint64_t offset, uint32_t length, std::string_view &str) {
+      if(offset > header.stringsSize || length > header.stringsSize - offset)
+      {
+        return false;
+      }
+      str = std::string_view(pStrings + offset, length);
+      return true;
     };
 
+    // The producers are interned in the order of the saved handles, so the handles are the same.
+    // Time complexity of the interning:
+    // - average: O(P)
+    // - worst:   O(P^2)
+    std::vector<std::string_view> producers(header.cntProducers);
+    for(size_t producer = 0; producer < producers.size(); ++producer)
+    {
+      SnapshotFormat::ProducerRecord record;
+      std::memcpy(&record, pData + layout.producersOffset + producer * sizeof(record), sizeof(record));
+      if(!stringAt(record.nameOffset, record.nameLength, producers[producer]))
+      {
+        return false;
+      }
+      if constexpr(kHasProducerIndex)
+      {
+        if(InternProducerUnlocked(producers[producer]) != producer)
+        {
+          return false;
+        }
+      }
+    }
+
+    // Time complexity of filling the id index:
+    // - average: O(N)
+    // - worst:   O(N^2)
+    const bool isSameHash = (header.hashProbe == typename ProductTraits::IdHash()(SnapshotFormat::kHashProbe));
+    mProductsWithMetasById.reserve(header.cntProducts);
+    std::vector<ProductWithMeta*> loadedProducts;
+    loadedProducts.reserve(header.cntProducts);
+    for(size_t i = 0; i < header.cntProducts; ++i)
+    {
+      SnapshotFormat::ProductRecord record;
+      std::memcpy(&record, pData + layout.productsOffset + i * sizeof(record), sizeof(record));
+
+      std::string_view id, name;
+      if(record.producer >= producers.size() || !stringAt(record.idOffset, record.idLength, id) ||
+         !stringAt(record.nameOffset, record.nameLength, name))
+      {
+        return false;
+      }
+
+      ProductPtr pProduct = ProductTraits::MakeFromStrings(mpMemoryResource, id, producers[record.producer], name,
+        Product::Price(record.price));
+      auto [it, success] = isSameHash?
+        mProductsWithMetasById.try_emplace_with_hash(record.idHash, ProductTraits::IdOf(*pProduct), pProduct) :
+        mProductsWithMetasById.try_emplace(ProductTraits::IdOf(*pProduct), pProduct);
+      if(!success)
+      {
+        return false;
+      }
+      if constexpr(kHasProducerIndex)
+      {
+        it->producer = record.producer;
+      }
+      loadedProducts.push_back(&*it);
+    }
+
+    // Time complexity of building the groups and the price index: O(P + N*logN)
+    BuildOptionalIndexesUnlocked(loadedProducts);
+    return true;
+
+    // Time complexity of the method:
+    // - average: O(P) + O(N) + O(P + N*logN) = O(P + N*logN)
+    // - worst:   O(P^2) + O(N^2) + O(P + N*logN) = O(N^2)
+  }
+
+  //! Swap the indexes with the ones of the warehouse \p other, which allocates from the same
+  //! memory resource, without locking
+  void SwapIndexesUnlocked(BasicWarehouse &other)
+  {
+    mProducerHandles.swap(other.mProducerHandles);
+    mProductsByProducer.swap(other.mProductsByProducer);
+    mProductsByPrice.swap(other.mProductsByPrice);
+    std::swap(mIsNameIndexEnabled, other.mIsNameIndexEnabled);
+    mProductsByName.swap(other.mProductsByName);
+    std::swap(mIsPriceColumnsEnabled, other.mIsPriceColumnsEnabled);
+    mPriceColumns.swap(other.mPriceColumns);
+    mExpiries.swap(other.mExpiries);
+    std::swap(mIsEvictionEnabled, other.mIsEvictionEnabled);
+    mProductsClock.swap(other.mProductsClock);
+    std::swap(mCapacity, other.mCapacity);
+    mProductsWithMetasById.swap(other.mProductsWithMetasById);
+  }
+
+  //! RemoveProductById() without locking
+  size_t RemoveProductByIdUnlocked(IdType id)
+  {
+    // Time complexity of the FlatHashTable::find(key):
+    // - average: O(1)
+    // - worst:   O(N)
+    auto it = mProductsWithMetasById.find(id);
+    if (it == mProductsWithMetasById.end()) 
+    {
+      return 0;
+    }
+
+    // the expired product counts as absent, but it is removed all the same
+    const bool isExpired = IsExpiredUnlocked(*it);
+    EraseProductUnlocked(it);
+    return isExpired? 0 : 1;
+
+    // Time complexity of the method:
+    // - average: O(1) + O(logN) = O(logN)
+    // - worst:   O(N) + O(logN) = O(N)
+  }
+
+  //! Remove the product of the id index pointed by \p it from all indexes without locking
+  void EraseProductUnlocked(typename ProductsById::iterator it)
+  {
+    // Time complexity of the PriceIndex::erase(): O(logM) amortized for the group
+    // and O(logN) amortized for the price index
+    const ProductPtr &pProduct = it->pProduct;
+    if constexpr(kHasProducerIndex)
+    {
+      mProductsByProducer[it->producer].erase(ProductTraits::PriceOf(*pProduct), pProduct);
+    }
+    if constexpr(kHasPriceIndex)
+    {
+      mProductsByPrice.erase(ProductTraits::PriceOf(*pProduct), pProduct);
+
+      // Time complexity of moving the last entry of the columns to the freed slot:
+      // - average: O(1)
+      // - worst:   O(N), spent on finding the moved product by its id
+      if(mIsPriceColumnsEnabled && mPriceColumns.erase(it->columnSlot))
+      {
+        const ProductPtr &pMoved = mPriceColumns.PtrOf(it->columnSlot);
+        mProductsWithMetasById.find(ProductTraits::IdOf(*pMoved))->columnSlot = it->columnSlot;
+      }
+    }
+    if constexpr(kHasNameIndex)
+    {
+      if(mIsNameIndexEnabled)
+      {
+        mProductsByName.erase(it->nameSlot);
+      }
+    }
+
+    if constexpr(kHasExpiryIndex)
+    {
+      if(it->expiryTimer != ExpiryWheel::kNoHandle)
+      {
+        mExpiries.Cancel(it->expiryTimer);
+      }
+    }
+
+    // Time complexity of moving the last entry of the ring to the freed slot:
+    // - average: O(1)
+    // - worst:   O(N), spent on finding the moved product by its id
+    if constexpr(kHasEvictionIndex)
+    {
+      if(mIsEvictionEnabled)
+      {
+        mCapacity.cntBytes -= EstimatedBytesOf(*pProduct);
+        if(mProductsClock.erase(it->clockSlot))
+        {
+          const ProductPtr &pMoved = mProductsClock.PtrOf(it->clockSlot);
+          mProductsWithMetasById.find(ProductTraits::IdOf(*pMoved))->clockSlot = it->clockSlot;
+        }
+      }
+    }
+
+    // Time complexity of the FlatHashTable::erase(iterator): O(1)
+    mProductsWithMetasById.erase(it);
+
+    // Time complexity of the method:
+    // - average: O(logN)
+    // - worst:   O(N), spent on the price columns
+  }
+
+  //! Get the handle of the given producer \p producer, interning it if necessary, without locking
+  ProducerHandle InternProducerUnlocked(std::string_view producer)
+  {
+    // pre-conditions
+    assert(mProductsByProducer.size() < std::numeric_limits<ProducerHandle>::max());
+
+    // the producer is looked up first, so no string is constructed for a known producer
+    auto it = mProducerHandles.find(producer);
+    if(it != mProducerHandles.end())
+    {
+      return it->handle;
+    }
+
+    const auto handle = static_cast<ProducerHandle>(mProductsByProducer.size());
+    mProducerHandles.try_emplace(producer, ProducerEntry{Product::Producer(producer), handle});
+    mProductsByProducer.emplace_back();
+    return handle;
+  }
+
+  mutable typename LockingPolicy::Mutex mMutex;
+
+  //! Counters of the operations, see GetStats()
+  mutable WarehouseStatsCollector mStats;
+
+  std::pmr::memory_resource *mpMemoryResource = nullptr;
+  
+  struct ProducerEntry
+  {
+    Product::Producer producer;
+    ProducerHandle handle;
+  };
+
+  struct ProducerOfEntry
+  {
+    const Product::Producer& operator()(const ProducerEntry &entry) const { return entry.producer; }
+  };
+
+  using ProducerHandles = FlatHashTable<ProducerEntry, ProducerOfEntry, StringHash, std::equal_to<>,
+    std::pmr::polymorphic_allocator<ProducerEntry>>;
+
+  //! Placeholder of an index that is not one of Indexes
+  struct NoIndex
+  {
+    explicit NoIndex(std::pmr::memory_resource *) {}
+    void swap(NoIndex &) noexcept {}
+  };
+
+  //! Placeholder of the members \p Meta that belong to an index that is not one of Indexes
+  template <typename Meta>
+  struct NoMeta {};
+
+  //! Interned producers, every producer is stored once no matter how many products it has
+  std::conditional_t<kHasProducerIndex, ProducerHandles, NoIndex> mProducerHandles;
+
+  //! Products of every producer, indexed by the producer handles; the groups allocate from
+  //! the same memory resource as the vector of them
+  std::conditional_t<kHasProducerIndex, std::pmr::vector<ProductGroup>, NoIndex> mProductsByProducer;
+
+  //! All products of the warehouse ordered by their prices
+  std::conditional_t<kHasPriceIndex, ProductGroup, NoIndex> mProductsByPrice;
+
+  //! Whether mProductsByName is maintained, see EnableNameIndex()
+  bool mIsNameIndexEnabled = false;
+
+  //! All products of the warehouse by their names, if the name index is enabled
+  std::conditional_t<kHasNameIndex, ProductsByName, NoIndex> mProductsByName;
+
+  //! Whether mPriceColumns is maintained, see EnablePriceColumns()
+  bool mIsPriceColumnsEnabled = false;
+
+  //! Prices and producers of all products of the warehouse, if the columns are enabled
+  std::conditional_t<kHasPriceIndex, ProductColumns, NoIndex> mPriceColumns;
+
+  //! Timers of the products that expire
+  std::conditional_t<kHasExpiryIndex, ExpiryWheel, NoIndex> mExpiries;
+
+  //! Whether mProductsClock is maintained, see SetCapacity()
+  bool mIsEvictionEnabled = false;
+
+  //! Reference bits of all products of the warehouse, if the capacity is set
+  std::conditional_t<kHasEvictionIndex, ProductsClock, NoIndex> mProductsClock;
+
+  //! Capacity of the warehouse, see SetCapacity()
+  struct Capacity
+  {
+    size_t maxProducts = std::numeric_limits<size_t>::max();
+    size_t maxBytes = std::numeric_limits<size_t>::max();
+    size_t cntBytes = 0;        //!< estimated bytes of the products, see EstimatedBytesOf()
+    uint64_t cntEvictions = 0;  //!< number of the evicted products
+  };
+
+  //! Loader of the missing products and the loads in progress, see FindOrLoadProductById()
+  struct ReadThrough
+  {
+    std::mutex mutex;
+    Loader loader;
+    std::map<IdValue, std::shared_future<ProductPtr>, std::less<>> loads;
+  };
+
+  std::conditional_t<kHasEvictionIndex, Capacity, NoMeta<Capacity>> mCapacity;
+
+  //! The loader is a setting of the warehouse, so it is neither copied nor swapped with the indexes
+  std::conditional_t<kHasEvictionIndex, ReadThrough, NoMeta<ReadThrough>> mReadThrough;
+
+  //! Members of an element of the id index that refer to the optional indexes; the element
+  //! derives from NoMeta instead of the members of a missing index, which takes no bytes
+  struct ProducerMeta
+  {
+    ProducerHandle producer = 0;  //!< handle of the producer of the product
+  };
+
+  struct NameMeta
+  {
+    typename ProductsByName::Slot nameSlot = 0;  //!< slot of the product in the name index, if it is enabled
+  };
+
+  struct ColumnMeta
+  {
+    typename ProductColumns::Slot columnSlot = 0;  //!< slot of the product in the price columns, if they are enabled
+  };
+
+  struct ClockMeta
+  {
+    typename ProductsClock::Slot clockSlot = 0;  //!< slot of the product in the reference bits, if the capacity is set
+  };
+
+  struct ExpiryMeta
+  {
+    uint64_t expiry = kNeverExpires;                          //!< tick at which the product expires
+    typename ExpiryWheel::Handle expiryTimer = ExpiryWheel::kNoHandle;  //!< timer of the expiry, if any
+  };
+
+  struct IdMeta
+  {
+    IdType id{};  //!< copy of the id of the product, see kIsIdInline
+  };
+
+  struct ProductWithMeta: std::conditional_t<kHasProducerIndex, ProducerMeta, NoMeta<ProducerMeta>>,
+    std::conditional_t<kHasNameIndex, NameMeta, NoMeta<NameMeta>>,
+    std::conditional_t<kHasPriceIndex, ColumnMeta, NoMeta<ColumnMeta>>,
+    std::conditional_t<kHasExpiryIndex, ExpiryMeta, NoMeta<ExpiryMeta>>,
+    std::conditional_t<kHasEvictionIndex, ClockMeta, NoMeta<ClockMeta>>,
+    std::conditional_t<kIsIdInline, IdMeta, NoMeta<IdMeta>>
+  {
+    explicit ProductWithMeta(ProductPtr _pProduct): pProduct(std::move(_pProduct))
+    {
+      if constexpr(kIsIdInline)
+      {
+        this->id = ProductTraits::IdOf(*pProduct);
+      }
+    }
+
     ProductPtr pProduct;
-    Meta meta;
-  };    
+  };
 
-  std::unordered_map<Product::Id, ProductWithMeta> mProductsWithMetasById;
+  struct IdOfProductWithMeta
+  {
+    IdType operator()(const ProductWithMeta &productWithMeta) const 
+    { 
+      if constexpr(kIsIdInline)
+      {
+        return productWithMeta.id;
+      }
+      else
+      {
+        return ProductTraits::IdOf(*productWithMeta.pProduct);
+      }
+    }
+  };
+
+  ProductsById mProductsWithMetasById;
 };
 
+//! Warehouse with the default (exclusive) locking policy
+using Warehouse = BasicWarehouse<>;
+
 #endif
\ No newline at end of file
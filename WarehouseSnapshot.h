@@ -0,0 +1,308 @@
+#ifndef _WAREHOUSE_SNAPSHOT_H
+#define _WAREHOUSE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the snapshot files are memory-mapped where POSIX mmap is available, otherwise they are read
+#if __has_include(<sys/mman.h>) && __has_include(<sys/stat.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WAREHOUSE_SNAPSHOT_MMAP 1
+#endif
+
+//! Binary format of the snapshots of the warehouse, see Warehouse::SaveSnapshot()
+//!
+//! The file consists of the sections, each of them starts at an offset that is a multiple of 8:
+//! - Header
+//! - ProducerRecord per producer, in the order of the producer handles
+//! - ProductRecord per product
+//! - string table with the ids, the names and the producers, which the records refer to
+//!
+//! The integers are stored in the byte order of the writer, which is checked by the reader.
+//! The records keep the hashes of the ids, so the id index is rebuilt without hashing the ids,
+//! unless the reader hashes strings differently than the writer. The header keeps the checksum
+//! of the sections after it, so a corrupted record, e.g. a wrong hash of an id, is detected
+//! without hashing the ids.
+struct SnapshotFormat
+{
+  static constexpr char kMagic[8] = {'W', 'H', 'S', 'N', 'A', 'P', '\0', '\0'};
+  static constexpr uint32_t kVersion = 2;
+  static constexpr uint32_t kByteOrderMark = 0x01020304;
+
+  //! String hashed by the writer and by the reader to find out if their hashes of the ids match
+  static constexpr std::string_view kHashProbe = "warehouse snapshot hash probe";
+
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint64_t hashProbe;       //!< hash of kHashProbe computed by the writer
+    uint64_t cntProducers;
+    uint64_t cntProducts;
+    uint64_t stringsSize;     //!< size of the string table in bytes
+    uint64_t checksum;        //!< Checksum of the sections after the header
+  };
+
+  struct ProducerRecord
+  {
+    uint64_t nameOffset;
+    uint32_t nameLength;
+    uint32_t reserved;
+  };
+
+  struct ProductRecord
+  {
+    uint64_t idHash;          //!< hash of the id computed by the writer
+    uint64_t idOffset;
+    uint64_t nameOffset;
+    uint32_t idLength;
+    uint32_t nameLength;
+    uint32_t producer;        //!< index of the ProducerRecord of the producer
+    uint32_t price;
+  };
+
+  static constexpr uint64_t Align(uint64_t size) { return (size + 7) / 8 * 8; }
+
+  //! Checksum of a sequence of bytes, which is mixed in by 8-byte words, so it is computed much
+  //! faster than the hashes of the ids; a changed word always changes the checksum
+  //!
+  //! The bytes may be added in pieces of any sizes, the checksum of a sequence whose size is not
+  //! a multiple of 8 includes its last word only after it is completed by the next bytes.
+  class Checksum
+  {
+  public:
+    void Update(const char *pData, size_t size)
+    {
+      for(; mCntBytes != 0 && size != 0; ++pData, --size)
+      {
+        AddByte(*pData);
+      }
+      for(; size >= sizeof(uint64_t); pData += sizeof(uint64_t), size -= sizeof(uint64_t))
+      {
+        Mix(LoadWord(pData));
+      }
+      for(; size != 0; ++pData, --size)
+      {
+        AddByte(*pData);
+      }
+    }
+
+    uint64_t Value() const { return mValue; }
+
+  private:
+    //! Word of 8 bytes in the little-endian order, so the checksum does not depend on the alignment
+    static uint64_t LoadWord(const char *pData)
+    {
+      uint64_t word = 0;
+      for(size_t i = 0; i < sizeof(word); ++i)
+      {
+        word |= uint64_t(static_cast<unsigned char>(pData[i])) << (8 * i);
+      }
+      return word;
+    }
+
+    void AddByte(char byte)
+    {
+      mWord |= uint64_t(static_cast<unsigned char>(byte)) << (8 * mCntBytes);
+      if(++mCntBytes == sizeof(uint64_t))
+      {
+        Mix(mWord);
+        mWord = 0;
+        mCntBytes = 0;
+      }
+    }
+
+    //! Both steps are bijective, so the value after a changed word differs and stays different
+    void Mix(uint64_t word)
+    {
+      mValue = (mValue ^ word) * 0x100000001B3ull;
+      mValue ^= mValue >> 29;
+    }
+
+    uint64_t mValue = 0xCBF29CE484222325ull;
+    uint64_t mWord = 0;
+    size_t mCntBytes = 0;
+  };
+
+  //! Offsets of the sections of a snapshot with the given \p header, the last one is the file size
+  struct Layout
+  {
+    uint64_t producersOffset;
+    uint64_t productsOffset;
+    uint64_t stringsOffset;
+    uint64_t fileSize;
+  };
+
+  //! Layout of a snapshot with the given \p header
+  //!
+  //! \return false if the sizes of the sections overflow
+  static bool LayoutOf(const Header &header, Layout &layout)
+  {
+    const uint64_t kMaxCount = UINT64_MAX / 64;
+    if(header.cntProducers > kMaxCount || header.cntProducts > kMaxCount || header.stringsSize > kMaxCount)
+    {
+      return false;
+    }
+    layout.producersOffset = Align(sizeof(Header));
+    layout.productsOffset = layout.producersOffset + Align(header.cntProducers * sizeof(ProducerRecord));
+    layout.stringsOffset = layout.productsOffset + Align(header.cntProducts * sizeof(ProductRecord));
+    layout.fileSize = layout.stringsOffset + Align(header.stringsSize);
+    return true;
+  }
+};
+
+//! Writer of a snapshot file
+//!
+//! The file is written under a temporary name and renamed on Commit(), so an existing
+//! snapshot is replaced only by a completely written one. The header is written again on
+//! Commit() with the checksum of the written sections.
+class SnapshotWriter
+{
+public:
+  //! Start the snapshot with the given path \p path by the header \p header
+  SnapshotWriter(const std::string &path, const SnapshotFormat::Header &header):
+    mPath(path), mTmpPath(path + ".tmp"), mFile(mTmpPath, std::ios::binary | std::ios::trunc), mHeader(header)
+  {
+    static_assert(sizeof(SnapshotFormat::Header) == SnapshotFormat::Align(sizeof(SnapshotFormat::Header)),
+      "the checksummed sections start right after the header");
+    mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+    mSize = sizeof(mHeader);
+  }
+
+  ~SnapshotWriter()
+  {
+    if(!mCommitted)
+    {
+      mFile.close();
+      std::remove(mTmpPath.c_str());
+    }
+  }
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter& operator=(const SnapshotWriter &) = delete;
+
+  void Write(const void *pData, size_t size)
+  {
+    mFile.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+    mChecksum.Update(static_cast<const char*>(pData), size);
+    mSize += size;
+  }
+
+  //! Write zeros up to the start of the next section
+  void Pad()
+  {
+    static const char kZeros[8] = {};
+    Write(kZeros, SnapshotFormat::Align(mSize) - mSize);
+  }
+
+  //! Finish the file and replace the snapshot with it
+  //!
+  //! \return false if the file could not be written
+  bool Commit()
+  {
+    mHeader.checksum = mChecksum.Value();
+    mFile.seekp(0);
+    mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+    mFile.close();
+    mCommitted = !mFile.fail() && std::rename(mTmpPath.c_str(), mPath.c_str()) == 0;
+    return mCommitted;
+  }
+
+private:
+  std::string mPath;
+  std::string mTmpPath;
+  std::ofstream mFile;
+  SnapshotFormat::Header mHeader;
+  SnapshotFormat::Checksum mChecksum;   //!< checksum of the bytes written after the header
+  uint64_t mSize = 0;
+  bool mCommitted = false;
+};
+
+//! Read-only content of a snapshot file, which is memory-mapped where possible
+class SnapshotFile
+{
+public:
+  SnapshotFile() = default;
+
+  ~SnapshotFile()
+  {
+#ifdef WAREHOUSE_SNAPSHOT_MMAP
+    if(mpMapping)
+    {
+      munmap(mpMapping, mSize);
+    }
+#endif
+  }
+
+  SnapshotFile(const SnapshotFile &) = delete;
+  SnapshotFile& operator=(const SnapshotFile &) = delete;
+
+  //! Map or read the file with the given path \p path
+  //!
+  //! \return false if the file could not be opened or read
+  bool Open(const std::string &path)
+  {
+#ifdef WAREHOUSE_SNAPSHOT_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+      return false;
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    mSize = static_cast<size_t>(st.st_size);
+    if(mSize != 0)
+    {
+      void *pMapping = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(pMapping != MAP_FAILED)
+      {
+        // the file is read from the beginning to the end, by the checksum and then by the records
+        ::madvise(pMapping, mSize, MADV_SEQUENTIAL);
+        mpMapping = pMapping;
+        mpData = static_cast<const char*>(pMapping);
+      }
+    }
+    ::close(fd);
+    if(mpMapping || mSize == 0)
+    {
+      return true;
+    }
+#endif
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+      return false;
+    }
+    mBuffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(mBuffer.data(), static_cast<std::streamsize>(mBuffer.size()));
+    mpData = mBuffer.data();
+    mSize = mBuffer.size();
+    return static_cast<bool>(file);
+  }
+
+  const char* data() const { return mpData; }
+  size_t size() const { return mSize; }
+
+private:
+  void *mpMapping = nullptr;
+  std::vector<char> mBuffer;
+  const char *mpData = nullptr;
+  size_t mSize = 0;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef _WAREHOUSE_STATS_H
+#define _WAREHOUSE_STATS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+// define WAREHOUSE_STATS to collect the stats of the warehouse operations, see BasicWarehouse::GetStats();
+// otherwise nothing is measured and the instrumentation compiles to the bare locks
+#ifdef WAREHOUSE_STATS
+#include <atomic>
+#include <chrono>
+#endif
+
+//! Operations of the warehouse that are measured, see WarehouseStats
+enum class WarehouseOperation
+{
+  AddProduct,
+  AddProducts,
+  UpsertProduct,
+  UpdatePrice,
+  FindProductById,
+  VisitProductById,
+  FindProductsByIds,
+  FindProductsByProducer,
+  FindProductsByPriceRange,
+  FindProductsByNamePrefix,
+  FindProductsByNameSubstring,
+  ForEachProductOfProducer,
+  SnapshotProducts,
+  SnapshotProductsByProducer,
+  GetPriceStats,
+  GetPriceStatsByProducer,
+  GetPriceHistogram,
+  CountProductsByProducer,
+  GetProducerHandle,
+  InternProducer,         //!< GetProducerHandle() of a producer that is not known yet
+  RemoveProductById,
+  RemoveProductsById,
+  ReapExpiredProducts,
+  SaveSnapshot,
+  LoadSnapshot,
+  Count
+};
+
+//! Name of the given operation \p operation
+inline const char* WarehouseOperationName(WarehouseOperation operation)
+{
+  static const char *const kNames[] = {"AddProduct", "AddProducts", "UpsertProduct", "UpdatePrice",
+    "FindProductById", "VisitProductById", "FindProductsByIds", "FindProductsByProducer", "FindProductsByPriceRange",
+    "FindProductsByNamePrefix", "FindProductsByNameSubstring", "ForEachProductOfProducer", "SnapshotProducts",
+    "SnapshotProductsByProducer", "GetPriceStats", "GetPriceStatsByProducer", "GetPriceHistogram",
+    "CountProductsByProducer", "GetProducerHandle", "InternProducer", "RemoveProductById", "RemoveProductsById",
+    "ReapExpiredProducts", "SaveSnapshot", "LoadSnapshot"};
+  static_assert(std::size(kNames) == static_cast<size_t>(WarehouseOperation::Count), "a name per operation");
+
+  return kNames[static_cast<size_t>(operation)];
+}
+
+//! Stats of a warehouse, see BasicWarehouse::GetStats()
+struct WarehouseStats
+{
+  static constexpr size_t kCntOperations = static_cast<size_t>(WarehouseOperation::Count);
+
+  //! Distribution of values over the buckets of powers of 2: the bucket 0 counts the zeros,
+  //! the bucket i counts the values from [2^(i-1), 2^i), the last one counts the larger values as well
+  struct Histogram
+  {
+    static constexpr size_t kCntBuckets = 40;
+
+    uint64_t count = 0;   //!< number of the values
+    uint64_t sum = 0;     //!< sum of the values
+    std::array<uint64_t, kCntBuckets> buckets{};
+
+    //! Bucket of the given value \p value
+    static size_t BucketOf(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+      const size_t width = value? static_cast<size_t>(64 - __builtin_clzll(value)) : 0;
+#else
+      size_t width = 0;
+      for(; value; value >>= 1)
+      {
+        ++width;
+      }
+#endif
+      return (width < kCntBuckets)? width : kCntBuckets - 1;
+    }
+
+    //! The largest value of the given bucket \p bucket
+    static uint64_t UpperBoundOf(size_t bucket)
+    {
+      return (bucket + 1 < kCntBuckets)? (uint64_t(1) << bucket) - 1 : std::numeric_limits<uint64_t>::max();
+    }
+
+    //! Mean of the values, 0 if there are no values
+    double Mean() const
+    {
+      return count? static_cast<double>(sum) / count : 0.0;
+    }
+
+    //! Upper bound of the given quantile \p quantile of the values, which is accurate up to a factor of 2
+    //!
+    //! \pre 0 <= \p quantile <= 1
+    uint64_t Quantile(double quantile) const
+    {
+      const double rank = quantile * count;
+      uint64_t cnt = 0;
+      for(size_t bucket = 0; bucket < kCntBuckets; ++bucket)
+      {
+        cnt += buckets[bucket];
+        if(cnt != 0 && cnt >= rank)
+        {
+          return UpperBoundOf(bucket);
+        }
+      }
+      return 0;
+    }
+
+    Histogram& operator+=(const Histogram &other)
+    {
+      count += other.count;
+      sum += other.sum;
+      for(size_t bucket = 0; bucket < kCntBuckets; ++bucket)
+      {
+        buckets[bucket] += other.buckets[bucket];
+      }
+      return *this;
+    }
+  };
+
+  //! Stats of one operation; the time is in nanoseconds
+  struct Operation
+  {
+    Histogram latency;      //!< time of the calls, including waiting for the lock
+    uint64_t lockWait = 0;  //!< total time of waiting for the lock of the warehouse
+    uint64_t lockHold = 0;  //!< total time of holding the lock of the warehouse
+
+    Operation& operator+=(const Operation &other)
+    {
+      latency += other.latency;
+      lockWait += other.lockWait;
+      lockHold += other.lockHold;
+      return *this;
+    }
+  };
+
+  //! true if the warehouse was compiled with WAREHOUSE_STATS, otherwise only the sizes are set
+  bool enabled = false;
+
+  std::array<Operation, kCntOperations> operations;
+
+  //! Numbers of the products found by FindProductsByProducer() for the known producers,
+  //! without the paginated calls
+  Histogram producerResultSizes;
+
+  size_t cntProducts = 0;
+  size_t cntProducers = 0;
+  size_t idIndexCapacity = 0;     //!< number of slots of the id index
+  size_t cntIdIndexRehashes = 0;  //!< see FlatHashTable::rehash_count()
+  size_t cntEvictions = 0;        //!< number of the evicted products, see BasicWarehouse::SetCapacity()
+
+  const Operation& operator[](WarehouseOperation operation) const
+  {
+    return operations[static_cast<size_t>(operation)];
+  }
+
+  //! Ratio of the products to the slots of the id index
+  double IdIndexLoadFactor() const
+  {
+    return idIndexCapacity? static_cast<double>(cntProducts) / idIndexCapacity : 0.0;
+  }
+
+  //! Add the stats of an other warehouse \p other, e.g. of another shard
+  WarehouseStats& operator+=(const WarehouseStats &other)
+  {
+    enabled = enabled || other.enabled;
+    for(size_t i = 0; i < kCntOperations; ++i)
+    {
+      operations[i] += other.operations[i];
+    }
+    producerResultSizes += other.producerResultSizes;
+    cntProducts += other.cntProducts;
+    cntProducers += other.cntProducers;
+    idIndexCapacity += other.idIndexCapacity;
+    cntIdIndexRehashes += other.cntIdIndexRehashes;
+    cntEvictions += other.cntEvictions;
+    return *this;
+  }
+};
+
+#ifdef WAREHOUSE_STATS
+
+//! Counters of the operations of a warehouse
+//!
+//! The counters are split into stripes on separate cache lines, and every thread updates the
+//! stripe it is assigned to on its first measurement, so the threads do not contend for the
+//! counters, unless there are more threads than stripes. The stripes are summed up on Collect().
+class WarehouseStatsCollector
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  WarehouseStatsCollector() = default;
+  WarehouseStatsCollector(const WarehouseStatsCollector &) = delete;
+  WarehouseStatsCollector& operator=(const WarehouseStatsCollector &) = delete;
+
+  //! Record a call of the given operation \p operation, which started at \p start, took the
+  //! lock at \p locked and released it at \p unlocked
+  void RecordOperation(WarehouseOperation operation, Clock::time_point start, Clock::time_point locked,
+    Clock::time_point unlocked)
+  {
+    auto &counters = mStripes[StripeOfThread()].operations[static_cast<size_t>(operation)];
+    counters.latency.Record(NanosecondsBetween(start, unlocked));
+    counters.lockWait.fetch_add(NanosecondsBetween(start, locked), std::memory_order_relaxed);
+    counters.lockHold.fetch_add(NanosecondsBetween(locked, unlocked), std::memory_order_relaxed);
+  }
+
+  //! Record the number \p cntProducts of the products found by FindProductsByProducer()
+  void RecordProducerResultSize(size_t cntProducts)
+  {
+    mStripes[StripeOfThread()].producerResultSizes.Record(cntProducts);
+  }
+
+  //! Add the counters to the given stats \p stats
+  //!
+  //! The counters are read without stopping the measurements, so the stats of the calls that
+  //! are in progress may be partially included.
+  void Collect(WarehouseStats &stats) const
+  {
+    stats.enabled = true;
+    for(const Stripe &stripe : mStripes)
+    {
+      for(size_t i = 0; i < WarehouseStats::kCntOperations; ++i)
+      {
+        const auto &counters = stripe.operations[i];
+        counters.latency.AddTo(stats.operations[i].latency);
+        stats.operations[i].lockWait += counters.lockWait.load(std::memory_order_relaxed);
+        stats.operations[i].lockHold += counters.lockHold.load(std::memory_order_relaxed);
+      }
+      stripe.producerResultSizes.AddTo(stats.producerResultSizes);
+    }
+  }
+
+private:
+  static constexpr size_t kCntStripes = 8;
+
+  struct HistogramCounters
+  {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::array<std::atomic<uint64_t>, WarehouseStats::Histogram::kCntBuckets> buckets{};
+
+    void Record(uint64_t value)
+    {
+      count.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(value, std::memory_order_relaxed);
+      buckets[WarehouseStats::Histogram::BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void AddTo(WarehouseStats::Histogram &histogram) const
+    {
+      histogram.count += count.load(std::memory_order_relaxed);
+      histogram.sum += sum.load(std::memory_order_relaxed);
+      for(size_t bucket = 0; bucket < buckets.size(); ++bucket)
+      {
+        histogram.buckets[bucket] += buckets[bucket].load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  struct OperationCounters
+  {
+    HistogramCounters latency;
+    std::atomic<uint64_t> lockWait{0};
+    std::atomic<uint64_t> lockHold{0};
+  };
+
+  struct alignas(64) Stripe
+  {
+    std::array<OperationCounters, WarehouseStats::kCntOperations> operations;
+    HistogramCounters producerResultSizes;
+  };
+
+  //! Stripe of the calling thread, the threads are assigned to the stripes round-robin
+  static size_t StripeOfThread()
+  {
+    static std::atomic<size_t> cntThreads{0};
+    thread_local const size_t stripe = cntThreads.fetch_add(1, std::memory_order_relaxed) % kCntStripes;
+    return stripe;
+  }
+
+  static uint64_t NanosecondsBetween(Clock::time_point from, Clock::time_point to)
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+  }
+
+  std::array<Stripe, kCntStripes> mStripes;
+};
+
+//! Lock of the mutex of a warehouse, which records the operation executed under it
+//!
+//! \tparam Lock lock of the locking policy of the warehouse
+template <typename Lock>
+class MeasuredLock
+{
+  using Clock = WarehouseStatsCollector::Clock;
+
+public:
+  template <typename Mutex>
+  MeasuredLock(Mutex &mutex, WarehouseStatsCollector &stats, WarehouseOperation operation):
+    mStats(stats), mOperation(operation), mStart(Clock::now()), mLock(mutex), mLocked(Clock::now())
+  {
+  }
+
+  ~MeasuredLock()
+  {
+    // the lock is still held, which is included into the hold time
+    mStats.RecordOperation(mOperation, mStart, mLocked, Clock::now());
+  }
+
+  MeasuredLock(const MeasuredLock &) = delete;
+  MeasuredLock& operator=(const MeasuredLock &) = delete;
+
+private:
+  WarehouseStatsCollector &mStats;
+  WarehouseOperation mOperation;
+  Clock::time_point mStart;
+  Lock mLock;
+  Clock::time_point mLocked;
+};
+
+#else
+
+//! Counters of the operations of a warehouse, which are not collected without WAREHOUSE_STATS
+class WarehouseStatsCollector
+{
+public:
+  void RecordProducerResultSize(size_t) {}
+  void Collect(WarehouseStats &) const {}
+};
+
+//! Lock of the mutex of a warehouse, which is the bare lock without WAREHOUSE_STATS
+template <typename Lock>
+class MeasuredLock
+{
+public:
+  template <typename Mutex>
+  MeasuredLock(Mutex &mutex, WarehouseStatsCollector &, WarehouseOperation): mLock(mutex) {}
+
+private:
+  Lock mLock;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#ifndef WAREHOUSE_STATS
+#define WAREHOUSE_STATS
+#endif
+#include "doctest.h"
+#include "Warehouse.h"
+#include "ShardedWarehouse.h"
+
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<class... Args>
+std::shared_ptr<Product> MakeProduct(Args&&... args)
+{
+  return std::make_shared<Product>(Product{std::forward<Args>(args)...});
+}
+
+TEST_CASE("histograms of the warehouse stats") {
+
+  using Histogram = WarehouseStats::Histogram;
+
+  CHECK(Histogram::BucketOf(0) == 0);
+  CHECK(Histogram::BucketOf(1) == 1);
+  CHECK(Histogram::BucketOf(2) == 2);
+  CHECK(Histogram::BucketOf(3) == 2);
+  CHECK(Histogram::BucketOf(1024) == 11);
+  CHECK(Histogram::BucketOf(UINT64_MAX) == Histogram::kCntBuckets - 1);
+  CHECK(Histogram::UpperBoundOf(0) == 0);
+  CHECK(Histogram::UpperBoundOf(11) == 2047);
+  CHECK(Histogram::UpperBoundOf(Histogram::kCntBuckets - 1) == UINT64_MAX);
+
+  Histogram histogram;
+  CHECK(histogram.Quantile(0.5) == 0);
+  CHECK(histogram.Mean() == 0.0);
+  for(uint64_t value : {0, 1, 5, 6, 7, 100})
+  {
+    histogram.buckets[Histogram::BucketOf(value)]++;
+    histogram.count++;
+    histogram.sum += value;
+  }
+  CHECK(histogram.Mean() == doctest::Approx(119.0 / 6));
+  CHECK(histogram.Quantile(0) == 0);
+  CHECK(histogram.Quantile(0.5) == 7);
+  CHECK(histogram.Quantile(0.9) == 127);
+
+  Histogram sum = histogram;
+  sum += histogram;
+  CHECK(sum.count == 12);
+  CHECK(sum.buckets[3] == 6);
+}
+
+TEST_CASE("collecting the stats of the warehouse") {
+
+  Warehouse wh;
+
+  const WarehouseStats empty = wh.GetStats();
+  CHECK(empty.enabled);
+  CHECK(empty[WarehouseOperation::AddProduct].latency.count == 0);
+  CHECK(empty.IdIndexLoadFactor() == 0.0);
+
+  for(int i = 0; i < 1000; ++i)
+  {
+    wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 10), "name", 1u));
+  }
+  wh.AddProduct(MakeProduct("id0", "producer", "name", 1u));
+  std::vector<Warehouse::ProductPtr> found;
+  wh.FindProductsByProducer("producer1", std::back_inserter(found));
+  wh.FindProductsByProducer(wh.GetProducerHandle("producer2"), std::back_inserter(found));
+  wh.FindProductsByProducer("producer3", 2, 3, std::back_inserter(found));
+  wh.FindProductsByProducer("unknown", std::back_inserter(found));
+  wh.FindProductById("id1");
+  wh.GetProducerHandle("new producer");
+  wh.RemoveProductById("id1");
+
+  const WarehouseStats stats = wh.GetStats();
+  CHECK(stats[WarehouseOperation::AddProduct].latency.count == 1001);
+  CHECK(stats[WarehouseOperation::FindProductsByProducer].latency.count == 4);
+  CHECK(stats[WarehouseOperation::FindProductById].latency.count == 1);
+  CHECK(stats[WarehouseOperation::GetProducerHandle].latency.count == 2);
+  CHECK(stats[WarehouseOperation::InternProducer].latency.count == 1);
+  CHECK(stats[WarehouseOperation::RemoveProductById].latency.count == 1);
+  CHECK(stats[WarehouseOperation::UpdatePrice].latency.count == 0);
+
+  // the latency includes both waiting for the lock and holding it
+  const auto &adding = stats[WarehouseOperation::AddProduct];
+  CHECK(adding.latency.sum >= adding.lockWait + adding.lockHold);
+  CHECK(adding.lockHold > 0);
+
+  // the unknown producer is not counted, the producer of 100 products is, the range finds none
+  CHECK(stats.producerResultSizes.count == 3);
+  CHECK(stats.producerResultSizes.sum == 200);
+  CHECK(stats.producerResultSizes.buckets[0] == 1);
+  CHECK(stats.producerResultSizes.buckets[WarehouseStats::Histogram::BucketOf(100)] == 2);
+
+  CHECK(stats.cntProducts == 999);
+  CHECK(stats.cntProducers == 11);
+  CHECK(stats.idIndexCapacity >= 1024);
+  CHECK(stats.IdIndexLoadFactor() <= 0.875);
+  CHECK(stats.cntIdIndexRehashes > 0);
+
+  SUBCASE("the copy starts with empty counters") {
+    const Warehouse copy(wh);
+    const WarehouseStats statsOfCopy = copy.GetStats();
+    CHECK(statsOfCopy[WarehouseOperation::AddProduct].latency.count == 0);
+    CHECK(statsOfCopy.cntProducts == 999);
+  }
+
+  SUBCASE("reserving the id index by bulk loading avoids the rehashes") {
+    std::vector<Warehouse::ProductPtr> products;
+    for(int i = 0; i < 1000; ++i)
+    {
+      products.push_back(MakeProduct("id" + std::to_string(i), "producer", "name", 1u));
+    }
+    Warehouse bulk;
+    bulk.AddProducts(products.begin(), products.end());
+    CHECK(bulk.GetStats().cntIdIndexRehashes == 0);
+    CHECK(bulk.GetStats()[WarehouseOperation::AddProducts].latency.count == 1);
+  }
+}
+
+TEST_CASE("collecting the stats of the warehouse used by several threads") {
+
+  BasicWarehouse<SharedLocking> wh;
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 12; ++t)
+  {
+    threads.emplace_back([&wh, t]() {
+      for(int i = 0; i < 100; ++i)
+      {
+        wh.AddProduct(MakeProduct(std::to_string(t) + "_" + std::to_string(i), "producer", "name", 1u));
+        wh.CountProductsByProducer("producer");
+      }
+    });
+  }
+  for(auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  // the counters of the threads sharing the stripes are not lost
+  const WarehouseStats stats = wh.GetStats();
+  CHECK(stats[WarehouseOperation::AddProduct].latency.count == 1200);
+  CHECK(stats[WarehouseOperation::CountProductsByProducer].latency.count == 1200);
+}
+
+TEST_CASE("collecting the stats of the sharded warehouse") {
+
+  ShardedWarehouse<4> wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", 1u));
+  }
+  std::vector<Warehouse::ProductPtr> found;
+  CHECK(wh.FindProductsByProducer("producer", std::back_inserter(found)) == 100);
+
+  const WarehouseStats stats = wh.GetStats();
+  CHECK(stats.cntProducts == 100);
+  CHECK(stats.cntProducers == 4);
+  CHECK(stats[WarehouseOperation::AddProduct].latency.count == 100);
+  CHECK(stats[WarehouseOperation::FindProductsByProducer].latency.count == 4);
+  CHECK(stats.producerResultSizes.sum == 100);
+}
@@ -0,0 +1,905 @@
+//! Benchmarks of the warehouses
+//!
+//! Usage: Warehouse_bench [sizes] [threads]
+//! - sizes:   comma-separated numbers of products in the catalog, 1000,100000,1000000 by default
+//! - threads: comma-separated numbers of threads of the mixed workload, 1,2,4 by default
+//!
+//! Every benchmark reports the throughput of the whole run and the percentiles of the
+//! latencies of single operations. The latencies include the cost of reading the clock,
+//! which is a few tens of nanoseconds. An empty thread count list skips the mixed workload,
+//! e.g. Warehouse_bench 1000000,10000000 "" compares the id indexes at 1M and 10M products.
+//!
+//! The memory is counted by the replaced global operator new, so the bytes per product of
+//! AddProduct are the bytes of the indexes and the bytes per product of MakeProduct are
+//! the bytes of the products themselves.
+
+#include "AsyncWarehouse.h"
+#include "CompactProduct.h"
+#include "ShardedWarehouse.h"
+#include "SkuProduct.h"
+#include "Warehouse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+//! Bytes allocated by the global operator new and not deallocated yet
+std::atomic<size_t> gBytesInUse{0};
+
+//! Every allocation is prefixed with its size, the prefix keeps the alignment of the allocation
+constexpr size_t kPrefixSize = alignof(std::max_align_t);
+
+void* Allocate(size_t size, size_t alignment)
+{
+  const size_t prefixSize = std::max(kPrefixSize, alignment);
+  void *p = std::aligned_alloc(prefixSize, (prefixSize + size + prefixSize - 1) / prefixSize * prefixSize);
+  if(!p)
+  {
+    throw std::bad_alloc();
+  }
+  gBytesInUse += size;
+  char *pData = static_cast<char*>(p) + prefixSize;
+  reinterpret_cast<size_t*>(pData)[-1] = size;
+  reinterpret_cast<size_t*>(pData)[-2] = prefixSize;
+  return pData;
+}
+
+void Deallocate(void *p) noexcept
+{
+  if(!p)
+  {
+    return;
+  }
+  char *pData = static_cast<char*>(p);
+  gBytesInUse -= reinterpret_cast<size_t*>(pData)[-1];
+  std::free(pData - reinterpret_cast<size_t*>(pData)[-2]);
+}
+
+} // namespace
+
+void* operator new(size_t size) { return Allocate(size, kPrefixSize); }
+void* operator new[](size_t size) { return Allocate(size, kPrefixSize); }
+void* operator new(size_t size, std::align_val_t alignment) { return Allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return Allocate(size, static_cast<size_t>(alignment)); }
+void operator delete(void *p) noexcept { Deallocate(p); }
+void operator delete[](void *p) noexcept { Deallocate(p); }
+void operator delete(void *p, size_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, size_t) noexcept { Deallocate(p); }
+void operator delete(void *p, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { Deallocate(p); }
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using ProductPtr = Warehouse::ProductPtr;
+
+std::string_view IdOf(const ProductPtr &pProduct) { return pProduct->id; }
+std::string_view IdOf(const CompactProductPtr &pProduct) { return pProduct->id(); }
+
+//! Latencies of single operations, in nanoseconds
+using Latencies = std::vector<uint64_t>;
+
+//! Run \p op and append its latency to \p latencies
+template <typename Op>
+void Measure(Latencies &latencies, Op &&op)
+{
+  const auto start = Clock::now();
+  op();
+  latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+uint64_t Percentile(const Latencies &sortedLatencies, double percentile)
+{
+  if(sortedLatencies.empty())
+  {
+    return 0;
+  }
+  return sortedLatencies[std::min(sortedLatencies.size() - 1, size_t(sortedLatencies.size() * percentile))];
+}
+
+//! Print one row of the report, \p bytesPerProduct is negative if the memory is not reported
+void Report(const char *benchmark, const char *warehouse, size_t cntProducts, size_t cntThreads,
+  Latencies latencies, Clock::duration elapsed, double bytesPerProduct = -1)
+{
+  std::sort(latencies.begin(), latencies.end());
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  std::printf("%-26s %-14s %10zu %7zu %14.0f %8llu %8llu", benchmark, warehouse, cntProducts, cntThreads,
+    (seconds > 0)? latencies.size() / seconds : 0.0,
+    static_cast<unsigned long long>(Percentile(latencies, 0.5)),
+    static_cast<unsigned long long>(Percentile(latencies, 0.99)));
+  if(bytesPerProduct >= 0)
+  {
+    std::printf(" %13.1f", bytesPerProduct);
+  }
+  std::printf("\n");
+}
+
+//! Catalog of products, made before any warehouse is measured
+template <typename Ptr>
+struct BasicCatalog
+{
+  std::vector<Ptr> products;              //!< products of the catalog, in random order
+  std::vector<Ptr> extraProducts;         //!< products out of the catalog, added by the mixed workload
+  std::vector<std::string> producers;     //!< producers, the first ones have the most products
+  double bytesPerProduct = 0;
+};
+
+using Catalog = BasicCatalog<ProductPtr>;
+
+//! Make a catalog of \p cntProducts products with skewed producer sizes
+//!
+//! There are about cntProducts/100 producers, the producer of a product is picked by
+//! a power law, so a few producers own a large part of the catalog and most own a few products.
+Catalog MakeCatalog(size_t cntProducts, std::mt19937_64 &random)
+{
+  Catalog catalog;
+  const size_t cntProducers = std::max<size_t>(1, cntProducts / 100);
+  for(size_t i = 0; i < cntProducers; ++i)
+  {
+    catalog.producers.push_back("producer" + std::to_string(i));
+  }
+
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  auto makeProducts = [&](std::vector<ProductPtr> &products, const char *idPrefix, size_t cnt) {
+    products.reserve(cnt);
+    for(size_t i = 0; i < cnt; ++i)
+    {
+      const size_t producer = std::min(cntProducers - 1, size_t(cntProducers * std::pow(uniform(random), 4.0)));
+      products.push_back(std::make_shared<Product>(
+        Product{idPrefix + std::to_string(i), catalog.producers[producer], "name", unsigned(random() % 1000)}));
+    }
+  };
+
+  const size_t bytesBefore = gBytesInUse;
+  makeProducts(catalog.products, "id", cntProducts);
+  catalog.bytesPerProduct = double(gBytesInUse - bytesBefore - cntProducts * sizeof(ProductPtr)) / cntProducts;
+  makeProducts(catalog.extraProducts, "extra", std::max<size_t>(1, cntProducts / 10));
+
+  std::shuffle(catalog.products.begin(), catalog.products.end(), random);
+  return catalog;
+}
+
+//! Copy of the catalog \p catalog with the same products made as compact ones
+BasicCatalog<CompactProductPtr> MakeCompactCatalog(const Catalog &catalog)
+{
+  BasicCatalog<CompactProductPtr> compactCatalog;
+  compactCatalog.producers = catalog.producers;
+  auto makeProducts = [](std::vector<CompactProductPtr> &compactProducts, const std::vector<ProductPtr> &products) {
+    compactProducts.reserve(products.size());
+    for(const ProductPtr &pProduct : products)
+    {
+      compactProducts.push_back(MakeCompactProduct(pProduct->id, pProduct->producer, pProduct->name, pProduct->price));
+    }
+  };
+
+  const size_t bytesBefore = gBytesInUse;
+  makeProducts(compactCatalog.products, catalog.products);
+  compactCatalog.bytesPerProduct = double(gBytesInUse - bytesBefore) / catalog.products.size() - sizeof(CompactProductPtr);
+  makeProducts(compactCatalog.extraProducts, catalog.extraProducts);
+  return compactCatalog;
+}
+
+//! Ids of \p cntQueries products picked at random from \p products
+template <typename Ptr>
+std::vector<std::string> PickIds(const std::vector<Ptr> &products, size_t cntQueries, std::mt19937_64 &random)
+{
+  std::vector<std::string> ids;
+  ids.reserve(cntQueries);
+  for(size_t i = 0; i < cntQueries; ++i)
+  {
+    ids.emplace_back(IdOf(products[random() % products.size()]));
+  }
+  return ids;
+}
+
+//! Run the mixed workload on \p cntThreads threads: 90% of lookups by id, 5% of additions
+//! and 5% of removals, every thread adds and removes its own products
+template <typename WarehouseT>
+void BenchMixed(const char *name, WarehouseT &wh, const BasicCatalog<typename WarehouseT::ProductPtr> &catalog,
+  size_t cntThreads, size_t cntOpsPerThread)
+{
+  std::vector<Latencies> latenciesOfThreads(cntThreads);
+  std::atomic<size_t> cntReady{0};
+  std::atomic<bool> go{false};
+
+  std::vector<std::thread> threads;
+  for(size_t t = 0; t < cntThreads; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      std::mt19937_64 random(t + 1);
+      const std::vector<std::string> ids = PickIds(catalog.products, cntOpsPerThread, random);
+      Latencies &latencies = latenciesOfThreads[t];
+      latencies.reserve(cntOpsPerThread);
+
+      // the extra products are split between the threads, so their additions never clash
+      const size_t cntOwn = catalog.extraProducts.size() / cntThreads;
+      const auto *pOwn = catalog.extraProducts.data() + t * cntOwn;
+      size_t cntAdded = 0, cntRemoved = 0;
+
+      cntReady++;
+      while(!go)
+      {
+        std::this_thread::yield();
+      }
+
+      for(size_t i = 0; i < cntOpsPerThread; ++i)
+      {
+        const auto dice = random() % 100;
+        if(dice < 5 && cntAdded < cntOwn)
+        {
+          Measure(latencies, [&]() { wh.AddProduct(pOwn[cntAdded++]); });
+        }
+        else if(dice < 10 && cntRemoved < cntAdded)
+        {
+          Measure(latencies, [&]() { wh.RemoveProductById(IdOf(pOwn[cntRemoved++])); });
+        }
+        else
+        {
+          Measure(latencies, [&]() { wh.FindProductById(ids[i]); });
+        }
+      }
+
+      // the products that are still added are removed, so the next run starts over
+      for(; cntRemoved < cntAdded; ++cntRemoved)
+      {
+        wh.RemoveProductById(IdOf(pOwn[cntRemoved]));
+      }
+    });
+  }
+
+  while(cntReady != cntThreads)
+  {
+    std::this_thread::yield();
+  }
+  const auto start = Clock::now();
+  go = true;
+  for(auto &thread : threads)
+  {
+    thread.join();
+  }
+  const auto elapsed = Clock::now() - start;
+
+  Latencies latencies;
+  for(const auto &latenciesOfThread : latenciesOfThreads)
+  {
+    latencies.insert(latencies.end(), latenciesOfThread.begin(), latenciesOfThread.end());
+  }
+  Report("Mixed 90/5/5", name, catalog.products.size(), cntThreads, std::move(latencies), elapsed);
+}
+
+//! Run all benchmarks on a warehouse of the type \p WarehouseT named \p name
+template <typename WarehouseT>
+void Bench(const char *name, const BasicCatalog<typename WarehouseT::ProductPtr> &catalog,
+  const std::vector<size_t> &threadCounts)
+{
+  const size_t cntProducts = catalog.products.size();
+  const size_t cntQueries = std::min<size_t>(cntProducts * 10, 1000000);
+  std::mt19937_64 random(42);
+
+  auto pWh = std::make_unique<WarehouseT>();
+  WarehouseT &wh = *pWh;
+
+  {
+    Latencies latencies;
+    latencies.reserve(cntProducts);
+    const size_t bytesBefore = gBytesInUse;
+    const auto start = Clock::now();
+    for(const auto &pProduct : catalog.products)
+    {
+      Measure(latencies, [&]() { wh.AddProduct(pProduct); });
+    }
+    const auto elapsed = Clock::now() - start;
+    // the latencies are not part of the warehouse
+    const double bytesPerProduct = double(gBytesInUse - bytesBefore - latencies.capacity() * sizeof(uint64_t)) / cntProducts;
+    Report("AddProduct", name, cntProducts, 1, std::move(latencies), elapsed, bytesPerProduct);
+  }
+
+  auto benchLookups = [&](const char *benchmark, const std::vector<std::string> &ids) {
+    Latencies latencies;
+    latencies.reserve(ids.size());
+    const auto start = Clock::now();
+    for(const auto &id : ids)
+    {
+      Measure(latencies, [&]() { wh.FindProductById(id); });
+    }
+    Report(benchmark, name, cntProducts, 1, std::move(latencies), Clock::now() - start);
+  };
+  benchLookups("FindProductById hit", PickIds(catalog.products, cntQueries, random));
+
+  {
+    // batches of the ids of a cart, looked up one by one and at once
+    const size_t kBatchSize = 100;
+    const std::vector<std::string> ids = PickIds(catalog.products, cntQueries, random);
+    std::vector<typename WarehouseT::ProductPtr> foundProducts;
+    foundProducts.reserve(kBatchSize);
+    auto benchBatches = [&](const char *benchmark, auto &&findBatch) {
+      Latencies latencies;
+      latencies.reserve(ids.size() / kBatchSize);
+      const auto start = Clock::now();
+      for(size_t i = 0; i + kBatchSize <= ids.size(); i += kBatchSize)
+      {
+        Measure(latencies, [&]() {
+          foundProducts.clear();
+          findBatch(ids.begin() + i, ids.begin() + i + kBatchSize);
+        });
+      }
+      Report(benchmark, name, cntProducts, 1, std::move(latencies), Clock::now() - start);
+    };
+    benchBatches("100 x FindProductById", [&](auto first, auto last) {
+      for(; first != last; ++first)
+      {
+        foundProducts.push_back(wh.FindProductById(*first));
+      }
+    });
+    benchBatches("FindProductsByIds (100)", [&](auto first, auto last) {
+      wh.FindProductsByIds(first, last, std::back_inserter(foundProducts));
+    });
+  }
+
+  std::vector<std::string> missingIds;
+  missingIds.reserve(cntQueries);
+  for(size_t i = 0; i < cntQueries; ++i)
+  {
+    missingIds.push_back("missing" + std::to_string(random() % cntProducts));
+  }
+  benchLookups("FindProductById miss", missingIds);
+
+  {
+    // the producers are queried uniformly, so most queries hit small producers and a few hit huge ones
+    const size_t cntProducerQueries = std::min<size_t>(cntQueries, 100000);
+    std::vector<size_t> producers;
+    for(size_t i = 0; i < cntProducerQueries; ++i)
+    {
+      producers.push_back(random() % catalog.producers.size());
+    }
+    std::vector<typename WarehouseT::ProductPtr> foundProducts;
+    size_t cntFound = 0;
+    Latencies latencies;
+    latencies.reserve(cntProducerQueries);
+    const auto start = Clock::now();
+    for(const size_t producer : producers)
+    {
+      Measure(latencies, [&]() {
+        foundProducts.clear();
+        cntFound += wh.FindProductsByProducer(catalog.producers[producer], std::back_inserter(foundProducts));
+      });
+    }
+    const auto elapsed = Clock::now() - start;
+    Report("FindProductsByProducer", name, cntProducts, 1, std::move(latencies), elapsed);
+    std::printf("%-26s %-14s %10zu %7s   products per query: %.1f\n", "", name, cntProducts, "",
+      double(cntFound) / cntProducerQueries);
+  }
+
+  {
+    // the prices are uniform in [0, 1000), so a range of one price finds about N/1000 products
+    const size_t cntPriceQueries = std::min<size_t>(cntQueries, 10000);
+    std::vector<typename WarehouseT::ProductPtr> foundProducts;
+    Latencies latencies;
+    latencies.reserve(cntPriceQueries);
+    const auto start = Clock::now();
+    for(size_t i = 0; i < cntPriceQueries; ++i)
+    {
+      const Product::Price price = random() % 1000;
+      Measure(latencies, [&]() {
+        foundProducts.clear();
+        wh.FindProductsByPriceRange(price, price, std::back_inserter(foundProducts));
+      });
+    }
+    Report("FindProductsByPriceRange", name, cntProducts, 1, std::move(latencies), Clock::now() - start);
+
+    // a tenth of the prices of the largest producer
+    latencies.clear();
+    const auto startOfProducer = Clock::now();
+    for(size_t i = 0; i < cntPriceQueries; ++i)
+    {
+      const Product::Price price = random() % 900;
+      Measure(latencies, [&]() {
+        foundProducts.clear();
+        wh.FindProductsByProducer(catalog.producers[0], price, price + 99, std::back_inserter(foundProducts));
+      });
+    }
+    Report("Producer+price range", name, cntProducts, 1, std::move(latencies), Clock::now() - startOfProducer);
+  }
+
+  for(const size_t cntThreads : threadCounts)
+  {
+    BenchMixed(name, wh, catalog, cntThreads, cntQueries / cntThreads);
+  }
+
+  {
+    std::vector<std::string> ids;
+    ids.reserve(cntProducts);
+    for(const auto &pProduct : catalog.products)
+    {
+      ids.emplace_back(IdOf(pProduct));
+    }
+    std::shuffle(ids.begin(), ids.end(), random);
+
+    Latencies latencies;
+    latencies.reserve(cntProducts);
+    const auto start = Clock::now();
+    for(const auto &id : ids)
+    {
+      Measure(latencies, [&]() { wh.RemoveProductById(id); });
+    }
+    Report("RemoveProductById", name, cntProducts, 1, std::move(latencies), Clock::now() - start);
+  }
+}
+
+//! Compare the warm start from a snapshot with loading the products in bulk, each is one operation
+void BenchSnapshot(const Catalog &catalog)
+{
+  const size_t cntProducts = catalog.products.size();
+  const std::string path = "Warehouse_bench.snapshot";
+
+  auto benchOnce = [cntProducts](const char *benchmark, auto &&op) {
+    Latencies latencies;
+    const auto start = Clock::now();
+    Measure(latencies, op);
+    Report(benchmark, "Warehouse", cntProducts, 1, std::move(latencies), Clock::now() - start);
+  };
+
+  Warehouse wh;
+  benchOnce("AddProducts (bulk)", [&]() { wh.AddProducts(catalog.products.begin(), catalog.products.end()); });
+  benchOnce("SaveSnapshot", [&]() { wh.SaveSnapshot(path); });
+
+  Warehouse loaded;
+  benchOnce("LoadSnapshot", [&]() { loaded.LoadSnapshot(path); });
+  std::remove(path.c_str());
+}
+
+//! Compare the latencies of the writers adding the products directly and through the queue of
+//! AsyncWarehouse, while two threads look the products up; the elapsed time of the queued
+//! additions includes the final Flush()
+void BenchAsync(const Catalog &catalog)
+{
+  const size_t cntProducts = catalog.products.size();
+  auto bench = [&](const char *benchmark, auto &wh, auto &&add) {
+    std::atomic<bool> isDone{false};
+    std::vector<std::thread> readers;
+    for(int t = 0; t < 2; ++t)
+    {
+      readers.emplace_back([&wh, &catalog, &isDone, t]() {
+        for(size_t i = t; !isDone.load(std::memory_order_relaxed); i += 7)
+        {
+          wh.FindProductById(catalog.products[i % catalog.products.size()]->id);
+        }
+      });
+    }
+
+    Latencies latencies;
+    latencies.reserve(cntProducts);
+    const auto start = Clock::now();
+    for(const ProductPtr &pProduct : catalog.products)
+    {
+      Measure(latencies, [&]() { add(pProduct); });
+    }
+    wh.Flush();
+    const auto elapsed = Clock::now() - start;
+    isDone = true;
+    for(auto &reader : readers)
+    {
+      reader.join();
+    }
+    Report(benchmark, "SharedLocking", cntProducts, 1, std::move(latencies), elapsed);
+  };
+
+  struct FlushedWarehouse: BasicWarehouse<SharedLocking>
+  {
+    void Flush() {}
+  };
+  FlushedWarehouse wh;
+  bench("AddProduct (readers)", wh, [&wh](const ProductPtr &pProduct) { wh.AddProduct(pProduct); });
+  AsyncWarehouse<BasicWarehouse<SharedLocking>> asyncWh;
+  bench("AddProductAsync (readers)", asyncWh, [&asyncWh](const ProductPtr &pProduct) {
+    asyncWh.AddProductAsync(pProduct, nullptr);
+  });
+}
+
+//! Compare the searches by the names with and without the name index, see Warehouse::EnableNameIndex()
+//!
+//! The names are three words of a vocabulary of 1000 pronounceable words, the prefixes are
+//! the first words with a letter of the second one and the substrings are 4 letters of the names.
+void BenchNames(const Catalog &catalog, std::mt19937_64 &random)
+{
+  const size_t cntProducts = catalog.products.size();
+  std::vector<std::string> words;
+  for(size_t i = 0; i < 1000; ++i)
+  {
+    std::string word;
+    for(size_t cntSyllables = 2 + random() % 2; cntSyllables > 0; --cntSyllables)
+    {
+      word += "bcdfghklmnprstvz"[random() % 16];
+      word += "aeiou"[random() % 5];
+    }
+    words.push_back(word);
+  }
+
+  std::vector<ProductPtr> products;
+  products.reserve(cntProducts);
+  for(const ProductPtr &pProduct : catalog.products)
+  {
+    const std::string name = words[random() % words.size()] + ' ' + words[random() % words.size()] + ' ' +
+      words[random() % words.size()];
+    products.push_back(std::make_shared<Product>(Product{pProduct->id, pProduct->producer, name, pProduct->price}));
+  }
+
+  Warehouse scanned;
+  scanned.AddProducts(products.begin(), products.end());
+  Warehouse indexed;
+  indexed.AddProducts(products.begin(), products.end());
+  const size_t bytesBefore = gBytesInUse;
+  indexed.EnableNameIndex();
+  const double bytesPerProduct = double(gBytesInUse - bytesBefore) / cntProducts;
+
+  const size_t cntQueries = std::min<size_t>(10000, std::max<size_t>(100, 1000000000 / (cntProducts * 100)));
+  std::vector<std::string> prefixes, substrings;
+  for(size_t i = 0; i < cntQueries; ++i)
+  {
+    const std::string &name = products[random() % cntProducts]->name;
+    prefixes.push_back(name.substr(0, name.find(' ') + 2));
+    substrings.push_back(name.substr(random() % (name.size() - 3), 4));
+  }
+
+  auto bench = [&](const char *benchmark, const char *warehouse, const std::vector<std::string> &patterns,
+    auto &&find, double bytes) {
+    std::vector<ProductPtr> foundProducts;
+    Latencies latencies;
+    latencies.reserve(patterns.size());
+    const auto start = Clock::now();
+    for(const std::string &pattern : patterns)
+    {
+      Measure(latencies, [&]() {
+        foundProducts.clear();
+        find(pattern, std::back_inserter(foundProducts));
+      });
+    }
+    Report(benchmark, warehouse, cntProducts, 1, std::move(latencies), Clock::now() - start, bytes);
+  };
+
+  // the autocomplete shows the first 10 products
+  bench("FindProductsByNamePrefix", "Warehouse", prefixes, [&](const std::string &prefix, auto out) {
+    scanned.FindProductsByNamePrefix(prefix, 10, out);
+  }, -1);
+  bench("FindProductsByNamePrefix", "NameIndex", prefixes, [&](const std::string &prefix, auto out) {
+    indexed.FindProductsByNamePrefix(prefix, 10, out);
+  }, bytesPerProduct);
+  bench("FindProductsByNameSubstr", "Warehouse", substrings, [&](const std::string &substring, auto out) {
+    scanned.FindProductsByNameSubstring(substring, 10, out);
+  }, -1);
+  bench("FindProductsByNameSubstr", "NameIndex", substrings, [&](const std::string &substring, auto out) {
+    indexed.FindProductsByNameSubstring(substring, 10, out);
+  }, bytesPerProduct);
+}
+
+//! Measure the full scans of the warehouse by the given numbers of threads, every scan is one
+//! operation; the scanning threads hash the names, so a scan is not bound by the snapshot only
+void BenchScan(const Catalog &catalog, const std::vector<size_t> &threadCounts)
+{
+  const size_t cntProducts = catalog.products.size();
+  Warehouse wh;
+  wh.AddProducts(catalog.products.begin(), catalog.products.end());
+
+  auto bench = [&](const char *benchmark, size_t cntThreads, auto &&scan) {
+    Latencies latencies;
+    const auto start = Clock::now();
+    for(int i = 0; i < 5; ++i)
+    {
+      Measure(latencies, scan);
+    }
+    Report(benchmark, "Warehouse", cntProducts, cntThreads, std::move(latencies), Clock::now() - start);
+  };
+
+  for(const size_t cntThreads : threadCounts)
+  {
+    const ScanPolicy policy{cntThreads};
+    std::atomic<size_t> checksum{0};
+    bench("ForEachProduct", cntThreads, [&]() {
+      wh.ForEachProduct(policy, [&checksum](const Product &product) {
+        if(std::hash<std::string>()(product.name) % 1000 == 0)
+        {
+          checksum.fetch_add(product.price, std::memory_order_relaxed);
+        }
+      });
+    });
+    bench("AggregateByProducer", cntThreads, [&]() {
+      wh.AggregateByProducer(policy, size_t(0), [](size_t sum, const Product &product) {
+        return sum + std::hash<std::string>()(product.name) % 1000 + product.price;
+      });
+    });
+  }
+}
+
+//! Compare the price analytics scanning the price index with the ones scanning the price
+//! columns, see Warehouse::EnablePriceColumns(); the bytes per product are of the columns
+void BenchPriceColumns(const Catalog &catalog)
+{
+  const size_t cntProducts = catalog.products.size();
+  Warehouse scanned;
+  scanned.AddProducts(catalog.products.begin(), catalog.products.end());
+  Warehouse columnar;
+  columnar.AddProducts(catalog.products.begin(), catalog.products.end());
+  const size_t bytesBefore = gBytesInUse;
+  columnar.EnablePriceColumns();
+  const double bytesPerProduct = double(gBytesInUse - bytesBefore) / cntProducts;
+
+  std::vector<Product::Price> bounds;
+  for(Product::Price bound = 1; bound < 1000; bound *= 2)
+  {
+    bounds.push_back(bound);
+  }
+
+  const size_t cntQueries = std::min<size_t>(1000, std::max<size_t>(5, 100000000 / cntProducts));
+  auto bench = [&](const char *benchmark, const char *warehouse, auto &&op, double bytes) {
+    Latencies latencies;
+    latencies.reserve(cntQueries);
+    const auto start = Clock::now();
+    for(size_t i = 0; i < cntQueries; ++i)
+    {
+      Measure(latencies, op);
+    }
+    Report(benchmark, warehouse, cntProducts, 1, std::move(latencies), Clock::now() - start, bytes);
+  };
+
+  // the results are summed, so the scans are not optimized away
+  std::atomic<uint64_t> checksum{0};
+  for(const Warehouse *pWarehouse : {&scanned, &columnar})
+  {
+    const char *warehouse = (pWarehouse == &scanned)? "Warehouse" : "PriceColumns";
+    const double bytes = (pWarehouse == &scanned)? -1 : bytesPerProduct;
+    bench("GetPriceStats", warehouse, [&]() {
+      checksum.fetch_add(pWarehouse->GetPriceStats().sum, std::memory_order_relaxed);
+    }, bytes);
+    bench("GetPriceHistogram (10)", warehouse, [&]() {
+      checksum.fetch_add(pWarehouse->GetPriceHistogram(bounds).back(), std::memory_order_relaxed);
+    }, bytes);
+  }
+}
+
+//! Compare adding and removing the products of the warehouses with the given sets of indexes,
+//! see WarehouseIndexes; the bytes per product are of the indexes
+template <typename Indexes>
+void BenchIndexes(const char *name, const Catalog &catalog, std::mt19937_64 &random)
+{
+  const size_t cntProducts = catalog.products.size();
+  BasicWarehouse<ExclusiveLocking, SharedProductTraits, Indexes> wh;
+
+  Latencies latencies;
+  latencies.reserve(cntProducts);
+  const size_t bytesBefore = gBytesInUse;
+  const auto start = Clock::now();
+  for(const auto &pProduct : catalog.products)
+  {
+    Measure(latencies, [&]() { wh.AddProduct(pProduct); });
+  }
+  const auto elapsed = Clock::now() - start;
+  const double bytesPerProduct = double(gBytesInUse - bytesBefore - latencies.capacity() * sizeof(uint64_t)) / cntProducts;
+  Report("AddProduct", name, cntProducts, 1, std::move(latencies), elapsed, bytesPerProduct);
+
+  std::vector<std::string> ids;
+  ids.reserve(cntProducts);
+  for(const auto &pProduct : catalog.products)
+  {
+    ids.push_back(pProduct->id);
+  }
+  std::shuffle(ids.begin(), ids.end(), random);
+  latencies.clear();
+  const auto startOfRemoval = Clock::now();
+  for(const auto &id : ids)
+  {
+    Measure(latencies, [&]() { wh.RemoveProductById(id); });
+  }
+  Report("RemoveProductById", name, cntProducts, 1, std::move(latencies), Clock::now() - startOfRemoval);
+}
+
+//! Compare the lookups of numeric ids kept as integers by SkuWarehouse with the lookups of
+//! the same ids kept as decimal strings by Warehouse
+void BenchSkus(const Catalog &catalog, std::mt19937_64 &random)
+{
+  const size_t cntProducts = catalog.products.size();
+  const size_t cntQueries = std::min<size_t>(cntProducts * 10, 1000000);
+
+  // the SKUs are numbered with a step, as the SKUs of the products of several ranges are
+  std::vector<uint64_t> skus(cntProducts);
+  for(size_t i = 0; i < cntProducts; ++i)
+  {
+    skus[i] = 100000000 + i * 16;
+  }
+  std::shuffle(skus.begin(), skus.end(), random);
+
+  SkuWarehouse whOfSkus;
+  Warehouse whOfStrings;
+  std::vector<SkuWarehouse::ProductPtr> skuProducts;
+  std::vector<ProductPtr> stringProducts;
+  skuProducts.reserve(cntProducts);
+  stringProducts.reserve(cntProducts);
+  for(size_t i = 0; i < cntProducts; ++i)
+  {
+    const ProductPtr &pProduct = catalog.products[i];
+    skuProducts.push_back(whOfSkus.MakeProduct(skus[i], pProduct->producer, pProduct->name, pProduct->price));
+    stringProducts.push_back(whOfStrings.MakeProduct(std::to_string(skus[i]), pProduct->producer, pProduct->name,
+      pProduct->price));
+  }
+
+  std::vector<uint64_t> hits, misses;
+  for(size_t i = 0; i < cntQueries; ++i)
+  {
+    hits.push_back(skus[random() % cntProducts]);
+    misses.push_back(skus[random() % cntProducts] + 1);
+  }
+  std::vector<std::string> hitsAsStrings, missesAsStrings;
+  for(size_t i = 0; i < cntQueries; ++i)
+  {
+    hitsAsStrings.push_back(std::to_string(hits[i]));
+    missesAsStrings.push_back(std::to_string(misses[i]));
+  }
+
+  auto bench = [&](const char *name, auto &wh, const auto &products, const auto &hitIds, const auto &missIds) {
+    Latencies latencies;
+    latencies.reserve(cntProducts);
+    const size_t bytesBefore = gBytesInUse;
+    const auto start = Clock::now();
+    for(const auto &pProduct : products)
+    {
+      Measure(latencies, [&]() { wh.AddProduct(pProduct); });
+    }
+    const auto elapsed = Clock::now() - start;
+    const double bytesPerProduct = double(gBytesInUse - bytesBefore - latencies.capacity() * sizeof(uint64_t)) / cntProducts;
+    Report("AddProduct", name, cntProducts, 1, std::move(latencies), elapsed, bytesPerProduct);
+
+    auto benchLookups = [&](const char *benchmark, const auto &ids) {
+      Latencies latencies;
+      latencies.reserve(ids.size());
+      const auto start = Clock::now();
+      for(const auto &id : ids)
+      {
+        Measure(latencies, [&]() { wh.FindProductById(id); });
+      }
+      Report(benchmark, name, cntProducts, 1, std::move(latencies), Clock::now() - start);
+    };
+    benchLookups("FindProductById hit", hitIds);
+    benchLookups("FindProductById miss", missIds);
+  };
+  bench("SkuAsString", whOfStrings, stringProducts, hitsAsStrings, missesAsStrings);
+  bench("Sku", whOfSkus, skuProducts, hits, misses);
+}
+
+//! Compare the id index of the warehouse, FlatHashTable, with std::unordered_map of the same
+//! ids and hash; the bytes per product are of the tables
+void BenchIdIndex(const Catalog &catalog, std::mt19937_64 &random)
+{
+  const size_t cntProducts = catalog.products.size();
+  const size_t cntQueries = std::min<size_t>(cntProducts * 10, 1000000);
+  const std::vector<std::string> hits = PickIds(catalog.products, cntQueries, random);
+  const std::vector<std::string> misses = PickIds(catalog.extraProducts, cntQueries, random);
+
+  struct IdOfProduct
+  {
+    std::string_view operator()(const ProductPtr &pProduct) const { return pProduct->id; }
+  };
+  using FlatIndex = FlatHashTable<ProductPtr, IdOfProduct, StringHash, std::equal_to<>>;
+  using MapIndex = std::unordered_map<std::string_view, ProductPtr, StringHash>;
+
+  // the results are summed, so the lookups are not optimized away
+  size_t cntFound = 0;
+  auto bench = [&](const char *name, auto &index, auto &&insert, auto &&contains) {
+    Latencies latencies;
+    latencies.reserve(cntProducts);
+    const size_t bytesBefore = gBytesInUse;
+    const auto start = Clock::now();
+    for(const ProductPtr &pProduct : catalog.products)
+    {
+      Measure(latencies, [&]() { insert(index, pProduct); });
+    }
+    const auto elapsed = Clock::now() - start;
+    const double bytesPerProduct = double(gBytesInUse - bytesBefore - latencies.capacity() * sizeof(uint64_t)) / cntProducts;
+    Report("id index insert", name, cntProducts, 1, std::move(latencies), elapsed, bytesPerProduct);
+
+    auto benchLookups = [&](const char *benchmark, const std::vector<std::string> &ids) {
+      Latencies latencies;
+      latencies.reserve(ids.size());
+      const auto start = Clock::now();
+      for(const std::string &id : ids)
+      {
+        Measure(latencies, [&]() { cntFound += contains(index, id); });
+      }
+      Report(benchmark, name, cntProducts, 1, std::move(latencies), Clock::now() - start);
+    };
+    benchLookups("id index hit", hits);
+    benchLookups("id index miss", misses);
+  };
+
+  {
+    MapIndex index;
+    bench("unordered_map", index,
+      [](MapIndex &index, const ProductPtr &pProduct) { index.try_emplace(pProduct->id, pProduct); },
+      [](const MapIndex &index, std::string_view id) { return index.find(id) != index.end(); });
+  }
+  {
+    FlatIndex index;
+    bench("FlatHashTable", index,
+      [](FlatIndex &index, const ProductPtr &pProduct) { index.try_emplace(std::string_view(pProduct->id), pProduct); },
+      [](const FlatIndex &index, std::string_view id) { return index.find(id) != index.end(); });
+  }
+  if(cntFound != 2 * cntQueries)
+  {
+    std::printf("unexpected number of found ids: %zu\n", cntFound);
+  }
+}
+
+std::vector<size_t> ParseList(const char *list)
+{
+  std::vector<size_t> values;
+  for(const char *p = list; *p; )
+  {
+    char *pEnd = nullptr;
+    const unsigned long long value = std::strtoull(p, &pEnd, 10);
+    if(pEnd == p)
+    {
+      break;
+    }
+    values.push_back(value);
+    p = (*pEnd == ',')? pEnd + 1 : pEnd;
+  }
+  return values;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  const std::vector<size_t> sizes = ParseList((argc > 1)? argv[1] : "1000,100000,1000000");
+  const std::vector<size_t> threadCounts = ParseList((argc > 2)? argv[2] : "1,2,4");
+
+  std::printf("%-26s %-14s %10s %7s %14s %8s %8s %13s\n",
+    "benchmark", "warehouse", "products", "threads", "ops/sec", "p50 ns", "p99 ns", "bytes/product");
+
+  std::mt19937_64 random(42);
+  for(const size_t cntProducts : sizes)
+  {
+    if(cntProducts == 0)
+    {
+      continue;
+    }
+    const Catalog catalog = MakeCatalog(cntProducts, random);
+    std::printf("%-26s %-14s %10zu %7s %14s %8s %8s %13.1f\n",
+      "MakeProduct", "-", cntProducts, "-", "-", "-", "-", catalog.bytesPerProduct);
+
+    Bench<Warehouse>("Warehouse", catalog, threadCounts);
+    Bench<BasicWarehouse<SharedLocking>>("SharedLocking", catalog, threadCounts);
+    Bench<ShardedWarehouse<16>>("Sharded<16>", catalog, threadCounts);
+
+    const auto compactCatalog = MakeCompactCatalog(catalog);
+    std::printf("%-26s %-14s %10zu %7s %14s %8s %8s %13.1f\n",
+      "MakeCompactProduct", "-", cntProducts, "-", "-", "-", "-", compactCatalog.bytesPerProduct);
+    Bench<CompactWarehouse>("Compact", compactCatalog, threadCounts);
+    BenchSnapshot(catalog);
+    BenchAsync(catalog);
+    BenchNames(catalog, random);
+    BenchScan(catalog, threadCounts);
+    BenchPriceColumns(catalog);
+    BenchIndexes<AllWarehouseIndexes>("AllIndexes", catalog, random);
+    BenchIndexes<WarehouseIndexes<ByProducerIndex>>("ByProducer", catalog, random);
+    BenchIndexes<IdWarehouseIndexes>("IdOnly", catalog, random);
+    BenchSkus(catalog, random);
+    BenchIdIndex(catalog, random);
+  }
+  return 0;
+}
@@ -0,0 +1,472 @@
+//! Concurrency stress test and contention profile of the warehouses
+//!
+//! Usage: Warehouse_stress [threads] [mix] [ops] [keys] [skew]
+//! - threads: comma-separated numbers of threads, 1,2,4,8 by default
+//! - mix:     comma-separated percents of FindProductById, FindProductsByProducer, AddProduct
+//!            and RemoveProductById, 80,10,5,5 by default
+//! - ops:     number of operations per thread, 200000 by default
+//! - keys:    number of the ids the operations pick from, 100000 by default
+//! - skew:    exponent of the Zipfian distribution of the ids, 0.99 by default (0 is uniform)
+//!
+//! Every thread runs the mix of the operations on one warehouse. The ids of the lookups follow
+//! the Zipfian distribution over all ids, so a few hot ids take most of the lookups. Every thread
+//! modifies only the ids it owns (id % threads == thread), picked by the same distribution, so it
+//! knows which of its products have to be in the warehouse and checks every result against that:
+//! - a lookup of its own id finds the product if and only if the thread added it last;
+//! - a lookup of any id finds the product with that id and its producer, or nothing;
+//! - FindProductsByProducer() finds the distinct products of that producer only;
+//! - after all threads are done, the warehouse has exactly the products the threads added last.
+//! RcuWarehouse publishes the writes of a thread every kPublishInterval writes, so its lookups of
+//! the own ids are checked only when all writes of the thread were published.
+//!
+//! The report has the throughput per warehouse and number of threads and the speedup over one
+//! thread. The warehouses compiled with WAREHOUSE_STATS report the time of waiting for and holding
+//! their locks per operation too, and the share of the time of the operations spent waiting.
+//!
+//! The program exits with 1 if any check fails, so it may run under ThreadSanitizer, e.g.
+//! g++ -std=c++17 -O1 -g -fsanitize=thread -pthread Warehouse_stress.cpp && ./a.out 1,4 80,10,5,5 20000 1000
+
+#include "RcuWarehouse.h"
+#include "ShardedWarehouse.h"
+#include "Warehouse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using ProductPtr = Warehouse::ProductPtr;
+
+//! Number of the producers of the products, the producer of an id is id % kCntProducers
+constexpr size_t kCntProducers = 64;
+
+//! Number of writes of a thread after which it publishes them to the readers of RcuWarehouse
+constexpr size_t kPublishInterval = 256;
+
+//! Options of the run, see the usage above
+struct Options
+{
+  std::vector<size_t> threadCounts;
+  unsigned percentFind = 80;
+  unsigned percentByProducer = 10;
+  unsigned percentAdd = 5;
+  unsigned percentRemove = 5;
+  size_t cntOpsPerThread = 200000;
+  size_t cntKeys = 100000;
+  double skew = 0.99;
+};
+
+std::string IdOf(size_t key) { return "id" + std::to_string(key); }
+std::string ProducerOf(size_t key) { return "producer" + std::to_string(key % kCntProducers); }
+
+ProductPtr MakeProduct(size_t key, unsigned price)
+{
+  return std::make_shared<Product>(Product{IdOf(key), ProducerOf(key), "name", price});
+}
+
+//! Key of the given id \p id, or SIZE_MAX if it is not an id of IdOf()
+size_t KeyOf(std::string_view id)
+{
+  if(id.size() < 3 || id.substr(0, 2) != "id")
+  {
+    return SIZE_MAX;
+  }
+  size_t key = 0;
+  for(const char c : id.substr(2))
+  {
+    if(c < '0' || c > '9')
+    {
+      return SIZE_MAX;
+    }
+    key = key * 10 + size_t(c - '0');
+  }
+  return key;
+}
+
+//! Zipfian distribution over the ranks [0, count): the rank r is drawn with the probability
+//! proportional to 1/(r+1)^skew, by the binary search in the cumulative distribution
+class ZipfianDistribution
+{
+public:
+  ZipfianDistribution(size_t count, double skew): mCdf(count)
+  {
+    double sum = 0;
+    for(size_t rank = 0; rank < count; ++rank)
+    {
+      sum += 1.0 / std::pow(double(rank + 1), skew);
+      mCdf[rank] = sum;
+    }
+    for(double &p : mCdf)
+    {
+      p /= sum;
+    }
+  }
+
+  template <typename Random>
+  size_t operator()(Random &random) const
+  {
+    const double p = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+    return std::min(size_t(std::lower_bound(mCdf.begin(), mCdf.end(), p) - mCdf.begin()), mCdf.size() - 1);
+  }
+
+private:
+  std::vector<double> mCdf;
+};
+
+//! Key of the given rank \p rank of \p count keys: the ranks are scattered over the keys,
+//! so the hot keys fall into different shards and are owned by different threads
+size_t ScatterRank(size_t rank, size_t count)
+{
+  // 2654435761 is a prime, which is coprime with any count below it
+  return size_t((uint64_t(rank) * 2654435761ull) % count);
+}
+
+template <typename WarehouseT>
+constexpr bool kIsRcu = std::is_same_v<WarehouseT, RcuWarehouse>;
+
+template <typename WarehouseT, typename = void>
+struct HasStats: std::false_type {};
+
+template <typename WarehouseT>
+struct HasStats<WarehouseT, std::void_t<decltype(std::declval<const WarehouseT&>().GetStats())>>: std::true_type {};
+
+//! Result of one thread of a run
+struct ThreadResult
+{
+  size_t cntOps = 0;
+  size_t cntViolations = 0;
+};
+
+//! Report a failed check of the key or the count \p value, the first few of them are printed
+void Violation(ThreadResult &result, const char *check, size_t value)
+{
+  static std::atomic<size_t> cntPrinted{0};
+  if(cntPrinted++ < 10)
+  {
+    std::fprintf(stderr, "violation: %s: %zu\n", check, value);
+  }
+  ++result.cntViolations;
+}
+
+//! Operations of the thread \p thread of \p cntThreads on the warehouse \p wh
+template <typename WarehouseT>
+ThreadResult RunThread(WarehouseT &wh, const Options &options, const ZipfianDistribution &allKeys,
+  const ZipfianDistribution &ownKeys, size_t thread, size_t cntThreads, std::vector<char> &isAdded)
+{
+  std::mt19937_64 random(thread + 1);
+  ThreadResult result;
+  const size_t cntOwnKeys = (options.cntKeys - thread + cntThreads - 1) / cntThreads;
+  size_t cntUnpublished = 0;
+
+  auto pickOwnKey = [&]() { return ScatterRank(ownKeys(random), cntOwnKeys) * cntThreads + thread; };
+  auto write = [&]() {
+    if constexpr(kIsRcu<WarehouseT>)
+    {
+      if(++cntUnpublished == kPublishInterval)
+      {
+        wh.Publish();
+        cntUnpublished = 0;
+      }
+    }
+  };
+
+  for(size_t i = 0; i < options.cntOpsPerThread; ++i)
+  {
+    const unsigned dice = unsigned(random() % 100);
+    if(dice < options.percentFind)
+    {
+      // every other lookup is of an own key, which is checked exactly
+      const bool isOwn = (i % 2 == 0);
+      const size_t key = isOwn? pickOwnKey() : ScatterRank(allKeys(random), options.cntKeys);
+      const ProductPtr pProduct = wh.FindProductById(IdOf(key));
+      if(pProduct && (pProduct->id != IdOf(key) || pProduct->producer != ProducerOf(key)))
+      {
+        Violation(result, "FindProductById found another product", key);
+      }
+      if(isOwn && cntUnpublished == 0 && bool(pProduct) != bool(isAdded[key]))
+      {
+        Violation(result, "FindProductById does not see the own write", key);
+      }
+    }
+    else if(dice < options.percentFind + options.percentByProducer)
+    {
+      const size_t key = ScatterRank(allKeys(random), options.cntKeys);
+      std::vector<ProductPtr> products;
+      wh.FindProductsByProducer(ProducerOf(key), std::back_inserter(products));
+      std::unordered_set<std::string_view> ids;
+      for(const ProductPtr &pProduct : products)
+      {
+        const size_t productKey = KeyOf(pProduct->id);
+        if(productKey % kCntProducers != key % kCntProducers || pProduct->producer != ProducerOf(key) ||
+           !ids.insert(pProduct->id).second)
+        {
+          Violation(result, "FindProductsByProducer found a wrong product", key);
+        }
+      }
+    }
+    else if(dice < options.percentFind + options.percentByProducer + options.percentAdd)
+    {
+      const size_t key = pickOwnKey();
+      if(wh.AddProduct(MakeProduct(key, unsigned(i))) == bool(isAdded[key]))
+      {
+        Violation(result, "AddProduct of an own id", key);
+      }
+      isAdded[key] = true;
+      write();
+    }
+    else
+    {
+      const size_t key = pickOwnKey();
+      if(wh.RemoveProductById(IdOf(key)) != size_t(isAdded[key]))
+      {
+        Violation(result, "RemoveProductById of an own id", key);
+      }
+      isAdded[key] = false;
+      write();
+    }
+    ++result.cntOps;
+  }
+  return result;
+}
+
+//! Result of a run of the threads on one warehouse
+struct RunResult
+{
+  double opsPerSecond = 0;
+  size_t cntViolations = 0;
+  WarehouseStats stats;
+};
+
+template <typename WarehouseT>
+RunResult Run(const Options &options, size_t cntThreads)
+{
+  auto pWarehouse = std::make_unique<WarehouseT>();
+  WarehouseT &wh = *pWarehouse;
+
+  // every thread owns the flags of its keys, which no other thread reads or writes
+  std::vector<char> isAdded(options.cntKeys, false);
+  std::mt19937_64 random(42);
+  for(size_t key = 0; key < options.cntKeys; ++key)
+  {
+    if(random() % 2)
+    {
+      wh.AddProduct(MakeProduct(key, 0));
+      isAdded[key] = true;
+    }
+  }
+  if constexpr(kIsRcu<WarehouseT>)
+  {
+    wh.Publish();
+  }
+
+  const size_t cntOwnKeys = (options.cntKeys + cntThreads - 1) / cntThreads;
+  const ZipfianDistribution allKeys(options.cntKeys, options.skew);
+  const ZipfianDistribution ownKeys(cntOwnKeys, options.skew);
+
+  std::vector<ThreadResult> results(cntThreads);
+  std::atomic<size_t> cntReady{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for(size_t t = 0; t < cntThreads; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      cntReady++;
+      while(!go)
+      {
+        std::this_thread::yield();
+      }
+      results[t] = RunThread(wh, options, allKeys, ownKeys, t, cntThreads, isAdded);
+    });
+  }
+  while(cntReady != cntThreads)
+  {
+    std::this_thread::yield();
+  }
+  const auto start = Clock::now();
+  go = true;
+  for(auto &thread : threads)
+  {
+    thread.join();
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  RunResult runResult;
+  size_t cntOps = 0;
+  for(const ThreadResult &result : results)
+  {
+    cntOps += result.cntOps;
+    runResult.cntViolations += result.cntViolations;
+  }
+  runResult.opsPerSecond = (seconds > 0)? cntOps / seconds : 0.0;
+
+  // the warehouse has exactly the products that the threads added last
+  if constexpr(kIsRcu<WarehouseT>)
+  {
+    wh.Publish();
+  }
+  ThreadResult finalCheck;
+  size_t cntExpected = 0;
+  for(size_t key = 0; key < options.cntKeys; ++key)
+  {
+    cntExpected += isAdded[key];
+    if(bool(wh.FindProductById(IdOf(key))) != bool(isAdded[key]))
+    {
+      Violation(finalCheck, "the warehouse differs from the writes of the threads", key);
+    }
+  }
+  size_t cntProducts = 0;
+  for(size_t producer = 0; producer < kCntProducers; ++producer)
+  {
+    cntProducts += wh.CountProductsByProducer(ProducerOf(producer));
+  }
+  if(cntProducts != cntExpected)
+  {
+    Violation(finalCheck, "the producer index differs from the id index", cntProducts);
+  }
+  runResult.cntViolations += finalCheck.cntViolations;
+
+  if constexpr(HasStats<WarehouseT>::value)
+  {
+    runResult.stats = wh.GetStats();
+  }
+  return runResult;
+}
+
+//! Run the threads on the warehouses of the type \p WarehouseT named \p name, for every number of threads
+//!
+//! \return number of the failed checks
+template <typename WarehouseT>
+size_t Stress(const char *name, const Options &options)
+{
+  size_t cntViolations = 0;
+  double opsPerSecondOfOne = 0;
+  for(const size_t cntThreads : options.threadCounts)
+  {
+    if(cntThreads == 0)
+    {
+      continue;
+    }
+    const RunResult result = Run<WarehouseT>(options, cntThreads);
+    cntViolations += result.cntViolations;
+    if(cntThreads == 1)
+    {
+      opsPerSecondOfOne = result.opsPerSecond;
+    }
+
+    std::printf("%-22s %7zu %14.0f", name, cntThreads, result.opsPerSecond);
+    if(opsPerSecondOfOne > 0)
+    {
+      std::printf(" %8.2f", result.opsPerSecond / opsPerSecondOfOne);
+    }
+    else
+    {
+      std::printf(" %8s", "-");
+    }
+
+    // the contention of the lock over all operations
+    uint64_t cntCalls = 0, latency = 0, lockWait = 0, lockHold = 0;
+    for(const WarehouseStats::Operation &operation : result.stats.operations)
+    {
+      cntCalls += operation.latency.count;
+      latency += operation.latency.sum;
+      lockWait += operation.lockWait;
+      lockHold += operation.lockHold;
+    }
+    if(result.stats.enabled && cntCalls != 0)
+    {
+      std::printf(" %10.0f %10.0f %7.1f%%", double(lockWait) / cntCalls, double(lockHold) / cntCalls,
+        latency? 100.0 * lockWait / latency : 0.0);
+    }
+    else
+    {
+      std::printf(" %10s %10s %8s", "-", "-", "-");
+    }
+    std::printf(" %10zu\n", result.cntViolations);
+    std::fflush(stdout);
+  }
+  return cntViolations;
+}
+
+std::vector<size_t> ParseList(const char *list)
+{
+  std::vector<size_t> values;
+  for(const char *p = list; *p; )
+  {
+    char *pEnd = nullptr;
+    const unsigned long long value = std::strtoull(p, &pEnd, 10);
+    if(pEnd == p)
+    {
+      break;
+    }
+    values.push_back(value);
+    p = (*pEnd == ',')? pEnd + 1 : pEnd;
+  }
+  return values;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  Options options;
+  options.threadCounts = ParseList((argc > 1)? argv[1] : "1,2,4,8");
+  const std::vector<size_t> mix = ParseList((argc > 2)? argv[2] : "80,10,5,5");
+  if(mix.size() != 4 || mix[0] + mix[1] + mix[2] + mix[3] != 100)
+  {
+    std::fprintf(stderr, "the mix has to be 4 percents that sum up to 100\n");
+    return 2;
+  }
+  options.percentFind = unsigned(mix[0]);
+  options.percentByProducer = unsigned(mix[1]);
+  options.percentAdd = unsigned(mix[2]);
+  options.percentRemove = unsigned(mix[3]);
+  if(argc > 3)
+  {
+    options.cntOpsPerThread = std::strtoull(argv[3], nullptr, 10);
+  }
+  if(argc > 4)
+  {
+    options.cntKeys = std::max<size_t>(std::strtoull(argv[4], nullptr, 10), 1);
+  }
+  if(argc > 5)
+  {
+    options.skew = std::strtod(argv[5], nullptr);
+  }
+  const size_t cntMaxThreads = options.threadCounts.empty()? 1 :
+    *std::max_element(options.threadCounts.begin(), options.threadCounts.end());
+  if(options.cntKeys < cntMaxThreads)
+  {
+    std::fprintf(stderr, "every thread has to own at least one id\n");
+    return 2;
+  }
+
+  std::printf("mix %u/%u/%u/%u, %zu ops per thread, %zu ids, skew %.2f\n", options.percentFind,
+    options.percentByProducer, options.percentAdd, options.percentRemove, options.cntOpsPerThread,
+    options.cntKeys, options.skew);
+  std::printf("%-22s %7s %14s %8s %10s %10s %8s %10s\n",
+    "warehouse", "threads", "ops/sec", "speedup", "wait ns/op", "hold ns/op", "wait", "violations");
+
+  size_t cntViolations = 0;
+  cntViolations += Stress<Warehouse>("Warehouse", options);
+  cntViolations += Stress<BasicWarehouse<SharedLocking>>("SharedLocking", options);
+  cntViolations += Stress<ShardedWarehouse<16>>("Sharded<16>", options);
+  cntViolations += Stress<ShardedWarehouse<16, SharedLocking>>("Sharded<16,Shared>", options);
+  cntViolations += Stress<RcuWarehouse>("Rcu", options);
+  return cntViolations? 1 : 0;
+}
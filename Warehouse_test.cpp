@@ -2,6 +2,23 @@
 #include "doctest.h"
 #include "Warehouse.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
 template<class... Args>
 std::shared_ptr<Product> MakeProduct(Args&&... args)
 {
@@ -200,4 +217,1465 @@ TEST_CASE("removing products from the warehouse by the given product id") {
       CHECK(foundProducts.size() == 0);
     }     
   }     
-}
\ No newline at end of file
+}
+TEST_CASE_TEMPLATE("warehouse with the given locking policy", LockingPolicy, ExclusiveLocking, SharedLocking, NoLocking) {
+
+  BasicWarehouse<LockingPolicy> wh;
+
+  auto producerA_product1 = MakeProduct("id1", "producerA", "1", 1u);
+  auto producerA_product2 = MakeProduct("id2", "producerA", "2", 1u);
+  REQUIRE(wh.AddProduct(producerA_product1));
+  REQUIRE(wh.AddProduct(producerA_product2));
+  CHECK(wh.AddProduct(MakeProduct("id1", "producerB", "1", 1u)) == false);
+
+  CHECK(wh.FindProductById("id1") == producerA_product1);
+  CHECK(!wh.FindProductById("id42"));
+
+  CHECK(wh.RemoveProductById("id1") == 1);
+  CHECK(!wh.FindProductById("id1"));
+
+  std::vector<Warehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer("producerA", std::back_inserter(foundProducts)) == 1);
+  CHECK(foundProducts == std::vector<Warehouse::ProductPtr>{producerA_product2});
+}
+
+TEST_CASE("concurrent lookups in the warehouse with the shared locking policy") {
+
+  BasicWarehouse<SharedLocking> wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", 1u)));
+  }
+
+  std::atomic<size_t> cntFound{0};
+  std::vector<std::thread> readers;
+  for(int t = 0; t < 4; ++t)
+  {
+    readers.emplace_back([&wh, &cntFound]() {
+      for(int i = 0; i < 100; ++i)
+      {
+        if(wh.FindProductById("id" + std::to_string(i)))
+        {
+          cntFound++;
+        }
+      }
+    });
+  }
+  for(auto &reader : readers)
+  {
+    reader.join();
+  }
+
+  CHECK(cntFound == 400);
+}
+
+TEST_CASE("copying the warehouse") {
+
+  Warehouse wh;
+  auto producerA_product1 = MakeProduct("id1", "producerA", "1", 1u);
+  auto producerA_product2 = MakeProduct("id2", "producerA", "2", 1u);
+  REQUIRE(wh.AddProduct(producerA_product1));
+  REQUIRE(wh.AddProduct(producerA_product2));
+
+  Warehouse copy(wh);
+  REQUIRE(wh.RemoveProductById("id1") == 1);
+
+  // the copy is independent of the original warehouse...
+  CHECK(copy.FindProductById("id1") == producerA_product1);
+  CHECK(copy.FindProductById("id2") == producerA_product2);
+
+  // ...and its producer index is consistent with its id index
+  CHECK(copy.RemoveProductById("id2") == 1);
+  std::vector<Warehouse::ProductPtr> foundProducts;
+  CHECK(copy.FindProductsByProducer("producerA", std::back_inserter(foundProducts)) == 1);
+  CHECK(foundProducts == std::vector<Warehouse::ProductPtr>{producerA_product1});
+
+  copy = wh;
+  CHECK(!copy.FindProductById("id1"));
+  CHECK(copy.FindProductById("id2") == producerA_product2);
+}
+
+TEST_CASE("adding and removing batches of products") {
+  
+  Warehouse wh;
+
+  auto producerA_product1 = MakeProduct("id1", "producerA", "1", 1u);
+  auto producerB_product2 = MakeProduct("id2", "producerB", "2", 1u);
+  auto producerA_product3 = MakeProduct("id3", "producerA", "3", 1u);
+  auto producerB_product1 = MakeProduct("id1", "producerB", "1", 1u);
+
+  SUBCASE("adding to the empty warehouse reports duplicates inside the batch") {
+    std::vector<Warehouse::ProductPtr> products{producerA_product1, producerB_product2, producerB_product1, producerA_product3};
+    std::vector<bool> added;
+    CHECK(wh.AddProducts(products.begin(), products.end(), std::back_inserter(added)) == 3);
+    CHECK(added == std::vector<bool>{true, true, false, true});
+
+    CHECK(wh.FindProductById("id1") == producerA_product1);
+    std::set<Warehouse::ProductPtr> foundProducts;
+    auto outIt = std::inserter(foundProducts, foundProducts.end());
+    CHECK(wh.FindProductsByProducer("producerA", outIt) == 2);
+    CHECK(foundProducts == std::set<Warehouse::ProductPtr>{producerA_product1, producerA_product3});
+  }
+
+  SUBCASE("adding to the non-empty warehouse reports products with existing ids") {
+    REQUIRE(wh.AddProduct(producerA_product1));
+
+    std::vector<Warehouse::ProductPtr> products{producerB_product1, producerB_product2};
+    std::vector<bool> added;
+    CHECK(wh.AddProducts(products.begin(), products.end(), std::back_inserter(added)) == 1);
+    CHECK(added == std::vector<bool>{false, true});
+    CHECK(wh.FindProductById("id1") == producerA_product1);
+    CHECK(wh.FindProductById("id2") == producerB_product2);
+  }
+
+  SUBCASE("removing reports ids of the products that are not inside the warehouse") {
+    std::vector<Warehouse::ProductPtr> products{producerA_product1, producerB_product2, producerA_product3};
+    REQUIRE(wh.AddProducts(products.begin(), products.end()) == 3);
+
+    std::vector<Product::Id> ids{"id1", "id42", "id3", "id1"};
+    std::vector<bool> removed;
+    CHECK(wh.RemoveProductsById(ids.begin(), ids.end(), std::back_inserter(removed)) == 2);
+    CHECK(removed == std::vector<bool>{true, false, true, false});
+
+    CHECK(wh.RemoveProductsById(ids.begin(), ids.end()) == 0);
+    CHECK(wh.FindProductById("id2") == producerB_product2);
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    CHECK(wh.FindProductsByProducer("producerA", std::back_inserter(foundProducts)) == 0);
+  }
+}
+
+TEST_CASE("removing products in an arbitrary order keeps the producer index consistent") {
+  
+  Warehouse wh;
+
+  std::set<Warehouse::ProductPtr> expectedProducts;
+  for(int i = 0; i < 50; ++i)
+  {
+    auto product = MakeProduct("id" + std::to_string(i), "producer", "name", 1u);
+    REQUIRE(wh.AddProduct(product));
+    expectedProducts.insert(product);
+  }
+
+  for(int i : {0, 49, 25, 1, 48, 2, 30, 31, 10})
+  {
+    const auto id = "id" + std::to_string(i);
+    expectedProducts.erase(wh.FindProductById(id));
+    REQUIRE(wh.RemoveProductById(id) == 1);
+
+    std::set<Warehouse::ProductPtr> foundProducts;
+    auto outIt = std::inserter(foundProducts, foundProducts.end());
+    CHECK(wh.FindProductsByProducer("producer", outIt) == expectedProducts.size());
+    CHECK(foundProducts == expectedProducts);
+  }
+
+  for(const auto &pProduct : expectedProducts)
+  {
+    CHECK(wh.RemoveProductById(pProduct->id) == 1);
+  }
+  std::vector<Warehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer("producer", std::back_inserter(foundProducts)) == 0);
+}
+
+TEST_CASE("finding products inside the warehouse by the given producer handle") {
+  
+  Warehouse wh;
+
+  // the handle can be resolved before any product of the producer is added
+  const auto producerA = wh.GetProducerHandle("producerA");
+  CHECK(wh.GetProducerHandle("producerA") == producerA);
+
+  auto producerA_product1 = MakeProduct("id1", "producerA", "1", 1u);
+  auto producerB_product2 = MakeProduct("id2", "producerB", "2", 1u);
+  REQUIRE(wh.AddProduct(producerA_product1));
+  REQUIRE(wh.AddProduct(producerB_product2));
+
+  const auto producerB = wh.GetProducerHandle("producerB");
+  CHECK(producerA != producerB);
+
+  std::vector<Warehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer(producerA, std::back_inserter(foundProducts)) == 1);
+  CHECK(foundProducts == std::vector<Warehouse::ProductPtr>{producerA_product1});
+
+  // the handle stays valid after all products of the producer are removed
+  REQUIRE(wh.RemoveProductById("id1") == 1);
+  foundProducts.clear();
+  CHECK(wh.FindProductsByProducer(producerA, std::back_inserter(foundProducts)) == 0);
+  CHECK(wh.GetProducerHandle("producerA") == producerA);
+
+  // an unknown handle finds nothing
+  CHECK(wh.FindProductsByProducer(Warehouse::ProducerHandle{42}, std::back_inserter(foundProducts)) == 0);
+}
+
+TEST_CASE("finding and removing products by string views") {
+  
+  Warehouse wh;
+
+  auto product = MakeProduct("a_product_id_longer_than_the_small_string_buffer", "a_producer", "name", 1u);
+  REQUIRE(wh.AddProduct(product));
+
+  // the views point into a larger buffer, as if they were sliced out of a request
+  const std::string buffer = "a_product_id_longer_than_the_small_string_buffer|a_producer";
+  const std::string_view id = std::string_view(buffer).substr(0, buffer.find('|'));
+  const std::string_view producer = std::string_view(buffer).substr(buffer.find('|') + 1);
+
+  CHECK(wh.FindProductById(id) == product);
+  CHECK(!wh.FindProductById(id.substr(1)));
+  CHECK(wh.VisitProductById(id, [](const Product &) {}) == true);
+
+  std::vector<Warehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer(producer, std::back_inserter(foundProducts)) == 1);
+  CHECK(wh.GetProducerHandle(producer) == wh.GetProducerHandle("a_producer"));
+
+  CHECK(wh.RemoveProductById(id) == 1);
+  CHECK(!wh.FindProductById(id));
+
+  const std::vector<std::string_view> ids{id};
+  CHECK(wh.RemoveProductsById(ids.begin(), ids.end()) == 0);
+}
+
+//! Memory resource that counts the bytes allocated from it and not deallocated yet
+class CountingResource: public std::pmr::memory_resource
+{
+public:
+  size_t cntAllocations = 0;
+  size_t cntBytesInUse = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override
+  {
+    cntAllocations++;
+    cntBytesInUse += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override
+  {
+    cntBytesInUse -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+TEST_CASE("allocating the warehouse and its products from the given memory resource") {
+
+  CountingResource resource;
+  {
+    Warehouse wh(&resource);
+    CHECK(wh.GetMemoryResource() == &resource);
+
+    auto product = wh.MakeProduct("id1", "producer", "name", 1u);
+    CHECK(resource.cntAllocations == 1);
+    CHECK(product->id == "id1");
+
+    REQUIRE(wh.AddProduct(product));
+    for(int i = 2; i < 100; ++i)
+    {
+      REQUIRE(wh.AddProduct(wh.MakeProduct("id" + std::to_string(i), "producer", "name", 1u)));
+    }
+    CHECK(resource.cntAllocations > 100);
+    CHECK(wh.FindProductById("id1") == product);
+
+    SUBCASE("copy allocates from the default resource unless the resource is given") {
+      const size_t cntAllocations = resource.cntAllocations;
+      Warehouse copy(wh);
+      CHECK(copy.GetMemoryResource() == std::pmr::get_default_resource());
+      CHECK(resource.cntAllocations == cntAllocations);
+
+      Warehouse copyWithResource(wh, &resource);
+      CHECK(copyWithResource.GetMemoryResource() == &resource);
+      CHECK(resource.cntAllocations > cntAllocations);
+      CHECK(copyWithResource.FindProductById("id1") == product);
+    }
+
+    SUBCASE("assigned warehouse keeps its resource") {
+      Warehouse other;
+      other = wh;
+      CHECK(other.GetMemoryResource() == std::pmr::get_default_resource());
+      CHECK(other.FindProductById("id1") == product);
+
+      wh = Warehouse();
+      CHECK(wh.GetMemoryResource() == &resource);
+      CHECK(!wh.FindProductById("id1"));
+    }
+  }
+  // everything is returned to the resource once the warehouse and the products are gone
+  CHECK(resource.cntBytesInUse == 0);
+}
+
+TEST_CASE("warehouse without locking allocating from a monotonic arena") {
+
+  std::pmr::monotonic_buffer_resource arena;
+  BasicWarehouse<NoLocking> wh(&arena);
+
+  std::vector<BasicWarehouse<NoLocking>::ProductPtr> products;
+  for(int i = 0; i < 1000; ++i)
+  {
+    products.push_back(wh.MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 10), "name", 1u));
+  }
+  CHECK(wh.AddProducts(products.begin(), products.end()) == 1000);
+  CHECK(wh.RemoveProductById("id0") == 1);
+
+  std::vector<BasicWarehouse<NoLocking>::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByProducer("producer1", std::back_inserter(foundProducts)) == 100);
+}
+
+TEST_CASE("finding products inside the warehouse by the given price range") {
+
+  Warehouse wh;
+
+  std::vector<Warehouse::ProductPtr> products;
+  for(unsigned i = 0; i < 100; ++i)
+  {
+    products.push_back(MakeProduct("id" + std::to_string(i), (i % 2)? "odd" : "even", "name", i));
+  }
+
+  // the empty warehouse is bulk loaded, the non-empty one is filled product by product
+  SUBCASE("bulk loaded") {
+    REQUIRE(wh.AddProducts(products.begin(), products.end()) == 100);
+  }
+  SUBCASE("added one by one") {
+    for(auto it = products.rbegin(); it != products.rend(); ++it)
+    {
+      REQUIRE(wh.AddProduct(*it));
+    }
+  }
+
+  std::vector<Warehouse::ProductPtr> foundProducts;
+  CHECK(wh.FindProductsByPriceRange(10, 19, std::back_inserter(foundProducts)) == 10);
+  CHECK(foundProducts == std::vector<Warehouse::ProductPtr>(products.begin() + 10, products.begin() + 20));
+
+  foundProducts.clear();
+  CHECK(wh.FindProductsByProducer("odd", 10, 19, std::back_inserter(foundProducts)) == 5);
+  CHECK(foundProducts == std::vector<Warehouse::ProductPtr>{products[11], products[13], products[15], products[17], products[19]});
+
+  foundProducts.clear();
+  CHECK(wh.FindProductsByProducer(wh.GetProducerHandle("even"), 95, 1000, std::back_inserter(foundProducts)) == 2);
+  CHECK(wh.FindProductsByProducer("unknown", 0, 1000, std::back_inserter(foundProducts)) == 0);
+  CHECK(wh.FindProductsByPriceRange(20, 10, std::back_inserter(foundProducts)) == 0);
+
+  REQUIRE(wh.RemoveProductById("id15") == 1);
+  foundProducts.clear();
+  CHECK(wh.FindProductsByProducer("odd", 10, 19, std::back_inserter(foundProducts)) == 4);
+  CHECK(wh.FindProductsByPriceRange(15, 15, std::back_inserter(foundProducts)) == 0);
+
+  // the copy has its own price indexes
+  Warehouse copy(wh);
+  REQUIRE(wh.RemoveProductById("id16") == 1);
+  CHECK(copy.FindProductsByPriceRange(16, 16, std::back_inserter(foundProducts)) == 1);
+  CHECK(wh.FindProductsByPriceRange(16, 16, std::back_inserter(foundProducts)) == 0);
+}
+
+TEST_CASE("visiting and counting products of the given producer") {
+
+  Warehouse wh;
+  for(unsigned i = 0; i < 10; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), (i < 7)? "producerA" : "producerB", "name", 10 - i)));
+  }
+
+  std::vector<Product::Price> prices;
+  CHECK(wh.ForEachProductOfProducer("producerB", [&prices](const Product &product) { prices.push_back(product.price); }) == 3);
+  CHECK(prices == std::vector<Product::Price>{1, 2, 3});
+
+  size_t cntVisited = 0;
+  CHECK(wh.ForEachProductOfProducer(wh.GetProducerHandle("producerA"), [&cntVisited](const Product &) { cntVisited++; }) == 7);
+  CHECK(cntVisited == 7);
+  CHECK(wh.ForEachProductOfProducer("producer42", [](const Product &) { FAIL("no product should be visited"); }) == 0);
+
+  CHECK(wh.CountProductsByProducer("producerA") == 7);
+  CHECK(wh.CountProductsByProducer(wh.GetProducerHandle("producerB")) == 3);
+  CHECK(wh.CountProductsByProducer("producer42") == 0);
+  CHECK(wh.CountProductsByProducer(Warehouse::ProducerHandle{42}) == 0);
+
+  REQUIRE(wh.RemoveProductById("id0") == 1);
+  CHECK(wh.CountProductsByProducer("producerA") == 6);
+}
+
+TEST_CASE("finding products of the given producer in chunks") {
+
+  Warehouse wh;
+  for(unsigned i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", i)));
+  }
+
+  SUBCASE("all products are found once, chunk by chunk") {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    Warehouse::ProducerCursor cursor;
+    size_t cntChunks = 0;
+    while(!cursor.AtEnd())
+    {
+      cursor = wh.FindProductsByProducer("producer", cursor, 30, std::back_inserter(foundProducts));
+      cntChunks++;
+    }
+    CHECK(cntChunks == 4);
+    REQUIRE(foundProducts.size() == 100);
+    for(unsigned i = 0; i < 100; ++i)
+    {
+      CHECK(foundProducts[i]->price == i);
+    }
+  }
+
+  SUBCASE("modifications between the chunks do not invalidate the cursor") {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    auto cursor = wh.FindProductsByProducer(wh.GetProducerHandle("producer"), Warehouse::ProducerCursor(), 50,
+      std::back_inserter(foundProducts));
+    REQUIRE(foundProducts.size() == 50);
+
+    // the last found product and a product after it are removed, a product is added after the cursor
+    REQUIRE(wh.RemoveProductById("id49") == 1);
+    REQUIRE(wh.RemoveProductById("id50") == 1);
+    REQUIRE(wh.AddProduct(MakeProduct("new", "producer", "name", 1000u)));
+
+    foundProducts.clear();
+    cursor = wh.FindProductsByProducer("producer", cursor, 1000, std::back_inserter(foundProducts));
+    CHECK(cursor.AtEnd());
+    REQUIRE(foundProducts.size() == 50);
+    CHECK(foundProducts.front()->id == "id51");
+    CHECK(foundProducts.back()->id == "new");
+  }
+
+  SUBCASE("unknown producer => nothing found") {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    CHECK(wh.FindProductsByProducer("producer42", Warehouse::ProducerCursor(), 10, std::back_inserter(foundProducts)).AtEnd());
+    CHECK(foundProducts.empty());
+  }
+}
+
+TEST_CASE("saving and loading snapshots of the warehouse") {
+
+  const std::string path = "Warehouse_test.snapshot";
+  Warehouse wh;
+  const auto emptyHandle = wh.GetProducerHandle("producer without products");
+  for(unsigned i = 0; i < 1000; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 7),
+      "name" + std::to_string(i), i % 101)));
+  }
+  REQUIRE(wh.RemoveProductById("id0") == 1);
+  REQUIRE(wh.SaveSnapshot(path));
+
+  auto readFile = [&path]() {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  };
+  auto writeFile = [&path](const std::string &content) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+  };
+
+  SUBCASE("the loaded warehouse has the same products, producers and handles") {
+    Warehouse loaded;
+    REQUIRE(loaded.AddProduct(MakeProduct("replaced", "producer", "name", 1u)));
+    REQUIRE(loaded.LoadSnapshot(path));
+
+    CHECK(loaded.FindProductById("replaced") == nullptr);
+    CHECK(loaded.FindProductById("id0") == nullptr);
+    for(unsigned i = 1; i < 1000; ++i)
+    {
+      auto pProduct = loaded.FindProductById("id" + std::to_string(i));
+      REQUIRE(pProduct);
+      CHECK(pProduct->producer == "producer" + std::to_string(i % 7));
+      CHECK(pProduct->name == "name" + std::to_string(i));
+      CHECK(pProduct->price == i % 101);
+    }
+    for(unsigned producer = 0; producer < 7; ++producer)
+    {
+      const std::string name = "producer" + std::to_string(producer);
+      CHECK(loaded.GetProducerHandle(name) == wh.GetProducerHandle(name));
+      CHECK(loaded.CountProductsByProducer(name) == wh.CountProductsByProducer(name));
+    }
+    CHECK(loaded.GetProducerHandle("producer without products") == emptyHandle);
+
+    auto idsOf = [](const std::vector<Warehouse::ProductPtr> &products) {
+      std::vector<std::string> ids;
+      for(const auto &pProduct : products)
+      {
+        ids.push_back(pProduct->id);
+      }
+      std::sort(ids.begin(), ids.end());
+      return ids;
+    };
+    std::vector<Warehouse::ProductPtr> loadedProducts, savedProducts;
+    loaded.FindProductsByPriceRange(10, 20, std::back_inserter(loadedProducts));
+    wh.FindProductsByPriceRange(10, 20, std::back_inserter(savedProducts));
+    CHECK(idsOf(loadedProducts) == idsOf(savedProducts));
+
+    loadedProducts.clear();
+    savedProducts.clear();
+    loaded.FindProductsByProducer("producer3", 50u, 60u, std::back_inserter(loadedProducts));
+    wh.FindProductsByProducer("producer3", 50u, 60u, std::back_inserter(savedProducts));
+    CHECK(idsOf(loadedProducts) == idsOf(savedProducts));
+
+    // the loaded warehouse is modified as usual
+    CHECK(loaded.AddProduct(MakeProduct("id0", "producer0", "name", 1u)));
+    CHECK(loaded.AddProduct(MakeProduct("id1", "producer0", "name", 1u)) == false);
+    CHECK(loaded.RemoveProductById("id2") == 1);
+  }
+
+  SUBCASE("saving an empty warehouse gives an empty snapshot") {
+    REQUIRE(Warehouse().SaveSnapshot(path));
+    REQUIRE(wh.LoadSnapshot(path));
+    CHECK(wh.FindProductById("id1") == nullptr);
+    CHECK(wh.CountProductsByProducer("producer1") == 0);
+  }
+
+  SUBCASE("invalid snapshots do not change the warehouse") {
+    const std::string content = readFile();
+
+    SUBCASE("missing file") {
+      CHECK(wh.LoadSnapshot(path + ".missing") == false);
+    }
+
+    SUBCASE("truncated file") {
+      writeFile(content.substr(0, content.size() / 2));
+      CHECK(wh.LoadSnapshot(path) == false);
+    }
+
+    SUBCASE("unknown version") {
+      std::string corrupted = content;
+      corrupted[offsetof(SnapshotFormat::Header, version)] ^= 0x7F;
+      writeFile(corrupted);
+      CHECK(wh.LoadSnapshot(path) == false);
+    }
+
+    SnapshotFormat::Header header{};
+    std::memcpy(&header, content.data(), sizeof(header));
+    SnapshotFormat::Layout layout{};
+    REQUIRE(SnapshotFormat::LayoutOf(header, layout));
+
+    SUBCASE("string out of the string table") {
+      std::string corrupted = content;
+      const uint32_t length = UINT32_MAX;
+      std::memcpy(&corrupted[layout.productsOffset + offsetof(SnapshotFormat::ProductRecord, idLength)],
+        &length, sizeof(length));
+
+      // the checksum is updated, so the string itself is checked
+      SnapshotFormat::Checksum checksum;
+      checksum.Update(corrupted.data() + layout.producersOffset, corrupted.size() - layout.producersOffset);
+      header.checksum = checksum.Value();
+      std::memcpy(&corrupted[0], &header, sizeof(header));
+      writeFile(corrupted);
+      CHECK(wh.LoadSnapshot(path) == false);
+    }
+
+    SUBCASE("corrupted hash of an id") {
+      std::string corrupted = content;
+      corrupted[layout.productsOffset + offsetof(SnapshotFormat::ProductRecord, idHash)] ^= 0x01;
+      writeFile(corrupted);
+      CHECK(wh.LoadSnapshot(path) == false);
+    }
+
+    SUBCASE("corrupted name") {
+      std::string corrupted = content;
+      corrupted[layout.stringsOffset + header.stringsSize - 1] ^= 0x01;
+      writeFile(corrupted);
+      CHECK(wh.LoadSnapshot(path) == false);
+    }
+
+    CHECK(wh.FindProductById("id1") != nullptr);
+    CHECK(wh.CountProductsByProducer("producer1") == 143);
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("upserting products and updating their prices") {
+
+  Warehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "name1", 10u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerA", "name2", 20u)));
+
+  auto pricesOf = [&wh](std::string_view producer) {
+    std::vector<Product::Price> prices;
+    wh.ForEachProductOfProducer(producer, [&prices](const Product &product) { prices.push_back(product.price); });
+    return prices;
+  };
+  auto countInPriceRange = [&wh](Product::Price priceLo, Product::Price priceHi) {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    return wh.FindProductsByPriceRange(priceLo, priceHi, std::back_inserter(foundProducts));
+  };
+  auto countOfProducerInPriceRange = [&wh](std::string_view producer, Product::Price priceLo, Product::Price priceHi) {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    return wh.FindProductsByProducer(producer, priceLo, priceHi, std::back_inserter(foundProducts));
+  };
+
+  SUBCASE("the product with a new id is added") {
+    CHECK(wh.UpsertProduct(MakeProduct("id3", "producerB", "name3", 30u)) == true);
+    CHECK(wh.CountProductsByProducer("producerB") == 1);
+    CHECK(countInPriceRange(0, 100) == 3);
+  }
+
+  SUBCASE("the product with the same id is replaced in all indexes") {
+    auto pOldProduct = wh.FindProductById("id1");
+    CHECK(wh.UpsertProduct(MakeProduct("id1", "producerA", "new name", 30u)) == false);
+
+    CHECK(wh.FindProductById("id1")->name == "new name");
+    CHECK(pricesOf("producerA") == std::vector<Product::Price>{20, 30});
+    CHECK(countInPriceRange(10, 10) == 0);
+    CHECK(countInPriceRange(30, 30) == 1);
+
+    // the holders of the replaced product keep it unchanged
+    CHECK(pOldProduct->name == "name1");
+    CHECK(pOldProduct->price == 10);
+  }
+
+  SUBCASE("the product moves to its new producer") {
+    CHECK(wh.UpsertProduct(MakeProduct("id1", "producerB", "name1", 10u)) == false);
+    CHECK(wh.CountProductsByProducer("producerA") == 1);
+    CHECK(pricesOf("producerB") == std::vector<Product::Price>{10});
+
+    CHECK(wh.RemoveProductById("id1") == 1);
+    CHECK(wh.CountProductsByProducer("producerB") == 0);
+    CHECK(countInPriceRange(0, 100) == 1);
+  }
+
+  SUBCASE("the price of the product is updated") {
+    CHECK(wh.UpdatePrice("id2", 5u) == true);
+    CHECK(wh.UpdatePrice("id2", 5u) == true);
+    CHECK(wh.UpdatePrice("id42", 5u) == false);
+
+    auto pProduct = wh.FindProductById("id2");
+    CHECK(pProduct->price == 5);
+    CHECK(pProduct->name == "name2");
+    CHECK(pricesOf("producerA") == std::vector<Product::Price>{5, 10});
+    CHECK(countOfProducerInPriceRange("producerA", 0u, 5u) == 1);
+    CHECK(countInPriceRange(20, 20) == 0);
+  }
+
+  SUBCASE("many updates keep the indexes consistent") {
+    for(unsigned i = 0; i < 1000; ++i)
+    {
+      REQUIRE(wh.UpdatePrice((i % 2)? "id1" : "id2", i % 37));
+    }
+    CHECK(countInPriceRange(0, 100) == 2);
+    CHECK(wh.CountProductsByProducer("producerA") == 2);
+    CHECK(wh.RemoveProductById("id1") == 1);
+    CHECK(wh.RemoveProductById("id2") == 1);
+    CHECK(countInPriceRange(0, 100) == 0);
+  }
+}
+
+TEST_CASE("finding batches of products by their ids") {
+
+  Warehouse wh;
+  std::vector<Warehouse::ProductPtr> foundProducts;
+
+  SUBCASE("empty warehouse => empty pointers for all ids") {
+    const std::vector<std::string> ids{"id1", "id2"};
+    CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(foundProducts)) == 0);
+    CHECK(foundProducts == std::vector<Warehouse::ProductPtr>(2));
+  }
+
+  SUBCASE("empty batch => nothing written") {
+    const std::vector<std::string> ids;
+    CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(foundProducts)) == 0);
+    CHECK(foundProducts.empty());
+  }
+
+  SUBCASE("the products are written in the order of the ids, missing ones as empty pointers") {
+    std::vector<std::string> ids;
+    for(int i = 0; i < 100; ++i)
+    {
+      const std::string id = "id" + std::to_string(i);
+      if(i % 3 != 0)
+      {
+        REQUIRE(wh.AddProduct(MakeProduct(id, "producer", "name", 1u)));
+      }
+      ids.push_back(id);
+    }
+    // the batch is longer than the prefetch distance and repeats the ids
+    std::reverse(ids.begin(), ids.end());
+    ids.push_back("id1");
+    ids.push_back("unknown");
+
+    CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(foundProducts)) == 67);
+    REQUIRE(foundProducts.size() == ids.size());
+    for(size_t i = 0; i < ids.size(); ++i)
+    {
+      CHECK(foundProducts[i] == wh.FindProductById(ids[i]));
+    }
+    CHECK(foundProducts[ids.size() - 2]->id == "id1");
+    CHECK(!foundProducts.back());
+  }
+
+  SUBCASE("the ids may be string views") {
+    REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)));
+    const std::string_view ids[] = {"id1", "id2"};
+    CHECK(wh.FindProductsByIds(std::begin(ids), std::end(ids), std::back_inserter(foundProducts)) == 1);
+    CHECK(foundProducts[0]->id == "id1");
+  }
+}
+
+TEST_CASE("finding products by the prefixes and the substrings of their names") {
+
+  Warehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "apple pie", 1u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerA", "apple", 2u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id3", "producerB", "pineapple", 3u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id4", "producerB", "banana", 4u)));
+  std::vector<Warehouse::ProductPtr> sink;
+
+  auto idsWithPrefix = [&wh](std::string_view prefix, size_t limit) {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    const size_t cntFound = wh.FindProductsByNamePrefix(prefix, limit, std::back_inserter(foundProducts));
+    CHECK(cntFound == foundProducts.size());
+    std::vector<std::string> ids;
+    for(const auto &pProduct : foundProducts)
+    {
+      ids.push_back(pProduct->id);
+    }
+    return ids;
+  };
+  auto idsWithSubstring = [&wh](std::string_view substring, size_t limit) {
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    const size_t cntFound = wh.FindProductsByNameSubstring(substring, limit, std::back_inserter(foundProducts));
+    CHECK(cntFound == foundProducts.size());
+    std::vector<std::string> ids;
+    for(const auto &pProduct : foundProducts)
+    {
+      ids.push_back(pProduct->id);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+  };
+
+  // the same results are found with and without the name index
+  for(bool isNameIndexEnabled : {false, true})
+  {
+    CAPTURE(isNameIndexEnabled);
+    if(isNameIndexEnabled)
+    {
+      wh.EnableNameIndex();
+    }
+    CHECK(wh.IsNameIndexEnabled() == isNameIndexEnabled);
+
+    CHECK(idsWithPrefix("apple", 10) == std::vector<std::string>{"id2", "id1"});
+    CHECK(idsWithPrefix("apple", 1) == std::vector<std::string>{"id2"});
+    CHECK(idsWithPrefix("", 10) == std::vector<std::string>{"id2", "id1", "id4", "id3"});
+    CHECK(idsWithPrefix("cherry", 10).empty());
+    CHECK(idsWithSubstring("apple", 10) == std::vector<std::string>{"id1", "id2", "id3"});
+    CHECK(idsWithSubstring("apple", 2).size() == 2);
+    CHECK(idsWithSubstring("na", 10) == std::vector<std::string>{"id4"});
+    CHECK(idsWithSubstring("apple", 0).empty());
+  }
+
+  SUBCASE("the name index follows the modifications") {
+    wh.EnableNameIndex();
+    CHECK(wh.RemoveProductById("id2") == 1);
+    CHECK(wh.UpsertProduct(MakeProduct("id4", "producerB", "bandana", 4u)) == false);
+    CHECK(wh.UpdatePrice("id1", 5u));
+    REQUIRE(wh.AddProduct(MakeProduct("id5", "producerC", "apple strudel", 6u)));
+
+    CHECK(idsWithPrefix("apple", 10) == std::vector<std::string>{"id1", "id5"});
+    CHECK(idsWithSubstring("ana", 10) == std::vector<std::string>{"id4"});
+    CHECK(idsWithSubstring("apple", 10) == std::vector<std::string>{"id1", "id3", "id5"});
+    CHECK(wh.FindProductsByNamePrefix("apple pie", 1, std::back_inserter(sink)) == 1);
+
+    // the found products are the current ones
+    std::vector<Warehouse::ProductPtr> foundProducts;
+    REQUIRE(wh.FindProductsByNamePrefix("apple pie", 1, std::back_inserter(foundProducts)) == 1);
+    CHECK(foundProducts[0]->price == 5);
+  }
+
+  SUBCASE("the name index is copied and loaded with the warehouse") {
+    wh.EnableNameIndex();
+    const Warehouse copy(wh);
+    REQUIRE(wh.RemoveProductById("id1") == 1);
+    CHECK(copy.IsNameIndexEnabled());
+    CHECK(copy.FindProductsByNameSubstring("pie", 10, std::back_inserter(sink)) == 1);
+    CHECK(idsWithSubstring("pie", 10).empty());
+
+    const std::string path = "Warehouse_test_names.snapshot";
+    REQUIRE(copy.SaveSnapshot(path));
+    REQUIRE(wh.LoadSnapshot(path));
+    std::remove(path.c_str());
+    CHECK(idsWithSubstring("pie", 10) == std::vector<std::string>{"id1"});
+    CHECK(wh.IsNameIndexEnabled());
+  }
+
+  SUBCASE("the name index is built by bulk loading the empty warehouse") {
+    std::vector<Warehouse::ProductPtr> products;
+    for(int i = 0; i < 1000; ++i)
+    {
+      products.push_back(MakeProduct("id" + std::to_string(i), "producer", "name " + std::to_string(i), 1u));
+    }
+    Warehouse bulk;
+    bulk.EnableNameIndex();
+    REQUIRE(bulk.AddProducts(products.begin(), products.end()) == 1000);
+    CHECK(bulk.FindProductsByNamePrefix("name 99", 100, std::back_inserter(sink)) == 11);
+    CHECK(bulk.FindProductsByNameSubstring("99", 100, std::back_inserter(sink)) == 19);
+    CHECK(bulk.FindProductsByNameSubstring("e 99", 100, std::back_inserter(sink)) == 11);
+    CHECK(bulk.RemoveProductById("id990") == 1);
+    CHECK(bulk.FindProductsByNameSubstring("e 99", 100, std::back_inserter(sink)) == 10);
+  }
+}
+
+TEST_CASE("scanning and aggregating all products of the warehouse") {
+
+  Warehouse wh;
+  for(int i = 0; i < 1000; ++i)
+  {
+    const std::string producer = "producer" + std::to_string(i % 7);
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), producer, "name", unsigned(i))));
+  }
+  // the producer without products is not aggregated
+  wh.GetProducerHandle("producer without products");
+  REQUIRE(wh.RemoveProductById("id0") == 1);
+
+  SUBCASE("empty warehouse => nothing visited or aggregated") {
+    Warehouse empty;
+    CHECK(empty.ForEachProduct(kParallelScan, [](const Product&) { FAIL("visited"); }) == 0);
+    CHECK(empty.AggregateByProducer(kParallelScan, 0u, [](unsigned acc, const Product&) { return acc; }).empty());
+    CHECK(empty.SnapshotProducts().empty());
+  }
+
+  SUBCASE("every product is visited once by any number of threads") {
+    for(size_t cntThreads : {1, 2, 4})
+    {
+      std::atomic<size_t> cntVisited{0}, sumOfPrices{0};
+      const ScanPolicy policy{cntThreads, 10};
+      CHECK(wh.ForEachProduct(policy, [&](const Product &product) {
+        cntVisited++;
+        sumOfPrices += product.price;
+      }) == 999);
+      CHECK(cntVisited == 999);
+      CHECK(sumOfPrices == 999 * 1000 / 2);
+    }
+  }
+
+  SUBCASE("the products of every producer are folded in the ascending order of the prices") {
+    const auto pricesByProducer = wh.AggregateByProducer(ScanPolicy{4, 1}, std::vector<unsigned>(),
+      [](std::vector<unsigned> &&prices, const Product &product) {
+        prices.push_back(product.price);
+        return std::move(prices);
+      });
+    REQUIRE(pricesByProducer.size() == 7);
+    for(size_t i = 0; i < pricesByProducer.size(); ++i)
+    {
+      CHECK(pricesByProducer[i].first == "producer" + std::to_string(i));
+      CHECK(std::is_sorted(pricesByProducer[i].second.begin(), pricesByProducer[i].second.end()));
+      CHECK(pricesByProducer[i].second.size() == wh.CountProductsByProducer(pricesByProducer[i].first));
+    }
+  }
+
+  SUBCASE("the sums by producer do not depend on the number of threads") {
+    auto sumByProducer = [&wh](const ScanPolicy &policy) {
+      return wh.AggregateByProducer(policy, size_t(0),
+        [](size_t sum, const Product &product) { return sum + product.price; });
+    };
+    const auto sums = sumByProducer(kSequentialScan);
+    REQUIRE(sums.size() == 7);
+    CHECK(sums[0].first == "producer0");
+    CHECK(sums[0].second == 142 * 143 / 2 * 7);
+    CHECK(sumByProducer(kParallelScan) == sums);
+    CHECK(sumByProducer(ScanPolicy{3, 1}) == sums);
+  }
+
+  SUBCASE("the snapshot is not changed by the later modifications") {
+    std::vector<Warehouse::ProductPtr> products = wh.SnapshotProducts();
+    auto producers = wh.SnapshotProductsByProducer();
+    REQUIRE(wh.RemoveProductById("id1") == 1);
+    REQUIRE(wh.AddProduct(MakeProduct("id1000", "new producer", "name", 1u)));
+    CHECK(products.size() == 999);
+    CHECK(producers.size() == 7);
+    CHECK(std::count_if(products.begin(), products.end(),
+      [](const Warehouse::ProductPtr &pProduct) { return pProduct->id == "id1"; }) == 1);
+  }
+
+  SUBCASE("the visitor may modify the warehouse") {
+    CHECK(wh.ForEachProduct(ScanPolicy{2, 100}, [&wh](const Product &product) {
+      wh.RemoveProductById(product.id);
+    }) == 999);
+    CHECK(wh.SnapshotProducts().empty());
+  }
+}
+
+TEST_CASE("stats and histograms of the prices of the warehouse") {
+
+  Warehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producerA", "name", 10u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id2", "producerB", "name", 20u)));
+  REQUIRE(wh.AddProduct(MakeProduct("id3", "producerA", "name", 30u)));
+  wh.GetProducerHandle("producer without products");
+
+  for(bool isPriceColumnsEnabled : {false, true})
+  {
+    CAPTURE(isPriceColumnsEnabled);
+    if(isPriceColumnsEnabled)
+    {
+      wh.EnablePriceColumns();
+    }
+    CHECK(wh.IsPriceColumnsEnabled() == isPriceColumnsEnabled);
+
+    const PriceStats stats = wh.GetPriceStats();
+    CHECK(stats.count == 3);
+    CHECK(stats.min == 10);
+    CHECK(stats.max == 30);
+    CHECK(stats.sum == 60);
+    CHECK(wh.GetPriceStats("producerA").sum == 40);
+    CHECK(wh.GetPriceStats("unknown").count == 0);
+
+    const auto statsByProducer = wh.GetPriceStatsByProducer();
+    REQUIRE(statsByProducer.size() == 2);
+    CHECK(statsByProducer[0].first == "producerA");
+    CHECK(statsByProducer[0].second.count == 2);
+    CHECK(statsByProducer[1].first == "producerB");
+    CHECK(statsByProducer[1].second.max == 20);
+
+    CHECK(wh.GetPriceHistogram({15, 20, 100}) == std::vector<size_t>{1, 0, 2, 0});
+    CHECK(wh.GetPriceHistogram({}) == std::vector<size_t>{3});
+  }
+
+  Warehouse empty;
+  empty.EnablePriceColumns();
+  CHECK(empty.GetPriceStats() == PriceStats());
+  CHECK(empty.GetPriceStatsByProducer().empty());
+  CHECK(empty.GetPriceHistogram({1}) == std::vector<size_t>{0, 0});
+}
+
+TEST_CASE("the price columns follow random modifications of the warehouse") {
+
+  std::mt19937 random(42);
+  Warehouse columnar, scanned;
+  columnar.EnablePriceColumns();
+  std::vector<Warehouse::ProductPtr> bulk;
+  for(int i = 0; i < 300; ++i)
+  {
+    bulk.push_back(MakeProduct("bulk" + std::to_string(i), "producer" + std::to_string(i % 4), "name", unsigned(i)));
+  }
+  // both bulk loads fill the empty warehouses by sorting
+  REQUIRE(columnar.AddProducts(bulk.begin(), bulk.end()) == 300);
+  REQUIRE(scanned.AddProducts(bulk.begin(), bulk.end()) == 300);
+
+  const std::vector<Product::Price> bounds{50, 100, 200, 500};
+  auto checkSame = [&bounds](const Warehouse &lhs, const Warehouse &rhs) {
+    CHECK(lhs.GetPriceStats() == rhs.GetPriceStats());
+    CHECK(lhs.GetPriceStatsByProducer() == rhs.GetPriceStatsByProducer());
+    CHECK(lhs.GetPriceHistogram(bounds) == rhs.GetPriceHistogram(bounds));
+  };
+
+  for(int i = 0; i < 2000; ++i)
+  {
+    const std::string id = "id" + std::to_string(random() % 200);
+    const std::string producer = "producer" + std::to_string(random() % 6);
+    const auto price = unsigned(random() % 1000);
+    switch(random() % 4)
+    {
+      case 0:
+        CHECK(columnar.AddProduct(MakeProduct(id, producer, "name", price)) ==
+          scanned.AddProduct(MakeProduct(id, producer, "name", price)));
+        break;
+      case 1:
+        CHECK(columnar.UpsertProduct(MakeProduct(id, producer, "name", price)) ==
+          scanned.UpsertProduct(MakeProduct(id, producer, "name", price)));
+        break;
+      case 2:
+        CHECK(columnar.UpdatePrice(id, price) == scanned.UpdatePrice(id, price));
+        break;
+      default:
+      {
+        const std::string removedId = (random() % 2)? id : "bulk" + std::to_string(random() % 300);
+        CHECK(columnar.RemoveProductById(removedId) == scanned.RemoveProductById(removedId));
+        break;
+      }
+    }
+    if(i % 100 == 0)
+    {
+      checkSame(columnar, scanned);
+    }
+  }
+  checkSame(columnar, scanned);
+
+  SUBCASE("copies keep the columns") {
+    Warehouse copy(columnar);
+    CHECK(copy.IsPriceColumnsEnabled());
+    checkSame(copy, scanned);
+  }
+
+  SUBCASE("loaded snapshots rebuild the columns") {
+    const std::string path = "Warehouse_test_columns.snapshot";
+    REQUIRE(scanned.SaveSnapshot(path));
+    Warehouse loaded;
+    loaded.EnablePriceColumns();
+    REQUIRE(loaded.LoadSnapshot(path));
+    CHECK(loaded.IsPriceColumnsEnabled());
+    checkSame(loaded, scanned);
+    std::remove(path.c_str());
+  }
+}
+
+TEST_CASE_TEMPLATE("warehouse with the given set of indexes", Indexes, IdWarehouseIndexes,
+  WarehouseIndexes<ByProducerIndex>, WarehouseIndexes<ByPriceIndex, ByNameIndex>, AllWarehouseIndexes) {
+
+  constexpr bool kHasProducerIndex = Indexes::template kHas<ByProducerIndex>;
+  constexpr bool kHasPriceIndex = Indexes::template kHas<ByPriceIndex>;
+  using IndexedWarehouse = BasicWarehouse<ExclusiveLocking, SharedProductTraits, Indexes>;
+
+  std::mt19937 random(42);
+  IndexedWarehouse wh;
+  Warehouse full;
+  if constexpr(Indexes::template kHas<ByNameIndex>)
+  {
+    wh.EnableNameIndex();
+  }
+  if constexpr(kHasPriceIndex)
+  {
+    wh.EnablePriceColumns();
+  }
+  std::vector<Warehouse::ProductPtr> bulk;
+  for(int i = 0; i < 300; ++i)
+  {
+    bulk.push_back(MakeProduct("bulk" + std::to_string(i), "producer" + std::to_string(i % 4),
+      "name" + std::to_string(i), unsigned(i)));
+  }
+  REQUIRE(wh.AddProducts(bulk.begin(), bulk.end()) == 300);
+  REQUIRE(full.AddProducts(bulk.begin(), bulk.end()) == 300);
+
+  auto sorted = [](std::vector<Warehouse::ProductPtr> products) {
+    std::sort(products.begin(), products.end());
+    return products;
+  };
+  auto checkSame = [&](const IndexedWarehouse &lhs, const Warehouse &rhs) {
+    for(int i = 0; i < 200; ++i)
+    {
+      const std::string id = "id" + std::to_string(i);
+      CHECK(lhs.FindProductById(id) == rhs.FindProductById(id));
+    }
+    std::vector<Warehouse::ProductPtr> lhsProducts, rhsProducts;
+    lhs.FindProductsByNamePrefix("name1", 1000, std::back_inserter(lhsProducts));
+    rhs.FindProductsByNamePrefix("name1", 1000, std::back_inserter(rhsProducts));
+    CHECK(lhsProducts == rhsProducts);
+    CHECK(sorted(lhs.SnapshotProducts()) == sorted(rhs.SnapshotProducts()));
+
+    if constexpr(kHasProducerIndex)
+    {
+      for(int producer = 0; producer < 6; ++producer)
+      {
+        const std::string name = "producer" + std::to_string(producer);
+        lhsProducts.clear();
+        rhsProducts.clear();
+        CHECK(lhs.FindProductsByProducer(name, std::back_inserter(lhsProducts)) ==
+          rhs.FindProductsByProducer(name, std::back_inserter(rhsProducts)));
+        CHECK(sorted(lhsProducts) == sorted(rhsProducts));
+      }
+    }
+    if constexpr(kHasPriceIndex)
+    {
+      lhsProducts.clear();
+      rhsProducts.clear();
+      CHECK(lhs.FindProductsByPriceRange(100, 500, std::back_inserter(lhsProducts)) ==
+        rhs.FindProductsByPriceRange(100, 500, std::back_inserter(rhsProducts)));
+      CHECK(sorted(lhsProducts) == sorted(rhsProducts));
+      CHECK(lhs.GetPriceStats() == rhs.GetPriceStats());
+    }
+  };
+
+  for(int i = 0; i < 2000; ++i)
+  {
+    const std::string id = "id" + std::to_string(random() % 200);
+    const auto pProduct = MakeProduct(id, "producer" + std::to_string(random() % 6),
+      "name" + std::to_string(random() % 50), unsigned(random() % 1000));
+    switch(random() % 4)
+    {
+      case 0:
+        CHECK(wh.AddProduct(pProduct) == full.AddProduct(pProduct));
+        break;
+      case 1:
+        CHECK(wh.UpsertProduct(pProduct) == full.UpsertProduct(pProduct));
+        break;
+      case 2:
+      {
+        // the updated products are made by every warehouse, so only their prices are compared
+        CHECK(wh.UpdatePrice(id, pProduct->price) == full.UpdatePrice(id, pProduct->price));
+        auto pUpdated = wh.FindProductById(id);
+        if(pUpdated)
+        {
+          CHECK(pUpdated->price == pProduct->price);
+          REQUIRE(wh.UpsertProduct(full.FindProductById(id)) == false);
+        }
+        break;
+      }
+      default:
+      {
+        const std::string removedId = (random() % 2)? id : "bulk" + std::to_string(random() % 300);
+        CHECK(wh.RemoveProductById(removedId) == full.RemoveProductById(removedId));
+        break;
+      }
+    }
+    if(i % 100 == 0)
+    {
+      checkSame(wh, full);
+    }
+  }
+  checkSame(wh, full);
+  CHECK(wh.GetStats().cntProducts == full.GetStats().cntProducts);
+
+  SUBCASE("copies have the same products") {
+    IndexedWarehouse copy(wh);
+    checkSame(copy, full);
+  }
+
+  SUBCASE("snapshots are loaded by the warehouses with any indexes") {
+    const std::string path = "Warehouse_test_indexes.snapshot";
+    REQUIRE(wh.SaveSnapshot(path));
+    Warehouse loaded;
+    REQUIRE(loaded.LoadSnapshot(path));
+    for(int producer = 0; producer < 6; ++producer)
+    {
+      const std::string name = "producer" + std::to_string(producer);
+      CHECK(loaded.CountProductsByProducer(name) == full.CountProductsByProducer(name));
+    }
+
+    REQUIRE(full.SaveSnapshot(path));
+    IndexedWarehouse loadedIndexed;
+    REQUIRE(loadedIndexed.LoadSnapshot(path));
+    CHECK(loadedIndexed.GetStats().cntProducts == full.GetStats().cntProducts);
+    for(const auto &pProduct : full.SnapshotProducts())
+    {
+      auto pLoaded = loadedIndexed.FindProductById(pProduct->id);
+      REQUIRE(pLoaded);
+      CHECK(pLoaded->producer == pProduct->producer);
+      CHECK(pLoaded->price == pProduct->price);
+    }
+    std::remove(path.c_str());
+  }
+}
+
+TEST_CASE("the missing indexes take no memory") {
+
+  static_assert(sizeof(BasicWarehouse<NoLocking, SharedProductTraits, IdWarehouseIndexes>) <
+    sizeof(BasicWarehouse<NoLocking>));
+
+  CountingResource idResource, producerResource, allResource;
+  BasicWarehouse<NoLocking, SharedProductTraits, IdWarehouseIndexes> idOnly(&idResource);
+  BasicWarehouse<NoLocking, SharedProductTraits, WarehouseIndexes<ByProducerIndex>> byProducer(&producerResource);
+  BasicWarehouse<NoLocking> all(&allResource);
+  for(int i = 0; i < 1000; ++i)
+  {
+    const auto pProduct = MakeProduct("id" + std::to_string(i), "producer" + std::to_string(i % 10), "name", 1u);
+    REQUIRE(idOnly.AddProduct(pProduct));
+    REQUIRE(byProducer.AddProduct(pProduct));
+    REQUIRE(all.AddProduct(pProduct));
+  }
+  CHECK(idOnly.GetStats().idIndexCapacity == all.GetStats().idIndexCapacity);
+  CHECK(idResource.cntBytesInUse < producerResource.cntBytesInUse);
+  CHECK(producerResource.cntBytesInUse < allResource.cntBytesInUse);
+  CHECK(idOnly.GetStats().cntProducers == 0);
+}
+
+TEST_CASE("expiring products") {
+
+  using ExpiringWarehouse = BasicWarehouse<ExclusiveLocking, SharedProductTraits, ExpiringWarehouseIndexes>;
+  using namespace std::chrono_literals;
+
+  ExpiringWarehouse wh;
+  const auto now = ExpiringWarehouse::ExpiryClock::now();
+  for(int i = 0; i < 100; ++i)
+  {
+    // the even products have expired already, the odd ones expire in an hour
+    const auto expiry = (i % 2)? now + 1h : now - 1s;
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", unsigned(i)), expiry));
+  }
+  REQUIRE(wh.AddProduct(MakeProduct("forever", "producer", "name", 1u)));
+  CHECK(wh.GetStats().cntProducts == 101);
+
+  SUBCASE("the lookups treat the expired products as absent") {
+    CHECK(!wh.FindProductById("id0"));
+    CHECK(wh.FindProductById("id1"));
+    CHECK(wh.FindProductById("forever"));
+    CHECK(!wh.VisitProductById("id2", [](const Product &) {}));
+    CHECK(!wh.UpdatePrice("id2", 5));
+    CHECK(wh.UpdatePrice("id3", 5));
+    CHECK(wh.FindProductById("id3")->price == 5);
+
+    const std::vector<std::string> ids{"id0", "id1", "id2"};
+    std::vector<Warehouse::ProductPtr> found;
+    CHECK(wh.FindProductsByIds(ids.begin(), ids.end(), std::back_inserter(found)) == 1);
+    CHECK(!found[0]);
+    CHECK(found[1]);
+
+    CHECK(wh.RemoveProductById("id4") == 0);
+    CHECK(wh.RemoveProductById("id5") == 1);
+    CHECK(wh.GetStats().cntProducts == 99);
+  }
+
+  SUBCASE("an expired product is replaced by a new product with the same id") {
+    CHECK(wh.AddProduct(MakeProduct("id0", "producer", "name", 7u)));
+    CHECK(wh.FindProductById("id0")->price == 7);
+    CHECK(!wh.AddProduct(MakeProduct("id1", "producer", "name", 7u)));
+    CHECK(wh.UpsertProduct(MakeProduct("id2", "producer", "name", 7u)) == true);
+    CHECK(wh.UpsertProduct(MakeProduct("id3", "producer", "name", 7u)) == false);
+    CHECK(wh.ReapExpiredProducts(1000) == 48);
+    CHECK(wh.FindProductById("id0"));
+    CHECK(wh.FindProductById("id2"));
+  }
+
+  SUBCASE("the expired products are reaped in batches") {
+    CHECK(wh.ReapExpiredProducts(20) == 20);
+    CHECK(wh.ReapExpiredProducts(20) == 20);
+    CHECK(wh.ReapExpiredProducts(20) == 10);
+    CHECK(wh.ReapExpiredProducts(20) == 0);
+    CHECK(wh.GetStats().cntProducts == 51);
+    CHECK(wh.CountProductsByProducer("producer") == 51);
+    CHECK(wh.FindProductById("id99"));
+  }
+
+  SUBCASE("the removed products are not reaped") {
+    for(int i = 0; i < 100; ++i)
+    {
+      wh.RemoveProductById("id" + std::to_string(i));
+    }
+    CHECK(wh.ReapExpiredProducts(1000) == 0);
+    CHECK(wh.GetStats().cntProducts == 1);
+  }
+
+  SUBCASE("copies and swapped warehouses reap their own products") {
+    ExpiringWarehouse copy(wh);
+    CHECK(copy.ReapExpiredProducts(1000) == 50);
+    CHECK(wh.GetStats().cntProducts == 101);
+    wh = copy;
+    CHECK(wh.ReapExpiredProducts(1000) == 0);
+    CHECK(wh.GetStats().cntProducts == 51);
+  }
+
+  SUBCASE("the products expire while the warehouse is used") {
+    REQUIRE(wh.AddProduct(MakeProduct("soon", "producer", "name", 1u), ExpiringWarehouse::ExpiryClock::now() + 20ms));
+    CHECK(wh.FindProductById("soon"));
+    std::this_thread::sleep_for(40ms);
+    CHECK(!wh.FindProductById("soon"));
+    CHECK(wh.ReapExpiredProducts(1000) == 51);
+    CHECK(wh.GetStats().cntProducts == 51);
+  }
+}
+
+TEST_CASE("the warehouses without the expiry index do not pay for it") {
+
+  static_assert(sizeof(BasicWarehouse<NoLocking>) <
+    sizeof(BasicWarehouse<NoLocking, SharedProductTraits, ExpiringWarehouseIndexes>));
+
+  CountingResource resource, expiringResource;
+  BasicWarehouse<NoLocking> wh(&resource);
+  BasicWarehouse<NoLocking, SharedProductTraits, ExpiringWarehouseIndexes> expiring(&expiringResource);
+  for(int i = 0; i < 1000; ++i)
+  {
+    const auto pProduct = MakeProduct("id" + std::to_string(i), "producer", "name", 1u);
+    REQUIRE(wh.AddProduct(pProduct));
+    REQUIRE(expiring.AddProduct(pProduct));
+  }
+  CHECK(resource.cntBytesInUse < expiringResource.cntBytesInUse);
+}
+
+TEST_CASE("bounded warehouse") {
+
+  using BoundedWarehouse = BasicWarehouse<ExclusiveLocking, SharedProductTraits, BoundedWarehouseIndexes>;
+
+  BoundedWarehouse wh;
+  for(int i = 0; i < 100; ++i)
+  {
+    REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", unsigned(i))));
+  }
+
+  SUBCASE("the products above the capacity are evicted") {
+    CHECK(wh.SetCapacity(50) == 50);
+    CHECK(wh.GetStats().cntProducts == 50);
+    CHECK(wh.CountProductsByProducer("producer") == 50);
+    for(int i = 100; i < 200; ++i)
+    {
+      REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", unsigned(i))));
+      REQUIRE(wh.GetStats().cntProducts == 50);
+    }
+    CHECK(wh.UpsertProduct(MakeProduct("id200", "producer", "name", 1u)));
+    CHECK(wh.GetStats().cntProducts == 50);
+    CHECK(wh.GetStats().cntEvictions == 151);
+    CHECK(wh.FindProductById("id200"));
+    CHECK(wh.SetCapacity(100) == 0);
+  }
+
+  SUBCASE("the used products are not evicted") {
+    CHECK(wh.SetCapacity(100) == 0);
+
+    // the first eviction sweeps over all products and clears the marks of their additions
+    REQUIRE(wh.AddProduct(MakeProduct("first", "producer", "name", 1u)));
+    std::vector<std::string> hotIds;
+    for(int i = 0; hotIds.size() < 10; ++i)
+    {
+      if(wh.FindProductById("id" + std::to_string(i)))
+      {
+        hotIds.push_back("id" + std::to_string(i));
+      }
+    }
+
+    for(int i = 100; i < 1000; ++i)
+    {
+      for(const std::string &id : hotIds)
+      {
+        REQUIRE(wh.FindProductById(id));
+      }
+      REQUIRE(wh.AddProduct(MakeProduct("id" + std::to_string(i), "producer", "name", unsigned(i))));
+    }
+    CHECK(wh.GetStats().cntProducts == 100);
+    CHECK(wh.GetStats().cntEvictions == 901);
+    CHECK(wh.FindProductById("id999"));
+  }
+
+  SUBCASE("the products are evicted by their bytes") {
+    CHECK(wh.SetCapacity(1000, 10000) > 0);
+    const size_t cntProducts = wh.GetStats().cntProducts;
+    CHECK(cntProducts < 100);
+    CHECK(cntProducts > 0);
+
+    // a product with the longer strings takes the place of several ones
+    REQUIRE(wh.AddProduct(MakeProduct("long", std::string(1000, 'p'), std::string(1000, 'n'), 1u)));
+    CHECK(wh.GetStats().cntProducts < cntProducts);
+    CHECK(wh.FindProductById("long"));
+  }
+
+  SUBCASE("the removed and the replaced products free their bytes") {
+    CHECK(wh.SetCapacity(1000, 10000) > 0);
+    const size_t cntProducts = wh.GetStats().cntProducts;
+    std::string id;
+    for(int i = 0; id.empty(); ++i)
+    {
+      if(wh.FindProductById("id" + std::to_string(i)))
+      {
+        id = "id" + std::to_string(i);
+      }
+    }
+    REQUIRE(wh.UpsertProduct(MakeProduct(id, "producer", "name", 7u)) == false);
+    CHECK(wh.GetStats().cntProducts == cntProducts);
+    CHECK(wh.RemoveProductById(id) == 1);
+    REQUIRE(wh.AddProduct(MakeProduct(id, "producer", "name", 7u)));
+    CHECK(wh.GetStats().cntProducts == cntProducts);
+    CHECK(wh.GetStats().cntEvictions == 100 - cntProducts);
+  }
+
+  SUBCASE("copies are bounded as the original") {
+    CHECK(wh.SetCapacity(50) == 50);
+    BoundedWarehouse copy(wh);
+    REQUIRE(copy.AddProduct(MakeProduct("new", "producer", "name", 1u)));
+    CHECK(copy.GetStats().cntProducts == 50);
+    CHECK(wh.GetStats().cntProducts == 50);
+    CHECK(!wh.FindProductById("new"));
+  }
+
+  SUBCASE("a loaded snapshot replaces the bytes of the products") {
+    // the smallest byte budget that keeps all products
+    size_t maxBytes = 0;
+    for(size_t step = size_t(1) << 20; step > 0; step /= 2)
+    {
+      BoundedWarehouse copy(wh);
+      if(copy.SetCapacity(1000, maxBytes + step - 1) > 0)
+      {
+        maxBytes += step;
+      }
+    }
+    REQUIRE(wh.SetCapacity(1000, maxBytes) == 0);
+
+    const std::string path = "Warehouse_test_bounded.snapshot";
+    REQUIRE(wh.SaveSnapshot(path));
+    REQUIRE(wh.LoadSnapshot(path));
+    CHECK(wh.GetStats().cntProducts == 100);
+    CHECK(wh.GetStats().cntEvictions == 0);
+    CHECK(wh.SetCapacity(1000, maxBytes - 1) == 1);
+    std::remove(path.c_str());
+  }
+}
+
+TEST_CASE("products loaded on the misses of the bounded warehouse") {
+
+  using BoundedWarehouse = BasicWarehouse<SharedLocking, SharedProductTraits, BoundedWarehouseIndexes>;
+
+  BoundedWarehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id0", "producer", "name", 0u)));
+  CHECK(wh.FindOrLoadProductById("id0"));
+  CHECK(!wh.FindOrLoadProductById("id1"));
+
+  std::atomic<int> cntLoads{0};
+  wh.SetLoader([&cntLoads](std::string_view id) -> BoundedWarehouse::ProductPtr {
+    ++cntLoads;
+    if(id == "missing")
+    {
+      return nullptr;
+    }
+    if(id == "broken")
+    {
+      throw std::runtime_error("the backing store is down");
+    }
+    // a slow backing store, so the concurrent misses of the same id overlap
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return MakeProduct(std::string(id), "loaded", "name", 1u);
+  });
+  CHECK(wh.SetCapacity(10) == 0);
+
+  SUBCASE("a missing product is loaded once") {
+    const auto pProduct = wh.FindOrLoadProductById("id1");
+    REQUIRE(pProduct);
+    CHECK(pProduct->producer == "loaded");
+    CHECK(wh.FindOrLoadProductById("id1") == pProduct);
+    CHECK(wh.FindProductById("id1") == pProduct);
+    CHECK(wh.FindOrLoadProductById("id0")->producer == "producer");
+    CHECK(cntLoads == 1);
+  }
+
+  SUBCASE("the concurrent misses of the same id call the loader once") {
+    std::vector<BoundedWarehouse::ProductPtr> found(8);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < found.size(); ++i)
+    {
+      threads.emplace_back([&wh, &found, i]() { found[i] = wh.FindOrLoadProductById(i % 2? "odd" : "even"); });
+    }
+    for(auto &thread : threads)
+    {
+      thread.join();
+    }
+    CHECK(cntLoads == 2);
+    for(size_t i = 0; i < found.size(); ++i)
+    {
+      REQUIRE(found[i]);
+      CHECK(found[i] == found[i % 2]);
+    }
+  }
+
+  SUBCASE("the loaded products are evicted as the added ones") {
+    for(int i = 1; i < 30; ++i)
+    {
+      REQUIRE(wh.FindOrLoadProductById("id" + std::to_string(i)));
+    }
+    CHECK(wh.GetStats().cntProducts == 10);
+    CHECK(cntLoads == 29);
+  }
+
+  SUBCASE("the products that the loader misses are not added") {
+    CHECK(!wh.FindOrLoadProductById("missing"));
+    CHECK(!wh.FindOrLoadProductById("missing"));
+    CHECK(cntLoads == 2);
+    CHECK(wh.GetStats().cntProducts == 1);
+  }
+
+  SUBCASE("the exceptions of the loader are rethrown") {
+    CHECK_THROWS_AS(wh.FindOrLoadProductById("broken"), std::runtime_error);
+    CHECK_THROWS_AS(wh.FindOrLoadProductById("broken"), std::runtime_error);
+    CHECK(cntLoads == 2);
+    CHECK(wh.FindOrLoadProductById("id1"));
+  }
+}
+
+#ifndef WAREHOUSE_STATS
+TEST_CASE("stats of the warehouse without WAREHOUSE_STATS") {
+
+  Warehouse wh;
+  REQUIRE(wh.AddProduct(MakeProduct("id1", "producer", "name", 1u)));
+
+  // only the sizes of the indexes are known
+  const WarehouseStats stats = wh.GetStats();
+  CHECK(stats.enabled == false);
+  CHECK(stats[WarehouseOperation::AddProduct].latency.count == 0);
+  CHECK(stats.cntProducts == 1);
+  CHECK(stats.cntProducers == 1);
+  CHECK(stats.idIndexCapacity > 0);
+}
+#endif